@@ -0,0 +1,109 @@
+//! Cost model accuracy: the CPU time `dnaKernelCost` predicts from a fresh
+//! calibration next to the CPU time the kernels actually take.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const iterations = 2;
+const chunks = 4;
+const pattern_len = 12;
+const panel_size = 16;
+const k = 3;
+
+const Fixture = struct {
+    ctx: openfhe.CryptoContext,
+    seqs: [chunks]openfhe.Ciphertext,
+    patterns: [panel_size][]const u8,
+};
+
+pub fn run(alloc: std.mem.Allocator, out: *std.Io.Writer) !void {
+    var ctx = try openfhe.CryptoContext.createBgv(.{ .multiplicative_depth = k });
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    const model = try ctx.calibrateCostModel(3);
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    const single = try openfhe.dnaHammingScanRotations(pattern_len, alloc);
+    defer alloc.free(single);
+    const multi = try ctx.dnaHammingMultiRotations(pattern_len, alloc);
+    defer alloc.free(multi);
+    const kmer = try ctx.dnaKmerRotations(k, alloc);
+    defer alloc.free(kmer);
+    try ctx.evalRotateKeysGen(sk, single);
+    try ctx.evalRotateKeysGen(sk, multi);
+    try ctx.evalRotateKeysGen(sk, kmer);
+
+    var prng = std.Random.DefaultPrng.init(5);
+    const random = prng.random();
+    const bases = try alloc.alloc(u8, ctx.getRingDim() / 4);
+    defer alloc.free(bases);
+
+    var storage: [panel_size][pattern_len]u8 = undefined;
+    var fixture = Fixture{ .ctx = ctx, .seqs = undefined, .patterns = undefined };
+    for (&storage, &fixture.patterns) |*pattern, *slice| {
+        for (pattern) |*base| base.* = "ACGT"[random.uintLessThan(usize, 4)];
+        slice.* = pattern;
+    }
+    for (&fixture.seqs) |*ct| {
+        for (bases) |*base| base.* = "ACGT"[random.uintLessThan(usize, 4)];
+        var pt = try ctx.makeDnaPlaintext(bases);
+        defer pt.deinit();
+        ct.* = try ctx.encrypt(pk, pt);
+    }
+    defer for (&fixture.seqs) |*ct| ct.deinit();
+
+    try out.print("\n== cost ==\n{d} chunks, ring dimension {d}, {d} towers\n", .{ chunks, model.raw.ring_dim, model.raw.towers });
+    try out.print("{s:<24} {s:>16} {s:>16} {s:>8} {s:>16}\n", .{
+        "kernel", "predicted cpu ms", "measured cpu ms", "ratio", "predicted peak MB",
+    });
+    try compare(alloc, out, "hamming", try ctx.dnaKernelCost(model, .hamming, chunks, pattern_len, 0), &fixture, hamming);
+    try compare(alloc, out, "hamming multi", try ctx.dnaKernelCost(model, .hamming_multi, chunks, pattern_len, panel_size), &fixture, hammingMulti);
+    try compare(alloc, out, "kmer", try ctx.dnaKernelCost(model, .kmer, chunks, k, 0), &fixture, kmerHistogram);
+}
+
+fn compare(
+    alloc: std.mem.Allocator,
+    out: *std.Io.Writer,
+    name: []const u8,
+    predicted: openfhe.CostEstimate,
+    fixture: *Fixture,
+    comptime f: fn (*Fixture, std.mem.Allocator) anyerror!void,
+) !void {
+    const result = try util.measure(alloc, iterations, fixture, f);
+    const measured = @as(f64, @floatFromInt(result.cpu_ns / iterations)) / std.time.ns_per_ms;
+    const estimate = @as(f64, @floatFromInt(predicted.cpu_ns)) / std.time.ns_per_ms;
+    try out.print("{s:<24} {d:>16.1} {d:>16.1} {d:>8.2} {d:>16.1}\n", .{
+        name,
+        estimate,
+        measured,
+        estimate / measured,
+        @as(f64, @floatFromInt(predicted.peak_bytes)) / (1024 * 1024),
+    });
+}
+
+fn hamming(f: *Fixture, arena: std.mem.Allocator) anyerror!void {
+    var profiles: [chunks]openfhe.Ciphertext = undefined;
+    try f.ctx.dnaHammingScan(&f.seqs, f.patterns[0], &profiles, arena);
+    for (&profiles) |*ct| ct.deinit();
+}
+
+fn hammingMulti(f: *Fixture, arena: std.mem.Allocator) anyerror!void {
+    const profiles = try f.ctx.dnaHammingScanMulti(&f.seqs, &f.patterns, arena);
+    for (profiles) |*ct| ct.deinit();
+}
+
+fn kmerHistogram(f: *Fixture, arena: std.mem.Allocator) anyerror!void {
+    const counts = try f.ctx.dnaKmerHistogram(&f.seqs, k, arena);
+    for (counts) |*ct| ct.deinit();
+}
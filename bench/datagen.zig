@@ -0,0 +1,552 @@
+//! Synthetic encrypted genome generator: `zig build datagen -Doptimize=ReleaseFast -- [options]`
+//!
+//! Synthesizes an ACGT sequence from a seed, plants patterns into it,
+//! packs it in the slot layout `dnaLayoutPlan` picks for the target kernel
+//! and encrypts the chunks on all cores. The ciphertexts are written as an
+//! upload-ready frame stream and, with `--store`, straight into a session of
+//! the segment store. `manifest.json` records the ground truth: composition,
+//! planted and actual pattern positions and optionally a k-mer histogram, so
+//! kernel results can be checked against it after decryption.
+//!
+//! The sequence is generated in fixed blocks, each from its own seed derived
+//! from `--seed` and the block index, so the output does not depend on the
+//! number of threads.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const uuid = @import("uuid");
+
+const usage =
+    \\usage: datagen [options]
+    \\  --out DIR                 output directory (default datagen-out)
+    \\  --seed N                  generator seed (default 1)
+    \\  --length N[K|M|G]         bases to generate (default 1M)
+    \\  --gc F                    G+C fraction of called bases (default 0.41)
+    \\  --n-rate F                fraction of N bases (default 0)
+    \\  --plant PATTERN:COUNT     plant COUNT copies of PATTERN, repeatable
+    \\  --kernel NAME             hamming | hamming_multi | kmer | compare (default hamming)
+    \\  --window N                bases per window (default: longest pattern or --kmer,
+    \\                            1 for compare)
+    \\  --kmer K                  add the exact K-mer histogram to the manifest
+    \\  --max-positions N         occurrence positions listed per pattern (default 10000)
+    \\  --batch N                 chunks encrypted per batch (default 4 per core)
+    \\  --public-key FILE         encrypt under this key instead of a new key pair
+    \\  --store DIR --session ID  also write the chunks into a segment store session
+    \\  --fhe-depth N, --fhe-plaintext-modulus T, --fhe-ring-dim N, --fhe-security L
+    \\                            context parameters (server defaults)
+;
+
+/// Bases per generation block; the unit the seed is split over
+const block_bases = 1 << 20;
+const max_kmer = 12;
+
+const Plant = struct {
+    pattern: []const u8,
+    count: usize,
+};
+
+const Options = struct {
+    out: []const u8 = "datagen-out",
+    seed: u64 = 1,
+    length: usize = 1 << 20,
+    gc: f64 = 0.41,
+    n_rate: f64 = 0,
+    plants: []const Plant = &.{},
+    kernel: openfhe.DnaKernel = .hamming,
+    window: ?usize = null,
+    kmer: ?u32 = null,
+    max_positions: usize = 10_000,
+    batch: usize = 0,
+    public_key: ?[]const u8 = null,
+    store: ?[:0]const u8 = null,
+    session: ?[]const u8 = null,
+    params: openfhe.BgvParams = .{},
+
+    fn windowBases(self: Options) usize {
+        if (self.window) |window| return window;
+        // Comparisons are slot by slot
+        if (self.kernel == .compare) return 1;
+        var longest: usize = if (self.kmer) |k| k else 1;
+        for (self.plants) |p| longest = @max(longest, p.pattern.len);
+        return longest;
+    }
+};
+
+const Composition = struct {
+    A: u64 = 0,
+    C: u64 = 0,
+    G: u64 = 0,
+    T: u64 = 0,
+    N: u64 = 0,
+};
+
+const PatternTruth = struct {
+    pattern: []const u8,
+    /// Where copies were planted; later plants never overlap earlier ones
+    planted: []const usize,
+    /// Every exact match, planted or not, overlapping matches included
+    occurrences: usize,
+    /// The first `--max-positions` matches in ascending order
+    positions: []const usize,
+};
+
+const Manifest = struct {
+    seed: u64,
+    length: usize,
+    gc: f64,
+    nRate: f64,
+    params: struct {
+        multiplicativeDepth: u32,
+        plaintextModulus: u64,
+        ringDim: u32,
+        securityLevel: u32,
+    },
+    kernel: []const u8,
+    window: usize,
+    layout: struct {
+        kind: []const u8,
+        stride: u32,
+        rowBases: u32,
+        overlap: u32,
+    },
+    /// Chunk i holds bases [i * basesPerChunk, i * basesPerChunk + basesPerChunk + overlap)
+    basesPerChunk: usize,
+    chunks: usize,
+    /// In ciphertext order; the channels layout stores four per chunk
+    ciphertexts: usize,
+    ciphertextBytes: u64,
+    composition: Composition,
+    patterns: []const PatternTruth,
+    /// Counts of every k-mer without N, in lexicographic order (A < C < G < T)
+    kmers: ?struct { k: u32, counts: []const u64 },
+};
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const alloc = gpa.allocator();
+
+    const args = try std.process.argsAlloc(alloc);
+    defer std.process.argsFree(alloc, args);
+
+    var arena = std.heap.ArenaAllocator.init(alloc);
+    defer arena.deinit();
+
+    const options = parseArgs(arena.allocator(), args) catch |err| {
+        std.log.err("{}\n{s}", .{ err, usage });
+        return err;
+    };
+
+    var stdout_buffer: [4096]u8 = undefined;
+    var stdout_writer = std.fs.File.stdout().writer(&stdout_buffer);
+    const out = &stdout_writer.interface;
+
+    try std.fs.cwd().makePath(options.out);
+    var dir = try std.fs.cwd().openDir(options.out, .{});
+    defer dir.close();
+
+    try out.print("\n== datagen ==\nseed {d}, {d} bases, GC {d:.2}, N {d:.4}\n", .{ options.seed, options.length, options.gc, options.n_rate });
+    try out.flush();
+
+    var timer = try std.time.Timer.start();
+    const genome = try alloc.alloc(u8, options.length);
+    defer alloc.free(genome);
+    try synthesize(options, genome);
+    const planted = try plant(arena.allocator(), options, genome);
+    try out.print("synthesized in {d} ms\n", .{timer.lap() / std.time.ns_per_ms});
+    try out.flush();
+
+    var ctx = try openfhe.CryptoContext.createBgv(options.params);
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var pk = if (options.public_key) |path| blk: {
+        const blob = try std.fs.cwd().readFileAlloc(alloc, path, 1 << 30);
+        defer alloc.free(blob);
+        break :blk try openfhe.PublicKey.deserialize(blob, .binary);
+    } else try generateKeys(alloc, ctx, dir);
+    defer pk.deinit();
+
+    const window = options.windowBases();
+    const plan = try ctx.dnaLayoutPlan(options.kernel, options.length, window);
+    const kind: openfhe.DnaLayoutKind = @enumFromInt(plan.layout.kind);
+    try out.print("{s} layout for {s}, window {d}: {d} chunks of {d} bases, {d} ciphertexts\n", .{
+        @tagName(kind), @tagName(options.kernel), window, plan.chunks, plan.bases_per_chunk, plan.ciphertexts,
+    });
+    try out.flush();
+
+    var store: ?openfhe.SegmentStore = if (options.store) |path| try openfhe.SegmentStore.open(path, 0) else null;
+    defer if (store) |*s| s.close();
+
+    const written = try encrypt(alloc, options, ctx, pk, plan, genome, dir, store);
+    try out.print("encrypted {d} ciphertexts ({d} MB) in {d} ms\n", .{
+        plan.ciphertexts, written / (1024 * 1024), timer.lap() / std.time.ns_per_ms,
+    });
+    try out.flush();
+
+    var manifest = Manifest{
+        .seed = options.seed,
+        .length = options.length,
+        .gc = options.gc,
+        .nRate = options.n_rate,
+        .params = .{
+            .multiplicativeDepth = options.params.multiplicative_depth,
+            .plaintextModulus = options.params.plaintext_modulus,
+            .ringDim = ctx.getRingDim(),
+            .securityLevel = options.params.security_level,
+        },
+        .kernel = @tagName(options.kernel),
+        .window = window,
+        .layout = .{
+            .kind = @tagName(kind),
+            .stride = plan.layout.stride,
+            .rowBases = plan.layout.row_bases,
+            .overlap = plan.layout.overlap,
+        },
+        .basesPerChunk = plan.bases_per_chunk,
+        .chunks = plan.chunks,
+        .ciphertexts = plan.ciphertexts,
+        .ciphertextBytes = written,
+        .composition = composition(genome),
+        .patterns = try groundTruth(arena.allocator(), options, genome, planted),
+        .kmers = null,
+    };
+    if (options.kmer) |k| manifest.kmers = .{ .k = k, .counts = try kmerCounts(arena.allocator(), genome, k) };
+
+    const file = try dir.createFile("manifest.json", .{});
+    defer file.close();
+    var buffer: [64 * 1024]u8 = undefined;
+    var writer = file.writer(&buffer);
+    try std.json.Stringify.value(manifest, .{ .whitespace = .indent_2 }, &writer.interface);
+    try writer.interface.writeByte('\n');
+    try writer.interface.flush();
+
+    try out.print("ground truth in {d} ms, written to {s}/manifest.json\n", .{ timer.lap() / std.time.ns_per_ms, options.out });
+    try out.flush();
+}
+
+/// Fills `genome` block by block on all cores
+fn synthesize(options: Options, genome: []u8) !void {
+    const Shared = struct {
+        options: Options,
+        genome: []u8,
+        next: std.atomic.Value(usize) = .init(0),
+
+        fn run(self: *@This()) void {
+            const blocks = std.math.divCeil(usize, self.genome.len, block_bases) catch unreachable;
+            while (true) {
+                const block = self.next.fetchAdd(1, .monotonic);
+                if (block >= blocks) return;
+                const start = block * block_bases;
+                fillBlock(self.options, block, self.genome[start..@min(self.genome.len, start + block_bases)]);
+            }
+        }
+    };
+
+    var shared = Shared{ .options = options, .genome = genome };
+    var threads: [256]std.Thread = undefined;
+    const count = @min(threads.len, std.Thread.getCpuCount() catch 1);
+    var spawned: usize = 0;
+    defer for (threads[0..spawned]) |thread| thread.join();
+    while (spawned < count) : (spawned += 1) {
+        threads[spawned] = try std.Thread.spawn(.{}, Shared.run, .{&shared});
+    }
+}
+
+fn fillBlock(options: Options, block: usize, bases: []u8) void {
+    var prng = std.Random.DefaultPrng.init(std.hash.Wyhash.hash(options.seed, std.mem.asBytes(&@as(u64, block))));
+    const random = prng.random();
+    const at = (1 - options.gc) / 2;
+    for (bases) |*base| {
+        const u = random.float(f64);
+        if (u < options.n_rate) {
+            base.* = 'N';
+            continue;
+        }
+        // Rescale to the called bases
+        const v = (u - options.n_rate) / (1 - options.n_rate);
+        base.* = if (v < at) 'A' else if (v < 2 * at) 'T' else if (v < 2 * at + options.gc / 2) 'G' else 'C';
+    }
+}
+
+/// Writes the planted copies into `genome` and returns their positions per
+/// plant. The genome is cut into one slot per copy and the slots are dealt
+/// out in a seeded shuffle, so copies never overlap.
+fn plant(alloc: std.mem.Allocator, options: Options, genome: []u8) ![][]usize {
+    var total: usize = 0;
+    var longest: usize = 0;
+    for (options.plants) |p| {
+        total += p.count;
+        longest = @max(longest, p.pattern.len);
+    }
+    const positions = try alloc.alloc([]usize, options.plants.len);
+    if (total == 0) {
+        for (positions) |*list| list.* = &.{};
+        return positions;
+    }
+    const slot = genome.len / total;
+    if (slot < longest) return error.TooManyPlants;
+
+    const slots = try alloc.alloc(usize, total);
+    for (slots, 0..) |*s, i| s.* = i;
+    var prng = std.Random.DefaultPrng.init(std.hash.Wyhash.hash(options.seed, "plant"));
+    const random = prng.random();
+    random.shuffle(usize, slots);
+
+    var next: usize = 0;
+    for (options.plants, positions) |p, *list| {
+        list.* = slots[next .. next + p.count];
+        next += p.count;
+        for (list.*) |*pos| {
+            pos.* = pos.* * slot + random.uintAtMost(usize, slot - p.pattern.len);
+            @memcpy(genome[pos.* .. pos.* + p.pattern.len], p.pattern);
+        }
+        std.mem.sort(usize, list.*, {}, std.sort.asc(usize));
+    }
+    return positions;
+}
+
+/// Creates a key pair and writes both halves next to the data
+fn generateKeys(alloc: std.mem.Allocator, ctx: openfhe.CryptoContext, dir: std.fs.Dir) !openfhe.PublicKey {
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    var pk = kp.getPublicKey();
+    errdefer pk.deinit();
+
+    const public_blob = try pk.serialize(.binary, alloc);
+    defer alloc.free(public_blob);
+    try dir.writeFile(.{ .sub_path = "public_key.bin", .data = public_blob });
+    const private_blob = try sk.serialize(.binary, alloc);
+    defer alloc.free(private_blob);
+    try dir.writeFile(.{ .sub_path = "private_key.bin", .data = private_blob });
+    return pk;
+}
+
+/// Encrypts the plan's chunks batch by batch and writes them to
+/// `chunks.ctstream` and the store; returns the serialized bytes
+fn encrypt(
+    alloc: std.mem.Allocator,
+    options: Options,
+    ctx: openfhe.CryptoContext,
+    pk: openfhe.PublicKey,
+    plan: openfhe.DnaLayoutPlan,
+    genome: []const u8,
+    dir: std.fs.Dir,
+    store: ?openfhe.SegmentStore,
+) !u64 {
+    const per_chunk = openfhe.dnaLayoutCiphertexts(@enumFromInt(plan.layout.kind));
+    const batch = if (options.batch > 0) options.batch else 4 * (std.Thread.getCpuCount() catch 1);
+
+    const file = try dir.createFile("chunks.ctstream", .{});
+    defer file.close();
+    var buffer: [64 * 1024]u8 = undefined;
+    var writer = file.writer(&buffer);
+    const stream = &writer.interface;
+
+    var sql: ?std.fs.File = null;
+    defer if (sql) |f| f.close();
+    var sql_buffer: [64 * 1024]u8 = undefined;
+    var sql_writer: std.fs.File.Writer = undefined;
+    var session_key: openfhe.SegmentStore.SessionId = undefined;
+    var object_id: u64 = 0;
+    if (store) |s| {
+        const session = options.session orelse return error.MissingSession;
+        session_key = std.mem.toBytes(try uuid.urn.deserialize(session));
+        // Append after whatever the session already holds
+        const existing = try s.list(&session_key, alloc);
+        defer alloc.free(existing);
+        if (existing.len > 0) object_id = existing[existing.len - 1] + 1;
+
+        sql = try dir.createFile("store.sql", .{});
+        sql_writer = sql.?.writer(&sql_buffer);
+        try writeKeyRow(alloc, &sql_writer.interface, session, pk);
+    }
+
+    const cts = try alloc.alloc(openfhe.Ciphertext, batch * per_chunk);
+    defer alloc.free(cts);
+
+    var written: u64 = 0;
+    var chunk: usize = 0;
+    while (chunk < plan.chunks) {
+        const count = @min(batch, plan.chunks - chunk);
+        const encrypted = cts[0 .. count * per_chunk];
+        try ctx.dnaLayoutEncryptBatch(pk, plan.layout, genome[chunk * plan.bases_per_chunk ..], count, encrypted, alloc);
+        defer for (encrypted) |*ct| ct.deinit();
+
+        for (encrypted) |ct| {
+            const blob = try ct.serialize(.binary, alloc);
+            defer alloc.free(blob);
+            var prefix: [4]u8 = undefined;
+            std.mem.writeInt(u32, &prefix, @intCast(blob.len), .little);
+            try stream.writeAll(&prefix);
+            try stream.writeAll(blob);
+            written += blob.len;
+
+            if (store) |s| {
+                try s.put(&session_key, object_id, blob);
+                try sql_writer.interface.print(
+                    "INSERT INTO ciphertexts (session_id, object_id, size_bytes, stored_at) VALUES ('{s}', {d}, {d}, now());\n",
+                    .{ options.session.?, object_id, blob.len },
+                );
+                object_id += 1;
+            }
+        }
+        chunk += count;
+    }
+    try stream.flush();
+    if (store) |s| {
+        try s.sync();
+        // Uploads through the API take their ids from this counter
+        try sql_writer.interface.print(
+            "UPDATE keys SET next_object_id = GREATEST(next_object_id, {d}) WHERE session_id = '{s}';\n",
+            .{ object_id, options.session.? },
+        );
+        try sql_writer.interface.flush();
+    }
+    return written;
+}
+
+/// The `keys` row a registration of `pk` under `session` would insert, so
+/// `psql -f store.sql` makes the stored session visible to the API
+fn writeKeyRow(alloc: std.mem.Allocator, sql: *std.Io.Writer, session: []const u8, pk: openfhe.PublicKey) !void {
+    const blob = try pk.serialize(.binary, alloc);
+    defer alloc.free(blob);
+    try sql.print("INSERT INTO keys (session_id, public_key, issued_at) SELECT '{s}', decode('", .{session});
+    for (blob) |byte| try sql.print("{x:0>2}", .{byte});
+    try sql.print("', 'hex'), now() WHERE NOT EXISTS (SELECT 1 FROM keys WHERE session_id = '{s}');\n", .{session});
+}
+
+fn composition(genome: []const u8) Composition {
+    var counts = Composition{};
+    for (genome) |base| switch (base) {
+        'A' => counts.A += 1,
+        'C' => counts.C += 1,
+        'G' => counts.G += 1,
+        'T' => counts.T += 1,
+        else => counts.N += 1,
+    };
+    return counts;
+}
+
+fn groundTruth(alloc: std.mem.Allocator, options: Options, genome: []const u8, planted: []const []usize) ![]PatternTruth {
+    const truths = try alloc.alloc(PatternTruth, options.plants.len);
+    for (options.plants, planted, truths) |p, positions, *truth| {
+        var matches: std.ArrayList(usize) = .empty;
+        var occurrences: usize = 0;
+        var from: usize = 0;
+        while (std.mem.indexOfPos(u8, genome, from, p.pattern)) |pos| : (from = pos + 1) {
+            if (matches.items.len < options.max_positions) try matches.append(alloc, pos);
+            occurrences += 1;
+        }
+        truth.* = .{
+            .pattern = p.pattern,
+            .planted = positions,
+            .occurrences = occurrences,
+            .positions = matches.items,
+        };
+    }
+    return truths;
+}
+
+/// Histogram of all k-mers that contain no N, indexed by their base-4 value
+fn kmerCounts(alloc: std.mem.Allocator, genome: []const u8, k: u32) ![]u64 {
+    const counts = try alloc.alloc(u64, @as(usize, 1) << @intCast(2 * k));
+    @memset(counts, 0);
+    const mask = counts.len - 1;
+    var index: usize = 0;
+    var valid: u32 = 0;
+    for (genome) |base| {
+        const digit: usize = switch (base) {
+            'A' => 0,
+            'C' => 1,
+            'G' => 2,
+            'T' => 3,
+            else => {
+                valid = 0;
+                continue;
+            },
+        };
+        index = ((index << 2) | digit) & mask;
+        valid = @min(valid + 1, k);
+        if (valid == k) counts[index] += 1;
+    }
+    return counts;
+}
+
+fn parseArgs(alloc: std.mem.Allocator, args: []const [:0]u8) !Options {
+    var options = Options{};
+    var plants: std.ArrayList(Plant) = .empty;
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 2) {
+        if (i + 1 >= args.len) return error.MissingValue;
+        const flag = args[i];
+        const value = args[i + 1];
+        if (std.mem.eql(u8, flag, "--out")) {
+            options.out = value;
+        } else if (std.mem.eql(u8, flag, "--seed")) {
+            options.seed = try std.fmt.parseInt(u64, value, 10);
+        } else if (std.mem.eql(u8, flag, "--length")) {
+            options.length = try parseLength(value);
+        } else if (std.mem.eql(u8, flag, "--gc")) {
+            options.gc = try std.fmt.parseFloat(f64, value);
+        } else if (std.mem.eql(u8, flag, "--n-rate")) {
+            options.n_rate = try std.fmt.parseFloat(f64, value);
+        } else if (std.mem.eql(u8, flag, "--plant")) {
+            const colon = std.mem.lastIndexOfScalar(u8, value, ':') orelse return error.InvalidPlant;
+            const pattern = value[0..colon];
+            if (pattern.len == 0) return error.InvalidPlant;
+            for (pattern) |base| if (std.mem.indexOfScalar(u8, "ACGT", base) == null) return error.InvalidPlant;
+            try plants.append(alloc, .{ .pattern = pattern, .count = try std.fmt.parseInt(usize, value[colon + 1 ..], 10) });
+        } else if (std.mem.eql(u8, flag, "--kernel")) {
+            options.kernel = std.meta.stringToEnum(openfhe.DnaKernel, value) orelse return error.UnknownKernel;
+        } else if (std.mem.eql(u8, flag, "--window")) {
+            options.window = try std.fmt.parseInt(usize, value, 10);
+        } else if (std.mem.eql(u8, flag, "--kmer")) {
+            options.kmer = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, flag, "--max-positions")) {
+            options.max_positions = try std.fmt.parseInt(usize, value, 10);
+        } else if (std.mem.eql(u8, flag, "--batch")) {
+            options.batch = try std.fmt.parseInt(usize, value, 10);
+        } else if (std.mem.eql(u8, flag, "--public-key")) {
+            options.public_key = value;
+        } else if (std.mem.eql(u8, flag, "--store")) {
+            options.store = value;
+        } else if (std.mem.eql(u8, flag, "--session")) {
+            options.session = value;
+        } else if (std.mem.eql(u8, flag, "--fhe-depth")) {
+            options.params.multiplicative_depth = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, flag, "--fhe-plaintext-modulus")) {
+            options.params.plaintext_modulus = try std.fmt.parseInt(u64, value, 10);
+        } else if (std.mem.eql(u8, flag, "--fhe-ring-dim")) {
+            options.params.ring_dim = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, flag, "--fhe-security")) {
+            options.params.security_level = try std.fmt.parseInt(u32, value, 10);
+        } else {
+            return error.UnknownFlag;
+        }
+    }
+    options.plants = plants.items;
+
+    if (options.length == 0) return error.EmptyGenome;
+    if (!(options.gc >= 0 and options.gc <= 1) or !(options.n_rate >= 0 and options.n_rate < 1)) return error.InvalidComposition;
+    if (options.kmer) |k| if (k == 0 or k > max_kmer) return error.UnsupportedK;
+    if ((options.store == null) != (options.session == null)) return error.StoreNeedsSession;
+    return options;
+}
+
+/// A count with an optional K, M or G (binary) suffix
+fn parseLength(value: []const u8) !usize {
+    if (value.len == 0) return error.InvalidLength;
+    const shift: u6 = switch (value[value.len - 1]) {
+        'K', 'k' => 10,
+        'M', 'm' => 20,
+        'G', 'g' => 30,
+        else => return std.fmt.parseInt(usize, value, 10),
+    };
+    return std.math.shlExact(usize, try std.fmt.parseInt(usize, value[0 .. value.len - 1], 10), shift);
+}
@@ -0,0 +1,57 @@
+//! Loading a stored genome: `ciphertext_deserialize` called once per chunk
+//! versus `ciphertext_deserialize_batch` spreading the chunks over all cores.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const iterations = 5;
+const chunks = 256;
+
+const Blobs = struct {
+    ctx: openfhe.CryptoContext,
+    data: [chunks][]u8,
+};
+
+pub fn run(alloc: std.mem.Allocator, out: *std.Io.Writer) !void {
+    var ctx = try openfhe.CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    const values = [_]i64{ 1, 2, 3, 4 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+
+    var blobs = Blobs{ .ctx = ctx, .data = undefined };
+    for (&blobs.data) |*blob| {
+        var ct = try ctx.encrypt(pk, pt);
+        defer ct.deinit();
+        blob.* = try ct.serialize(.binary, alloc);
+    }
+    defer for (blobs.data) |blob| alloc.free(blob);
+
+    try util.printHeader(out, "deserialize");
+    try out.print("{d} ciphertexts of {d} bytes per op, {d} cores\n", .{ chunks, blobs.data[0].len, std.Thread.getCpuCount() catch 1 });
+    try util.printResult(out, "deserialize/sequential", try util.measure(alloc, iterations, &blobs, sequential));
+    try util.printResult(out, "deserialize/batch", try util.measure(alloc, iterations, &blobs, batch));
+}
+
+fn sequential(blobs: *Blobs, _: std.mem.Allocator) anyerror!void {
+    for (blobs.data) |blob| {
+        var ct = try openfhe.Ciphertext.deserialize(blobs.ctx, blob, .binary);
+        ct.deinit();
+    }
+}
+
+fn batch(blobs: *Blobs, arena: std.mem.Allocator) anyerror!void {
+    var cts: [chunks]openfhe.Ciphertext = undefined;
+    try openfhe.Ciphertext.deserializeBatch(blobs.ctx, &blobs.data, .binary, 0, &cts, arena);
+    for (&cts) |*ct| ct.deinit();
+}
@@ -0,0 +1,76 @@
+//! Searching a marker panel: `dnaHammingScan` once per pattern versus
+//! `dnaHammingScanMulti`, which shares the sequence rotations across the
+//! whole panel.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const iterations = 3;
+const panel_size = 16;
+const pattern_len = 12;
+
+const Fixture = struct {
+    ctx: openfhe.CryptoContext,
+    seq: openfhe.Ciphertext,
+    patterns: [panel_size][]const u8,
+};
+
+pub fn run(alloc: std.mem.Allocator, out: *std.Io.Writer) !void {
+    var ctx = try openfhe.CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    const single = try openfhe.dnaHammingScanRotations(pattern_len, alloc);
+    defer alloc.free(single);
+    const multi = try ctx.dnaHammingMultiRotations(pattern_len, alloc);
+    defer alloc.free(multi);
+    try ctx.evalRotateKeysGen(sk, single);
+    try ctx.evalRotateKeysGen(sk, multi);
+
+    var prng = std.Random.DefaultPrng.init(7);
+    const random = prng.random();
+
+    const bases = try alloc.alloc(u8, ctx.getRingDim() / 8);
+    defer alloc.free(bases);
+    for (bases) |*base| base.* = "ACGT"[random.uintLessThan(usize, 4)];
+
+    var storage: [panel_size][pattern_len]u8 = undefined;
+    var fixture = Fixture{ .ctx = ctx, .seq = undefined, .patterns = undefined };
+    for (&storage, &fixture.patterns) |*pattern, *slice| {
+        for (pattern) |*base| base.* = "ACGT"[random.uintLessThan(usize, 4)];
+        slice.* = pattern;
+    }
+
+    var pt = try ctx.makeDnaPlaintext(bases);
+    defer pt.deinit();
+    fixture.seq = try ctx.encrypt(pk, pt);
+    defer fixture.seq.deinit();
+
+    try util.printHeader(out, "hamming");
+    try out.print("{d} patterns of {d} bases\n", .{ panel_size, pattern_len });
+    try util.printResult(out, "hamming/per pattern", try util.measure(alloc, iterations, &fixture, perPattern));
+    try util.printResult(out, "hamming/multi", try util.measure(alloc, iterations, &fixture, multiPattern));
+}
+
+fn perPattern(f: *Fixture, arena: std.mem.Allocator) anyerror!void {
+    for (f.patterns) |pattern| {
+        var profile: [1]openfhe.Ciphertext = undefined;
+        try f.ctx.dnaHammingScan(&.{f.seq}, pattern, &profile, arena);
+        profile[0].deinit();
+    }
+}
+
+fn multiPattern(f: *Fixture, arena: std.mem.Allocator) anyerror!void {
+    const profiles = try f.ctx.dnaHammingScanMulti(&.{f.seq}, &f.patterns, arena);
+    for (profiles) |*ct| ct.deinit();
+}
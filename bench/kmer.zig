@@ -0,0 +1,126 @@
+//! Trinucleotide spectrum of a few genome chunks: one evaluation per k-mer
+//! (rotate, multiply, mask, reduce) versus `dnaKmerHistogram`, which shares
+//! hoisted rotations and prefix products and reduces once per four k-mers.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const iterations = 3;
+const k = 3;
+const chunks = 2;
+const kmers = 1 << (2 * k);
+
+const Fixture = struct {
+    ctx: openfhe.CryptoContext,
+    seqs: [chunks]openfhe.Ciphertext,
+    mask: openfhe.Plaintext,
+    strides: []const i32,
+};
+
+pub fn run(alloc: std.mem.Allocator, out: *std.Io.Writer) !void {
+    var ctx = try openfhe.CryptoContext.createBgv(.{ .multiplicative_depth = k });
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    // The kernel's key set covers the naive evaluation as well
+    const rotations = try ctx.dnaKmerRotations(k, alloc);
+    defer alloc.free(rotations);
+    try ctx.evalRotateKeysGen(sk, rotations);
+
+    const ring_dim = ctx.getRingDim();
+    const bases = try alloc.alloc(u8, ring_dim / 4);
+    defer alloc.free(bases);
+    var prng = std.Random.DefaultPrng.init(42);
+    for (bases) |*base| base.* = "ACGT"[prng.random().uintLessThan(usize, 4)];
+
+    var fixture = Fixture{ .ctx = ctx, .seqs = undefined, .mask = undefined, .strides = undefined };
+    for (&fixture.seqs) |*ct| {
+        var pt = try ctx.makeDnaPlaintext(bases);
+        defer pt.deinit();
+        ct.* = try ctx.encrypt(pk, pt);
+    }
+    defer for (&fixture.seqs) |*ct| ct.deinit();
+
+    // Slot 4i of every base where a k-mer fits into its row
+    const row_bases = ring_dim / 8;
+    const mask = try alloc.alloc(i64, ring_dim);
+    defer alloc.free(mask);
+    @memset(mask, 0);
+    for (0..2 * row_bases) |i| {
+        if (i % row_bases + k <= row_bases) mask[4 * i] = 1;
+    }
+    fixture.mask = try ctx.makePackedPlaintext(mask);
+    defer fixture.mask.deinit();
+
+    var strides: std.ArrayList(i32) = .empty;
+    defer strides.deinit(alloc);
+    var stride: i32 = 4;
+    while (stride < ring_dim / 2) : (stride *= 2) try strides.append(alloc, stride);
+    fixture.strides = strides.items;
+
+    try util.printHeader(out, "kmer");
+    try out.print("{d}-mers over {d} chunks of {d} bases\n", .{ k, chunks, bases.len });
+    try util.printResult(out, "kmer/per k-mer", try util.measure(alloc, iterations, &fixture, perKmer));
+    try util.printResult(out, "kmer/histogram", try util.measure(alloc, iterations, &fixture, histogram));
+}
+
+fn perKmer(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    for (0..kmers) |w| {
+        var total: ?openfhe.Ciphertext = null;
+        defer if (total) |*ct| ct.deinit();
+
+        for (f.seqs) |seq| {
+            var product = try shift(f, seq, w, 0);
+            defer product.deinit();
+            for (1..k) |t| {
+                var shifted = try shift(f, seq, w, t);
+                defer shifted.deinit();
+                const next = try f.ctx.evalMult(product, shifted);
+                product.deinit();
+                product = next;
+            }
+            var masked = try f.ctx.evalMultPlaintext(product, f.mask);
+
+            if (total) |*sum| {
+                defer masked.deinit();
+                const next = try f.ctx.evalAdd(sum.*, masked);
+                sum.deinit();
+                sum.* = next;
+            } else {
+                total = masked;
+            }
+        }
+
+        for (f.strides) |s| {
+            var rotated = try f.ctx.evalRotate(total.?, s);
+            defer rotated.deinit();
+            const next = try f.ctx.evalAdd(total.?, rotated);
+            total.?.deinit();
+            total = next;
+        }
+    }
+}
+
+/// Channel of base `t` of k-mer `w`, moved to slot 4i
+fn shift(f: *Fixture, seq: openfhe.Ciphertext, w: usize, t: usize) !openfhe.Ciphertext {
+    const base = (w >> @intCast(2 * (k - 1 - t))) & 3;
+    const index: i32 = @intCast(4 * t + base);
+    if (index == 0) return seq.clone();
+    return f.ctx.evalRotate(seq, index);
+}
+
+fn histogram(f: *Fixture, arena: std.mem.Allocator) anyerror!void {
+    const counts = try f.ctx.dnaKmerHistogram(&f.seqs, k, arena);
+    for (counts) |*ct| ct.deinit();
+}
@@ -0,0 +1,468 @@
+//! HTTP load generator: `zig build loadgen -Doptimize=ReleaseFast -- [options]`
+//!
+//! Drives a running deployment (by default the docker-compose stack behind
+//! nginx) with real BGV traffic. The client builds a context from the
+//! server's `/params`, generates key pairs and encrypted chunks up front, and
+//! then runs a scenario from `--concurrency` threads for `--duration` seconds.
+//! Without `--rate` every thread sends its next request as soon as the last
+//! one is answered (closed loop). With `--rate` requests are started on a
+//! fixed schedule (open loop). Latency is then measured from the scheduled
+//! start, so a stalled server shows up in the tail instead of lowering the
+//! offered load. Prints p50/p95/p99, errors and throughput per endpoint.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+
+const usage =
+    \\usage: loadgen [options]
+    \\  --url URL          API base URL (default https://localhost:443)
+    \\  --ca FILE          PEM certificate to trust (default certs/server.crt if present)
+    \\  --scenario NAME    register | upload | session (default register)
+    \\  --concurrency N    client threads (default 8)
+    \\  --rate R           requests started per second, 0 for closed loop (default 0)
+    \\  --duration S       seconds to run (default 30)
+    \\  --keys N           key pairs to generate, at least one per thread for
+    \\                     register and session (default 8)
+    \\  --chunks N         ciphertexts per upload (default 4)
+;
+
+const Scenario = enum {
+    /// `POST /register`, deleting each session again so its key can be reused
+    register,
+    /// Uploads to sessions registered before the run
+    upload,
+    /// A whole session per iteration: register, upload, download, delete
+    session,
+};
+
+/// Every request the scenarios send. A new API route gets an entry here and
+/// a function like `upload` that calls `send`.
+const Endpoint = enum {
+    register,
+    upload,
+    download,
+    delete,
+};
+
+const endpoint_count = std.enums.values(Endpoint).len;
+
+/// A failed request: its endpoint and HTTP status, 0 for a transport error
+/// (connection refused or reset, TLS failure)
+const Failure = struct { Endpoint, u16 };
+
+const Options = struct {
+    url: []const u8 = "https://localhost:443",
+    ca: ?[]const u8 = null,
+    scenario: Scenario = .register,
+    concurrency: u32 = 8,
+    rate: f64 = 0,
+    duration_s: u64 = 30,
+    keys: usize = 8,
+    chunks: usize = 4,
+};
+
+const ServerParams = struct {
+    multiplicativeDepth: u32,
+    plaintextModulus: u64,
+    ringDim: u32,
+    securityLevel: u32,
+};
+
+/// Request bodies, generated before the run so it measures only the server
+const Fixture = struct {
+    public_keys: [][]u8,
+    /// One upload body per key: length-prefixed ciphertexts encrypted under it
+    uploads: [][]u8,
+    /// For `upload`: a session per key, registered before the run
+    sessions: [][36]u8,
+};
+
+/// Per-thread results, merged after the run
+const Recorder = struct {
+    latencies: [endpoint_count]std.ArrayList(u64) = @splat(.empty),
+    errors: std.AutoHashMapUnmanaged(Failure, u64) = .empty,
+
+    fn deinit(self: *Recorder, alloc: std.mem.Allocator) void {
+        for (&self.latencies) |*list| list.deinit(alloc);
+        self.errors.deinit(alloc);
+    }
+
+    fn fail(self: *Recorder, alloc: std.mem.Allocator, endpoint: Endpoint, status: u16) void {
+        const entry = self.errors.getOrPut(alloc, .{ endpoint, status }) catch return;
+        if (!entry.found_existing) entry.value_ptr.* = 0;
+        entry.value_ptr.* += 1;
+    }
+};
+
+const Run = struct {
+    alloc: std.mem.Allocator,
+    options: Options,
+    fixture: *const Fixture,
+    http: *std.http.Client,
+    start_ns: i128,
+    duration_ns: u64,
+    /// Index of the next iteration, shared by all threads
+    next: std.atomic.Value(u64) = .init(0),
+};
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const alloc = gpa.allocator();
+
+    const args = try std.process.argsAlloc(alloc);
+    defer std.process.argsFree(alloc, args);
+    const options = parseArgs(args) catch |err| {
+        std.log.err("{}\n{s}", .{ err, usage });
+        return err;
+    };
+
+    var stdout_buffer: [4096]u8 = undefined;
+    var stdout_writer = std.fs.File.stdout().writer(&stdout_buffer);
+    const out = &stdout_writer.interface;
+
+    var http: std.http.Client = .{ .allocator = alloc };
+    defer http.deinit();
+    try trustCertificate(alloc, &http, options.ca);
+
+    var arena = std.heap.ArenaAllocator.init(alloc);
+    defer arena.deinit();
+
+    const params = try fetchParams(arena.allocator(), &http, options.url);
+    try out.print("\n== loadgen ==\n{s}: ring dimension {d}, depth {d}, t = {d}\n", .{
+        options.url, params.ringDim, params.multiplicativeDepth, params.plaintextModulus,
+    });
+    try out.print("generating {d} key pairs and {d} ciphertexts each...\n", .{ options.keys, options.chunks });
+    try out.flush();
+
+    var fixture = try generate(arena.allocator(), options, params);
+    if (options.scenario == .upload) {
+        for (fixture.public_keys, fixture.sessions) |key, *session| {
+            var recorder: Recorder = .{};
+            defer recorder.deinit(alloc);
+            session.* = (try register(alloc, &http, options.url, key, &recorder, std.time.nanoTimestamp())) orelse
+                return error.SetupRegisterFailed;
+        }
+    }
+
+    var run = Run{
+        .alloc = alloc,
+        .options = options,
+        .fixture = &fixture,
+        .http = &http,
+        .start_ns = std.time.nanoTimestamp(),
+        .duration_ns = options.duration_s * std.time.ns_per_s,
+    };
+    try out.print("{s} scenario, {d} threads, {s}, {d} s\n", .{
+        @tagName(options.scenario),
+        options.concurrency,
+        if (options.rate > 0) try std.fmt.allocPrint(arena.allocator(), "{d} req/s", .{options.rate}) else "closed loop",
+        options.duration_s,
+    });
+    try out.flush();
+
+    const recorders = try alloc.alloc(Recorder, options.concurrency);
+    defer alloc.free(recorders);
+    for (recorders) |*recorder| recorder.* = .{};
+    defer for (recorders) |*recorder| recorder.deinit(alloc);
+
+    {
+        const threads = try alloc.alloc(std.Thread, options.concurrency);
+        defer alloc.free(threads);
+        var spawned: usize = 0;
+        defer for (threads[0..spawned]) |thread| thread.join();
+        for (threads, recorders) |*thread, *recorder| {
+            thread.* = try std.Thread.spawn(.{}, worker, .{ &run, recorder, spawned });
+            spawned += 1;
+        }
+    }
+    const elapsed_ns: u64 = @intCast(std.time.nanoTimestamp() - run.start_ns);
+
+    if (options.scenario == .upload) {
+        for (fixture.sessions) |session| {
+            var recorder: Recorder = .{};
+            defer recorder.deinit(alloc);
+            _ = deleteSession(alloc, &http, options.url, &session, &recorder, std.time.nanoTimestamp());
+        }
+    }
+
+    try report(alloc, out, recorders, elapsed_ns);
+    try out.flush();
+}
+
+fn worker(run: *Run, recorder: *Recorder, thread_index: usize) void {
+    while (true) {
+        const i = run.next.fetchAdd(1, .monotonic);
+        var start = std.time.nanoTimestamp();
+        if (run.options.rate > 0) {
+            const offset_ns: u64 = @intFromFloat(@as(f64, @floatFromInt(i)) * std.time.ns_per_s / run.options.rate);
+            if (offset_ns >= run.duration_ns) return;
+            const due = run.start_ns + offset_ns;
+            if (due > start) std.Thread.sleep(@intCast(due - start));
+            start = due;
+        } else if (start - run.start_ns >= run.duration_ns) {
+            return;
+        }
+        iteration(run, recorder, i, thread_index, start);
+    }
+}
+
+fn iteration(run: *Run, recorder: *Recorder, i: u64, thread_index: usize, start: i128) void {
+    const alloc = run.alloc;
+    const url = run.options.url;
+    // A public key can only be registered by one session at a time, so each
+    // thread registers its own
+    const own_key = thread_index;
+    switch (run.options.scenario) {
+        .register => {
+            const session = register(alloc, run.http, url, run.fixture.public_keys[own_key], recorder, start) orelse return;
+            _ = deleteSession(alloc, run.http, url, &session, recorder, std.time.nanoTimestamp());
+        },
+        .upload => {
+            const key = i % run.fixture.public_keys.len;
+            _ = upload(alloc, run.http, url, &run.fixture.sessions[key], run.fixture.uploads[key], recorder, start);
+        },
+        .session => {
+            const session = register(alloc, run.http, url, run.fixture.public_keys[own_key], recorder, start) orelse return;
+            defer _ = deleteSession(alloc, run.http, url, &session, recorder, std.time.nanoTimestamp());
+            if (!upload(alloc, run.http, url, &session, run.fixture.uploads[own_key], recorder, std.time.nanoTimestamp())) return;
+            _ = download(alloc, run.http, url, &session, recorder, std.time.nanoTimestamp());
+        },
+    }
+}
+
+fn register(alloc: std.mem.Allocator, http: *std.http.Client, url: []const u8, public_key: []const u8, recorder: *Recorder, start: i128) ?[36]u8 {
+    var body = std.Io.Writer.Allocating.init(alloc);
+    defer body.deinit();
+    const target = std.fmt.allocPrint(alloc, "{s}/api/v0.1.0/register", .{url}) catch return null;
+    defer alloc.free(target);
+    if (!send(alloc, http, .register, .POST, target, public_key, &body.writer, recorder, start)) return null;
+
+    const parsed = std.json.parseFromSlice(struct { sessionId: []const u8 }, alloc, body.written(), .{ .ignore_unknown_fields = true }) catch {
+        recorder.fail(alloc, .register, 200);
+        return null;
+    };
+    defer parsed.deinit();
+    if (parsed.value.sessionId.len != 36) {
+        recorder.fail(alloc, .register, 200);
+        return null;
+    }
+    return parsed.value.sessionId[0..36].*;
+}
+
+fn upload(alloc: std.mem.Allocator, http: *std.http.Client, url: []const u8, session: *const [36]u8, stream: []const u8, recorder: *Recorder, start: i128) bool {
+    const target = std.fmt.allocPrint(alloc, "{s}/api/v0.1.0/sessions/{s}/ciphertexts", .{ url, session }) catch return false;
+    defer alloc.free(target);
+    return send(alloc, http, .upload, .POST, target, stream, null, recorder, start);
+}
+
+fn download(alloc: std.mem.Allocator, http: *std.http.Client, url: []const u8, session: *const [36]u8, recorder: *Recorder, start: i128) bool {
+    const target = std.fmt.allocPrint(alloc, "{s}/api/v0.1.0/sessions/{s}/results", .{ url, session }) catch return false;
+    defer alloc.free(target);
+    return send(alloc, http, .download, .GET, target, null, null, recorder, start);
+}
+
+fn deleteSession(alloc: std.mem.Allocator, http: *std.http.Client, url: []const u8, session: *const [36]u8, recorder: *Recorder, start: i128) bool {
+    const target = std.fmt.allocPrint(alloc, "{s}/api/v0.1.0/sessions/{s}", .{ url, session }) catch return false;
+    defer alloc.free(target);
+    return send(alloc, http, .delete, .DELETE, target, null, null, recorder, start);
+}
+
+/// One request; records its latency from `start` if it succeeds, or the failure
+fn send(
+    alloc: std.mem.Allocator,
+    http: *std.http.Client,
+    endpoint: Endpoint,
+    method: std.http.Method,
+    target: []const u8,
+    payload: ?[]const u8,
+    response: ?*std.Io.Writer,
+    recorder: *Recorder,
+    start: i128,
+) bool {
+    const result = http.fetch(.{
+        .location = .{ .url = target },
+        .method = method,
+        .payload = payload,
+        .headers = .{ .content_type = .{ .override = "application/octet-stream" } },
+        .response_writer = response,
+    }) catch {
+        recorder.fail(alloc, endpoint, 0);
+        return false;
+    };
+    const status = @intFromEnum(result.status);
+    // No job has published results yet, so an empty download is a 404
+    const ok = result.status.class() == .success or (endpoint == .download and result.status == .not_found);
+    if (!ok) {
+        recorder.fail(alloc, endpoint, status);
+        return false;
+    }
+    const latency: u64 = @intCast(std.time.nanoTimestamp() - start);
+    recorder.latencies[@intFromEnum(endpoint)].append(alloc, latency) catch {};
+    return true;
+}
+
+fn fetchParams(alloc: std.mem.Allocator, http: *std.http.Client, url: []const u8) !ServerParams {
+    var body = std.Io.Writer.Allocating.init(alloc);
+    defer body.deinit();
+    const result = try http.fetch(.{
+        .location = .{ .url = try std.fmt.allocPrint(alloc, "{s}/api/v0.1.0/params", .{url}) },
+        .response_writer = &body.writer,
+    });
+    if (result.status != .ok) return error.ParamsUnavailable;
+    const parsed = try std.json.parseFromSliceLeaky(ServerParams, alloc, body.written(), .{ .ignore_unknown_fields = true });
+    return parsed;
+}
+
+/// Key pairs and upload bodies under a context matching the server's
+fn generate(alloc: std.mem.Allocator, options: Options, params: ServerParams) !Fixture {
+    var ctx = try openfhe.CryptoContext.createBgv(.{
+        .multiplicative_depth = params.multiplicativeDepth,
+        .plaintext_modulus = params.plaintextModulus,
+        .ring_dim = params.ringDim,
+        .security_level = params.securityLevel,
+    });
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var fixture = Fixture{
+        .public_keys = try alloc.alloc([]u8, options.keys),
+        .uploads = try alloc.alloc([]u8, options.keys),
+        .sessions = try alloc.alloc([36]u8, options.keys),
+    };
+
+    var prng = std.Random.DefaultPrng.init(7);
+    const random = prng.random();
+    const bases = try alloc.alloc(u8, ctx.getRingDim() / 4);
+
+    for (fixture.public_keys, fixture.uploads) |*public_key, *stream| {
+        var kp = try ctx.keyGen();
+        defer kp.deinit();
+        var pk = kp.getPublicKey();
+        defer pk.deinit();
+        public_key.* = try pk.serialize(.binary, alloc);
+
+        var body: std.ArrayList(u8) = .empty;
+        for (0..options.chunks) |_| {
+            for (bases) |*base| base.* = "ACGT"[random.uintLessThan(usize, 4)];
+            var pt = try ctx.makeDnaPlaintext(bases);
+            defer pt.deinit();
+            var ct = try ctx.encrypt(pk, pt);
+            defer ct.deinit();
+            const blob = try ct.serialize(.binary, alloc);
+            var prefix: [4]u8 = undefined;
+            std.mem.writeInt(u32, &prefix, @intCast(blob.len), .little);
+            try body.appendSlice(alloc, &prefix);
+            try body.appendSlice(alloc, blob);
+        }
+        stream.* = body.items;
+    }
+    return fixture;
+}
+
+/// Trusts `ca`, or the self-signed certificate of the docker-compose stack
+/// if it exists; otherwise the system certificates
+fn trustCertificate(alloc: std.mem.Allocator, http: *std.http.Client, ca: ?[]const u8) !void {
+    const path = ca orelse blk: {
+        std.fs.cwd().access("certs/server.crt", .{}) catch return;
+        break :blk "certs/server.crt";
+    };
+    try http.ca_bundle.addCertsFromFilePath(alloc, std.fs.cwd(), path);
+    http.next_https_rescan_certs = false;
+}
+
+fn report(alloc: std.mem.Allocator, out: *std.Io.Writer, recorders: []Recorder, elapsed_ns: u64) !void {
+    var merged: Recorder = .{};
+    defer merged.deinit(alloc);
+    for (recorders) |*recorder| {
+        for (&merged.latencies, &recorder.latencies) |*all, part| try all.appendSlice(alloc, part.items);
+        var it = recorder.errors.iterator();
+        while (it.next()) |entry| {
+            const total = try merged.errors.getOrPut(alloc, entry.key_ptr.*);
+            if (!total.found_existing) total.value_ptr.* = 0;
+            total.value_ptr.* += entry.value_ptr.*;
+        }
+    }
+
+    const seconds = @as(f64, @floatFromInt(elapsed_ns)) / std.time.ns_per_s;
+    try out.print("{s:<10} {s:>9} {s:>8} {s:>9} {s:>9} {s:>9} {s:>9} {s:>9}\n", .{
+        "endpoint", "ok", "errors", "req/s", "p50 ms", "p95 ms", "p99 ms", "max ms",
+    });
+    for (std.enums.values(Endpoint), &merged.latencies) |endpoint, *list| {
+        var errors: u64 = 0;
+        var it = merged.errors.iterator();
+        while (it.next()) |entry| {
+            if (entry.key_ptr[0] == endpoint) errors += entry.value_ptr.*;
+        }
+        if (list.items.len == 0 and errors == 0) continue;
+
+        const latencies = list.items;
+        std.mem.sort(u64, latencies, {}, std.sort.asc(u64));
+        try out.print("{s:<10} {d:>9} {d:>8} {d:>9.1} {d:>9.1} {d:>9.1} {d:>9.1} {d:>9.1}\n", .{
+            @tagName(endpoint),
+            latencies.len,
+            errors,
+            @as(f64, @floatFromInt(latencies.len)) / seconds,
+            percentileMs(latencies, 0.50),
+            percentileMs(latencies, 0.95),
+            percentileMs(latencies, 0.99),
+            percentileMs(latencies, 1.0),
+        });
+    }
+
+    if (merged.errors.count() > 0) {
+        try out.print("errors:", .{});
+        var it = merged.errors.iterator();
+        while (it.next()) |entry| {
+            const endpoint, const status = entry.key_ptr.*;
+            if (status == 0) {
+                try out.print(" {s} transport x{d}", .{ @tagName(endpoint), entry.value_ptr.* });
+            } else {
+                try out.print(" {s} {d} x{d}", .{ @tagName(endpoint), status, entry.value_ptr.* });
+            }
+        }
+        try out.print("\n", .{});
+    }
+}
+
+fn percentileMs(sorted: []const u64, p: f64) f64 {
+    if (sorted.len == 0) return 0;
+    const rank: usize = @intFromFloat(@ceil(p * @as(f64, @floatFromInt(sorted.len))));
+    const ns = sorted[@max(rank, 1) - 1];
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+}
+
+fn parseArgs(args: []const [:0]u8) !Options {
+    var options = Options{};
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const flag = args[i];
+        if (i + 1 >= args.len) return error.MissingValue;
+        const value = args[i + 1];
+        i += 1;
+        if (std.mem.eql(u8, flag, "--url")) {
+            options.url = std.mem.trimRight(u8, value, "/");
+        } else if (std.mem.eql(u8, flag, "--ca")) {
+            options.ca = value;
+        } else if (std.mem.eql(u8, flag, "--scenario")) {
+            options.scenario = std.meta.stringToEnum(Scenario, value) orelse return error.UnknownScenario;
+        } else if (std.mem.eql(u8, flag, "--concurrency")) {
+            options.concurrency = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, flag, "--rate")) {
+            options.rate = try std.fmt.parseFloat(f64, value);
+        } else if (std.mem.eql(u8, flag, "--duration")) {
+            options.duration_s = try std.fmt.parseInt(u64, value, 10);
+        } else if (std.mem.eql(u8, flag, "--keys")) {
+            options.keys = try std.fmt.parseInt(usize, value, 10);
+        } else if (std.mem.eql(u8, flag, "--chunks")) {
+            options.chunks = try std.fmt.parseInt(usize, value, 10);
+        } else {
+            return error.UnknownFlag;
+        }
+    }
+    if (options.concurrency == 0 or options.keys == 0 or options.rate < 0) return error.InvalidValue;
+    if (options.scenario != .upload and options.keys < options.concurrency) return error.TooFewKeys;
+    return options;
+}
@@ -0,0 +1,38 @@
+//! Benchmark runner: `zig build bench -Doptimize=ReleaseFast [-- <suite>]`
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+
+const suites = .{
+    .{ "register", @import("register.zig") },
+    .{ "store", @import("store.zig") },
+    .{ "deserialize", @import("deserialize.zig") },
+    .{ "rerandomize", @import("rerandomize.zig") },
+    .{ "kmer", @import("kmer.zig") },
+    .{ "hamming", @import("hamming.zig") },
+    .{ "cost", @import("cost.zig") },
+};
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    const filter: ?[]const u8 = if (args.len > 1) args[1] else null;
+
+    var stdout_buffer: [4096]u8 = undefined;
+    var stdout_writer = std.fs.File.stdout().writer(&stdout_buffer);
+    const stdout = &stdout_writer.interface;
+
+    // Tells the runs of `zig build bench-variants` apart
+    try stdout.print("openfhe_c build: {s}\n", .{openfhe.buildVariant()});
+
+    inline for (suites) |suite| {
+        if (filter == null or std.mem.eql(u8, filter.?, suite[0])) {
+            try suite[1].run(allocator, stdout);
+            try stdout.flush();
+        }
+    }
+}
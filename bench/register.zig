@@ -0,0 +1,57 @@
+//! `/register` request decoding: legacy JSON + base64 body versus the raw
+//! `application/octet-stream` body handed straight to the deserializer.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const iterations = 200;
+
+const Bodies = struct {
+    json: []const u8,
+    binary: []const u8,
+};
+
+pub fn run(alloc: std.mem.Allocator, out: *std.Io.Writer) !void {
+    var ctx = try openfhe.CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    const binary = try pk.serialize(.binary, alloc);
+    defer alloc.free(binary);
+
+    const encoded = try alloc.alloc(u8, std.base64.standard.Encoder.calcSize(binary.len));
+    defer alloc.free(encoded);
+    _ = std.base64.standard.Encoder.encode(encoded, binary);
+
+    const json = try std.fmt.allocPrint(alloc, "{{\"publicKey\":\"{s}\"}}", .{encoded});
+    defer alloc.free(json);
+
+    const bodies = Bodies{ .json = json, .binary = binary };
+
+    try util.printHeader(out, "register");
+    try out.print("public key: {d} bytes binary, {d} bytes JSON\n", .{ binary.len, json.len });
+    try util.printResult(out, "register/json+base64", try util.measure(alloc, iterations, &bodies, decodeJson));
+    try util.printResult(out, "register/octet-stream", try util.measure(alloc, iterations, &bodies, decodeBinary));
+}
+
+fn decodeJson(bodies: *const Bodies, arena: std.mem.Allocator) anyerror!void {
+    const request = try std.json.parseFromSliceLeaky(struct { publicKey: []const u8 }, arena, bodies.json, .{});
+    const decoded = try arena.alloc(u8, try std.base64.standard.Decoder.calcSizeForSlice(request.publicKey));
+    try std.base64.standard.Decoder.decode(decoded, request.publicKey);
+
+    var pk = try openfhe.PublicKey.deserialize(decoded, .binary);
+    pk.deinit();
+}
+
+fn decodeBinary(bodies: *const Bodies, _: std.mem.Allocator) anyerror!void {
+    var pk = try openfhe.PublicKey.deserialize(bodies.binary, .binary);
+    pk.deinit();
+}
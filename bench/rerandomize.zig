@@ -0,0 +1,69 @@
+//! Re-randomizing results before download: a fresh public-key encryption of
+//! zero per result versus `Ciphertext.rerandomize` drawing from a warm pool.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const iterations = 5;
+const results_per_op = 8;
+
+const Fixture = struct {
+    ctx: openfhe.CryptoContext,
+    pk: openfhe.PublicKey,
+    zero: openfhe.Plaintext,
+    pool: openfhe.ZeroPool,
+    result: openfhe.Ciphertext,
+};
+
+pub fn run(alloc: std.mem.Allocator, out: *std.Io.Writer) !void {
+    var ctx = try openfhe.CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    const values = [_]i64{ 1, 2, 3, 4 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+    var zero = try ctx.makePackedPlaintext(&.{0});
+    defer zero.deinit();
+
+    var fixture = Fixture{
+        .ctx = ctx,
+        .pk = pk,
+        .zero = zero,
+        .pool = try openfhe.ZeroPool.init(ctx, pk, iterations * results_per_op),
+        .result = try ctx.encrypt(pk, pt),
+    };
+    defer fixture.pool.deinit();
+    defer fixture.result.deinit();
+
+    // Measure the steady state of an idle server: a full pool
+    while (fixture.pool.stats().available < iterations * results_per_op) {
+        std.Thread.sleep(10 * std.time.ns_per_ms);
+    }
+
+    try util.printHeader(out, "rerandomize");
+    try out.print("{d} results per op\n", .{results_per_op});
+    try util.printResult(out, "rerandomize/inline", try util.measure(alloc, iterations, &fixture, inline_));
+    try util.printResult(out, "rerandomize/pool", try util.measure(alloc, iterations, &fixture, pooled));
+}
+
+fn inline_(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    for (0..results_per_op) |_| {
+        var fresh = try f.ctx.encrypt(f.pk, f.zero);
+        defer fresh.deinit();
+        var sum = try f.ctx.evalAdd(f.result, fresh);
+        sum.deinit();
+    }
+}
+
+fn pooled(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    for (0..results_per_op) |_| try f.result.rerandomize(f.pool);
+}
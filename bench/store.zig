@@ -0,0 +1,200 @@
+//! Ciphertext storage: the memory-mapped segment store versus the old
+//! Postgres `bytea` column, and row-at-a-time versus batched INSERTs of the
+//! upload metadata rows and of `bytea` payloads. The Postgres side only runs
+//! when `BENCH_DB_HOST`, `BENCH_DB_PORT`, `BENCH_DB_USER`,
+//! `BENCH_DB_PASSWORD` and `BENCH_DB_DATABASE` are set.
+
+const std = @import("std");
+const pg = @import("pg");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const iterations = 200;
+/// Rows per batched INSERT, as in `ingest.insert_batch`
+const batch_rows = 256;
+const batch_iterations = 10;
+const store_dir = "/tmp/genz-bench-store";
+const session: openfhe.SegmentStore.SessionId = @splat(0x42);
+const bench_session_id = "42424242-4242-4242-4242-424242424242";
+
+const Fixture = struct {
+    ctx: openfhe.CryptoContext,
+    frame: []const u8,
+    store: openfhe.SegmentStore,
+    conn: ?*pg.Conn = null,
+    next_put: u64 = 0,
+    next_get: u64 = 0,
+    /// `batch_rows` copies of `frame`, and their sizes
+    frames: []const []const u8 = &.{},
+    sizes: []const i64 = &.{},
+};
+
+pub fn run(alloc: std.mem.Allocator, out: *std.Io.Writer) !void {
+    var ctx = try openfhe.CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    const values = [_]i64{ 1, 2, 3, 4 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+    var ct = try ctx.encrypt(pk, pt);
+    defer ct.deinit();
+    const frame = try ct.serialize(.binary, alloc);
+    defer alloc.free(frame);
+
+    std.fs.cwd().deleteTree(store_dir) catch {};
+    defer std.fs.cwd().deleteTree(store_dir) catch {};
+    var store = try openfhe.SegmentStore.open(store_dir, 0);
+    defer store.close();
+
+    var fixture = Fixture{ .ctx = ctx, .frame = frame, .store = store };
+
+    try util.printHeader(out, "store");
+    try out.print("ciphertext: {d} bytes\n", .{frame.len});
+    try util.printResult(out, "store/segment put", try util.measure(alloc, iterations, &fixture, segmentPut));
+    try util.printResult(out, "store/segment load", try util.measure(alloc, iterations, &fixture, segmentLoad));
+
+    const pool = (try connect(alloc)) orelse {
+        try out.print("postgres comparison skipped, BENCH_DB_* not set\n", .{});
+        return;
+    };
+    defer pool.deinit();
+    const conn = try pool.acquire();
+    defer conn.release();
+    _ = try conn.exec("CREATE TEMP TABLE bench_ciphertexts (object_id BIGINT PRIMARY KEY, data bytea);", .{});
+
+    fixture.conn = conn;
+    fixture.next_put = 0;
+    fixture.next_get = 0;
+    try util.printResult(out, "store/postgres insert", try util.measure(alloc, iterations, &fixture, postgresInsert));
+    try util.printResult(out, "store/postgres load", try util.measure(alloc, iterations, &fixture, postgresLoad));
+
+    const frames = try alloc.alloc([]const u8, batch_rows);
+    defer alloc.free(frames);
+    @memset(frames, frame);
+    const sizes = try alloc.alloc(i64, batch_rows);
+    defer alloc.free(sizes);
+    @memset(sizes, @intCast(frame.len));
+    fixture.frames = frames;
+    fixture.sizes = sizes;
+
+    _ = try conn.exec("CREATE TEMP TABLE bench_metadata (session_id UUID, object_id BIGINT, size_bytes BIGINT, stored_at timestamp);", .{});
+    fixture.next_put = 1_000_000;
+    const metadata_rows = try util.measure(alloc, batch_iterations, &fixture, metadataRows);
+    const metadata_batch = try util.measure(alloc, batch_iterations, &fixture, metadataBatch);
+    const payload_rows = try util.measure(alloc, batch_iterations, &fixture, postgresRows);
+    const payload_batch = try util.measure(alloc, batch_iterations, &fixture, postgresBatch);
+    try util.printResult(out, "store/metadata row x256", metadata_rows);
+    try util.printResult(out, "store/metadata batch x256", metadata_batch);
+    try util.printResult(out, "store/postgres insert x256", payload_rows);
+    try util.printResult(out, "store/postgres batch x256", payload_batch);
+
+    try out.print("{s:<32} {s:>14} {s:>14}\n", .{ "", "rows/s", "MB/s" });
+    try printThroughput(out, "store/metadata row x256", metadata_rows, 0);
+    try printThroughput(out, "store/metadata batch x256", metadata_batch, 0);
+    try printThroughput(out, "store/postgres insert x256", payload_rows, frame.len);
+    try printThroughput(out, "store/postgres batch x256", payload_batch, frame.len);
+}
+
+fn printThroughput(out: *std.Io.Writer, name: []const u8, r: util.Result, row_bytes: usize) !void {
+    const seconds = @as(f64, @floatFromInt(r.wall_ns)) / std.time.ns_per_s;
+    const rows: f64 = @floatFromInt(r.iterations * batch_rows);
+    try out.print("{s:<32} {d:>14.0} {d:>14.1}\n", .{
+        name,
+        rows / seconds,
+        rows * @as(f64, @floatFromInt(row_bytes)) / seconds / (1024 * 1024),
+    });
+}
+
+fn connect(alloc: std.mem.Allocator) !?*pg.Pool {
+    const host = std.posix.getenv("BENCH_DB_HOST") orelse return null;
+    const port = std.posix.getenv("BENCH_DB_PORT") orelse return null;
+    const user = std.posix.getenv("BENCH_DB_USER") orelse return null;
+    const password = std.posix.getenv("BENCH_DB_PASSWORD") orelse return null;
+    const database = std.posix.getenv("BENCH_DB_DATABASE") orelse return null;
+
+    return try pg.Pool.init(alloc, .{
+        .size = 1,
+        .connect = .{ .port = try std.fmt.parseInt(u16, port, 10), .host = host },
+        .auth = .{ .username = user, .database = database, .password = password },
+    });
+}
+
+/// Durable like an autocommitted Postgres insert, so the two compare fairly
+fn segmentPut(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    try f.store.put(&session, f.next_put, f.frame);
+    try f.store.sync();
+    f.next_put += 1;
+}
+
+fn segmentLoad(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    var ct = try f.store.loadCiphertext(f.ctx, &session, f.next_get, .binary);
+    ct.deinit();
+    f.next_get += 1;
+}
+
+fn postgresInsert(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    _ = try f.conn.?.exec(
+        "INSERT INTO bench_ciphertexts (object_id, data) VALUES ($1, $2);",
+        .{ @as(i64, @intCast(f.next_put)), f.frame },
+    );
+    f.next_put += 1;
+}
+
+fn metadataRows(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    for (f.sizes) |size| {
+        _ = try f.conn.?.exec(
+            "INSERT INTO bench_metadata (session_id, object_id, size_bytes, stored_at) VALUES ($1, $2, $3, $4);",
+            .{ bench_session_id, @as(i64, @intCast(f.next_put)), size, std.time.microTimestamp() },
+        );
+        f.next_put += 1;
+    }
+}
+
+/// The statement `ingest.StoreSink.flush` runs
+fn metadataBatch(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    _ = try f.conn.?.exec(
+        \\INSERT INTO bench_metadata (session_id, object_id, size_bytes, stored_at)
+        \\SELECT $1::uuid, $2 + n - 1, size_bytes, $4::timestamp FROM unnest($3::bigint[]) WITH ORDINALITY AS frames (size_bytes, n);
+    ,
+        .{ bench_session_id, @as(i64, @intCast(f.next_put)), f.sizes, std.time.microTimestamp() },
+    );
+    f.next_put += f.sizes.len;
+}
+
+fn postgresRows(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    for (f.frames) |frame| {
+        _ = try f.conn.?.exec(
+            "INSERT INTO bench_ciphertexts (object_id, data) VALUES ($1, $2);",
+            .{ @as(i64, @intCast(f.next_put)), frame },
+        );
+        f.next_put += 1;
+    }
+}
+
+fn postgresBatch(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    _ = try f.conn.?.exec(
+        "INSERT INTO bench_ciphertexts (object_id, data) SELECT $1 + n - 1, data FROM unnest($2::bytea[]) WITH ORDINALITY AS frames (data, n);",
+        .{ @as(i64, @intCast(f.next_put)), f.frames },
+    );
+    f.next_put += f.frames.len;
+}
+
+fn postgresLoad(f: *Fixture, _: std.mem.Allocator) anyerror!void {
+    var row = (try f.conn.?.row(
+        "SELECT data FROM bench_ciphertexts WHERE object_id = $1;",
+        .{@as(i64, @intCast(f.next_get))},
+    )) orelse return error.NotFound;
+    defer row.deinit() catch {};
+
+    var ct = try openfhe.Ciphertext.deserialize(f.ctx, row.get([]u8, 0), .binary);
+    ct.deinit();
+    f.next_get += 1;
+}
@@ -0,0 +1,338 @@
+//! BGV parameter tuner: `zig build tune -Doptimize=ReleaseFast -- <kernel> [options]`
+//!
+//! Finds the parameters that run a declared workload fastest. Each candidate
+//! (plaintext modulus x ring dimension, at the smallest depth the kernel
+//! needs) is built at the requested security level and rejected if OpenFHE
+//! refuses it or its slots cannot hold the workload. The rest are calibrated
+//! by running the kernel on a few encrypted chunks, and the predicted latency
+//! scales that to the whole workload. Candidates whose results keep less than
+//! `min_budget_bits` of estimated noise budget are rejected, since their
+//! outputs could fail to decrypt. The fastest set is printed as server flags.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+const util = @import("util.zig");
+
+const Kernel = enum { hamming, kmer, equality };
+
+const Workload = struct {
+    kernel: Kernel,
+    /// Bases per pattern for `hamming`
+    pattern_len: usize = 12,
+    /// K-mer length for `kmer`
+    k: u32 = 3,
+    /// Bases to scan, or values to compare for `equality`
+    sequence_len: usize = 1_000_000,
+    security_level: u32 = 128,
+
+    /// Bases a window spans; chunks overlap by one less
+    fn window(self: Workload) usize {
+        return switch (self.kernel) {
+            .hamming => self.pattern_len,
+            .kmer => self.k,
+            .equality => 1,
+        };
+    }
+
+    fn depth(self: Workload, plaintext_modulus: u64) !u32 {
+        return switch (self.kernel) {
+            .hamming => 1,
+            .kmer => self.k,
+            .equality => (try openfhe.isZeroCost(plaintext_modulus, 2)).depth,
+        };
+    }
+
+    /// Largest value a result slot holds; must stay below t / 2
+    fn maxResult(self: Workload) usize {
+        return switch (self.kernel) {
+            .hamming => self.pattern_len,
+            .kmer => self.sequence_len,
+            .equality => 1,
+        };
+    }
+
+    /// Ciphertexts the workload occupies, null if a window does not fit a row
+    fn chunks(self: Workload, ring_dim: u32) ?usize {
+        if (self.kernel == .equality) return std.math.divCeil(usize, self.sequence_len, ring_dim) catch unreachable;
+        const row_bases = ring_dim / 8;
+        if (row_bases < self.window() or self.sequence_len < self.window()) return null;
+        // Each of the two rows yields one window per base but the last few
+        const windows_per_chunk = 2 * (row_bases - self.window() + 1);
+        return std.math.divCeil(usize, self.sequence_len - self.window() + 1, windows_per_chunk) catch unreachable;
+    }
+};
+
+const plaintext_moduli = [_]u64{ 65537, 786433, 7340033 };
+const ring_dims = [_]u32{ 8192, 16384, 32768, 65536 };
+/// Chunks per calibration run, so OpenMP batching is part of the measurement
+const calibration_chunks = 4;
+const iterations = 2;
+/// Noise budget every kernel output must keep, covering the looseness of the
+/// estimate in the other direction
+const min_budget_bits = 10.0;
+
+const Calibration = struct {
+    params: openfhe.BgvParams,
+    chunks: usize,
+    batch: usize,
+    batch_ns: u64,
+    ciphertext_bytes: usize,
+    budget_bits: f64,
+
+    fn predictedNs(self: Calibration) u64 {
+        return self.batch_ns * (std.math.divCeil(usize, self.chunks, self.batch) catch unreachable);
+    }
+};
+
+const Fixture = struct {
+    ctx: openfhe.CryptoContext,
+    workload: Workload,
+    pattern: []const u8,
+    seqs: []openfhe.Ciphertext,
+    /// Right-hand operands for `equality`
+    others: []openfhe.Ciphertext,
+    /// Smallest estimated noise budget among the kernel outputs
+    budget_bits: f64 = std.math.inf(f64),
+
+    fn noteBudget(self: *Fixture, ct: openfhe.Ciphertext) !void {
+        self.budget_bits = @min(self.budget_bits, (try self.ctx.noiseEstimate(ct)).budget_bits);
+    }
+};
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const alloc = gpa.allocator();
+
+    const args = try std.process.argsAlloc(alloc);
+    defer std.process.argsFree(alloc, args);
+    const workload = parseArgs(args) catch |err| {
+        std.log.err("{}\nusage: tune <hamming|kmer|equality> [--pattern-len N] [--k K] [--sequence-len N] [--security 128|192|256]", .{err});
+        return err;
+    };
+
+    var stdout_buffer: [4096]u8 = undefined;
+    var stdout_writer = std.fs.File.stdout().writer(&stdout_buffer);
+    const out = &stdout_writer.interface;
+
+    try out.print("\n== tune ==\n{s}, {d} bases, window {d}, {d}-bit security\n", .{
+        @tagName(workload.kernel), workload.sequence_len, workload.window(), workload.security_level,
+    });
+    try out.print("{s:>10} {s:>9} {s:>6} {s:>8} {s:>12} {s:>14} {s:>14} {s:>10}  {s}\n", .{
+        "t", "ring_dim", "depth", "chunks", "chunk ms", "predicted s", "upload MB", "budget b", "",
+    });
+    try out.flush();
+
+    var best: ?Calibration = null;
+    for (plaintext_moduli) |t| {
+        for (ring_dims) |ring_dim| {
+            const depth = try workload.depth(t);
+            try out.print("{d:>10} {d:>9} {d:>6} ", .{ t, ring_dim, depth });
+
+            const reason: ?[]const u8 = if ((t - 1) % (2 * ring_dim) != 0)
+                "t does not split for this ring"
+            else if (workload.maxResult() >= t / 2)
+                "results overflow t"
+            else if (workload.chunks(ring_dim) == null)
+                "window does not fit a row"
+            else
+                null;
+            if (reason) |why| {
+                try out.print("{s:>8} {s:>12} {s:>14} {s:>14} {s:>10}  {s}\n", .{ "-", "-", "-", "-", "-", why });
+                try out.flush();
+                continue;
+            }
+
+            const params = openfhe.BgvParams{
+                .multiplicative_depth = depth,
+                .plaintext_modulus = t,
+                .security_level = workload.security_level,
+                .ring_dim = ring_dim,
+            };
+            const result = calibrate(alloc, workload, params) catch |err| {
+                try out.print("{s:>8} {s:>12} {s:>14} {s:>14} {s:>10}  rejected: {s}\n", .{ "-", "-", "-", "-", "-", rejection(err) });
+                try out.flush();
+                continue;
+            };
+            try out.print("{d:>8} {d:>12.1} {d:>14.2} {d:>14.1} {d:>10.1}", .{
+                result.chunks,
+                @as(f64, @floatFromInt(result.batch_ns / result.batch)) / std.time.ns_per_ms,
+                @as(f64, @floatFromInt(result.predictedNs())) / std.time.ns_per_s,
+                @as(f64, @floatFromInt(result.ciphertext_bytes * result.chunks)) / (1024 * 1024),
+                result.budget_bits,
+            });
+            if (result.budget_bits < min_budget_bits) {
+                try out.print("  rejected: noise budget exhausted\n", .{});
+                try out.flush();
+                continue;
+            }
+            try out.print("\n", .{});
+            try out.flush();
+
+            if (best == null or result.predictedNs() < best.?.predictedNs()) best = result;
+        }
+    }
+
+    const chosen = best orelse {
+        try out.print("\nno candidate can run this workload\n", .{});
+        try out.flush();
+        return error.NoValidParams;
+    };
+    try out.print(
+        \\
+        \\fastest: {d:.2} s predicted, {d} B per ciphertext
+        \\server flags: --fhe-depth {d} --fhe-plaintext-modulus {d} --fhe-ring-dim {d} --fhe-security {d}
+        \\
+    , .{
+        @as(f64, @floatFromInt(chosen.predictedNs())) / std.time.ns_per_s,
+        chosen.ciphertext_bytes,
+        chosen.params.multiplicative_depth,
+        chosen.params.plaintext_modulus,
+        chosen.params.ring_dim,
+        chosen.params.security_level,
+    });
+    try out.flush();
+}
+
+fn rejection(err: anyerror) []const u8 {
+    return switch (err) {
+        error.InvalidParam, error.CryptoFailure, error.InternalError => openfhe.getLastError(),
+        else => @errorName(err),
+    };
+}
+
+/// Builds the context, generates the kernel's keys and times it on a batch
+/// of random chunks
+fn calibrate(alloc: std.mem.Allocator, workload: Workload, params: openfhe.BgvParams) !Calibration {
+    var ctx = try openfhe.CryptoContext.createBgv(params);
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    var prng = std.Random.DefaultPrng.init(11);
+    const random = prng.random();
+    const pattern = try alloc.alloc(u8, workload.pattern_len);
+    defer alloc.free(pattern);
+    for (pattern) |*base| base.* = "ACGT"[random.uintLessThan(usize, 4)];
+
+    switch (workload.kernel) {
+        .hamming => {
+            const rotations = try openfhe.dnaHammingScanRotations(workload.pattern_len, alloc);
+            defer alloc.free(rotations);
+            try ctx.evalRotateKeysGen(sk, rotations);
+        },
+        .kmer => {
+            try ctx.evalMultKeysGen(sk);
+            const rotations = try ctx.dnaKmerRotations(workload.k, alloc);
+            defer alloc.free(rotations);
+            try ctx.evalRotateKeysGen(sk, rotations);
+        },
+        .equality => try ctx.evalMultKeysGen(sk),
+    }
+
+    const ring_dim = ctx.getRingDim();
+    const chunks = workload.chunks(ring_dim) orelse return error.WindowTooLong;
+    const batch = @min(chunks, calibration_chunks);
+
+    const seqs = try alloc.alloc(openfhe.Ciphertext, 2 * batch);
+    defer alloc.free(seqs);
+    var encrypted: usize = 0;
+    defer for (seqs[0..encrypted]) |*ct| ct.deinit();
+
+    const bases = try alloc.alloc(u8, ring_dim / 4);
+    defer alloc.free(bases);
+    const values = try alloc.alloc(i64, ring_dim);
+    defer alloc.free(values);
+    const operands: usize = if (workload.kernel == .equality) 2 * batch else batch;
+    while (encrypted < operands) : (encrypted += 1) {
+        var pt = if (workload.kernel == .equality) blk: {
+            for (values) |*v| v.* = random.intRangeLessThan(i64, 0, 4);
+            break :blk try ctx.makePackedPlaintext(values);
+        } else blk: {
+            for (bases) |*base| base.* = "ACGT"[random.uintLessThan(usize, 4)];
+            break :blk try ctx.makeDnaPlaintext(bases);
+        };
+        defer pt.deinit();
+        seqs[encrypted] = try ctx.encrypt(pk, pt);
+    }
+
+    const blob = try seqs[0].serialize(.binary, alloc);
+    defer alloc.free(blob);
+
+    var fixture = Fixture{
+        .ctx = ctx,
+        .workload = workload,
+        .pattern = pattern,
+        .seqs = seqs[0..batch],
+        .others = seqs[batch..operands],
+    };
+    const result = try util.measure(alloc, iterations, &fixture, runKernel);
+    return .{
+        .params = params,
+        .chunks = chunks,
+        .batch = batch,
+        .batch_ns = result.wall_ns / iterations,
+        .ciphertext_bytes = blob.len,
+        .budget_bits = fixture.budget_bits,
+    };
+}
+
+fn runKernel(f: *Fixture, arena: std.mem.Allocator) anyerror!void {
+    switch (f.workload.kernel) {
+        .hamming => {
+            const profiles = try arena.alloc(openfhe.Ciphertext, f.seqs.len);
+            try f.ctx.dnaHammingScan(f.seqs, f.pattern, profiles, arena);
+            for (profiles) |*ct| {
+                try f.noteBudget(ct.*);
+                ct.deinit();
+            }
+        },
+        .kmer => {
+            const counts = try f.ctx.dnaKmerHistogram(f.seqs, f.workload.k, arena);
+            for (counts) |*ct| {
+                try f.noteBudget(ct.*);
+                ct.deinit();
+            }
+        },
+        .equality => for (f.seqs, f.others) |a, b| {
+            var equal = try f.ctx.evalEqual(a, b);
+            defer equal.deinit();
+            try f.noteBudget(equal);
+        },
+    }
+}
+
+fn parseArgs(args: []const [:0]u8) !Workload {
+    if (args.len < 2) return error.MissingKernel;
+    var workload = Workload{ .kernel = std.meta.stringToEnum(Kernel, args[1]) orelse return error.UnknownKernel };
+
+    var i: usize = 2;
+    while (i < args.len) : (i += 2) {
+        if (i + 1 >= args.len) return error.MissingValue;
+        const flag = args[i];
+        const value = args[i + 1];
+        if (std.mem.eql(u8, flag, "--pattern-len")) {
+            workload.pattern_len = try std.fmt.parseInt(usize, value, 10);
+        } else if (std.mem.eql(u8, flag, "--k")) {
+            workload.k = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, flag, "--sequence-len")) {
+            workload.sequence_len = try std.fmt.parseInt(usize, value, 10);
+        } else if (std.mem.eql(u8, flag, "--security")) {
+            workload.security_level = try std.fmt.parseInt(u32, value, 10);
+        } else {
+            return error.UnknownFlag;
+        }
+    }
+
+    if (workload.pattern_len == 0 or workload.sequence_len == 0) return error.EmptyWorkload;
+    if (openfhe.dnaKmerHistogramOutputs(workload.k) == 0) return error.UnsupportedK;
+    return workload;
+}
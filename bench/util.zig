@@ -0,0 +1,120 @@
+const std = @import("std");
+
+/// Wraps an allocator and records how many bytes pass through it, so each
+/// benchmark can report heap traffic per operation next to its timings.
+pub const CountingAllocator = struct {
+    child: std.mem.Allocator,
+    allocated: usize = 0,
+    live: usize = 0,
+    peak: usize = 0,
+
+    pub fn allocator(self: *CountingAllocator) std.mem.Allocator {
+        return .{
+            .ptr = self,
+            .vtable = &.{
+                .alloc = alloc,
+                .resize = resize,
+                .remap = remap,
+                .free = free,
+            },
+        };
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const ptr = self.child.rawAlloc(len, alignment, ret_addr) orelse return null;
+        self.record(0, len);
+        return ptr;
+    }
+
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        if (!self.child.rawResize(memory, alignment, new_len, ret_addr)) return false;
+        self.record(memory.len, new_len);
+        return true;
+    }
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const ptr = self.child.rawRemap(memory, alignment, new_len, ret_addr) orelse return null;
+        self.record(memory.len, new_len);
+        return ptr;
+    }
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        self.child.rawFree(memory, alignment, ret_addr);
+        self.live -= memory.len;
+    }
+
+    fn record(self: *CountingAllocator, old_len: usize, new_len: usize) void {
+        if (new_len > old_len) self.allocated += new_len - old_len;
+        self.live = self.live + new_len - old_len;
+        self.peak = @max(self.peak, self.live);
+    }
+};
+
+/// User + system CPU time consumed by the process so far
+pub fn cpuTimeNs() u64 {
+    const usage = std.posix.getrusage(std.posix.rusage.SELF);
+    return timevalNs(usage.utime) + timevalNs(usage.stime);
+}
+
+fn timevalNs(tv: std.posix.timeval) u64 {
+    return @as(u64, @intCast(tv.sec)) * std.time.ns_per_s + @as(u64, @intCast(tv.usec)) * std.time.ns_per_us;
+}
+
+pub const Result = struct {
+    iterations: usize,
+    wall_ns: u64,
+    cpu_ns: u64,
+    heap_bytes: usize,
+    heap_peak: usize,
+};
+
+/// Runs `f(context, arena)` `iterations` times. Every iteration gets a fresh
+/// arena on top of a counting allocator, mirroring the per-request arena the
+/// HTTP handlers work with.
+pub fn measure(
+    alloc: std.mem.Allocator,
+    iterations: usize,
+    context: anytype,
+    comptime f: fn (@TypeOf(context), std.mem.Allocator) anyerror!void,
+) !Result {
+    var counting = CountingAllocator{ .child = alloc };
+
+    var timer = try std.time.Timer.start();
+    const cpu_start = cpuTimeNs();
+    for (0..iterations) |_| {
+        var arena = std.heap.ArenaAllocator.init(counting.allocator());
+        defer arena.deinit();
+        try f(context, arena.allocator());
+    }
+
+    return .{
+        .iterations = iterations,
+        .wall_ns = timer.read(),
+        .cpu_ns = cpuTimeNs() - cpu_start,
+        .heap_bytes = counting.allocated,
+        .heap_peak = counting.peak,
+    };
+}
+
+pub fn printHeader(out: *std.Io.Writer, suite: []const u8) !void {
+    try out.print("\n== {s} ==\n", .{suite});
+    try out.print("{s:<32} {s:>8} {s:>14} {s:>14} {s:>14} {s:>14}\n", .{
+        "benchmark", "iters", "wall us/op", "cpu us/op", "heap B/op", "heap peak B",
+    });
+}
+
+pub fn printResult(out: *std.Io.Writer, name: []const u8, r: Result) !void {
+    const n: f64 = @floatFromInt(r.iterations);
+    try out.print("{s:<32} {d:>8} {d:>14.1} {d:>14.1} {d:>14.0} {d:>14}\n", .{
+        name,
+        r.iterations,
+        @as(f64, @floatFromInt(r.wall_ns)) / n / std.time.ns_per_us,
+        @as(f64, @floatFromInt(r.cpu_ns)) / n / std.time.ns_per_us,
+        @as(f64, @floatFromInt(r.heap_bytes)) / n,
+        r.heap_peak,
+    });
+}
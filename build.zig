@@ -7,27 +7,21 @@ const std = @import("std");
 // build runner to parallelize the build automatically (and the cache system to
 // know when a step doesn't need to be re-run).
 pub fn build(b: *std.Build) void {
+    // OpenFHE's native integer width; 64 covers our moduli and keeps the
+    // fastest NTT, 128 is for plaintext moduli above 60 bits
+    const native_size = b.option(u32, "openfhe-native-size", "OpenFHE NATIVE_SIZE (64 or 128)") orelse 64;
+    // Also build OpenFHE and openfhe_c for x86-64-v3 (AVX2) and x86-64-v4
+    // (AVX-512), installed under lib/glibc-hwcaps/ so that the dynamic loader
+    // picks the best build the CPU supports. Pair with `-Dcpu=baseline` for a
+    // portable fallback.
+    const cpu_variants = b.option(bool, "cpu-variants", "Build AVX2 and AVX-512 variants of the FHE libraries") orelse false;
+    // Lets tests decrypt noise with the secret key (ciphertext_noise_measure);
+    // never for deployed servers, which hold no secret keys anyway
+    const exact_noise = b.option(bool, "exact-noise", "Build exact noise measurement into openfhe_c") orelse false;
+
     // Build OpenFHE using CMake
     const openfhe_build_dir = "third-party/openfhe/build";
-
-    const cmake_configure = b.addSystemCommand(&.{
-        "cmake",
-        "-S", "third-party/openfhe",
-        "-B", openfhe_build_dir,
-        "-DCMAKE_CXX_COMPILER=clang++",
-        "-DCMAKE_CXX_FLAGS=-stdlib=libc++",
-        "-DBUILD_UNITTESTS=OFF",
-        "-DBUILD_EXAMPLES=OFF",
-        "-DBUILD_BENCHMARKS=OFF",
-        "-DGIT_SUBMOD_AUTO=OFF",
-    });
-
-    const cmake_build = b.addSystemCommand(&.{
-        "cmake",
-        "--build", openfhe_build_dir,
-        "--parallel",
-    });
-    cmake_build.step.dependOn(&cmake_configure.step);
+    const cmake_build = addOpenfheBuild(b, openfhe_build_dir, "-stdlib=libc++", native_size);
 
     const openfhe_step = b.step("openfhe", "Build OpenFHE");
     openfhe_step.dependOn(&cmake_build.step);
@@ -47,34 +41,49 @@ pub fn build(b: *std.Build) void {
     // in this directory.
 
     // Build C++ wrapper as shared library (cached by Zig)
-    const openfhe_c_mod = b.createModule(.{
-        .target = target,
-        .optimize = optimize,
-    });
-    openfhe_c_mod.addCSourceFile(.{
-        .file = b.path("lib/openfhe_c.cpp"),
-        .flags = &.{ "-std=c++17", "-stdlib=libstdc++" },
-    });
-    openfhe_c_mod.addIncludePath(b.path("lib"));
-    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/src/core/include"));
-    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/src/pke/include"));
-    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/src/binfhe/include"));
-    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/build/src/core"));
-    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/third-party/cereal/include"));
-    openfhe_c_mod.addLibraryPath(b.path("third-party/openfhe/build/lib"));
-    openfhe_c_mod.linkSystemLibrary("OPENFHEcore", .{});
-    openfhe_c_mod.linkSystemLibrary("OPENFHEpke", .{});
-    openfhe_c_mod.linkSystemLibrary("OPENFHEbinfhe", .{});
-    openfhe_c_mod.linkSystemLibrary("c++", .{});
-
-    const openfhe_c = b.addLibrary(.{
-        .name = "openfhe_c",
-        .root_module = openfhe_c_mod,
-        .linkage = .dynamic,
-    });
+    const openfhe_c = addOpenfheC(b, target, optimize, openfhe_build_dir, if (cpu_variants) target.result.cpu.model.name else "default", exact_noise);
     openfhe_c.step.dependOn(&cmake_build.step);
     b.installArtifact(openfhe_c);
 
+    if (cpu_variants) {
+        if (target.result.cpu.arch != .x86_64 or target.result.os.tag != .linux) {
+            @panic("-Dcpu-variants needs an x86_64 Linux target");
+        }
+        // The fallback OpenFHE sits next to the fallback openfhe_c, so the
+        // install prefix holds every variant
+        const install_openfhe = b.addInstallDirectory(.{
+            .source_dir = b.path(openfhe_build_dir ++ "/lib"),
+            .install_dir = .lib,
+            .install_subdir = "",
+        });
+        install_openfhe.step.dependOn(&cmake_build.step);
+        b.getInstallStep().dependOn(&install_openfhe.step);
+
+        for (cpu_variant_list) |variant| {
+            const build_dir = b.fmt("third-party/openfhe/build-{s}", .{variant.name});
+            const variant_build = addOpenfheBuild(b, build_dir, b.fmt("-stdlib=libc++ -march={s}", .{variant.name}), native_size);
+            openfhe_step.dependOn(&variant_build.step);
+
+            var query = target.query;
+            query.cpu_model = .{ .explicit = variant.model };
+            const variant_lib = addOpenfheC(b, b.resolveTargetQuery(query), optimize, build_dir, variant.name, exact_noise);
+            variant_lib.step.dependOn(&variant_build.step);
+
+            const subdir = b.fmt("glibc-hwcaps/{s}", .{variant.name});
+            const install_lib = b.addInstallArtifact(variant_lib, .{
+                .dest_dir = .{ .override = .{ .custom = b.fmt("lib/{s}", .{subdir}) } },
+            });
+            b.getInstallStep().dependOn(&install_lib.step);
+            const install_variant_openfhe = b.addInstallDirectory(.{
+                .source_dir = b.path(b.fmt("{s}/lib", .{build_dir})),
+                .install_dir = .lib,
+                .install_subdir = subdir,
+            });
+            install_variant_openfhe.step.dependOn(&variant_build.step);
+            b.getInstallStep().dependOn(&install_variant_openfhe.step);
+        }
+    }
+
     // OpenFHE Zig bindings module
     const openfhe_mod = b.addModule("openfhe", .{
         .root_source_file = b.path("lib/openfhe.zig"),
@@ -200,9 +209,121 @@ pub fn build(b: *std.Build) void {
     // A run step that will run the test executable.
     const run_mod_tests = b.addRunArtifact(mod_tests);
 
+    // Tests of the server's own logic (scheduler, result cache, worker
+    // protocol), which needs the executable's imports
+    const exe_tests = b.addTest(.{
+        .root_module = exe.root_module,
+    });
+    const run_exe_tests = b.addRunArtifact(exe_tests);
+
     // A top level step for running tests.
     const test_step = b.step("test", "Run tests");
     test_step.dependOn(&run_mod_tests.step);
+    test_step.dependOn(&run_exe_tests.step);
+
+    // Benchmarks for the FHE and request-handling hot paths. Pass a suite
+    // name to run only that suite: `zig build bench -Doptimize=ReleaseFast -- register`
+    const bench = b.addExecutable(.{
+        .name = "bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("bench/main.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "openfhe", .module = openfhe_mod },
+                .{ .name = "pg", .module = pg.module("pg") },
+            },
+        }),
+    });
+    const run_bench = b.addRunArtifact(bench);
+    if (b.args) |args| {
+        run_bench.addArgs(args);
+    }
+    const bench_step = b.step("bench", "Run benchmarks");
+    bench_step.dependOn(&run_bench.step);
+
+    // With -Dcpu-variants, runs the benchmarks once per variant, fallback
+    // first, by limiting which glibc-hwcaps subdirectories the loader may
+    // search. A variant the CPU cannot run falls back to the next best one;
+    // each run prints the build it actually loaded.
+    const bench_variants_step = b.step("bench-variants", "Run benchmarks against each CPU variant");
+    if (cpu_variants) {
+        var previous: ?*std.Build.Step = null;
+        for ([_][]const u8{"none"} ++ cpu_variant_names) |mask| {
+            const run_variant = b.addSystemCommand(&.{ "/lib64/ld-linux-x86-64.so.2", "--glibc-hwcaps-mask", mask });
+            run_variant.addArtifactArg(bench);
+            if (b.args) |args| {
+                run_variant.addArgs(args);
+            }
+            run_variant.setEnvironmentVariable("LD_LIBRARY_PATH", b.getInstallPath(.lib, ""));
+            run_variant.step.dependOn(b.getInstallStep());
+            // One at a time, so the runs do not compete for cores
+            if (previous) |step| run_variant.step.dependOn(step);
+            previous = &run_variant.step;
+            bench_variants_step.dependOn(&run_variant.step);
+        }
+    }
+
+    // Picks BGV parameters for a workload by calibrating each candidate:
+    // `zig build tune -Doptimize=ReleaseFast -- hamming --pattern-len 16`
+    const tune = b.addExecutable(.{
+        .name = "tune",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("bench/tune.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "openfhe", .module = openfhe_mod },
+            },
+        }),
+    });
+    const run_tune = b.addRunArtifact(tune);
+    if (b.args) |args| {
+        run_tune.addArgs(args);
+    }
+    const tune_step = b.step("tune", "Pick BGV parameters for a workload");
+    tune_step.dependOn(&run_tune.step);
+
+    // Drives a running deployment with real BGV traffic and reports latency
+    // percentiles: `zig build loadgen -Doptimize=ReleaseFast -- --scenario session`
+    const loadgen = b.addExecutable(.{
+        .name = "loadgen",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("bench/loadgen.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "openfhe", .module = openfhe_mod },
+            },
+        }),
+    });
+    const run_loadgen = b.addRunArtifact(loadgen);
+    if (b.args) |args| {
+        run_loadgen.addArgs(args);
+    }
+    const loadgen_step = b.step("loadgen", "Load-test a running server");
+    loadgen_step.dependOn(&run_loadgen.step);
+
+    // Generates a seeded, encrypted genome with a ground-truth manifest:
+    // `zig build datagen -Doptimize=ReleaseFast -- --length 100M --plant ACGTACGTACGT:50`
+    const datagen = b.addExecutable(.{
+        .name = "datagen",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("bench/datagen.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "openfhe", .module = openfhe_mod },
+                .{ .name = "uuid", .module = uuid.module("uuid") },
+            },
+        }),
+    });
+    const run_datagen = b.addRunArtifact(datagen);
+    if (b.args) |args| {
+        run_datagen.addArgs(args);
+    }
+    const datagen_step = b.step("datagen", "Generate an encrypted synthetic genome");
+    datagen_step.dependOn(&run_datagen.step);
 
     // Just like flags, top level steps are also listed in the `--help` menu.
     //
@@ -216,3 +337,87 @@ pub fn build(b: *std.Build) void {
     // Lastly, the Zig build system is relatively simple and self-contained,
     // and reading its source code will allow you to master it.
 }
+
+const CpuVariant = struct {
+    /// glibc-hwcaps subdirectory and `-march` value
+    name: []const u8,
+    model: *const std.Target.Cpu.Model,
+};
+
+const cpu_variant_list = [_]CpuVariant{
+    .{ .name = "x86-64-v3", .model = &std.Target.x86.cpu.x86_64_v3 },
+    .{ .name = "x86-64-v4", .model = &std.Target.x86.cpu.x86_64_v4 },
+};
+
+const cpu_variant_names = blk: {
+    var names: [cpu_variant_list.len][]const u8 = undefined;
+    for (cpu_variant_list, &names) |variant, *name| name.* = variant.name;
+    break :blk names;
+};
+
+/// Configures and builds OpenFHE into `build_dir`
+fn addOpenfheBuild(b: *std.Build, build_dir: []const u8, cxx_flags: []const u8, native_size: u32) *std.Build.Step.Run {
+    const cmake_configure = b.addSystemCommand(&.{
+        "cmake",
+        "-S", "third-party/openfhe",
+        "-B", build_dir,
+        "-DCMAKE_CXX_COMPILER=clang++",
+        b.fmt("-DCMAKE_CXX_FLAGS={s}", .{cxx_flags}),
+        "-DBUILD_UNITTESTS=OFF",
+        "-DBUILD_EXAMPLES=OFF",
+        "-DBUILD_BENCHMARKS=OFF",
+        "-DGIT_SUBMOD_AUTO=OFF",
+        b.fmt("-DNATIVE_SIZE={d}", .{native_size}),
+        // -march comes from the flags above, never from the build machine
+        "-DWITH_NATIVEOPT=OFF",
+    });
+
+    const cmake_build = b.addSystemCommand(&.{
+        "cmake",
+        "--build", build_dir,
+        "--parallel",
+    });
+    cmake_build.step.dependOn(&cmake_configure.step);
+    return cmake_build;
+}
+
+/// The C wrapper for `target`, linked against the OpenFHE in `openfhe_build_dir`
+fn addOpenfheC(
+    b: *std.Build,
+    target: std.Build.ResolvedTarget,
+    optimize: std.builtin.OptimizeMode,
+    openfhe_build_dir: []const u8,
+    variant: []const u8,
+    exact_noise: bool,
+) *std.Build.Step.Compile {
+    const openfhe_c_mod = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+    });
+    const variant_flag = b.fmt("-DOPENFHE_C_VARIANT=\"{s}\"", .{variant});
+    openfhe_c_mod.addCSourceFile(.{
+        .file = b.path("lib/openfhe_c.cpp"),
+        .flags = if (exact_noise)
+            &.{ "-std=c++17", "-stdlib=libstdc++", "-fopenmp", variant_flag, "-DOPENFHE_C_EXACT_NOISE" }
+        else
+            &.{ "-std=c++17", "-stdlib=libstdc++", "-fopenmp", variant_flag },
+    });
+    openfhe_c_mod.addIncludePath(b.path("lib"));
+    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/src/core/include"));
+    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/src/pke/include"));
+    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/src/binfhe/include"));
+    openfhe_c_mod.addIncludePath(b.path(b.fmt("{s}/src/core", .{openfhe_build_dir})));
+    openfhe_c_mod.addIncludePath(b.path("third-party/openfhe/third-party/cereal/include"));
+    openfhe_c_mod.addLibraryPath(b.path(b.fmt("{s}/lib", .{openfhe_build_dir})));
+    openfhe_c_mod.linkSystemLibrary("OPENFHEcore", .{});
+    openfhe_c_mod.linkSystemLibrary("OPENFHEpke", .{});
+    openfhe_c_mod.linkSystemLibrary("OPENFHEbinfhe", .{});
+    openfhe_c_mod.linkSystemLibrary("c++", .{});
+    openfhe_c_mod.linkSystemLibrary("omp", .{});
+
+    return b.addLibrary(.{
+        .name = "openfhe_c",
+        .root_module = openfhe_c_mod,
+        .linkage = .dynamic,
+    });
+}
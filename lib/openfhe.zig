@@ -10,6 +10,11 @@ pub const PublicKeyHandle = c.PublicKeyHandle;
 pub const PrivateKeyHandle = c.PrivateKeyHandle;
 pub const CiphertextHandle = c.CiphertextHandle;
 pub const PlaintextHandle = c.PlaintextHandle;
+pub const CiphertextStreamHandle = c.CiphertextStreamHandle;
+pub const SegmentStoreHandle = c.SegmentStoreHandle;
+pub const SegmentStoreStats = c.SegmentStoreStats;
+pub const ZeroPoolStats = c.ZeroPoolStats;
+pub const CowStats = c.CiphertextCowStats;
 
 pub const Error = error{
     NullPointer,
@@ -17,6 +22,7 @@ pub const Error = error{
     CryptoFailure,
     SerializationError,
     KeyNotFound,
+    Aborted,
     InternalError,
 };
 
@@ -28,6 +34,7 @@ fn mapError(err: c.OpenfheError) Error!void {
         c.OPENFHE_ERROR_CRYPTO_FAILURE => Error.CryptoFailure,
         c.OPENFHE_ERROR_SERIALIZATION => Error.SerializationError,
         c.OPENFHE_ERROR_KEY_NOT_FOUND => Error.KeyNotFound,
+        c.OPENFHE_ERROR_ABORTED => Error.Aborted,
         else => Error.InternalError,
     };
 }
@@ -37,6 +44,134 @@ pub fn getLastError() []const u8 {
     return std.mem.span(msg);
 }
 
+/// CPU level of the loaded library build, e.g. "x86-64-v3"; "default" unless
+/// built with `-Dcpu-variants`
+pub fn buildVariant() []const u8 {
+    return std.mem.span(c.openfhe_c_build_variant());
+}
+
+/// Caps the serialized size of all materialized lazy ciphertexts; 0 disables
+pub fn setLazyBudget(bytes: usize) void {
+    c.ciphertext_set_lazy_budget(bytes);
+}
+
+pub fn lazyResidentBytes() usize {
+    return c.ciphertext_get_lazy_resident_bytes();
+}
+
+/// Process-wide copy-on-write counters, see `Ciphertext.clone`
+pub fn cowStats() CowStats {
+    var stats: CowStats = undefined;
+    c.ciphertext_get_cow_stats(&stats);
+    return stats;
+}
+
+/// Rotation indices `CryptoContext.dnaHammingScan` needs keys for; caller
+/// owns the slice
+pub fn dnaHammingScanRotations(pattern_len: usize, allocator: std.mem.Allocator) Error![]i32 {
+    const count = c.dna_hamming_scan_rotations(pattern_len, null, 0);
+    const indices = allocator.alloc(i32, count) catch return Error.InternalError;
+    _ = c.dna_hamming_scan_rotations(pattern_len, indices.ptr, indices.len);
+    return indices;
+}
+
+pub fn dnaHammingMultiOutputs(num_patterns: usize) usize {
+    return c.dna_hamming_multi_outputs(num_patterns);
+}
+
+pub fn dnaKmerHistogramOutputs(k: u32) usize {
+    return c.dna_kmer_histogram_outputs(k);
+}
+
+pub fn dnaKmerPartialSums(k: u32) usize {
+    return c.dna_kmer_partial_sums(k);
+}
+
+/// Adds up the two row totals of one decrypted `dnaKmerHistogram` output:
+/// `slots` holds all ring_dim values, `counts` receives the four k-mers
+pub fn dnaKmerCounts(slots: []const i64, counts: *[4]i64) void {
+    const row = slots.len / 2;
+    for (counts, 0..) |*count, lane| count.* = slots[lane] + slots[row + lane];
+}
+
+pub const DnaLayout = c.DnaLayout;
+pub const DnaLayoutPlan = c.DnaLayoutPlan;
+
+pub const DnaLayoutKind = enum(u32) {
+    one_hot = c.DNA_LAYOUT_ONE_HOT,
+    channels = c.DNA_LAYOUT_CHANNELS,
+    base4 = c.DNA_LAYOUT_BASE4,
+};
+
+pub const DnaKernel = enum(c.DnaKernel) {
+    hamming = c.DNA_KERNEL_HAMMING,
+    hamming_multi = c.DNA_KERNEL_HAMMING_MULTI,
+    kmer = c.DNA_KERNEL_KMER,
+    compare = c.DNA_KERNEL_COMPARE,
+};
+
+/// Ciphertexts one chunk of the layout takes
+pub fn dnaLayoutCiphertexts(kind: DnaLayoutKind) usize {
+    return c.dna_layout_ciphertexts(@intFromEnum(kind));
+}
+
+/// Base to start encrypting bases appended to a genome of `existing_bases`
+/// at, so no window of `window` bases is counted twice
+pub fn dnaLayoutAppendOffset(existing_bases: usize, window: usize) usize {
+    return c.dna_layout_append_offset(existing_bases, window);
+}
+
+pub const NoiseEstimate = c.NoiseEstimate;
+
+/// True if the library was built with `-Dexact-noise=true`, enabling
+/// `CryptoContext.measureNoise`
+pub fn exactNoiseAvailable() bool {
+    return c.openfhe_c_has_exact_noise();
+}
+
+pub const EqualityTestCost = c.EqualityTestCost;
+
+/// Depth and key switches `CryptoContext.evalIsZero` needs in a context with
+/// the given plaintext modulus and max_relin_sk_deg
+pub fn isZeroCost(plaintext_modulus: u64, max_relin_sk_deg: u32) Error!EqualityTestCost {
+    var cost: EqualityTestCost = undefined;
+    try mapError(c.eval_is_zero_cost(plaintext_modulus, max_relin_sk_deg, &cost));
+    return cost;
+}
+
+pub const FheOp = enum(c.FheOp) {
+    add = c.FHE_OP_ADD,
+    mult_plain = c.FHE_OP_MULT_PLAIN,
+    mult = c.FHE_OP_MULT,
+    rotate = c.FHE_OP_ROTATE,
+    rotate_precompute = c.FHE_OP_ROTATE_PRECOMPUTE,
+    fast_rotate = c.FHE_OP_FAST_ROTATE,
+    encrypt = c.FHE_OP_ENCRYPT,
+    deserialize = c.FHE_OP_DESERIALIZE,
+};
+
+pub const CostEstimate = c.FheCostEstimate;
+
+/// Per-operation timings measured by `CryptoContext.calibrateCostModel`
+pub const CostModel = struct {
+    raw: c.FheCostModel,
+
+    /// Predicted CPU nanoseconds of one `op` on ciphertexts of the given shape
+    pub fn opNs(self: CostModel, op: FheOp, ring_dim: u32, towers: u32) f64 {
+        return c.fhe_cost_op_ns(&self.raw, @intFromEnum(op), ring_dim, towers);
+    }
+
+    /// Same, for fresh ciphertexts of the calibrated context
+    pub fn freshOpNs(self: CostModel, op: FheOp) f64 {
+        return self.opNs(op, self.raw.ring_dim, self.raw.towers);
+    }
+
+    /// In-memory size of a fresh ciphertext of the calibrated context
+    pub fn ciphertextBytes(self: CostModel) u64 {
+        return c.fhe_ciphertext_bytes(self.raw.ring_dim, self.raw.towers);
+    }
+};
+
 pub const SerialFormat = enum(c.SerialFormat) {
     binary = c.SERIAL_BINARY,
     json = c.SERIAL_JSON,
@@ -145,6 +280,13 @@ pub const CryptoContext = struct {
         return .{ .handle = handle };
     }
 
+    /// One-hot packs bases (A, C, G, T, or N for unknown) from slot 0
+    pub fn makeDnaPlaintext(self: CryptoContext, bases: []const u8) Error!Plaintext {
+        var handle: c.PlaintextHandle = null;
+        try mapError(c.make_dna_plaintext(self.handle, bases.ptr, bases.len, &handle));
+        return .{ .handle = handle };
+    }
+
     pub fn encrypt(self: CryptoContext, pk: PublicKey, pt: Plaintext) Error!Ciphertext {
         var handle: c.CiphertextHandle = null;
         try mapError(c.encrypt(self.handle, pk.handle, pt.handle, &handle));
@@ -295,6 +437,259 @@ pub const CryptoContext = struct {
         return .{ .handle = handle };
     }
 
+    /// Mismatch profile of `pattern` against each one-hot packed sequence in
+    /// `seqs`, written to `out` (same length). Slot 4j of a profile holds the
+    /// Hamming distance of the window starting at base j; see
+    /// `dna_hamming_scan` for which windows are meaningful. Requires the
+    /// rotation keys listed by `dnaHammingScanRotations`.
+    pub fn dnaHammingScan(self: CryptoContext, seqs: []const Ciphertext, pattern: []const u8, out: []Ciphertext, allocator: std.mem.Allocator) Error!void {
+        std.debug.assert(seqs.len == out.len);
+        const handles = allocator.alloc(c.CiphertextHandle, seqs.len * 2) catch return Error.InternalError;
+        defer allocator.free(handles);
+
+        const inputs = handles[0..seqs.len];
+        const profiles = handles[seqs.len..];
+        for (seqs, inputs) |ct, *handle| handle.* = ct.handle;
+        try mapError(c.dna_hamming_scan(self.handle, inputs.ptr, inputs.len, pattern.ptr, pattern.len, profiles.ptr));
+        for (profiles, out) |handle, *ct| ct.* = .{ .handle = handle };
+    }
+
+    /// Mismatch profiles of every pattern against each sequence in one pass.
+    /// Returns `dnaHammingMultiOutputs(patterns.len)` ciphertexts per sequence,
+    /// sequence by sequence; profile g holds pattern 4g + l in slot 4j + l.
+    /// Caller owns them.
+    pub fn dnaHammingScanMulti(self: CryptoContext, seqs: []const Ciphertext, patterns: []const []const u8, allocator: std.mem.Allocator) Error![]Ciphertext {
+        const outputs = dnaHammingMultiOutputs(patterns.len);
+
+        const inputs = allocator.alloc(c.CiphertextHandle, seqs.len) catch return Error.InternalError;
+        defer allocator.free(inputs);
+        for (seqs, inputs) |ct, *handle| handle.* = ct.handle;
+
+        const ptrs = allocator.alloc([*c]const u8, patterns.len) catch return Error.InternalError;
+        defer allocator.free(ptrs);
+        const lens = allocator.alloc(usize, patterns.len) catch return Error.InternalError;
+        defer allocator.free(lens);
+        for (patterns, ptrs, lens) |pattern, *ptr, *len| {
+            ptr.* = pattern.ptr;
+            len.* = pattern.len;
+        }
+
+        const handles = allocator.alloc(c.CiphertextHandle, seqs.len * outputs) catch return Error.InternalError;
+        defer allocator.free(handles);
+        try mapError(c.dna_hamming_scan_multi(self.handle, inputs.ptr, inputs.len, ptrs.ptr, lens.ptr, patterns.len, handles.ptr));
+
+        const profiles = allocator.alloc(Ciphertext, handles.len) catch {
+            for (handles) |handle| c.ciphertext_destroy(handle);
+            return Error.InternalError;
+        };
+        for (handles, profiles) |handle, *ct| ct.* = .{ .handle = handle };
+        return profiles;
+    }
+
+    /// Rotation indices `dnaHammingScanMulti` needs keys for; caller owns the slice
+    pub fn dnaHammingMultiRotations(self: CryptoContext, max_pattern_len: usize, allocator: std.mem.Allocator) Error![]i32 {
+        const count = c.dna_hamming_multi_rotations(self.handle, max_pattern_len, null, 0);
+        const indices = allocator.alloc(i32, count) catch return Error.InternalError;
+        _ = c.dna_hamming_multi_rotations(self.handle, max_pattern_len, indices.ptr, indices.len);
+        return indices;
+    }
+
+    /// Counts of all 4^k k-mers over the one-hot packed sequences, as
+    /// `dnaKmerHistogramOutputs(k)` ciphertexts; caller owns them. See
+    /// `dna_kmer_histogram` for the layout, and `dnaKmerCounts` to decode.
+    pub fn dnaKmerHistogram(self: CryptoContext, seqs: []const Ciphertext, k: u32, allocator: std.mem.Allocator) Error![]Ciphertext {
+        const outputs = c.dna_kmer_histogram_outputs(k);
+        if (outputs == 0) return Error.InvalidParam;
+
+        const inputs = allocator.alloc(c.CiphertextHandle, seqs.len) catch return Error.InternalError;
+        defer allocator.free(inputs);
+        for (seqs, inputs) |ct, *handle| handle.* = ct.handle;
+
+        const handles = allocator.alloc(c.CiphertextHandle, outputs) catch return Error.InternalError;
+        defer allocator.free(handles);
+        try mapError(c.dna_kmer_histogram(self.handle, inputs.ptr, inputs.len, k, handles.ptr));
+
+        const counts = allocator.alloc(Ciphertext, outputs) catch {
+            for (handles) |handle| c.ciphertext_destroy(handle);
+            return Error.InternalError;
+        };
+        for (handles, counts) |handle, *ct| ct.* = .{ .handle = handle };
+        return counts;
+    }
+
+    /// Starts counting k-mers incrementally: the `dnaKmerPartialSums(k)`
+    /// partial sums of `seqs`, which `dnaKmerAccumulate` extends and
+    /// `dnaKmerFinalize` turns into the histogram; caller owns them
+    pub fn dnaKmerPartials(self: CryptoContext, seqs: []const Ciphertext, k: u32, allocator: std.mem.Allocator) Error![]Ciphertext {
+        const kmers = c.dna_kmer_partial_sums(k);
+        if (kmers == 0) return Error.InvalidParam;
+
+        const inputs = allocator.alloc(c.CiphertextHandle, seqs.len) catch return Error.InternalError;
+        defer allocator.free(inputs);
+        for (seqs, inputs) |ct, *handle| handle.* = ct.handle;
+
+        const handles = allocator.alloc(c.CiphertextHandle, kmers) catch return Error.InternalError;
+        defer allocator.free(handles);
+        @memset(handles, null);
+        try mapError(c.dna_kmer_accumulate(self.handle, inputs.ptr, inputs.len, k, handles.ptr));
+
+        const partials = allocator.alloc(Ciphertext, kmers) catch {
+            for (handles) |handle| c.ciphertext_destroy(handle);
+            return Error.InternalError;
+        };
+        for (handles, partials) |handle, *ct| ct.* = .{ .handle = handle };
+        return partials;
+    }
+
+    /// Adds the k-mers of `seqs`, e.g. newly appended chunks, to `partials`
+    /// in place; on error they are unchanged
+    pub fn dnaKmerAccumulate(self: CryptoContext, seqs: []const Ciphertext, k: u32, partials: []Ciphertext, allocator: std.mem.Allocator) Error!void {
+        if (partials.len != c.dna_kmer_partial_sums(k)) return Error.InvalidParam;
+
+        const inputs = allocator.alloc(c.CiphertextHandle, seqs.len) catch return Error.InternalError;
+        defer allocator.free(inputs);
+        for (seqs, inputs) |ct, *handle| handle.* = ct.handle;
+
+        const handles = allocator.alloc(c.CiphertextHandle, partials.len) catch return Error.InternalError;
+        defer allocator.free(handles);
+        for (partials, handles) |ct, *handle| handle.* = ct.handle;
+        try mapError(c.dna_kmer_accumulate(self.handle, inputs.ptr, inputs.len, k, handles.ptr));
+    }
+
+    /// The `dnaKmerHistogram` outputs for the k-mers counted in `partials`;
+    /// caller owns them
+    pub fn dnaKmerFinalize(self: CryptoContext, partials: []const Ciphertext, k: u32, allocator: std.mem.Allocator) Error![]Ciphertext {
+        const outputs = c.dna_kmer_histogram_outputs(k);
+        if (outputs == 0 or partials.len != c.dna_kmer_partial_sums(k)) return Error.InvalidParam;
+
+        const inputs = allocator.alloc(c.CiphertextHandle, partials.len) catch return Error.InternalError;
+        defer allocator.free(inputs);
+        for (partials, inputs) |ct, *handle| handle.* = ct.handle;
+
+        const handles = allocator.alloc(c.CiphertextHandle, outputs) catch return Error.InternalError;
+        defer allocator.free(handles);
+        try mapError(c.dna_kmer_finalize(self.handle, inputs.ptr, k, handles.ptr));
+
+        const counts = allocator.alloc(Ciphertext, outputs) catch {
+            for (handles) |handle| c.ciphertext_destroy(handle);
+            return Error.InternalError;
+        };
+        for (handles, counts) |handle, *ct| ct.* = .{ .handle = handle };
+        return counts;
+    }
+
+    /// Rotation indices `dnaKmerHistogram` needs keys for; caller owns the slice
+    pub fn dnaKmerRotations(self: CryptoContext, k: u32, allocator: std.mem.Allocator) Error![]i32 {
+        const count = c.dna_kmer_rotations(self.handle, k, null, 0);
+        if (count == 0) return Error.InvalidParam;
+        const indices = allocator.alloc(i32, count) catch return Error.InternalError;
+        _ = c.dna_kmer_rotations(self.handle, k, indices.ptr, indices.len);
+        return indices;
+    }
+
+    /// Layout with the fewest ciphertexts that `kernel` accepts for a genome
+    /// of `genome_len` bases searched with windows of `window` bases
+    pub fn dnaLayoutPlan(self: CryptoContext, kernel: DnaKernel, genome_len: usize, window: usize) Error!DnaLayoutPlan {
+        var plan: DnaLayoutPlan = undefined;
+        try mapError(c.dna_layout_plan(self.handle, @intFromEnum(kernel), genome_len, window, &plan));
+        return plan;
+    }
+
+    /// Encrypts one chunk in `layout` into `out`, which must hold
+    /// `dnaLayoutCiphertexts` ciphertexts for the layout's kind
+    pub fn dnaLayoutEncrypt(self: CryptoContext, pk: PublicKey, layout: DnaLayout, bases: []const u8, out: []Ciphertext) Error!void {
+        var handles: [4]c.CiphertextHandle = undefined;
+        std.debug.assert(out.len == c.dna_layout_ciphertexts(layout.kind));
+        try mapError(c.dna_layout_encrypt(self.handle, pk.handle, &layout, bases.ptr, bases.len, &handles));
+        for (out, handles[0..out.len]) |*ct, handle| ct.* = .{ .handle = handle };
+    }
+
+    /// Encrypts `chunks` consecutive chunks of `bases` on all cores; chunk i
+    /// starts at base i * `DnaLayoutPlan.bases_per_chunk`. `out` must hold
+    /// `dnaLayoutCiphertexts` ciphertexts per chunk. On error none of `out`
+    /// is set.
+    pub fn dnaLayoutEncryptBatch(self: CryptoContext, pk: PublicKey, layout: DnaLayout, bases: []const u8, chunks: usize, out: []Ciphertext, allocator: std.mem.Allocator) Error!void {
+        std.debug.assert(out.len == chunks * c.dna_layout_ciphertexts(layout.kind));
+        const handles = allocator.alloc(c.CiphertextHandle, out.len) catch return Error.InternalError;
+        defer allocator.free(handles);
+        try mapError(c.dna_layout_encrypt_batch(self.handle, pk.handle, &layout, bases.ptr, bases.len, chunks, handles.ptr));
+        for (handles, out) |handle, *ct| ct.* = .{ .handle = handle };
+    }
+
+    /// Splits a one-hot or base-4 ciphertext into its four channels
+    pub fn dnaLayoutSplit(self: CryptoContext, ct: Ciphertext) Error![4]Ciphertext {
+        var handles: [4]c.CiphertextHandle = undefined;
+        try mapError(c.dna_layout_split(self.handle, ct.handle, &handles));
+        var channels: [4]Ciphertext = undefined;
+        for (&channels, handles) |*channel, handle| channel.* = .{ .handle = handle };
+        return channels;
+    }
+
+    /// Merges four channel ciphertexts into one of `kind` (one-hot or base-4)
+    pub fn dnaLayoutMerge(self: CryptoContext, channels: [4]Ciphertext, kind: DnaLayoutKind) Error!Ciphertext {
+        var handles: [4]c.CiphertextHandle = undefined;
+        for (&handles, channels) |*handle, channel| handle.* = channel.handle;
+        var handle: c.CiphertextHandle = null;
+        try mapError(c.dna_layout_merge(self.handle, &handles, @intFromEnum(kind), &handle));
+        return .{ .handle = handle };
+    }
+
+    /// 1 in every slot of `ct` holding 0, 0 elsewhere. Fails with
+    /// `Error.InvalidParam` if `ct` has fewer levels left than
+    /// `isZeroCost` reports.
+    pub fn evalIsZero(self: CryptoContext, ct: Ciphertext) Error!Ciphertext {
+        var handle: c.CiphertextHandle = null;
+        try mapError(c.eval_is_zero(self.handle, ct.handle, &handle));
+        return .{ .handle = handle };
+    }
+
+    /// 1 in every slot where `ct1` and `ct2` agree, 0 elsewhere
+    pub fn evalEqual(self: CryptoContext, ct1: Ciphertext, ct2: Ciphertext) Error!Ciphertext {
+        var handle: c.CiphertextHandle = null;
+        try mapError(c.eval_equal(self.handle, ct1.handle, ct2.handle, &handle));
+        return .{ .handle = handle };
+    }
+
+    /// Analytic noise bound of `ct`, tracked through the operations that
+    /// produced it
+    pub fn noiseEstimate(self: CryptoContext, ct: Ciphertext) Error!NoiseEstimate {
+        var estimate: NoiseEstimate = undefined;
+        try mapError(c.ciphertext_noise_estimate(self.handle, ct.handle, &estimate));
+        return estimate;
+    }
+
+    /// Towers `ct` could shed while keeping `min_budget_bits` of estimated
+    /// budget; 0 if its noise is not tracked
+    pub fn droppableTowers(self: CryptoContext, ct: Ciphertext, min_budget_bits: f64) Error!u32 {
+        var towers: u32 = 0;
+        try mapError(c.ciphertext_noise_droppable_towers(self.handle, ct.handle, min_budget_bits, &towers));
+        return towers;
+    }
+
+    /// Exact noise of `ct`, decrypted with `sk`; needs `exactNoiseAvailable()`
+    pub fn measureNoise(self: CryptoContext, sk: PrivateKey, ct: Ciphertext) Error!NoiseEstimate {
+        var measurement: NoiseEstimate = undefined;
+        try mapError(c.ciphertext_noise_measure(self.handle, sk.handle, ct.handle, &measurement));
+        return measurement;
+    }
+
+    /// Times every operation on this context, see `CostModel`. Registers and
+    /// removes throwaway evaluation keys, so nothing may evaluate meanwhile.
+    pub fn calibrateCostModel(self: CryptoContext, iterations: u32) Error!CostModel {
+        var model: CostModel = undefined;
+        try mapError(c.fhe_cost_model_calibrate(self.handle, iterations, &model.raw));
+        return model;
+    }
+
+    /// Predicted CPU time and peak memory of running `kernel` over `chunks`
+    /// ciphertexts; `window` is the (longest) pattern length or k, `patterns`
+    /// the panel size for `.hamming_multi`
+    pub fn dnaKernelCost(self: CryptoContext, model: CostModel, kernel: DnaKernel, chunks: usize, window: usize, patterns: usize) Error!CostEstimate {
+        var estimate: CostEstimate = undefined;
+        try mapError(c.dna_kernel_cost(self.handle, &model.raw, @intFromEnum(kernel), chunks, window, patterns, &estimate));
+        return estimate;
+    }
+
     // Serialization
     pub fn serialize(self: CryptoContext, format: SerialFormat, allocator: std.mem.Allocator) Error![]u8 {
         var data: [*]u8 = undefined;
@@ -313,6 +708,19 @@ pub const CryptoContext = struct {
         return .{ .handle = handle };
     }
 
+    /// Atomically writes a snapshot of the context to `path`
+    pub fn saveSnapshot(self: CryptoContext, path: [:0]const u8) Error!void {
+        try mapError(c.crypto_context_snapshot_save(self.handle, path.ptr));
+    }
+
+    /// Restores a context written by `saveSnapshot`. Fails with
+    /// `Error.InvalidParam` for snapshots of another format or OpenFHE version.
+    pub fn loadSnapshot(path: [:0]const u8) Error!CryptoContext {
+        var handle: c.CryptoContextHandle = null;
+        try mapError(c.crypto_context_snapshot_load(path.ptr, &handle));
+        return .{ .handle = handle };
+    }
+
     pub fn serializeEvalMultKeys(self: CryptoContext, format: SerialFormat, allocator: std.mem.Allocator) Error![]u8 {
         var data: [*]u8 = undefined;
         var size: usize = 0;
@@ -343,6 +751,22 @@ pub const CryptoContext = struct {
         try mapError(c.eval_automorphism_keys_deserialize(self.handle, data.ptr, data.len, @intFromEnum(format)));
     }
 
+    /// Registers the keys under `register_tag`, only if all of them carry
+    /// `key_tag` (see `PublicKey.getTag`). Ciphertexts are evaluated with them
+    /// once retagged with `Ciphertext.setKeyTag(register_tag)`.
+    pub fn deserializeEvalMultKeysTagged(self: CryptoContext, data: []const u8, format: SerialFormat, key_tag: [:0]const u8, register_tag: [:0]const u8) Error!void {
+        try mapError(c.eval_mult_keys_deserialize_tagged(self.handle, data.ptr, data.len, @intFromEnum(format), key_tag.ptr, register_tag.ptr));
+    }
+
+    pub fn deserializeEvalAutomorphismKeysTagged(self: CryptoContext, data: []const u8, format: SerialFormat, key_tag: [:0]const u8, register_tag: [:0]const u8) Error!void {
+        try mapError(c.eval_automorphism_keys_deserialize_tagged(self.handle, data.ptr, data.len, @intFromEnum(format), key_tag.ptr, register_tag.ptr));
+    }
+
+    /// Drops the multiplication and automorphism keys registered under `key_tag`
+    pub fn clearEvalKeys(self: CryptoContext, key_tag: [:0]const u8) Error!void {
+        try mapError(c.eval_keys_clear(self.handle, key_tag.ptr));
+    }
+
     pub fn deinit(self: *CryptoContext) void {
         c.crypto_context_destroy(self.handle);
         self.handle = null;
@@ -386,6 +810,22 @@ pub const PublicKey = struct {
         return .{ .handle = handle };
     }
 
+    /// Fails with `Error.InvalidParam` unless the key belongs to `ctx`'s parameters
+    pub fn checkContext(self: PublicKey, ctx: CryptoContext) Error!void {
+        try mapError(c.public_key_check_context(ctx.handle, self.handle));
+    }
+
+    /// Tag of the key pair, under which its evaluation keys are registered
+    pub fn getTag(self: PublicKey, allocator: std.mem.Allocator) Error![:0]u8 {
+        var len: usize = 0;
+        try mapError(c.public_key_get_tag(self.handle, null, 0, &len));
+
+        const tag = allocator.allocSentinel(u8, len, 0) catch return Error.InternalError;
+        errdefer allocator.free(tag);
+        try mapError(c.public_key_get_tag(self.handle, tag.ptr, tag.len, &len));
+        return tag;
+    }
+
     pub fn deinit(self: *PublicKey) void {
         c.public_key_destroy(self.handle);
         self.handle = null;
@@ -444,14 +884,26 @@ pub const Plaintext = struct {
 pub const Ciphertext = struct {
     handle: c.CiphertextHandle,
 
+    /// O(1): the clone shares the polynomials until either handle is
+    /// modified in place, which copies them for that handle
     pub fn clone(self: Ciphertext) Ciphertext {
         return .{ .handle = c.ciphertext_clone(self.handle) };
     }
 
+    /// True while the polynomials are shared with a clone
+    pub fn isShared(self: Ciphertext) bool {
+        return c.ciphertext_is_shared(self.handle);
+    }
+
     pub fn getLevel(self: Ciphertext) u32 {
         return c.ciphertext_get_level(self.handle);
     }
 
+    /// Evaluation keys are looked up by this tag (see `deserializeEvalMultKeysTagged`)
+    pub fn setKeyTag(self: Ciphertext, key_tag: [:0]const u8) Error!void {
+        try mapError(c.ciphertext_set_key_tag(self.handle, key_tag.ptr));
+    }
+
     pub fn serialize(self: Ciphertext, format: SerialFormat, allocator: std.mem.Allocator) Error![]u8 {
         var data: [*]u8 = undefined;
         var size: usize = 0;
@@ -463,18 +915,262 @@ pub const Ciphertext = struct {
         return result;
     }
 
+    /// Serializes straight into `writer`, anything with a `writeAll([]const u8) !void`
+    /// method (e.g. `*std.Io.Writer`), in blocks of at most 64 KiB.
+    pub fn serializeTo(self: Ciphertext, format: SerialFormat, writer: anytype) Error!void {
+        const Writer = @TypeOf(writer);
+        const Trampoline = struct {
+            fn call(user_ctx: ?*anyopaque, data: [*c]const u8, size: usize) callconv(.c) c_int {
+                const w: *const Writer = @ptrCast(@alignCast(user_ctx));
+                w.*.writeAll(data[0..size]) catch return 1;
+                return 0;
+            }
+        };
+        try mapError(c.ciphertext_serialize_to(self.handle, @intFromEnum(format), &Trampoline.call, @ptrCast(@constCast(&writer))));
+    }
+
     pub fn deserialize(ctx: CryptoContext, data: []const u8, format: SerialFormat) Error!Ciphertext {
         var handle: c.CiphertextHandle = null;
         try mapError(c.ciphertext_deserialize(ctx.handle, data.ptr, data.len, @intFromEnum(format), &handle));
         return .{ .handle = handle };
     }
 
+    /// Handle that decodes `data` on first use. `data` is borrowed and must
+    /// outlive the handle and its clones.
+    pub fn lazyFromSpan(ctx: CryptoContext, data: []const u8, format: SerialFormat) Error!Ciphertext {
+        var handle: c.CiphertextHandle = null;
+        try mapError(c.ciphertext_lazy_from_span(ctx.handle, data.ptr, data.len, @intFromEnum(format), &handle));
+        return .{ .handle = handle };
+    }
+
+    /// Handle that decodes a segment store object on first use; the store
+    /// must outlive the handle
+    pub fn lazyFromStore(ctx: CryptoContext, store: SegmentStore, session: *const SegmentStore.SessionId, object_id: u64, format: SerialFormat) Error!Ciphertext {
+        var handle: c.CiphertextHandle = null;
+        try mapError(c.ciphertext_lazy_from_store(ctx.handle, store.handle, session, object_id, @intFromEnum(format), &handle));
+        return .{ .handle = handle };
+    }
+
+    pub fn isLazy(self: Ciphertext) bool {
+        return c.ciphertext_is_lazy(self.handle);
+    }
+
+    pub fn isMaterialized(self: Ciphertext) bool {
+        return c.ciphertext_is_materialized(self.handle);
+    }
+
+    /// Drops the polynomials of an unmodified lazy handle
+    pub fn evict(self: Ciphertext) bool {
+        return c.ciphertext_evict(self.handle);
+    }
+
+    /// DNA slot layout recorded on the ciphertext, if any
+    pub fn getDnaLayout(self: Ciphertext) ?DnaLayout {
+        var layout: DnaLayout = undefined;
+        return if (c.ciphertext_get_dna_layout(self.handle, &layout)) layout else null;
+    }
+
+    pub fn setDnaLayout(self: Ciphertext, layout: DnaLayout) Error!void {
+        try mapError(c.ciphertext_set_dna_layout(self.handle, &layout));
+    }
+
+    /// Adds a fresh encryption of zero from `pool`, hiding how the ciphertext
+    /// was computed without changing its plaintext
+    pub fn rerandomize(self: Ciphertext, pool: ZeroPool) Error!void {
+        try mapError(c.ciphertext_rerandomize(self.handle, pool.handle));
+    }
+
+    /// Deserializes independent blobs in parallel into `out` (same length as
+    /// `blobs`). Each must belong to `ctx` and, unless `level` is null, be at
+    /// that level. On error none of `out` is set.
+    pub fn deserializeBatch(ctx: CryptoContext, blobs: []const []const u8, format: SerialFormat, level: ?u32, out: []Ciphertext, allocator: std.mem.Allocator) Error!void {
+        std.debug.assert(blobs.len == out.len);
+        const spans = allocator.alloc(c.OpenfheSpan, blobs.len) catch return Error.InternalError;
+        defer allocator.free(spans);
+        const handles = allocator.alloc(c.CiphertextHandle, blobs.len) catch return Error.InternalError;
+        defer allocator.free(handles);
+
+        for (blobs, spans) |blob, *span| span.* = .{ .data = blob.ptr, .size = blob.len };
+        try mapError(c.ciphertext_deserialize_batch(
+            ctx.handle,
+            spans.ptr,
+            spans.len,
+            @intFromEnum(format),
+            level orelse std.math.maxInt(u32),
+            handles.ptr,
+        ));
+        for (handles, out) |handle, *ct| ct.* = .{ .handle = handle };
+    }
+
     pub fn deinit(self: *Ciphertext) void {
         c.ciphertext_destroy(self.handle);
         self.handle = null;
     }
 };
 
+/// Incremental decoder for a stream of length-prefixed ciphertexts
+/// (u32 little-endian length, then the serialized ciphertext).
+pub const CiphertextStream = struct {
+    handle: c.CiphertextStreamHandle,
+
+    pub fn init(ctx: CryptoContext, format: SerialFormat, max_frame_size: usize) Error!CiphertextStream {
+        var handle: c.CiphertextStreamHandle = null;
+        try mapError(c.ciphertext_stream_create(ctx.handle, @intFromEnum(format), max_frame_size, &handle));
+        return .{ .handle = handle };
+    }
+
+    /// Decodes every frame completed by `data` and passes it to
+    /// `sink.onCiphertext(frame: []const u8, ct: Ciphertext) !void`.
+    /// The sink owns `ct` even when it returns an error, which aborts the stream.
+    pub fn feed(self: CiphertextStream, data: []const u8, sink: anytype) Error!void {
+        const Sink = @TypeOf(sink);
+        const Trampoline = struct {
+            fn call(user_ctx: ?*anyopaque, frame: [*c]const u8, frame_size: usize, ct: c.CiphertextHandle) callconv(.c) c_int {
+                const s: Sink = @ptrCast(@alignCast(user_ctx));
+                s.onCiphertext(frame[0..frame_size], .{ .handle = ct }) catch return 1;
+                return 0;
+            }
+        };
+        try mapError(c.ciphertext_stream_feed(self.handle, data.ptr, data.len, &Trampoline.call, sink));
+    }
+
+    /// Fails if the input ended in the middle of a frame
+    pub fn finish(self: CiphertextStream) Error!void {
+        try mapError(c.ciphertext_stream_finish(self.handle));
+    }
+
+    pub fn count(self: CiphertextStream) u64 {
+        return c.ciphertext_stream_get_count(self.handle);
+    }
+
+    pub fn deinit(self: *CiphertextStream) void {
+        c.ciphertext_stream_destroy(self.handle);
+        self.handle = null;
+    }
+};
+
+/// Append-only, memory-mapped store for serialized objects keyed by
+/// (16-byte session id, object id).
+pub const SegmentStore = struct {
+    handle: c.SegmentStoreHandle,
+
+    pub const SessionId = [16]u8;
+
+    /// `segment_size` of 0 selects the default (256 MiB)
+    pub fn open(dir: [:0]const u8, segment_size: u64) Error!SegmentStore {
+        var handle: c.SegmentStoreHandle = null;
+        try mapError(c.segment_store_open(dir.ptr, segment_size, &handle));
+        return .{ .handle = handle };
+    }
+
+    pub fn put(self: SegmentStore, session: *const SessionId, object_id: u64, data: []const u8) Error!void {
+        try mapError(c.segment_store_put(self.handle, session, object_id, data.ptr, data.len));
+    }
+
+    /// Zero-copy view into the mapping; valid until `compact` or `close`
+    pub fn get(self: SegmentStore, session: *const SessionId, object_id: u64) Error![]const u8 {
+        var data: [*c]const u8 = null;
+        var size: usize = 0;
+        try mapError(c.segment_store_get(self.handle, session, object_id, &data, &size));
+        return data[0..size];
+    }
+
+    pub fn loadCiphertext(self: SegmentStore, ctx: CryptoContext, session: *const SessionId, object_id: u64, format: SerialFormat) Error!Ciphertext {
+        var handle: c.CiphertextHandle = null;
+        try mapError(c.segment_store_load_ciphertext(self.handle, ctx.handle, session, object_id, @intFromEnum(format), &handle));
+        return .{ .handle = handle };
+    }
+
+    /// Object ids of the session in ascending order; caller owns the slice
+    pub fn list(self: SegmentStore, session: *const SessionId, allocator: std.mem.Allocator) Error![]u64 {
+        var count: usize = 0;
+        try mapError(c.segment_store_list(self.handle, session, null, 0, &count));
+        while (true) {
+            const ids = allocator.alloc(u64, count) catch return Error.InternalError;
+            var total: usize = 0;
+            mapError(c.segment_store_list(self.handle, session, ids.ptr, ids.len, &total)) catch |err| {
+                allocator.free(ids);
+                return err;
+            };
+            if (total == ids.len) return ids;
+            // The session changed between the two calls
+            allocator.free(ids);
+            count = total;
+        }
+    }
+
+    pub fn delete(self: SegmentStore, session: *const SessionId, object_id: u64) Error!void {
+        try mapError(c.segment_store_delete(self.handle, session, object_id));
+    }
+
+    pub fn deleteSession(self: SegmentStore, session: *const SessionId) Error!void {
+        try mapError(c.segment_store_delete_session(self.handle, session));
+    }
+
+    pub fn compact(self: SegmentStore) Error!void {
+        try mapError(c.segment_store_compact(self.handle));
+    }
+
+    /// Compacts the oldest segment with dead bytes; true while more remain
+    pub fn compactStep(self: SegmentStore) Error!bool {
+        var more = false;
+        try mapError(c.segment_store_compact_step(self.handle, &more));
+        return more;
+    }
+
+    pub fn sync(self: SegmentStore) Error!void {
+        try mapError(c.segment_store_sync(self.handle));
+    }
+
+    pub fn stats(self: SegmentStore) SegmentStoreStats {
+        var out: SegmentStoreStats = undefined;
+        c.segment_store_get_stats(self.handle, &out);
+        return out;
+    }
+
+    pub fn close(self: *SegmentStore) void {
+        c.segment_store_close(self.handle);
+        self.handle = null;
+    }
+};
+
+/// Encryptions of zero under one public key, precomputed for
+/// `Ciphertext.rerandomize` by one idle-priority thread shared by all pools
+pub const ZeroPool = struct {
+    handle: c.ZeroPoolHandle,
+
+    /// Caps the bytes all pools of the process hold together; 0 selects 256 MiB
+    pub fn setBudget(bytes: usize) void {
+        c.zero_pool_set_budget(bytes);
+    }
+
+    pub fn pooledBytes() usize {
+        return c.zero_pool_get_pooled_bytes();
+    }
+
+    pub fn init(ctx: CryptoContext, pk: PublicKey, capacity: usize) Error!ZeroPool {
+        var handle: c.ZeroPoolHandle = null;
+        try mapError(c.zero_pool_create(ctx.handle, pk.handle, capacity, &handle));
+        return .{ .handle = handle };
+    }
+
+    pub fn stats(self: ZeroPool) ZeroPoolStats {
+        var out: ZeroPoolStats = undefined;
+        c.zero_pool_get_stats(self.handle, &out);
+        return out;
+    }
+
+    /// Keeps at least `capacity` encryptions ready from now on
+    pub fn reserve(self: ZeroPool, capacity: usize) void {
+        c.zero_pool_reserve(self.handle, capacity);
+    }
+
+    pub fn deinit(self: *ZeroPool) void {
+        c.zero_pool_destroy(self.handle);
+        self.handle = null;
+    }
+};
+
 // Tests
 test "BGV basic operations" {
     // Create context
@@ -780,3 +1476,1260 @@ test "BGV public key serialization" {
     try std.testing.expectEqual(@as(i64, 44), decrypted[2]);
     try std.testing.expectEqual(@as(i64, 45), decrypted[3]);
 }
+
+test "BGV ciphertext stream decoding" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    // Build a stream of three length-prefixed ciphertexts
+    var stream_bytes: std.ArrayList(u8) = .empty;
+    defer stream_bytes.deinit(allocator);
+    for (0..3) |i| {
+        const values = [_]i64{ @intCast(i), @intCast(i + 10) };
+        var pt = try ctx.makePackedPlaintext(&values);
+        defer pt.deinit();
+        var ct = try ctx.encrypt(pk, pt);
+        defer ct.deinit();
+
+        const serialized = try ct.serialize(.binary, allocator);
+        defer allocator.free(serialized);
+
+        var len: [4]u8 = undefined;
+        std.mem.writeInt(u32, &len, @intCast(serialized.len), .little);
+        try stream_bytes.appendSlice(allocator, &len);
+        try stream_bytes.appendSlice(allocator, serialized);
+    }
+
+    const Sink = struct {
+        ctx: CryptoContext,
+        sk: PrivateKey,
+        seen: usize = 0,
+
+        pub fn onCiphertext(self: *@This(), _: []const u8, ct: Ciphertext) !void {
+            var owned = ct;
+            defer owned.deinit();
+
+            var pt = try self.ctx.decrypt(self.sk, owned);
+            defer pt.deinit();
+            var buffer: [16]i64 = undefined;
+            const decrypted = try pt.getValues(&buffer);
+            try std.testing.expectEqual(@as(i64, @intCast(self.seen)), decrypted[0]);
+            try std.testing.expectEqual(@as(i64, @intCast(self.seen + 10)), decrypted[1]);
+            self.seen += 1;
+        }
+    };
+    var sink = Sink{ .ctx = ctx, .sk = sk };
+
+    var stream = try CiphertextStream.init(ctx, .binary, 64 * 1024 * 1024);
+    defer stream.deinit();
+
+    // Odd chunk size so frames and length prefixes get split across feeds
+    var rest: []const u8 = stream_bytes.items;
+    while (rest.len > 0) {
+        const n = @min(rest.len, 4099);
+        try stream.feed(rest[0..n], &sink);
+        rest = rest[n..];
+    }
+    try stream.finish();
+
+    try std.testing.expectEqual(@as(usize, 3), sink.seen);
+    try std.testing.expectEqual(@as(u64, 3), stream.count());
+}
+
+test "BGV ciphertext serialization to writer" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    const values = [_]i64{ 7, 8, 9 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+
+    var ct = try ctx.encrypt(pk, pt);
+    defer ct.deinit();
+
+    const expected = try ct.serialize(.binary, allocator);
+    defer allocator.free(expected);
+
+    var out: std.Io.Writer.Allocating = .init(allocator);
+    defer out.deinit();
+    try ct.serializeTo(.binary, &out.writer);
+
+    try std.testing.expectEqualSlices(u8, expected, out.written());
+}
+
+test "segment store put, reopen and compact" {
+    const allocator = std.testing.allocator;
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(dir);
+    const dir_z = try allocator.dupeZ(u8, dir);
+    defer allocator.free(dir_z);
+
+    const a: SegmentStore.SessionId = @splat(0xaa);
+    const b: SegmentStore.SessionId = @splat(0xbb);
+
+    {
+        // Tiny segments so the records spread over several files
+        var store = try SegmentStore.open(dir_z, 4096);
+        defer store.close();
+
+        var payload: [1500]u8 = undefined;
+        for (0..4) |i| {
+            @memset(&payload, @intCast(i));
+            try store.put(&a, i, &payload);
+        }
+        try store.put(&b, 0, "other session");
+        try store.put(&a, 1, "replaced");
+        try store.sync();
+    }
+
+    var store = try SegmentStore.open(dir_z, 4096);
+    defer store.close();
+
+    try std.testing.expectEqualSlices(u8, "replaced", try store.get(&a, 1));
+    try std.testing.expectEqual(@as(u8, 3), (try store.get(&a, 3))[1499]);
+
+    const ids = try store.list(&a, allocator);
+    defer allocator.free(ids);
+    try std.testing.expectEqualSlices(u64, &.{ 0, 1, 2, 3 }, ids);
+
+    try store.deleteSession(&b);
+    try store.delete(&a, 0);
+    try std.testing.expectError(Error.KeyNotFound, store.get(&b, 0));
+    try std.testing.expect(store.stats().dead_bytes > 0);
+
+    // One step at a time reaches the same state as a full compaction
+    while (try store.compactStep()) {}
+    const stats = store.stats();
+    try std.testing.expectEqual(@as(u64, 0), stats.dead_bytes);
+    try std.testing.expectEqual(@as(u64, 3), stats.live_objects);
+    try std.testing.expectEqualSlices(u8, "replaced", try store.get(&a, 1));
+    try std.testing.expectEqual(@as(u8, 2), (try store.get(&a, 2))[0]);
+}
+
+test "BGV tagged eval key loading" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    var other = try ctx.keyGen();
+    defer other.deinit();
+    var other_pk = other.getPublicKey();
+    defer other_pk.deinit();
+
+    const tag = try pk.getTag(allocator);
+    defer allocator.free(tag);
+    const other_tag = try other_pk.getTag(allocator);
+    defer allocator.free(other_tag);
+    try std.testing.expect(!std.mem.eql(u8, tag, other_tag));
+
+    // Public keys are only accepted for the parameters they were made for
+    try pk.checkContext(ctx);
+    var shallow = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 1,
+        .plaintext_modulus = 65537,
+    });
+    defer shallow.deinit();
+    try shallow.enablePke();
+    var shallow_kp = try shallow.keyGen();
+    defer shallow_kp.deinit();
+    var shallow_pk = shallow_kp.getPublicKey();
+    defer shallow_pk.deinit();
+    try std.testing.expectError(Error.InvalidParam, shallow_pk.checkContext(ctx));
+
+    try ctx.evalMultKeysGen(sk);
+    const blob = try ctx.serializeEvalMultKeys(.binary, allocator);
+    defer allocator.free(blob);
+    try ctx.clearEvalKeys(tag);
+
+    // Keys of one key pair must not be accepted for another
+    try std.testing.expectError(Error.InvalidParam, ctx.deserializeEvalMultKeysTagged(blob, .binary, other_tag, "session-a"));
+    try ctx.deserializeEvalMultKeysTagged(blob, .binary, tag, "session-a");
+    // Registered under the owner's name, not the key pair's tag
+    try ctx.clearEvalKeys(tag);
+
+    const values = [_]i64{ 3, 4 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+    var ct = try ctx.encrypt(pk, pt);
+    defer ct.deinit();
+    try ct.setKeyTag("session-a");
+
+    var product = try ctx.evalMult(ct, ct);
+    defer product.deinit();
+    try product.setKeyTag(tag);
+
+    var result = try ctx.decrypt(sk, product);
+    defer result.deinit();
+    var buffer: [16]i64 = undefined;
+    const decrypted = try result.getValues(&buffer);
+    try std.testing.expectEqual(@as(i64, 9), decrypted[0]);
+    try std.testing.expectEqual(@as(i64, 16), decrypted[1]);
+}
+
+test "BGV batch ciphertext deserialization" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    var blobs: [8][]u8 = undefined;
+    for (&blobs, 0..) |*blob, i| {
+        const values = [_]i64{@intCast(i)};
+        var pt = try ctx.makePackedPlaintext(&values);
+        defer pt.deinit();
+        var ct = try ctx.encrypt(pk, pt);
+        defer ct.deinit();
+        blob.* = try ct.serialize(.binary, allocator);
+    }
+    defer for (blobs) |blob| allocator.free(blob);
+
+    var cts: [8]Ciphertext = undefined;
+    try Ciphertext.deserializeBatch(ctx, &blobs, .binary, 0, &cts, allocator);
+    defer for (&cts) |*ct| ct.deinit();
+
+    for (cts, 0..) |ct, i| {
+        var pt = try ctx.decrypt(sk, ct);
+        defer pt.deinit();
+        var buffer: [16]i64 = undefined;
+        const decrypted = try pt.getValues(&buffer);
+        try std.testing.expectEqual(@as(i64, @intCast(i)), decrypted[0]);
+    }
+
+    // A single bad span fails the whole batch
+    var rejected: [8]Ciphertext = undefined;
+    try std.testing.expectError(Error.InvalidParam, Ciphertext.deserializeBatch(ctx, &blobs, .binary, 1, &rejected, allocator));
+    var truncated: [8][]const u8 = undefined;
+    for (&truncated, blobs) |*t, blob| t.* = blob;
+    truncated[3] = blobs[3][0 .. blobs[3].len / 2];
+    try std.testing.expectError(Error.SerializationError, Ciphertext.deserializeBatch(ctx, &truncated, .binary, null, &rejected, allocator));
+}
+
+test "BGV lazy ciphertexts" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    var blobs: [2][]u8 = undefined;
+    for (&blobs, 0..) |*blob, i| {
+        const values = [_]i64{ @intCast(i + 1), 10 };
+        var pt = try ctx.makePackedPlaintext(&values);
+        defer pt.deinit();
+        var ct = try ctx.encrypt(pk, pt);
+        defer ct.deinit();
+        blob.* = try ct.serialize(.binary, allocator);
+    }
+    defer for (blobs) |blob| allocator.free(blob);
+
+    var a = try Ciphertext.lazyFromSpan(ctx, blobs[0], .binary);
+    defer a.deinit();
+    var b = try Ciphertext.lazyFromSpan(ctx, blobs[1], .binary);
+    defer b.deinit();
+    try std.testing.expect(a.isLazy());
+    try std.testing.expect(!a.isMaterialized());
+
+    // Operations decode lazy operands transparently
+    var sum = try ctx.evalAdd(a, b);
+    defer sum.deinit();
+    try std.testing.expect(a.isMaterialized() and b.isMaterialized());
+    try std.testing.expect(!sum.isLazy());
+
+    var pt = try ctx.decrypt(sk, sum);
+    defer pt.deinit();
+    var buffer: [16]i64 = undefined;
+    const decrypted = try pt.getValues(&buffer);
+    try std.testing.expectEqual(@as(i64, 3), decrypted[0]);
+    try std.testing.expectEqual(@as(i64, 20), decrypted[1]);
+
+    // Dropped polynomials come back on the next read
+    try std.testing.expect(a.evict());
+    try std.testing.expect(!a.isMaterialized());
+    try std.testing.expectEqual(@as(u32, 0), a.getLevel());
+    try std.testing.expect(a.isMaterialized());
+
+    // With room for one ciphertext, using one evicts the other
+    setLazyBudget(blobs[0].len);
+    defer setLazyBudget(0);
+    try std.testing.expect(!b.isMaterialized());
+    _ = b.getLevel();
+    try std.testing.expect(b.isMaterialized());
+    try std.testing.expect(!a.isMaterialized());
+
+    // Modifying a lazy handle turns it into an ordinary one
+    try ctx.evalAddInplace(&b, sum);
+    try std.testing.expect(!b.isLazy());
+    try std.testing.expectEqual(@as(usize, 0), lazyResidentBytes());
+}
+
+test "BGV context snapshot" {
+    const allocator = std.testing.allocator;
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(dir);
+    const path = try std.fs.path.joinZ(allocator, &.{ dir, "context.snap" });
+    defer allocator.free(path);
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+    try ctx.saveSnapshot(path);
+
+    var restored = try CryptoContext.loadSnapshot(path);
+    defer restored.deinit();
+    try std.testing.expectEqual(ctx.getRingDim(), restored.getRingDim());
+    try std.testing.expectEqual(ctx.getPlaintextModulus(), restored.getPlaintextModulus());
+
+    // The restored context is fully usable
+    var kp = try restored.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    const values = [_]i64{ 1, 2, 3, 4 };
+    var pt = try restored.makePackedPlaintext(&values);
+    defer pt.deinit();
+    var ct = try restored.encrypt(pk, pt);
+    defer ct.deinit();
+    var decrypted = try restored.decrypt(sk, ct);
+    defer decrypted.deinit();
+    decrypted.setLength(values.len);
+    var buf: [4]i64 = undefined;
+    try std.testing.expectEqualSlices(i64, &values, try decrypted.getValues(&buf));
+
+    // A flipped payload byte fails the checksum
+    {
+        var file = try tmp.dir.openFile("context.snap", .{ .mode = .read_write });
+        defer file.close();
+        const end = try file.getEndPos();
+        var byte: [1]u8 = undefined;
+        _ = try file.pread(&byte, end - 1);
+        byte[0] ^= 0xff;
+        try file.pwriteAll(&byte, end - 1);
+    }
+    try std.testing.expectError(Error.SerializationError, CryptoContext.loadSnapshot(path));
+}
+
+test "BGV zero pool re-randomization" {
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    var pool = try ZeroPool.init(ctx, pk, 2);
+    defer pool.deinit();
+
+    const values = [_]i64{ 3, 5, 7 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+    var ct = try ctx.encrypt(pk, pt);
+    defer ct.deinit();
+
+    // A product, like the results jobs publish
+    var squared = try ctx.evalMult(ct, ct);
+    defer squared.deinit();
+    const before = try squared.serialize(.binary, std.testing.allocator);
+    defer std.testing.allocator.free(before);
+
+    try squared.rerandomize(pool);
+    try ct.rerandomize(pool);
+    const after = try squared.serialize(.binary, std.testing.allocator);
+    defer std.testing.allocator.free(after);
+    try std.testing.expect(!std.mem.eql(u8, before, after));
+
+    var buf: [3]i64 = undefined;
+    var decrypted = try ctx.decrypt(sk, squared);
+    defer decrypted.deinit();
+    decrypted.setLength(values.len);
+    try std.testing.expectEqualSlices(i64, &.{ 9, 25, 49 }, try decrypted.getValues(&buf));
+
+    var fresh = try ctx.decrypt(sk, ct);
+    defer fresh.deinit();
+    fresh.setLength(values.len);
+    try std.testing.expectEqualSlices(i64, &values, try fresh.getValues(&buf));
+
+    const stats = pool.stats();
+    try std.testing.expectEqual(@as(u64, 2), stats.served + stats.misses);
+
+    // Reserving only ever grows the pool
+    pool.reserve(8);
+    try std.testing.expectEqual(@as(usize, 8), pool.stats().capacity);
+    pool.reserve(4);
+    try std.testing.expectEqual(@as(usize, 8), pool.stats().capacity);
+
+    // Ciphertexts of another key pair are rejected
+    var other = try ctx.keyGen();
+    defer other.deinit();
+    var other_pk = other.getPublicKey();
+    defer other_pk.deinit();
+    var foreign = try ctx.encrypt(other_pk, pt);
+    defer foreign.deinit();
+    try std.testing.expectError(Error.InvalidParam, foreign.rerandomize(pool));
+}
+
+test "BGV zero pools share one byte budget" {
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    ZeroPool.setBudget(1);
+    defer ZeroPool.setBudget(0);
+
+    var a = try ZeroPool.init(ctx, pk, 8);
+    defer a.deinit();
+    var b = try ZeroPool.init(ctx, pk, 8);
+    defer b.deinit();
+
+    // The first encryption is made before its size is known; it alone
+    // exhausts the budget, so neither pool gets another
+    var waited: usize = 0;
+    while (ZeroPool.pooledBytes() == 0 and waited < 1000) : (waited += 1) std.Thread.sleep(10 * std.time.ns_per_ms);
+    std.Thread.sleep(200 * std.time.ns_per_ms);
+    try std.testing.expectEqual(@as(usize, 1), a.stats().available + b.stats().available);
+    try std.testing.expect(ZeroPool.pooledBytes() > 0);
+}
+
+test "BGV DNA Hamming scan" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    const pattern = "CGTA";
+    const rotations = try dnaHammingScanRotations(pattern.len, allocator);
+    defer allocator.free(rotations);
+    try ctx.evalRotateKeysGen(sk, rotations);
+
+    const sequences = [_][]const u8{ "ACGTACGTTTCGAA", "CGTNCCTAcgta" };
+    var seqs: [sequences.len]Ciphertext = undefined;
+    for (sequences, &seqs) |bases, *ct| {
+        var pt = try ctx.makeDnaPlaintext(bases);
+        defer pt.deinit();
+        ct.* = try ctx.encrypt(pk, pt);
+    }
+    defer for (&seqs) |*ct| ct.deinit();
+
+    var profiles: [sequences.len]Ciphertext = undefined;
+    try ctx.dnaHammingScan(&seqs, pattern, &profiles, allocator);
+    defer for (&profiles) |*ct| ct.deinit();
+
+    var buf: [64]i64 = undefined;
+    for (sequences, profiles) |bases, profile| {
+        var pt = try ctx.decrypt(sk, profile);
+        defer pt.deinit();
+        pt.setLength(4 * bases.len);
+        const slots = try pt.getValues(&buf);
+
+        for (0..bases.len) |j| {
+            // Positions past the end of the sequence never match
+            var expected: i64 = 0;
+            for (pattern, 0..) |base, k| {
+                const pos = j + k;
+                if (pos >= bases.len or std.ascii.toUpper(bases[pos]) != base) expected += 1;
+            }
+            try std.testing.expectEqual(expected, slots[4 * j]);
+        }
+    }
+
+    try std.testing.expectError(Error.InvalidParam, ctx.makeDnaPlaintext("ACGX"));
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaHammingScan(&seqs, "ACN", &profiles, allocator));
+}
+
+test "BGV DNA k-mer histogram" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    const k = 2;
+    const rotations = try ctx.dnaKmerRotations(k, allocator);
+    defer allocator.free(rotations);
+    try ctx.evalRotateKeysGen(sk, rotations);
+
+    // Chunks overlap by k - 1 bases, so every dinucleotide is counted once
+    const genome = "ACGTTGCAACGNGGTA";
+    const chunks = [_][]const u8{ genome[0..9], genome[8..] };
+    var seqs: [chunks.len]Ciphertext = undefined;
+    for (chunks, &seqs) |bases, *ct| {
+        var pt = try ctx.makeDnaPlaintext(bases);
+        defer pt.deinit();
+        ct.* = try ctx.encrypt(pk, pt);
+    }
+    defer for (&seqs) |*ct| ct.deinit();
+
+    const outputs = try ctx.dnaKmerHistogram(&seqs, k, allocator);
+    defer {
+        for (outputs) |*ct| ct.deinit();
+        allocator.free(outputs);
+    }
+    try std.testing.expectEqual(dnaKmerHistogramOutputs(k), outputs.len);
+
+    var expected = [_]i64{0} ** 16;
+    for (0..genome.len - 1) |i| {
+        const a = std.mem.indexOfScalar(u8, "ACGT", genome[i]) orelse continue;
+        const b = std.mem.indexOfScalar(u8, "ACGT", genome[i + 1]) orelse continue;
+        expected[4 * a + b] += 1;
+    }
+
+    const slots = try allocator.alloc(i64, ctx.getRingDim());
+    defer allocator.free(slots);
+    for (outputs, 0..) |ct, g| {
+        var pt = try ctx.decrypt(sk, ct);
+        defer pt.deinit();
+        pt.setLength(slots.len);
+        var counts: [4]i64 = undefined;
+        dnaKmerCounts(try pt.getValues(slots), &counts);
+        try std.testing.expectEqualSlices(i64, expected[4 * g ..][0..4], &counts);
+    }
+
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaKmerHistogram(&seqs, 4, allocator));
+}
+
+test "BGV DNA multi-pattern Hamming scan" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    // Five patterns of mixed length fill one profile and start a second
+    const patterns = [_][]const u8{ "ACG", "TTT", "GA", "CGTA", "A" };
+    const rotations = try ctx.dnaHammingMultiRotations(4, allocator);
+    defer allocator.free(rotations);
+    try ctx.evalRotateKeysGen(sk, rotations);
+
+    const bases = "ACGTTTGACGTAAN";
+    var pt = try ctx.makeDnaPlaintext(bases);
+    defer pt.deinit();
+    var seq = try ctx.encrypt(pk, pt);
+    defer seq.deinit();
+
+    const profiles = try ctx.dnaHammingScanMulti(&.{seq}, &patterns, allocator);
+    defer {
+        for (profiles) |*ct| ct.deinit();
+        allocator.free(profiles);
+    }
+    try std.testing.expectEqual(@as(usize, 2), profiles.len);
+
+    var buf: [64]i64 = undefined;
+    for (profiles, 0..) |profile, g| {
+        var decrypted = try ctx.decrypt(sk, profile);
+        defer decrypted.deinit();
+        decrypted.setLength(4 * bases.len);
+        const slots = try decrypted.getValues(&buf);
+
+        for (0..4) |lane| {
+            const p = 4 * g + lane;
+            for (0..bases.len) |j| {
+                var expected: i64 = 0;
+                if (p < patterns.len) {
+                    for (patterns[p], 0..) |base, k| {
+                        if (j + k >= bases.len or bases[j + k] != base) expected += 1;
+                    }
+                }
+                try std.testing.expectEqual(expected, slots[4 * j + lane]);
+            }
+        }
+    }
+}
+
+test "BGV equality test" {
+    // 65536 = 2^16: a pure squaring chain
+    const fermat = try isZeroCost(65537, 2);
+    try std.testing.expectEqual(@as(u32, 16), fermat.depth);
+    try std.testing.expectEqual(@as(u32, 16), fermat.key_switches);
+    // 7680 = 2^12 + 2^11 + 2^10 + 2^9: three more products, no more depth
+    const mixed = try isZeroCost(7681, 2);
+    try std.testing.expectEqual(@as(u32, 13), mixed.depth);
+    try std.testing.expectEqual(@as(u32, 15), mixed.key_switches);
+    try std.testing.expectError(Error.InvalidParam, isZeroCost(1, 2));
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = fermat.depth,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    const values1 = [_]i64{ 3, 0, 5, 7, -1, 0 };
+    const values2 = [_]i64{ 3, 1, 5, 2, -1, 0 };
+    var pt1 = try ctx.makePackedPlaintext(&values1);
+    defer pt1.deinit();
+    var pt2 = try ctx.makePackedPlaintext(&values2);
+    defer pt2.deinit();
+    var ct1 = try ctx.encrypt(pk, pt1);
+    defer ct1.deinit();
+    var ct2 = try ctx.encrypt(pk, pt2);
+    defer ct2.deinit();
+
+    var buf: [values1.len]i64 = undefined;
+
+    var equal = try ctx.evalEqual(ct1, ct2);
+    defer equal.deinit();
+    var decrypted = try ctx.decrypt(sk, equal);
+    defer decrypted.deinit();
+    decrypted.setLength(values1.len);
+    try std.testing.expectEqualSlices(i64, &.{ 1, 0, 1, 0, 1, 1 }, try decrypted.getValues(&buf));
+
+    var zero = try ctx.evalIsZero(ct1);
+    defer zero.deinit();
+    var decryptedZero = try ctx.decrypt(sk, zero);
+    defer decryptedZero.deinit();
+    decryptedZero.setLength(values1.len);
+    try std.testing.expectEqualSlices(i64, &.{ 0, 1, 0, 0, 0, 1 }, try decryptedZero.getValues(&buf));
+
+    // The result has no levels left for a second test
+    try std.testing.expectError(Error.InvalidParam, ctx.evalIsZero(zero));
+}
+
+test "BGV DNA slot layouts" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+    try ctx.evalRotateKeysGen(sk, &.{ 1, 2, 3, -1, -2, -3 });
+
+    // Search kernels need one-hot; a positional comparison packs four times
+    // denser in base-4 digits
+    const genome_len = 10 * ctx.getRingDim();
+    const search = try ctx.dnaLayoutPlan(.hamming, genome_len, 12);
+    try std.testing.expectEqual(@intFromEnum(DnaLayoutKind.one_hot), search.layout.kind);
+    try std.testing.expectEqual(@as(u32, 11), search.layout.overlap);
+    const compare = try ctx.dnaLayoutPlan(.compare, genome_len, 1);
+    try std.testing.expectEqual(@intFromEnum(DnaLayoutKind.base4), compare.layout.kind);
+    try std.testing.expect(compare.ciphertexts * 4 <= search.ciphertexts + 4);
+
+    const bases = "ACGTNNTGCA";
+    const digits = [_]i64{ 0, 1, 2, 3, -1, -1, 3, 2, 1, 0 };
+
+    // Base-4 survives serialization with its layout and splits into channels
+    var base4: [1]Ciphertext = undefined;
+    try ctx.dnaLayoutEncrypt(pk, compare.layout, bases, &base4);
+    defer base4[0].deinit();
+    const blob = try base4[0].serialize(.binary, allocator);
+    defer allocator.free(blob);
+    var restored = try Ciphertext.deserialize(ctx, blob, .binary);
+    defer restored.deinit();
+    const layout = restored.getDnaLayout() orelse return error.TestExpectedLayout;
+    try std.testing.expectEqual(@intFromEnum(DnaLayoutKind.base4), layout.kind);
+    try std.testing.expectEqual(@as(u32, 1), layout.stride);
+
+    var channels = try ctx.dnaLayoutSplit(restored);
+    defer for (&channels) |*ct| ct.deinit();
+    var buf: [bases.len]i64 = undefined;
+    for (channels, 0..) |channel, c_index| {
+        var pt = try ctx.decrypt(sk, channel);
+        defer pt.deinit();
+        pt.setLength(bases.len);
+        for (try pt.getValues(&buf), digits) |value, digit| {
+            try std.testing.expectEqual(@as(i64, @intFromBool(digit == @as(i64, @intCast(c_index)))), value);
+        }
+    }
+    // Dense channels have no room for the one-hot stride
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaLayoutMerge(channels, .one_hot));
+
+    // One-hot round trip through channels, and into base-4
+    var one_hot: [1]Ciphertext = undefined;
+    try ctx.dnaLayoutEncrypt(pk, search.layout, bases, &one_hot);
+    defer one_hot[0].deinit();
+    var split = try ctx.dnaLayoutSplit(one_hot[0]);
+    defer for (&split) |*ct| ct.deinit();
+
+    var digits_ct = try ctx.dnaLayoutMerge(split, .base4);
+    defer digits_ct.deinit();
+    var decoded = try ctx.decrypt(sk, digits_ct);
+    defer decoded.deinit();
+    var strided: [4 * bases.len]i64 = undefined;
+    decoded.setLength(strided.len);
+    const slots = try decoded.getValues(&strided);
+    for (digits, 0..) |digit, i| try std.testing.expectEqual(digit, slots[4 * i]);
+
+    var merged = try ctx.dnaLayoutMerge(split, .one_hot);
+    defer merged.deinit();
+    var expected = try ctx.makeDnaPlaintext(bases);
+    defer expected.deinit();
+    var round_trip = try ctx.decrypt(sk, merged);
+    defer round_trip.deinit();
+    var want: [4 * bases.len]i64 = undefined;
+    var got: [4 * bases.len]i64 = undefined;
+    expected.setLength(want.len);
+    round_trip.setLength(got.len);
+    try std.testing.expectEqualSlices(i64, try expected.getValues(&want), try round_trip.getValues(&got));
+
+    // Kernels refuse layouts they do not understand
+    var profile: [1]Ciphertext = undefined;
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaHammingScan(&.{base4[0]}, "ACG", &profile, allocator));
+}
+
+test "BGV cost model" {
+    var ctx = try CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    const model = try ctx.calibrateCostModel(2);
+    try std.testing.expectEqual(ctx.getRingDim(), model.raw.ring_dim);
+    for (std.enums.values(FheOp)) |op| try std.testing.expect(model.freshOpNs(op) > 0);
+    try std.testing.expect(model.freshOpNs(.mult) > model.freshOpNs(.add));
+    try std.testing.expect(model.freshOpNs(.rotate) > model.freshOpNs(.fast_rotate));
+    // Key switching grows with the square of the towers, the rest linearly
+    const towers = model.raw.towers;
+    try std.testing.expectApproxEqRel(2 * model.opNs(.add, 2 * ctx.getRingDim(), towers), 4 * model.freshOpNs(.add), 1e-9);
+    try std.testing.expectApproxEqRel(model.opNs(.rotate, ctx.getRingDim(), 2 * towers), 4 * model.freshOpNs(.rotate), 1e-9);
+
+    // Costs grow with the work
+    const one = try ctx.dnaKernelCost(model, .hamming, 1, 12, 0);
+    const many = try ctx.dnaKernelCost(model, .hamming, 64, 12, 0);
+    try std.testing.expect(one.cpu_ns > 0 and one.peak_bytes >= 2 * model.ciphertextBytes());
+    try std.testing.expect(many.cpu_ns >= 60 * one.cpu_ns);
+    try std.testing.expect(many.peak_bytes > one.peak_bytes);
+
+    const k2 = try ctx.dnaKernelCost(model, .kmer, 4, 2, 0);
+    const k3 = try ctx.dnaKernelCost(model, .kmer, 4, 3, 0);
+    try std.testing.expect(k3.cpu_ns > k2.cpu_ns and k3.peak_bytes > k2.peak_bytes);
+    const panel = try ctx.dnaKernelCost(model, .hamming_multi, 1, 12, 16);
+    try std.testing.expect(panel.cpu_ns < 16 * one.cpu_ns);
+
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaKernelCost(model, .hamming, 1, 0, 0));
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaKernelCost(model, .kmer, 1, 99, 0));
+}
+
+test "BGV copy-on-write clones" {
+    var ctx = try CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalRotateKeysGen(sk, &.{1});
+
+    const values = [_]i64{ 1, 2, 3 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+    var a = try ctx.encrypt(pk, pt);
+    defer a.deinit();
+    try std.testing.expect(!a.isShared());
+
+    const before = cowStats();
+    var b = a.clone();
+    defer b.deinit();
+    var d = a.clone();
+    defer d.deinit();
+    try std.testing.expect(a.isShared() and b.isShared());
+    try std.testing.expectEqual(before.shared_clones + 2, cowStats().shared_clones);
+    try std.testing.expectEqual(before.copies, cowStats().copies);
+
+    // Writing to one clone copies it and leaves the others alone
+    try ctx.evalAddInplace(&b, a);
+    try std.testing.expect(!b.isShared());
+    try std.testing.expect(a.isShared() and d.isShared());
+    const after = cowStats();
+    try std.testing.expectEqual(before.copies + 1, after.copies);
+    try std.testing.expect(after.copied_bytes > before.copied_bytes);
+
+    var buffer: [16]i64 = undefined;
+    var doubled = try ctx.decrypt(sk, b);
+    defer doubled.deinit();
+    try std.testing.expectEqualSlices(i64, &.{ 2, 4, 6 }, (try doubled.getValues(&buffer))[0..3]);
+    var original = try ctx.decrypt(sk, a);
+    defer original.deinit();
+    try std.testing.expectEqualSlices(i64, &values, (try original.getValues(&buffer))[0..3]);
+
+    // Out-of-place results replace the polynomials without a copy
+    try ctx.evalRotateInplace(&d, 1);
+    try std.testing.expect(!d.isShared() and !a.isShared());
+    try std.testing.expectEqual(after.copies, cowStats().copies);
+}
+
+test "BGV DNA batch encryption" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+
+    const plan = try ctx.dnaLayoutPlan(.compare, 5 * ctx.getRingDim() / 2, 1);
+    try std.testing.expectEqual(@as(usize, 3), plan.chunks);
+    const genome = try allocator.alloc(u8, 5 * ctx.getRingDim() / 2);
+    defer allocator.free(genome);
+    for (genome, 0..) |*base, i| base.* = "ACGT"[(i * 7 + i / 5) % 4];
+
+    var cts: [3]Ciphertext = undefined;
+    try ctx.dnaLayoutEncryptBatch(pk, plan.layout, genome, plan.chunks, &cts, allocator);
+    defer for (&cts) |*ct| ct.deinit();
+
+    // Each chunk matches encrypting it alone
+    for (cts, 0..) |ct, i| {
+        const start = i * plan.bases_per_chunk;
+        var single: [1]Ciphertext = undefined;
+        try ctx.dnaLayoutEncrypt(pk, plan.layout, genome[start..@min(genome.len, start + plan.bases_per_chunk)], &single);
+        defer single[0].deinit();
+
+        var batch_pt = try ctx.decrypt(sk, ct);
+        defer batch_pt.deinit();
+        var single_pt = try ctx.decrypt(sk, single[0]);
+        defer single_pt.deinit();
+        var want: [64]i64 = undefined;
+        var got: [64]i64 = undefined;
+        batch_pt.setLength(want.len);
+        single_pt.setLength(got.len);
+        try std.testing.expectEqualSlices(i64, try single_pt.getValues(&want), try batch_pt.getValues(&got));
+        try std.testing.expectEqual(@intFromEnum(DnaLayoutKind.base4), (ct.getDnaLayout() orelse return error.TestExpectedLayout).kind);
+    }
+
+    // More chunks than the genome covers, and bad bases, fail as a whole
+    var extra: [4]Ciphertext = undefined;
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaLayoutEncryptBatch(pk, plan.layout, genome, 4, &extra, allocator));
+    genome[genome.len - 1] = 'X';
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaLayoutEncryptBatch(pk, plan.layout, genome, plan.chunks, &cts, allocator));
+}
+
+test "BGV noise estimates" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+    try ctx.evalRotateKeysGen(sk, &.{1});
+
+    const values = [_]i64{ 1, 2, 3 };
+    var pt = try ctx.makePackedPlaintext(&values);
+    defer pt.deinit();
+    var a = try ctx.encrypt(pk, pt);
+    defer a.deinit();
+
+    const fresh = try ctx.noiseEstimate(a);
+    try std.testing.expectEqual(@as(i32, 1), fresh.tracked);
+    try std.testing.expect(fresh.budget_bits > 0);
+    try std.testing.expect(try ctx.droppableTowers(a, 0) < fresh.towers);
+
+    // Products and rotations only add noise
+    var squared = try ctx.evalMult(a, a);
+    defer squared.deinit();
+    var rotated = try ctx.evalRotate(a, 1);
+    defer rotated.deinit();
+    const product = try ctx.noiseEstimate(squared);
+    try std.testing.expect(product.noise_bits > fresh.noise_bits);
+    try std.testing.expect(product.budget_bits > 0);
+    try std.testing.expect((try ctx.noiseEstimate(rotated)).noise_bits > fresh.noise_bits);
+
+    // The estimate is not serialized
+    const bytes = try a.serialize(.binary, allocator);
+    defer allocator.free(bytes);
+    var loaded = try Ciphertext.deserialize(ctx, bytes, .binary);
+    defer loaded.deinit();
+    try std.testing.expectEqual(@as(i32, 0), (try ctx.noiseEstimate(loaded)).tracked);
+    // Nothing is dropped from a ciphertext of unknown history
+    try std.testing.expectEqual(@as(u32, 0), try ctx.droppableTowers(loaded, 0));
+
+    if (!exactNoiseAvailable()) {
+        try std.testing.expectError(Error.InvalidParam, ctx.measureNoise(sk, a));
+        return;
+    }
+    // The analytic bound holds for the real noise
+    try std.testing.expect((try ctx.measureNoise(sk, a)).noise_bits <= fresh.noise_bits);
+    try std.testing.expect((try ctx.measureNoise(sk, squared)).noise_bits <= product.noise_bits);
+}
+
+test "BGV DNA incremental k-mer counts" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    const k = 2;
+    const rotations = try ctx.dnaKmerRotations(k, allocator);
+    defer allocator.free(rotations);
+    try ctx.evalRotateKeysGen(sk, rotations);
+
+    // The genome arrives in two uploads; the second is encrypted from the
+    // append offset so the dinucleotide across the old end is counted once
+    const genome = "ACGTTGCAACGNGGTA";
+    const uploaded = 9;
+    const offset = dnaLayoutAppendOffset(uploaded, k);
+    try std.testing.expectEqual(@as(usize, uploaded - (k - 1)), offset);
+    try std.testing.expectEqual(@as(usize, 0), dnaLayoutAppendOffset(k - 1, k));
+
+    var partials: []Ciphertext = &.{};
+    defer {
+        for (partials) |*ct| ct.deinit();
+        allocator.free(partials);
+    }
+    for ([_][]const u8{ genome[0..uploaded], genome[offset..] }, [_]usize{ uploaded, genome.len }) |bases, seen| {
+        var pt = try ctx.makeDnaPlaintext(bases);
+        defer pt.deinit();
+        var seq = try ctx.encrypt(pk, pt);
+        defer seq.deinit();
+
+        if (partials.len == 0) {
+            partials = try ctx.dnaKmerPartials(&.{seq}, k, allocator);
+            try std.testing.expectEqual(dnaKmerPartialSums(k), partials.len);
+        } else {
+            try ctx.dnaKmerAccumulate(&.{seq}, k, partials, allocator);
+        }
+
+        try expectDinucleotideCounts(ctx, sk, partials, genome[0..seen], allocator);
+    }
+
+    try std.testing.expectError(Error.InvalidParam, ctx.dnaKmerAccumulate(&.{}, k, partials[1..], allocator));
+}
+
+test "BGV DNA k-mer counts append past a wider layout overlap" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    const k = 2;
+    const rotations = try ctx.dnaKmerRotations(k, allocator);
+    defer allocator.free(rotations);
+    try ctx.evalRotateKeysGen(sk, rotations);
+
+    // Chunks laid out for 8-base searches overlap by 7 bases; repeating all
+    // of them would count the dinucleotides among them twice
+    const genome = "GATTACACGTAGCTTAGGCANTCA";
+    const uploaded = 14;
+    const plan = try ctx.dnaLayoutPlan(.kmer, genome.len, 8);
+    try std.testing.expect(plan.layout.overlap > k - 1);
+    const offset = dnaLayoutAppendOffset(uploaded, k);
+    try std.testing.expect(offset > uploaded - plan.layout.overlap);
+
+    var partials: []Ciphertext = &.{};
+    defer {
+        for (partials) |*ct| ct.deinit();
+        allocator.free(partials);
+    }
+    for ([_][]const u8{ genome[0..uploaded], genome[offset..] }) |bases| {
+        var seq: [1]Ciphertext = undefined;
+        try ctx.dnaLayoutEncrypt(pk, plan.layout, bases, &seq);
+        defer seq[0].deinit();
+
+        if (partials.len == 0) {
+            partials = try ctx.dnaKmerPartials(&seq, k, allocator);
+        } else {
+            try ctx.dnaKmerAccumulate(&seq, k, partials, allocator);
+        }
+    }
+    try expectDinucleotideCounts(ctx, sk, partials, genome, allocator);
+}
+
+test "BGV DNA k-mer counts skip the bases a wider layout overlap repeats" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try CryptoContext.createBgv(.{
+        .multiplicative_depth = 2,
+        .plaintext_modulus = 65537,
+    });
+    defer ctx.deinit();
+
+    try ctx.enablePke();
+    try ctx.enableKeyswitch();
+    try ctx.enableLeveledShe();
+
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+    var sk = kp.getPrivateKey();
+    defer sk.deinit();
+    try ctx.evalMultKeysGen(sk);
+
+    const k = 2;
+    const rotations = try ctx.dnaKmerRotations(k, allocator);
+    defer allocator.free(rotations);
+    try ctx.evalRotateKeysGen(sk, rotations);
+
+    // Long enough to fill the second row of every chunk and to need several
+    // chunks, each repeating 7 bases of the one before
+    const row_bases = ctx.getRingDim() / 2 / 4;
+    const genome = try allocator.alloc(u8, 5 * row_bases);
+    defer allocator.free(genome);
+    var prng = std.Random.DefaultPrng.init(50);
+    for (genome) |*base| base.* = "ACGT"[prng.random().uintLessThan(usize, 4)];
+
+    const plan = try ctx.dnaLayoutPlan(.kmer, genome.len, 8);
+    try std.testing.expect(plan.layout.overlap > k - 1);
+    try std.testing.expect(plan.chunks > 2);
+
+    const seqs = try allocator.alloc(Ciphertext, plan.ciphertexts);
+    defer allocator.free(seqs);
+    try ctx.dnaLayoutEncryptBatch(pk, plan.layout, genome, plan.chunks, seqs, allocator);
+    defer for (seqs) |*ct| ct.deinit();
+
+    const partials = try ctx.dnaKmerPartials(seqs, k, allocator);
+    defer {
+        for (partials) |*ct| ct.deinit();
+        allocator.free(partials);
+    }
+    try expectDinucleotideCounts(ctx, sk, partials, genome, allocator);
+}
+
+/// Finalizes `k = 2` partial sums and checks them against the plaintext
+/// counts of `genome`
+fn expectDinucleotideCounts(ctx: CryptoContext, sk: PrivateKey, partials: []const Ciphertext, genome: []const u8, allocator: std.mem.Allocator) !void {
+    var expected = [_]i64{0} ** 16;
+    for (0..genome.len -| 1) |i| {
+        const a = std.mem.indexOfScalar(u8, "ACGT", genome[i]) orelse continue;
+        const b = std.mem.indexOfScalar(u8, "ACGT", genome[i + 1]) orelse continue;
+        expected[4 * a + b] += 1;
+    }
+
+    const slots = try allocator.alloc(i64, ctx.getRingDim());
+    defer allocator.free(slots);
+    const outputs = try ctx.dnaKmerFinalize(partials, 2, allocator);
+    defer {
+        for (outputs) |*ct| ct.deinit();
+        allocator.free(outputs);
+    }
+    for (outputs, 0..) |ct, g| {
+        var counts_pt = try ctx.decrypt(sk, ct);
+        defer counts_pt.deinit();
+        counts_pt.setLength(slots.len);
+        var counts: [4]i64 = undefined;
+        dnaKmerCounts(try counts_pt.getValues(slots), &counts);
+        try std.testing.expectEqualSlices(i64, expected[4 * g ..][0..4], &counts);
+    }
+}
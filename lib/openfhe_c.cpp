@@ -9,7 +9,37 @@
 #include <string>
 #include <sstream>
 #include <cstring>
+#include <cstdio>
+#include <cerrno>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <istream>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace lbcrypto;
 
@@ -20,10 +50,75 @@ static thread_local std::string g_last_error;
 // Internal Wrapper Structures
 // ============================================================================
 
+struct OpenfheCiphertext;
+
+// Noise of a BGV ciphertext: a bound, in bits, on the canonical norm of
+// m + t*e, the value decryption recovers modulo the ciphertext modulus.
+struct Noise {
+    double bits;
+    uint32_t towers;
+    // Noise scale degree: 2 for a product that is not rescaled yet
+    uint32_t degree;
+};
+
+// Analytic noise bounds for BGV-RNS with hybrid key switching. They follow
+// the usual canonical-embedding heuristics: a polynomial whose coefficients
+// have variance V has canonical norm at most 6 sqrt(N V), and norms multiply
+// under products. The canonical norm bounds the coefficients, so a positive
+// budget guarantees correct decryption with overwhelming probability.
+//
+// Operations take and return bounds the way OpenFHE's automatic rescaling
+// applies them: a pending product is rescaled before it is multiplied again.
+// `settle` then aligns a prediction with the towers of the actual result.
+class NoiseModel {
+public:
+    explicit NoiseModel(const CryptoContext<DCRTPoly>& cc);
+
+    Noise fresh(uint32_t towers) const { return {fresh_bits_, towers, 1}; }
+    Noise fresh_private(uint32_t towers) const { return {fresh_private_bits_, towers, 1}; }
+
+    Noise add(Noise a, Noise b) const;
+    // Sum of `count` values bounded by `a`
+    Noise sum(Noise a, double count) const;
+    Noise add_plaintext(Noise a) const;
+    // Tensor product, not relinearized
+    Noise mult(Noise a, Noise b) const;
+    Noise mult_plaintext(Noise a) const;
+    Noise mult_scalar(Noise a, int64_t scalar) const;
+    // Relinearization or rotation
+    Noise key_switch(Noise a) const;
+
+    // Drops `n` to `towers`: a pending product is rescaled, dividing its
+    // noise by the dropped modulus; otherwise the noise is kept as it is
+    Noise settle(Noise n, uint32_t towers) const;
+    double modulus_bits(uint32_t towers) const;
+    double budget_bits(Noise n) const { return modulus_bits(n.towers) - 1 - n.bits; }
+
+    // Bound of a handle's ciphertext, fresh if its history is unknown
+    Noise of(const OpenfheCiphertext& handle) const;
+    // Records the bound predicted for the handle's ciphertext
+    void track(OpenfheCiphertext& handle, Noise predicted) const;
+
+private:
+    static double add_bits(double a, double b) {
+        const double hi = std::max(a, b);
+        return hi + std::log2(1 + std::exp2(std::min(a, b) - hi));
+    }
+    Noise rescaled(Noise n) const;
+
+    std::vector<double> tower_bits_;
+    double fresh_bits_;
+    double fresh_private_bits_;
+    double rescale_bits_;
+    double key_switch_bits_;
+    double plaintext_bits_;
+};
+
 struct OpenfheCryptoContext {
     CryptoContext<DCRTPoly> ctx;
+    NoiseModel noise;
 
-    explicit OpenfheCryptoContext(CryptoContext<DCRTPoly> c) : ctx(std::move(c)) {}
+    explicit OpenfheCryptoContext(CryptoContext<DCRTPoly> c) : ctx(std::move(c)), noise(ctx) {}
 };
 
 struct OpenfheKeyPair {
@@ -48,10 +143,47 @@ struct OpenfhePrivateKey {
         : key(std::move(k)), owned(o) {}
 };
 
+struct OpenfheSegmentStore;
+
 struct OpenfheCiphertext {
-    Ciphertext<DCRTPoly> ct;
+    // Where a lazy handle decodes its polynomials from. Kept until the handle
+    // is modified, so unmodified handles can drop and re-decode them.
+    struct LazySource {
+        CryptoContext<DCRTPoly> ctx;
+        SerialFormat format;
+        // Either borrowed bytes...
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        // ...or an object in a segment store
+        OpenfheSegmentStore* store = nullptr;
+        std::array<uint8_t, 16> session{};
+        uint64_t object_id = 0;
+
+        // Residency bookkeeping, guarded by the lazy cache mutex
+        bool cached = false;
+        size_t resident_bytes = 0;
+        std::list<OpenfheCiphertext*>::iterator lru;
+    };
+
+    // Null for ordinary handles and while a lazy handle is not materialized
+    mutable Ciphertext<DCRTPoly> ct;
+    std::unique_ptr<LazySource> lazy;
+    mutable std::mutex mutex;
+    // NoiseModel bound of `ct`; NaN while its history is unknown
+    double noise_bits = std::numeric_limits<double>::quiet_NaN();
 
     explicit OpenfheCiphertext(Ciphertext<DCRTPoly> c) : ct(std::move(c)) {}
+    explicit OpenfheCiphertext(std::unique_ptr<LazySource> source) : lazy(std::move(source)) {}
+    ~OpenfheCiphertext();
+
+    // Ciphertext for reading; decodes a lazy handle on first use
+    Ciphertext<DCRTPoly> get() const;
+    // Ciphertext for in-place modification; a lazy handle becomes an ordinary
+    // one, and polynomials shared with a clone are copied first
+    Ciphertext<DCRTPoly>& mut();
+    // Replaces the ciphertext with the result of an out-of-place operation,
+    // which needs no copy
+    void set(Ciphertext<DCRTPoly> c);
 };
 
 struct OpenfhePlaintext {
@@ -60,6 +192,88 @@ struct OpenfhePlaintext {
     explicit OpenfhePlaintext(Plaintext p) : pt(std::move(p)) {}
 };
 
+// Read-only streambuf over caller-owned memory. Deserializers read request
+// bodies and stored blobs in place through it instead of copying them into a
+// std::string first.
+class SpanStreamBuf : public std::streambuf {
+public:
+    SpanStreamBuf(const uint8_t* data, size_t size) {
+        char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+        char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+        char* target = base + off;
+        if (target < eback() || target > egptr()) return pos_type(off_type(-1));
+        setg(eback(), target, egptr());
+        return pos_type(target - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+// Write-only streambuf that hands serialized bytes to a caller callback in
+// bounded blocks, so large objects never exist in one contiguous buffer.
+class WriterStreamBuf : public std::streambuf {
+public:
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    WriterStreamBuf(OpenfheWriteFn write_fn, void* user_ctx)
+        : write_fn_(write_fn), user_ctx_(user_ctx), block_(kBlockSize) {
+        setp(block_.data(), block_.data() + block_.size());
+    }
+
+    bool failed() const { return failed_; }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!flush_block()) return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        std::streamsize written = 0;
+        while (written < n) {
+            if (pptr() == epptr() && !flush_block()) break;
+            std::streamsize take = std::min<std::streamsize>(n - written, epptr() - pptr());
+            std::memcpy(pptr(), s + written, static_cast<size_t>(take));
+            pbump(static_cast<int>(take));
+            written += take;
+        }
+        return written;
+    }
+
+    int sync() override {
+        return flush_block() ? 0 : -1;
+    }
+
+private:
+    bool flush_block() {
+        if (failed_) return false;
+        size_t size = static_cast<size_t>(pptr() - pbase());
+        if (size > 0 && write_fn_(user_ctx_, reinterpret_cast<const uint8_t*>(pbase()), size) != 0) {
+            failed_ = true;
+            return false;
+        }
+        setp(block_.data(), block_.data() + block_.size());
+        return true;
+    }
+
+    OpenfheWriteFn write_fn_;
+    void* user_ctx_;
+    std::vector<char> block_;
+    bool failed_ = false;
+};
+
 // ============================================================================
 // Error Handling Implementation
 // ============================================================================
@@ -72,6 +286,14 @@ extern "C" const char* openfhe_get_last_error(void) {
     return g_last_error.c_str();
 }
 
+#ifndef OPENFHE_C_VARIANT
+#define OPENFHE_C_VARIANT "default"
+#endif
+
+extern "C" const char* openfhe_c_build_variant(void) {
+    return OPENFHE_C_VARIANT;
+}
+
 // Macro for exception handling
 #define TRY_CATCH_BEGIN try {
 #define TRY_CATCH_END \
@@ -84,6 +306,37 @@ extern "C" const char* openfhe_get_last_error(void) {
         return OPENFHE_ERROR_INTERNAL; \
     }
 
+// Runs `fn(i, error)` for every i < count on the OpenMP thread pool; `fn`
+// returns OPENFHE_OK, or an error code with a message in `error`. Exceptions
+// must not leave the parallel region, so each item records its own outcome,
+// a caught exception counting as `exception_code`, and the first failure in
+// item order is reported afterwards as "<item> <i>: <error>". Batches are
+// all or nothing: callers publish results only if this returns OPENFHE_OK.
+template <typename Fn>
+static OpenfheError parallel_all_or_nothing(size_t count, const char* item, OpenfheError exception_code, Fn&& fn) {
+    std::vector<OpenfheError> codes(count, OPENFHE_OK);
+    std::vector<std::string> errors(count);
+
+    const int64_t n = static_cast<int64_t>(count);
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t i = 0; i < n; ++i) {
+        try {
+            codes[i] = fn(static_cast<size_t>(i), errors[i]);
+        } catch (const std::exception& e) {
+            codes[i] = exception_code;
+            errors[i] = e.what();
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (codes[i] != OPENFHE_OK) {
+            set_error(std::string(item) + " " + std::to_string(i) + ": " + errors[i]);
+            return codes[i];
+        }
+    }
+    return OPENFHE_OK;
+}
+
 // ============================================================================
 // Context Operations Implementation
 // ============================================================================
@@ -339,6 +592,7 @@ extern "C" OpenfheError encrypt(
     TRY_CATCH_BEGIN
         auto ct = ctx->ctx->Encrypt(pk->key, pt->pt);
         *out_ct = new OpenfheCiphertext(ct);
+        (*out_ct)->noise_bits = ctx->noise.fresh(0).bits;
     TRY_CATCH_END
 }
 
@@ -353,6 +607,7 @@ extern "C" OpenfheError encrypt_private(
     TRY_CATCH_BEGIN
         auto ct = ctx->ctx->Encrypt(sk->key, pt->pt);
         *out_ct = new OpenfheCiphertext(ct);
+        (*out_ct)->noise_bits = ctx->noise.fresh_private(0).bits;
     TRY_CATCH_END
 }
 
@@ -366,7 +621,7 @@ extern "C" OpenfheError decrypt(
 
     TRY_CATCH_BEGIN
         Plaintext pt;
-        ctx->ctx->Decrypt(sk->key, ct->ct, &pt);
+        ctx->ctx->Decrypt(sk->key, ct->get(), &pt);
         *out_pt = new OpenfhePlaintext(pt);
     TRY_CATCH_END
 }
@@ -384,8 +639,10 @@ extern "C" OpenfheError eval_add(
     if (!ctx || !ct1 || !ct2 || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalAdd(ct1->ct, ct2->ct);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalAdd(ct1->get(), ct2->get());
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.add(noise.of(*ct1), noise.of(*ct2)));
     TRY_CATCH_END
 }
 
@@ -397,7 +654,9 @@ extern "C" OpenfheError eval_add_inplace(
     if (!ctx || !ct1 || !ct2) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        ctx->ctx->EvalAddInPlace(ct1->ct, ct2->ct);
+        const Noise predicted = ctx->noise.add(ctx->noise.of(*ct1), ctx->noise.of(*ct2));
+        ctx->ctx->EvalAddInPlace(ct1->mut(), ct2->get());
+        ctx->noise.track(*ct1, predicted);
     TRY_CATCH_END
 }
 
@@ -410,8 +669,10 @@ extern "C" OpenfheError eval_add_plaintext(
     if (!ctx || !ct || !pt || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalAdd(ct->ct, pt->pt);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalAdd(ct->get(), pt->pt);
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.add_plaintext(noise.of(*ct)));
     TRY_CATCH_END
 }
 
@@ -424,8 +685,10 @@ extern "C" OpenfheError eval_sub(
     if (!ctx || !ct1 || !ct2 || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalSub(ct1->ct, ct2->ct);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalSub(ct1->get(), ct2->get());
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.add(noise.of(*ct1), noise.of(*ct2)));
     TRY_CATCH_END
 }
 
@@ -437,7 +700,9 @@ extern "C" OpenfheError eval_sub_inplace(
     if (!ctx || !ct1 || !ct2) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        ctx->ctx->EvalSubInPlace(ct1->ct, ct2->ct);
+        const Noise predicted = ctx->noise.add(ctx->noise.of(*ct1), ctx->noise.of(*ct2));
+        ctx->ctx->EvalSubInPlace(ct1->mut(), ct2->get());
+        ctx->noise.track(*ct1, predicted);
     TRY_CATCH_END
 }
 
@@ -450,8 +715,10 @@ extern "C" OpenfheError eval_mult(
     if (!ctx || !ct1 || !ct2 || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalMult(ct1->ct, ct2->ct);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalMult(ct1->get(), ct2->get());
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.key_switch(noise.mult(noise.of(*ct1), noise.of(*ct2))));
     TRY_CATCH_END
 }
 
@@ -464,7 +731,9 @@ extern "C" OpenfheError eval_mult_inplace(
 
     TRY_CATCH_BEGIN
         // OpenFHE doesn't have in-place mult for two ciphertexts, so we do it manually
-        ct1->ct = ctx->ctx->EvalMult(ct1->ct, ct2->ct);
+        const Noise predicted = ctx->noise.key_switch(ctx->noise.mult(ctx->noise.of(*ct1), ctx->noise.of(*ct2)));
+        ct1->set(ctx->ctx->EvalMult(ct1->get(), ct2->get()));
+        ctx->noise.track(*ct1, predicted);
     TRY_CATCH_END
 }
 
@@ -477,8 +746,10 @@ extern "C" OpenfheError eval_mult_no_relin(
     if (!ctx || !ct1 || !ct2 || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalMultNoRelin(ct1->ct, ct2->ct);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalMultNoRelin(ct1->get(), ct2->get());
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.mult(noise.of(*ct1), noise.of(*ct2)));
     TRY_CATCH_END
 }
 
@@ -491,8 +762,10 @@ extern "C" OpenfheError eval_mult_plaintext(
     if (!ctx || !ct || !pt || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalMult(ct->ct, pt->pt);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalMult(ct->get(), pt->pt);
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.mult_plaintext(noise.of(*ct)));
     TRY_CATCH_END
 }
 
@@ -505,14 +778,28 @@ extern "C" OpenfheError eval_mult_many(
     if (!ctx || !cts || !out_ct || num_cts == 0) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
+        const NoiseModel& noise = ctx->noise;
         std::vector<Ciphertext<DCRTPoly>> ct_vec;
+        std::vector<Noise> factors;
         ct_vec.reserve(num_cts);
         for (size_t i = 0; i < num_cts; ++i) {
             if (!cts[i]) return OPENFHE_ERROR_NULL_POINTER;
-            ct_vec.push_back(cts[i]->ct);
+            ct_vec.push_back(cts[i]->get());
+            factors.push_back(noise.of(*cts[i]));
         }
         auto result = ctx->ctx->EvalMultMany(ct_vec);
         *out_ct = new OpenfheCiphertext(result);
+
+        // EvalMultMany multiplies pairwise, level by level
+        while (factors.size() > 1) {
+            std::vector<Noise> products;
+            for (size_t i = 0; i + 1 < factors.size(); i += 2) {
+                products.push_back(noise.key_switch(noise.mult(factors[i], factors[i + 1])));
+            }
+            if (factors.size() % 2 == 1) products.push_back(factors.back());
+            factors = std::move(products);
+        }
+        noise.track(**out_ct, factors[0]);
     TRY_CATCH_END
 }
 
@@ -524,8 +811,10 @@ extern "C" OpenfheError eval_relinearize(
     if (!ctx || !ct || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->Relinearize(ct->ct);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->Relinearize(ct->get());
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.key_switch(noise.of(*ct)));
     TRY_CATCH_END
 }
 
@@ -537,8 +826,10 @@ extern "C" OpenfheError eval_negate(
     if (!ctx || !ct || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalNegate(ct->ct);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalNegate(ct->get());
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.of(*ct));
     TRY_CATCH_END
 }
 
@@ -549,7 +840,9 @@ extern "C" OpenfheError eval_negate_inplace(
     if (!ctx || !ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        ctx->ctx->EvalNegateInPlace(ct->ct);
+        const Noise predicted = ctx->noise.of(*ct);
+        ctx->ctx->EvalNegateInPlace(ct->mut());
+        ctx->noise.track(*ct, predicted);
     TRY_CATCH_END
 }
 
@@ -557,6 +850,17 @@ extern "C" OpenfheError eval_negate_inplace(
 // Rotation Operations Implementation
 // ============================================================================
 
+namespace {
+
+// EvalSum and EvalInnerProduct fold `batch_size` slots with log2 of it
+// rotate-and-add steps
+Noise rotate_and_sum_noise(const NoiseModel& noise, Noise n, uint32_t batch_size) {
+    for (uint32_t width = 1; width < batch_size; width <<= 1) n = noise.add(n, noise.key_switch(n));
+    return n;
+}
+
+}  // namespace
+
 extern "C" OpenfheError eval_rotate(
     CryptoContextHandle ctx,
     CiphertextHandle ct,
@@ -566,8 +870,10 @@ extern "C" OpenfheError eval_rotate(
     if (!ctx || !ct || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalRotate(ct->ct, index);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalRotate(ct->get(), index);
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.key_switch(noise.of(*ct)));
     TRY_CATCH_END
 }
 
@@ -580,7 +886,9 @@ extern "C" OpenfheError eval_rotate_inplace(
 
     TRY_CATCH_BEGIN
         // OpenFHE doesn't have in-place rotate, so we do it manually
-        ct->ct = ctx->ctx->EvalRotate(ct->ct, index);
+        const Noise predicted = ctx->noise.key_switch(ctx->noise.of(*ct));
+        ct->set(ctx->ctx->EvalRotate(ct->get(), index));
+        ctx->noise.track(*ct, predicted);
     TRY_CATCH_END
 }
 
@@ -593,8 +901,10 @@ extern "C" OpenfheError eval_sum(
     if (!ctx || !ct || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalSum(ct->ct, batch_size);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalSum(ct->get(), batch_size);
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, rotate_and_sum_noise(noise, noise.of(*ct), batch_size));
     TRY_CATCH_END
 }
 
@@ -608,8 +918,11 @@ extern "C" OpenfheError eval_inner_product(
     if (!ctx || !ct1 || !ct2 || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalInnerProduct(ct1->ct, ct2->ct, batch_size);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->EvalInnerProduct(ct1->get(), ct2->get(), batch_size);
         *out_ct = new OpenfheCiphertext(result);
+        const Noise product = noise.key_switch(noise.mult(noise.of(*ct1), noise.of(*ct2)));
+        noise.track(**out_ct, rotate_and_sum_noise(noise, product, batch_size));
     TRY_CATCH_END
 }
 
@@ -625,8 +938,10 @@ extern "C" OpenfheError mod_reduce(
     if (!ctx || !ct || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->ModReduce(ct->ct);
+        const NoiseModel& noise = ctx->noise;
+        auto result = ctx->ctx->ModReduce(ct->get());
         *out_ct = new OpenfheCiphertext(result);
+        noise.track(**out_ct, noise.of(*ct));
     TRY_CATCH_END
 }
 
@@ -637,12 +952,236 @@ extern "C" OpenfheError mod_reduce_inplace(
     if (!ctx || !ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        ctx->ctx->ModReduceInPlace(ct->ct);
+        const Noise predicted = ctx->noise.of(*ct);
+        ctx->ctx->ModReduceInPlace(ct->mut());
+        ctx->noise.track(*ct, predicted);
     TRY_CATCH_END
 }
 
 extern "C" uint32_t ciphertext_get_level(CiphertextHandle ct) {
-    return ct ? ct->ct->GetLevel() : 0;
+    if (!ct) return 0;
+    try {
+        return ct->get()->GetLevel();
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return 0;
+    }
+}
+
+// ============================================================================
+// Noise Estimation Implementation
+// ============================================================================
+
+NoiseModel::NoiseModel(const CryptoContext<DCRTPoly>& cc) {
+    const double n = cc->GetRingDimension();
+    const double t_bits = std::log2(static_cast<double>(cc->GetCryptoParameters()->GetPlaintextModulus()));
+    auto params = std::dynamic_pointer_cast<CryptoParametersRNS>(cc->GetCryptoParameters());
+    const double sigma = params ? params->GetDistributionParameter() : 3.19;
+    const double digits = params ? std::max<uint32_t>(params->GetNumPartQ(), 1) : 1;
+
+    // t times the canonical norm of a polynomial with coefficient variance v
+    auto scaled_norm_bits = [&](double v) { return t_bits + std::log2(6 * std::sqrt(n * v)); };
+    // Secrets and encryption randomness are ternary (variance 2/3), errors
+    // Gaussian, and messages uniform modulo t (variance 1/12 in units of t).
+    // Public-key encryption adds e*u + e1 + e2*s to the message.
+    fresh_bits_ = scaled_norm_bits(sigma * sigma * (4 * n / 3 + 1) + 1.0 / 12);
+    fresh_private_bits_ = scaled_norm_bits(sigma * sigma + 1.0 / 12);
+    // Rounding of a modulus switch: t(r0 + r1*s), r uniform in [-1/2, 1/2]
+    rescale_bits_ = scaled_norm_bits((1 + 2 * n / 3) / 12);
+    // The digit products are divided by P, which is at least as large as
+    // each digit, and the final ModDown rounds like a modulus switch
+    key_switch_bits_ = add_bits(rescale_bits_, scaled_norm_bits(digits * n * sigma * sigma / 12));
+    // A packed plaintext has coefficients uniform modulo t
+    plaintext_bits_ = scaled_norm_bits(1.0 / 12);
+
+    for (const auto& tower : cc->GetElementParams()->GetParams()) {
+        tower_bits_.push_back(std::log2(tower->GetModulus().ConvertToDouble()));
+    }
+}
+
+Noise NoiseModel::rescaled(Noise n) const {
+    if (n.degree < 2 || n.towers < 2) return n;
+    n.bits = add_bits(n.bits - tower_bits_[n.towers - 1], rescale_bits_);
+    --n.towers;
+    --n.degree;
+    return n;
+}
+
+Noise NoiseModel::add(Noise a, Noise b) const {
+    return {add_bits(a.bits, b.bits), std::min(a.towers, b.towers), std::max(a.degree, b.degree)};
+}
+
+Noise NoiseModel::sum(Noise a, double count) const {
+    a.bits += std::log2(std::max(count, 1.0));
+    return a;
+}
+
+Noise NoiseModel::add_plaintext(Noise a) const {
+    a.bits = add_bits(a.bits, plaintext_bits_);
+    return a;
+}
+
+Noise NoiseModel::mult(Noise a, Noise b) const {
+    a = rescaled(a);
+    b = rescaled(b);
+    return {a.bits + b.bits, std::min(a.towers, b.towers), a.degree + b.degree};
+}
+
+Noise NoiseModel::mult_plaintext(Noise a) const {
+    a = rescaled(a);
+    a.bits += plaintext_bits_;
+    ++a.degree;
+    return a;
+}
+
+Noise NoiseModel::mult_scalar(Noise a, int64_t scalar) const {
+    a.bits += std::log2(std::max(std::fabs(static_cast<double>(scalar)), 1.0));
+    return a;
+}
+
+Noise NoiseModel::key_switch(Noise a) const {
+    a.bits = add_bits(a.bits, key_switch_bits_);
+    return a;
+}
+
+Noise NoiseModel::settle(Noise n, uint32_t towers) const {
+    while (n.towers > towers) {
+        if (n.degree > 1) {
+            n = rescaled(n);
+        } else {
+            --n.towers;
+        }
+    }
+    return n;
+}
+
+double NoiseModel::modulus_bits(uint32_t towers) const {
+    double bits = 0;
+    for (uint32_t i = 0; i < towers && i < tower_bits_.size(); ++i) bits += tower_bits_[i];
+    return bits;
+}
+
+Noise NoiseModel::of(const OpenfheCiphertext& handle) const {
+    Ciphertext<DCRTPoly> ct = handle.get();
+    const uint32_t towers = ct->GetElements()[0].GetNumOfElements();
+    if (std::isnan(handle.noise_bits)) return fresh(towers);
+    return {handle.noise_bits, towers, std::max<uint32_t>(ct->GetNoiseScaleDeg(), 1)};
+}
+
+void NoiseModel::track(OpenfheCiphertext& handle, Noise predicted) const {
+    handle.noise_bits = settle(predicted, handle.get()->GetElements()[0].GetNumOfElements()).bits;
+}
+
+namespace {
+
+NoiseEstimate noise_estimate(const NoiseModel& model, Noise n, bool tracked) {
+    NoiseEstimate estimate{};
+    estimate.noise_bits = n.bits;
+    estimate.modulus_bits = model.modulus_bits(n.towers);
+    estimate.budget_bits = model.budget_bits(n);
+    estimate.towers = n.towers;
+    estimate.tracked = tracked ? 1 : 0;
+    return estimate;
+}
+
+#ifdef OPENFHE_C_EXACT_NOISE
+double big_integer_bits(const BigInteger& value) {
+    const usint msb = value.GetMSB();
+    if (msb == 0) return 0;
+    if (msb <= 53) return std::log2(value.ConvertToDouble());
+    return std::log2((value >> (msb - 53)).ConvertToDouble()) + (msb - 53);
+}
+
+// Largest centered coefficient of c0 + c1*s + c2*s^2 + ... modulo Q
+double measured_noise_bits(const PrivateKey<DCRTPoly>& sk, const Ciphertext<DCRTPoly>& ct) {
+    const std::vector<DCRTPoly>& elements = ct->GetElements();
+    DCRTPoly s = sk->GetPrivateElement();
+    const usint towers = elements[0].GetNumOfElements();
+    if (s.GetNumOfElements() > towers) s.DropLastElements(s.GetNumOfElements() - towers);
+
+    DCRTPoly acc = elements[0];
+    DCRTPoly power = s;
+    for (size_t i = 1; i < elements.size(); ++i) {
+        acc = acc + elements[i] * power;
+        if (i + 1 < elements.size()) power = power * s;
+    }
+    acc.SetFormat(COEFFICIENT);
+
+    Poly poly = acc.CRTInterpolate();
+    const BigInteger q = poly.GetModulus();
+    const BigInteger half = q >> 1;
+    BigInteger largest;
+    for (usint i = 0; i < poly.GetLength(); ++i) {
+        BigInteger c = poly[i];
+        if (c > half) c = q - c;
+        if (c > largest) largest = c;
+    }
+    return big_integer_bits(largest);
+}
+#endif
+
+}  // namespace
+
+extern "C" OpenfheError ciphertext_noise_estimate(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    NoiseEstimate* out_estimate
+) {
+    if (!ctx || !ct || !out_estimate) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        *out_estimate = noise_estimate(ctx->noise, ctx->noise.of(*ct), !std::isnan(ct->noise_bits));
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError ciphertext_noise_droppable_towers(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    double min_budget_bits,
+    uint32_t* out_towers
+) {
+    if (!ctx || !ct || !out_towers) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        // Without a history the noise could be anything; dropping a tower
+        // could destroy the plaintext
+        if (std::isnan(ct->noise_bits)) {
+            *out_towers = 0;
+            return OPENFHE_OK;
+        }
+        const Noise n = ctx->noise.of(*ct);
+        uint32_t towers = n.towers;
+        while (towers > 1 && ctx->noise.modulus_bits(towers - 1) - 1 - n.bits >= min_budget_bits) --towers;
+        *out_towers = n.towers - towers;
+    TRY_CATCH_END
+}
+
+extern "C" bool openfhe_c_has_exact_noise(void) {
+#ifdef OPENFHE_C_EXACT_NOISE
+    return true;
+#else
+    return false;
+#endif
+}
+
+extern "C" OpenfheError ciphertext_noise_measure(
+    CryptoContextHandle ctx,
+    PrivateKeyHandle sk,
+    CiphertextHandle ct,
+    NoiseEstimate* out_measurement
+) {
+    if (!ctx || !sk || !ct || !out_measurement) return OPENFHE_ERROR_NULL_POINTER;
+
+#ifdef OPENFHE_C_EXACT_NOISE
+    TRY_CATCH_BEGIN
+        Noise measured = ctx->noise.of(*ct);
+        measured.bits = measured_noise_bits(sk->key, ct->get());
+        *out_measurement = noise_estimate(ctx->noise, measured, true);
+    TRY_CATCH_END
+#else
+    set_error("Noise measurement needs a build with OPENFHE_C_EXACT_NOISE");
+    return OPENFHE_ERROR_INVALID_PARAM;
+#endif
 }
 
 // ============================================================================
@@ -690,7 +1229,7 @@ extern "C" OpenfheError eval_bootstrap(
     if (!ctx || !ct || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        auto result = ctx->ctx->EvalBootstrap(ct->ct, num_iterations, precision);
+        auto result = ctx->ctx->EvalBootstrap(ct->get(), num_iterations, precision);
         *out_ct = new OpenfheCiphertext(result);
     TRY_CATCH_END
 }
@@ -731,8 +1270,8 @@ extern "C" OpenfheError crypto_context_deserialize(
     if (!data || !out_ctx) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        std::string str(reinterpret_cast<const char*>(data), size);
-        std::stringstream ss(str);
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
 
         CryptoContext<DCRTPoly> ctx;
         if (format == SERIAL_BINARY) {
@@ -777,8 +1316,8 @@ extern "C" OpenfheError public_key_deserialize(
     if (!data || !out_pk) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        std::string str(reinterpret_cast<const char*>(data), size);
-        std::stringstream ss(str);
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
 
         PublicKey<DCRTPoly> pk;
         if (format == SERIAL_BINARY) {
@@ -791,6 +1330,17 @@ extern "C" OpenfheError public_key_deserialize(
     TRY_CATCH_END
 }
 
+extern "C" OpenfheError public_key_check_context(CryptoContextHandle ctx, PublicKeyHandle pk) {
+    if (!ctx || !pk) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        if (!pk->key || *pk->key->GetCryptoParameters() != *ctx->ctx->GetCryptoParameters()) {
+            set_error("Public key does not match the crypto context parameters");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+    TRY_CATCH_END
+}
+
 extern "C" OpenfheError private_key_serialize(
     PrivateKeyHandle sk,
     SerialFormat format,
@@ -823,8 +1373,8 @@ extern "C" OpenfheError private_key_deserialize(
     if (!data || !out_sk) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        std::string str(reinterpret_cast<const char*>(data), size);
-        std::stringstream ss(str);
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
 
         PrivateKey<DCRTPoly> sk;
         if (format == SERIAL_BINARY) {
@@ -848,9 +1398,9 @@ extern "C" OpenfheError ciphertext_serialize(
     TRY_CATCH_BEGIN
         std::stringstream ss;
         if (format == SERIAL_BINARY) {
-            Serial::Serialize(ct->ct, ss, SerType::BINARY);
+            Serial::Serialize(ct->get(), ss, SerType::BINARY);
         } else {
-            Serial::Serialize(ct->ct, ss, SerType::JSON);
+            Serial::Serialize(ct->get(), ss, SerType::JSON);
         }
 
         std::string data = ss.str();
@@ -860,6 +1410,38 @@ extern "C" OpenfheError ciphertext_serialize(
     TRY_CATCH_END
 }
 
+extern "C" OpenfheError ciphertext_serialize_to(
+    CiphertextHandle ct,
+    SerialFormat format,
+    OpenfheWriteFn write_fn,
+    void* user_ctx
+) {
+    if (!ct || !write_fn) return OPENFHE_ERROR_NULL_POINTER;
+
+    WriterStreamBuf buf(write_fn, user_ctx);
+    try {
+        std::ostream os(&buf);
+        if (format == SERIAL_BINARY) {
+            Serial::Serialize(ct->get(), os, SerType::BINARY);
+        } else {
+            Serial::Serialize(ct->get(), os, SerType::JSON);
+        }
+        os.flush();
+    } catch (const std::exception& e) {
+        if (buf.failed()) {
+            set_error("Writer aborted serialization");
+            return OPENFHE_ERROR_ABORTED;
+        }
+        set_error(e.what());
+        return OPENFHE_ERROR_SERIALIZATION;
+    }
+    if (buf.failed()) {
+        set_error("Writer aborted serialization");
+        return OPENFHE_ERROR_ABORTED;
+    }
+    return OPENFHE_OK;
+}
+
 extern "C" OpenfheError ciphertext_deserialize(
     CryptoContextHandle ctx,
     const uint8_t* data,
@@ -870,8 +1452,8 @@ extern "C" OpenfheError ciphertext_deserialize(
     if (!ctx || !data || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        std::string str(reinterpret_cast<const char*>(data), size);
-        std::stringstream ss(str);
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
 
         Ciphertext<DCRTPoly> ct;
         if (format == SERIAL_BINARY) {
@@ -916,8 +1498,8 @@ extern "C" OpenfheError eval_mult_keys_deserialize(
     if (!ctx || !data) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        std::string str(reinterpret_cast<const char*>(data), size);
-        std::stringstream ss(str);
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
 
         if (format == SERIAL_BINARY) {
             ctx->ctx->DeserializeEvalMultKey(ss, SerType::BINARY);
@@ -959,8 +1541,8 @@ extern "C" OpenfheError eval_automorphism_keys_deserialize(
     if (!ctx || !data) return OPENFHE_ERROR_NULL_POINTER;
 
     TRY_CATCH_BEGIN
-        std::string str(reinterpret_cast<const char*>(data), size);
-        std::stringstream ss(str);
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
 
         if (format == SERIAL_BINARY) {
             ctx->ctx->DeserializeEvalAutomorphismKey(ss, SerType::BINARY);
@@ -975,14 +1557,3188 @@ extern "C" void serialized_data_free(uint8_t* data) {
 }
 
 // ============================================================================
-// Ciphertext Management Implementation
+// Evaluation Key Management Implementation
 // ============================================================================
 
-extern "C" CiphertextHandle ciphertext_clone(CiphertextHandle ct) {
-    if (!ct) return nullptr;
-    return new OpenfheCiphertext(ct->ct->Clone());
+extern "C" OpenfheError public_key_get_tag(
+    PublicKeyHandle pk,
+    char* out,
+    size_t capacity,
+    size_t* out_len
+) {
+    if (!pk || !out_len || (!out && capacity > 0)) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const std::string tag = pk->key->GetKeyTag();
+        if (capacity > 0) std::memcpy(out, tag.data(), std::min(capacity, tag.size()));
+        *out_len = tag.size();
+    TRY_CATCH_END
 }
 
-extern "C" void ciphertext_destroy(CiphertextHandle ct) {
-    delete ct;
+template <typename KeyT>
+static bool eval_key_matches(const CryptoContext<DCRTPoly>& ctx, const KeyT& key, const std::string& key_tag) {
+    return key && key->GetKeyTag() == key_tag && key->GetCryptoContext() == ctx;
+}
+
+static void reject_key_tag(const std::string& found, const std::string& expected) {
+    set_error("Evaluation key tagged '" + found + "' does not belong to '" + expected + "'");
+}
+
+extern "C" OpenfheError eval_mult_keys_deserialize_tagged(
+    CryptoContextHandle ctx,
+    const uint8_t* data,
+    size_t size,
+    SerialFormat format,
+    const char* key_tag,
+    const char* register_tag
+) {
+    if (!ctx || !data || !key_tag || !register_tag) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
+
+        // The same map DeserializeEvalMultKey reads, checked before it is registered
+        std::map<std::string, std::vector<EvalKey<DCRTPoly>>> keys;
+        if (format == SERIAL_BINARY) {
+            Serial::Deserialize(keys, ss, SerType::BINARY);
+        } else {
+            Serial::Deserialize(keys, ss, SerType::JSON);
+        }
+
+        for (const auto& [tag, vec] : keys) {
+            if (tag != key_tag) {
+                reject_key_tag(tag, key_tag);
+                return OPENFHE_ERROR_INVALID_PARAM;
+            }
+            for (const auto& key : vec) {
+                if (!eval_key_matches(ctx->ctx, key, key_tag)) {
+                    reject_key_tag(key ? key->GetKeyTag() : "", key_tag);
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+            }
+        }
+        for (const auto& [tag, vec] : keys) {
+            for (const auto& key : vec) key->SetKeyTag(register_tag);
+            CryptoContextImpl<DCRTPoly>::InsertEvalMultKey(vec, register_tag);
+        }
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError eval_automorphism_keys_deserialize_tagged(
+    CryptoContextHandle ctx,
+    const uint8_t* data,
+    size_t size,
+    SerialFormat format,
+    const char* key_tag,
+    const char* register_tag
+) {
+    if (!ctx || !data || !key_tag || !register_tag) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
+
+        std::map<std::string, std::shared_ptr<std::map<uint32_t, EvalKey<DCRTPoly>>>> keys;
+        if (format == SERIAL_BINARY) {
+            Serial::Deserialize(keys, ss, SerType::BINARY);
+        } else {
+            Serial::Deserialize(keys, ss, SerType::JSON);
+        }
+
+        for (const auto& [tag, indexed] : keys) {
+            if (tag != key_tag || !indexed) {
+                reject_key_tag(tag, key_tag);
+                return OPENFHE_ERROR_INVALID_PARAM;
+            }
+            for (const auto& [index, key] : *indexed) {
+                if (!eval_key_matches(ctx->ctx, key, key_tag)) {
+                    reject_key_tag(key ? key->GetKeyTag() : "", key_tag);
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+            }
+        }
+        for (const auto& [tag, indexed] : keys) {
+            for (const auto& [index, key] : *indexed) key->SetKeyTag(register_tag);
+            CryptoContextImpl<DCRTPoly>::InsertEvalAutomorphismKey(indexed, register_tag);
+        }
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError eval_keys_clear(CryptoContextHandle ctx, const char* key_tag) {
+    if (!ctx || !key_tag) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        CryptoContextImpl<DCRTPoly>::ClearEvalMultKeys(key_tag);
+        CryptoContextImpl<DCRTPoly>::ClearEvalAutomorphismKeys(key_tag);
+    TRY_CATCH_END
+}
+
+// ============================================================================
+// Streaming Ciphertext Decoding Implementation
+// ============================================================================
+
+struct OpenfheCiphertextStream {
+    CryptoContext<DCRTPoly> ctx;
+    SerialFormat format;
+    size_t max_frame_size;
+
+    uint8_t header[4] = {};
+    size_t header_len = 0;
+    size_t frame_size = 0;
+    std::vector<uint8_t> frame;
+
+    uint64_t count = 0;
+    bool failed = false;
+
+    OpenfheCiphertextStream(CryptoContext<DCRTPoly> c, SerialFormat f, size_t max)
+        : ctx(std::move(c)), format(f), max_frame_size(max) {}
+};
+
+static bool ciphertext_matches_context(const CryptoContext<DCRTPoly>& ctx, const Ciphertext<DCRTPoly>& ct) {
+    return ct && *ct->GetCryptoParameters() == *ctx->GetCryptoParameters();
+}
+
+// Rejects ciphertexts produced under different crypto parameters than `ctx`
+static bool check_ciphertext_context(const CryptoContext<DCRTPoly>& ctx, const Ciphertext<DCRTPoly>& ct) {
+    if (!ciphertext_matches_context(ctx, ct)) {
+        set_error("Ciphertext does not match the crypto context parameters");
+        return false;
+    }
+    return true;
+}
+
+static OpenfheError stream_emit_frame(
+    OpenfheCiphertextStream* stream,
+    const uint8_t* data,
+    size_t size,
+    CiphertextSinkFn sink,
+    void* user_ctx
+) {
+    Ciphertext<DCRTPoly> ct;
+    try {
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
+        if (stream->format == SERIAL_BINARY) {
+            Serial::Deserialize(ct, ss, SerType::BINARY);
+        } else {
+            Serial::Deserialize(ct, ss, SerType::JSON);
+        }
+    } catch (const std::exception& e) {
+        set_error(std::string("Frame ") + std::to_string(stream->count) + ": " + e.what());
+        return OPENFHE_ERROR_SERIALIZATION;
+    }
+    if (!check_ciphertext_context(stream->ctx, ct)) return OPENFHE_ERROR_INVALID_PARAM;
+
+    stream->count++;
+    if (sink(user_ctx, data, size, new OpenfheCiphertext(std::move(ct))) != 0) {
+        set_error("Ciphertext sink aborted the stream");
+        return OPENFHE_ERROR_ABORTED;
+    }
+    return OPENFHE_OK;
+}
+
+extern "C" OpenfheError ciphertext_stream_create(
+    CryptoContextHandle ctx,
+    SerialFormat format,
+    size_t max_frame_size,
+    CiphertextStreamHandle* out_stream
+) {
+    if (!ctx || !out_stream) return OPENFHE_ERROR_NULL_POINTER;
+    if (max_frame_size == 0) {
+        set_error("max_frame_size must be positive");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+
+    TRY_CATCH_BEGIN
+        *out_stream = new OpenfheCiphertextStream(ctx->ctx, format, max_frame_size);
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError ciphertext_stream_feed(
+    CiphertextStreamHandle stream,
+    const uint8_t* data,
+    size_t size,
+    CiphertextSinkFn sink,
+    void* user_ctx
+) {
+    if (!stream || !sink || (!data && size > 0)) return OPENFHE_ERROR_NULL_POINTER;
+    if (stream->failed) {
+        set_error("Ciphertext stream already failed");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+
+    TRY_CATCH_BEGIN
+        while (size > 0) {
+            if (stream->header_len < sizeof(stream->header)) {
+                size_t take = std::min(sizeof(stream->header) - stream->header_len, size);
+                std::memcpy(stream->header + stream->header_len, data, take);
+                stream->header_len += take;
+                data += take;
+                size -= take;
+                if (stream->header_len < sizeof(stream->header)) break;
+
+                stream->frame_size = static_cast<size_t>(stream->header[0]) |
+                                     static_cast<size_t>(stream->header[1]) << 8 |
+                                     static_cast<size_t>(stream->header[2]) << 16 |
+                                     static_cast<size_t>(stream->header[3]) << 24;
+                if (stream->frame_size == 0 || stream->frame_size > stream->max_frame_size) {
+                    stream->failed = true;
+                    set_error("Frame " + std::to_string(stream->count) + " has invalid length " +
+                              std::to_string(stream->frame_size));
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                stream->frame.clear();
+                continue;
+            }
+
+            OpenfheError err = OPENFHE_OK;
+            if (stream->frame.empty() && size >= stream->frame_size) {
+                // Whole frame inside this chunk: decode it in place
+                err = stream_emit_frame(stream, data, stream->frame_size, sink, user_ctx);
+                data += stream->frame_size;
+                size -= stream->frame_size;
+            } else {
+                size_t take = std::min(stream->frame_size - stream->frame.size(), size);
+                stream->frame.insert(stream->frame.end(), data, data + take);
+                data += take;
+                size -= take;
+                if (stream->frame.size() < stream->frame_size) break;
+                err = stream_emit_frame(stream, stream->frame.data(), stream->frame.size(), sink, user_ctx);
+                stream->frame.clear();
+            }
+            stream->header_len = 0;
+            if (err != OPENFHE_OK) {
+                stream->failed = true;
+                return err;
+            }
+        }
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError ciphertext_stream_finish(CiphertextStreamHandle stream) {
+    if (!stream) return OPENFHE_ERROR_NULL_POINTER;
+    if (stream->failed) {
+        set_error("Ciphertext stream already failed");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+    if (stream->header_len != 0) {
+        set_error("Ciphertext stream ended in the middle of frame " + std::to_string(stream->count));
+        return OPENFHE_ERROR_SERIALIZATION;
+    }
+    return OPENFHE_OK;
+}
+
+extern "C" uint64_t ciphertext_stream_get_count(CiphertextStreamHandle stream) {
+    return stream ? stream->count : 0;
+}
+
+extern "C" void ciphertext_stream_destroy(CiphertextStreamHandle stream) {
+    delete stream;
+}
+
+// ============================================================================
+// Batch Ciphertext Decoding Implementation
+// ============================================================================
+
+extern "C" OpenfheError ciphertext_deserialize_batch(
+    CryptoContextHandle ctx,
+    const OpenfheSpan* spans,
+    size_t count,
+    SerialFormat format,
+    uint32_t level,
+    CiphertextHandle* out_cts
+) {
+    if (!ctx || (count > 0 && (!spans || !out_cts))) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::vector<Ciphertext<DCRTPoly>> cts(count);
+        OpenfheError code = parallel_all_or_nothing(count, "Ciphertext", OPENFHE_ERROR_SERIALIZATION,
+            [&](size_t i, std::string& error) {
+                if (!spans[i].data) {
+                    error = "no data";
+                    return OPENFHE_ERROR_NULL_POINTER;
+                }
+                SpanStreamBuf buf(spans[i].data, spans[i].size);
+                std::istream ss(&buf);
+                if (format == SERIAL_BINARY) {
+                    Serial::Deserialize(cts[i], ss, SerType::BINARY);
+                } else {
+                    Serial::Deserialize(cts[i], ss, SerType::JSON);
+                }
+
+                if (!ciphertext_matches_context(ctx->ctx, cts[i])) {
+                    error = "crypto context parameters do not match";
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                if (level != OPENFHE_ANY_LEVEL && cts[i]->GetLevel() != level) {
+                    error = "level " + std::to_string(cts[i]->GetLevel()) + " instead of " + std::to_string(level);
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                return OPENFHE_OK;
+            });
+        if (code != OPENFHE_OK) return code;
+
+        for (size_t i = 0; i < count; ++i) {
+            out_cts[i] = new OpenfheCiphertext(std::move(cts[i]));
+        }
+    TRY_CATCH_END
+}
+
+// ============================================================================
+// Segment Store Implementation
+// ============================================================================
+
+namespace {
+
+constexpr uint32_t kRecordMagic = 0x52535a47;  // "GZSR"
+constexpr uint64_t kDefaultSegmentSize = 256ull << 20;
+
+enum RecordKind : uint32_t {
+    RECORD_PUT = 0,
+    RECORD_DELETE_OBJECT = 1,
+    RECORD_DELETE_SESSION = 2,
+};
+
+// On-disk record header (native byte order), followed by `size` payload bytes
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t kind;
+    uint8_t session[16];
+    uint64_t object_id;
+    uint64_t size;
+};
+static_assert(sizeof(RecordHeader) == 40, "record header layout is part of the file format");
+
+using SessionKey = std::array<uint8_t, 16>;
+using ObjectKey = std::pair<SessionKey, uint64_t>;
+
+struct ObjectLocation {
+    uint32_t segment;
+    uint64_t offset;  // of the record header
+    uint64_t size;    // of the payload
+};
+
+struct Segment {
+    uint32_t id = 0;
+    std::string path;
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t map_size = 0;
+    uint64_t size = 0;
+    uint64_t dead = 0;
+
+    ~Segment() {
+        if (map) munmap(map, map_size);
+        if (fd >= 0) close(fd);
+    }
+};
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+std::string segment_name(uint32_t id) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%08u.dat", id);
+    return name;
+}
+
+SessionKey session_key(const uint8_t* session_id) {
+    SessionKey key;
+    std::memcpy(key.data(), session_id, key.size());
+    return key;
+}
+
+void pwrite_all(int fd, const void* buf, size_t size, uint64_t offset, const std::string& path) {
+    const uint8_t* p = static_cast<const uint8_t*>(buf);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw_errno("write " + path);
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+// Map the segment read-only, reserving room for appends up to `min_size`.
+// Pages past the end of file are never touched, so mapping ahead is safe and
+// appends written with pwrite show up in the shared mapping.
+void segment_map(Segment& seg, uint64_t min_size) {
+    size_t want = static_cast<size_t>(std::max(min_size, seg.size));
+    if (seg.map && seg.map_size >= want) return;
+    if (seg.map) munmap(seg.map, seg.map_size);
+    seg.map = nullptr;
+
+    void* p = mmap(nullptr, want, PROT_READ, MAP_SHARED, seg.fd, 0);
+    if (p == MAP_FAILED) throw_errno("mmap " + seg.path);
+    seg.map = static_cast<uint8_t*>(p);
+    seg.map_size = want;
+}
+
+}  // namespace
+
+struct OpenfheSegmentStore {
+    std::string dir;
+    uint64_t segment_size;
+    std::map<uint32_t, std::unique_ptr<Segment>> segments;
+    uint32_t active = 0;  // segment receiving appends, 0 if none yet
+    std::set<uint32_t> dirty;
+    std::map<ObjectKey, ObjectLocation> index;
+    uint64_t live_bytes = 0;
+    mutable std::shared_mutex mutex;
+};
+
+static Segment& store_open_segment(OpenfheSegmentStore* store, uint32_t id, bool create, uint64_t min_size) {
+    auto seg = std::make_unique<Segment>();
+    seg->id = id;
+    seg->path = store->dir + "/" + segment_name(id);
+    seg->fd = open(seg->path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0600);
+    if (seg->fd < 0) throw_errno("open " + seg->path);
+
+    struct stat st;
+    if (fstat(seg->fd, &st) != 0) throw_errno("stat " + seg->path);
+    seg->size = static_cast<uint64_t>(st.st_size);
+    segment_map(*seg, std::max(store->segment_size, min_size));
+
+    Segment& ref = *seg;
+    store->segments[id] = std::move(seg);
+    return ref;
+}
+
+static void store_mark_dead(OpenfheSegmentStore* store, const ObjectLocation& loc) {
+    uint64_t record_size = sizeof(RecordHeader) + loc.size;
+    store->segments.at(loc.segment)->dead += record_size;
+    store->live_bytes -= record_size;
+}
+
+static void store_apply(OpenfheSegmentStore* store, const RecordHeader& h, const ObjectLocation& loc) {
+    SessionKey session = session_key(h.session);
+    switch (h.kind) {
+        case RECORD_PUT: {
+            auto [it, inserted] = store->index.try_emplace(ObjectKey{session, h.object_id}, loc);
+            if (!inserted) {
+                store_mark_dead(store, it->second);
+                it->second = loc;
+            }
+            store->live_bytes += sizeof(RecordHeader) + h.size;
+            return;
+        }
+        case RECORD_DELETE_OBJECT: {
+            auto it = store->index.find(ObjectKey{session, h.object_id});
+            if (it != store->index.end()) {
+                store_mark_dead(store, it->second);
+                store->index.erase(it);
+            }
+            break;
+        }
+        case RECORD_DELETE_SESSION: {
+            auto first = store->index.lower_bound(ObjectKey{session, 0});
+            auto last = store->index.upper_bound(ObjectKey{session, UINT64_MAX});
+            for (auto it = first; it != last; ++it) store_mark_dead(store, it->second);
+            store->index.erase(first, last);
+            break;
+        }
+    }
+    // Tombstones only matter until compaction drops what they delete
+    store->segments.at(loc.segment)->dead += sizeof(RecordHeader) + h.size;
+}
+
+// Replays a segment into the index. A torn record at the end of the newest
+// segment (crash during append) is cut off; anywhere else it is corruption.
+static void store_scan_segment(OpenfheSegmentStore* store, Segment& seg, bool newest) {
+    uint64_t file_size = seg.size;
+    uint64_t offset = 0;
+    while (offset < file_size) {
+        RecordHeader h;
+        bool valid = file_size - offset >= sizeof(h);
+        if (valid) {
+            std::memcpy(&h, seg.map + offset, sizeof(h));
+            valid = h.magic == kRecordMagic && h.kind <= RECORD_DELETE_SESSION &&
+                    h.size <= file_size - offset - sizeof(h);
+        }
+        if (!valid) {
+            if (!newest) {
+                throw std::runtime_error("Corrupt record in " + seg.path + " at offset " + std::to_string(offset));
+            }
+            if (ftruncate(seg.fd, static_cast<off_t>(offset)) != 0) throw_errno("truncate " + seg.path);
+            break;
+        }
+        store_apply(store, h, ObjectLocation{seg.id, offset, h.size});
+        offset += sizeof(h) + h.size;
+    }
+    seg.size = offset;
+}
+
+static ObjectLocation store_append(OpenfheSegmentStore* store, const RecordHeader& h, const uint8_t* payload) {
+    uint64_t record_size = sizeof(RecordHeader) + h.size;
+
+    Segment* seg = store->active ? store->segments.at(store->active).get() : nullptr;
+    if (seg && seg->size == 0) {
+        // Nothing can point into an empty segment yet, so it may be remapped
+        segment_map(*seg, record_size);
+    } else if (!seg || seg->size + record_size > seg->map_size) {
+        uint32_t id = store->segments.empty() ? 1 : store->segments.rbegin()->first + 1;
+        seg = &store_open_segment(store, id, true, record_size);
+        store->active = id;
+    }
+
+    pwrite_all(seg->fd, &h, sizeof(h), seg->size, seg->path);
+    if (h.size > 0) pwrite_all(seg->fd, payload, h.size, seg->size + sizeof(h), seg->path);
+
+    ObjectLocation loc{seg->id, seg->size, h.size};
+    seg->size += record_size;
+    store->dirty.insert(seg->id);
+    return loc;
+}
+
+static RecordHeader make_record(RecordKind kind, const uint8_t* session_id, uint64_t object_id, uint64_t size) {
+    RecordHeader h;
+    h.magic = kRecordMagic;
+    h.kind = kind;
+    std::memcpy(h.session, session_id, sizeof(h.session));
+    h.object_id = object_id;
+    h.size = size;
+    return h;
+}
+
+extern "C" OpenfheError segment_store_open(
+    const char* dir,
+    uint64_t segment_size,
+    SegmentStoreHandle* out_store
+) {
+    if (!dir || !out_store) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        auto store = std::make_unique<OpenfheSegmentStore>();
+        store->dir = dir;
+        store->segment_size = segment_size > 0 ? segment_size : kDefaultSegmentSize;
+        std::filesystem::create_directories(store->dir);
+
+        std::vector<uint32_t> ids;
+        for (const auto& entry : std::filesystem::directory_iterator(store->dir)) {
+            std::string name = entry.path().filename().string();
+            unsigned id = 0;
+            if (std::sscanf(name.c_str(), "seg-%u.dat", &id) == 1 && id > 0 && name == segment_name(id)) {
+                ids.push_back(id);
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            Segment& seg = store_open_segment(store.get(), ids[i], false, 0);
+            store_scan_segment(store.get(), seg, i + 1 == ids.size());
+        }
+        store->active = ids.empty() ? 0 : ids.back();
+
+        *out_store = store.release();
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError segment_store_put(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    const uint8_t* data,
+    size_t size
+) {
+    if (!store || !session_id || (!data && size > 0)) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::unique_lock lock(store->mutex);
+        RecordHeader h = make_record(RECORD_PUT, session_id, object_id, size);
+        store_apply(store, h, store_append(store, h, data));
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError segment_store_get(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    const uint8_t** out_data,
+    size_t* out_size
+) {
+    if (!store || !session_id || !out_data || !out_size) return OPENFHE_ERROR_NULL_POINTER;
+
+    std::shared_lock lock(store->mutex);
+    auto it = store->index.find(ObjectKey{session_key(session_id), object_id});
+    if (it == store->index.end()) {
+        set_error("Object " + std::to_string(object_id) + " not found");
+        return OPENFHE_ERROR_KEY_NOT_FOUND;
+    }
+    const Segment& seg = *store->segments.at(it->second.segment);
+    *out_data = seg.map + it->second.offset + sizeof(RecordHeader);
+    *out_size = it->second.size;
+    return OPENFHE_OK;
+}
+
+extern "C" OpenfheError segment_store_load_ciphertext(
+    SegmentStoreHandle store,
+    CryptoContextHandle ctx,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    SerialFormat format,
+    CiphertextHandle* out_ct
+) {
+    if (!store || !ctx || !session_id || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
+
+    std::shared_lock lock(store->mutex);
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    auto it = store->index.find(ObjectKey{session_key(session_id), object_id});
+    if (it == store->index.end()) {
+        set_error("Object " + std::to_string(object_id) + " not found");
+        return OPENFHE_ERROR_KEY_NOT_FOUND;
+    }
+    data = store->segments.at(it->second.segment)->map + it->second.offset + sizeof(RecordHeader);
+    size = it->second.size;
+
+    TRY_CATCH_BEGIN
+        SpanStreamBuf buf(data, size);
+        std::istream ss(&buf);
+
+        Ciphertext<DCRTPoly> ct;
+        if (format == SERIAL_BINARY) {
+            Serial::Deserialize(ct, ss, SerType::BINARY);
+        } else {
+            Serial::Deserialize(ct, ss, SerType::JSON);
+        }
+        if (!check_ciphertext_context(ctx->ctx, ct)) return OPENFHE_ERROR_INVALID_PARAM;
+
+        *out_ct = new OpenfheCiphertext(ct);
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError segment_store_list(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t* out_ids,
+    size_t max_ids,
+    size_t* out_count
+) {
+    if (!store || !session_id || !out_count || (!out_ids && max_ids > 0)) return OPENFHE_ERROR_NULL_POINTER;
+
+    std::shared_lock lock(store->mutex);
+    SessionKey session = session_key(session_id);
+    size_t count = 0;
+    auto last = store->index.upper_bound(ObjectKey{session, UINT64_MAX});
+    for (auto it = store->index.lower_bound(ObjectKey{session, 0}); it != last; ++it, ++count) {
+        if (count < max_ids) out_ids[count] = it->first.second;
+    }
+    *out_count = count;
+    return OPENFHE_OK;
+}
+
+extern "C" OpenfheError segment_store_delete(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id
+) {
+    if (!store || !session_id) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::unique_lock lock(store->mutex);
+        if (store->index.find(ObjectKey{session_key(session_id), object_id}) == store->index.end()) {
+            set_error("Object " + std::to_string(object_id) + " not found");
+            return OPENFHE_ERROR_KEY_NOT_FOUND;
+        }
+        RecordHeader h = make_record(RECORD_DELETE_OBJECT, session_id, object_id, 0);
+        store_apply(store, h, store_append(store, h, nullptr));
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError segment_store_delete_session(
+    SegmentStoreHandle store,
+    const uint8_t* session_id
+) {
+    if (!store || !session_id) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::unique_lock lock(store->mutex);
+        auto first = store->index.lower_bound(ObjectKey{session_key(session_id), 0});
+        if (first == store->index.end() || first->first.first != session_key(session_id)) return OPENFHE_OK;
+
+        RecordHeader h = make_record(RECORD_DELETE_SESSION, session_id, 0, 0);
+        store_apply(store, h, store_append(store, h, nullptr));
+    TRY_CATCH_END
+}
+
+// Copies the live records out of `victims` and removes their files. The
+// caller holds the store mutex exclusively.
+static void store_compact_segments(OpenfheSegmentStore* store, const std::set<uint32_t>& victims) {
+    // Copies must never land in a segment that is about to be removed
+    if (victims.count(store->active)) store->active = 0;
+
+    for (auto& [key, loc] : store->index) {
+        if (!victims.count(loc.segment)) continue;
+        const uint8_t* record = store->segments.at(loc.segment)->map + loc.offset;
+        RecordHeader h;
+        std::memcpy(&h, record, sizeof(h));
+        loc = store_append(store, h, record + sizeof(h));
+    }
+
+    // The copies have to be durable before the originals disappear
+    for (uint32_t id : store->dirty) {
+        if (!victims.count(id) && fdatasync(store->segments.at(id)->fd) != 0) {
+            throw_errno("sync " + store->segments.at(id)->path);
+        }
+    }
+    for (uint32_t id : victims) {
+        Segment& seg = *store->segments.at(id);
+        if (unlink(seg.path.c_str()) != 0) throw_errno("unlink " + seg.path);
+        store->dirty.erase(id);
+        store->segments.erase(id);
+    }
+    store->dirty.clear();
+}
+
+extern "C" OpenfheError segment_store_compact(SegmentStoreHandle store) {
+    if (!store) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::unique_lock lock(store->mutex);
+
+        std::set<uint32_t> victims;
+        for (const auto& [id, seg] : store->segments) {
+            if (seg->dead > 0) victims.insert(id);
+        }
+        if (!victims.empty()) store_compact_segments(store, victims);
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError segment_store_compact_step(SegmentStoreHandle store, bool* out_more) {
+    if (!store || !out_more) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::unique_lock lock(store->mutex);
+        *out_more = false;
+
+        // Oldest first: whatever a tombstone in the victim deletes sits in the
+        // victim itself or in an older segment that has already been
+        // compacted, so dropping the tombstone cannot resurrect anything.
+        auto victim = std::find_if(store->segments.begin(), store->segments.end(),
+                                   [](const auto& entry) { return entry.second->dead > 0; });
+        if (victim == store->segments.end()) return OPENFHE_OK;
+        store_compact_segments(store, {victim->first});
+
+        *out_more = std::any_of(store->segments.begin(), store->segments.end(),
+                                [](const auto& entry) { return entry.second->dead > 0; });
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError segment_store_sync(SegmentStoreHandle store) {
+    if (!store) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::unique_lock lock(store->mutex);
+        for (uint32_t id : store->dirty) {
+            const Segment& seg = *store->segments.at(id);
+            if (fdatasync(seg.fd) != 0) throw_errno("sync " + seg.path);
+        }
+        store->dirty.clear();
+    TRY_CATCH_END
+}
+
+extern "C" void segment_store_get_stats(SegmentStoreHandle store, SegmentStoreStats* out_stats) {
+    if (!store || !out_stats) return;
+
+    std::shared_lock lock(store->mutex);
+    out_stats->live_objects = store->index.size();
+    out_stats->live_bytes = store->live_bytes;
+    out_stats->dead_bytes = 0;
+    for (const auto& [id, seg] : store->segments) out_stats->dead_bytes += seg->dead;
+    out_stats->segments = static_cast<uint32_t>(store->segments.size());
+}
+
+extern "C" void segment_store_close(SegmentStoreHandle store) {
+    delete store;
+}
+
+// ============================================================================
+// Lazy Ciphertexts Implementation
+// ============================================================================
+
+namespace {
+
+// Materialized lazy handles in least recently used order (front is newest).
+// Lock order: cache mutex before any handle mutex.
+struct LazyCache {
+    std::mutex mutex;
+    std::list<OpenfheCiphertext*> lru;
+    size_t bytes = 0;
+    size_t budget = 0;  // 0 = unlimited
+};
+
+LazyCache& lazy_cache() {
+    static LazyCache cache;
+    return cache;
+}
+
+}  // namespace
+
+static Ciphertext<DCRTPoly> decode_ciphertext(
+    const CryptoContext<DCRTPoly>& ctx,
+    const uint8_t* data,
+    size_t size,
+    SerialFormat format
+) {
+    SpanStreamBuf buf(data, size);
+    std::istream ss(&buf);
+
+    Ciphertext<DCRTPoly> ct;
+    if (format == SERIAL_BINARY) {
+        Serial::Deserialize(ct, ss, SerType::BINARY);
+    } else {
+        Serial::Deserialize(ct, ss, SerType::JSON);
+    }
+    if (!ciphertext_matches_context(ctx, ct)) {
+        throw std::runtime_error("Ciphertext does not match the crypto context parameters");
+    }
+    return ct;
+}
+
+static Ciphertext<DCRTPoly> lazy_decode(OpenfheCiphertext::LazySource& src) {
+    if (!src.store) {
+        src.resident_bytes = src.size;
+        return decode_ciphertext(src.ctx, src.data, src.size, src.format);
+    }
+
+    std::shared_lock lock(src.store->mutex);
+    auto it = src.store->index.find(ObjectKey{src.session, src.object_id});
+    if (it == src.store->index.end()) {
+        throw std::runtime_error("Object " + std::to_string(src.object_id) + " not found");
+    }
+    src.resident_bytes = it->second.size;
+    const uint8_t* data = src.store->segments.at(it->second.segment)->map + it->second.offset + sizeof(RecordHeader);
+    return decode_ciphertext(src.ctx, data, it->second.size, src.format);
+}
+
+// Takes a handle out of the cache. Caller holds the cache mutex.
+static void lazy_forget_locked(LazyCache& cache, OpenfheCiphertext* ct) {
+    if (!ct->lazy->cached) return;
+    cache.lru.erase(ct->lazy->lru);
+    cache.bytes -= ct->lazy->resident_bytes;
+    ct->lazy->cached = false;
+}
+
+// Drops a handle's polynomials. Caller holds the cache and handle mutexes.
+static void lazy_evict_locked(LazyCache& cache, OpenfheCiphertext* ct) {
+    ct->ct.reset();
+    lazy_forget_locked(cache, ct);
+}
+
+// Evicts least recently used handles until the cache fits its budget. Handles
+// busy in another thread are skipped. Caller holds the cache mutex.
+static void lazy_trim_locked(LazyCache& cache, const OpenfheCiphertext* keep) {
+    if (cache.budget == 0) return;
+    auto it = cache.lru.end();
+    while (cache.bytes > cache.budget && it != cache.lru.begin()) {
+        OpenfheCiphertext* victim = *--it;
+        if (victim == keep || !victim->mutex.try_lock()) continue;
+        // Erasing the victim leaves `it` dangling, so step past it first
+        auto next = it;
+        ++next;
+        lazy_evict_locked(cache, victim);
+        victim->mutex.unlock();
+        it = next;
+    }
+}
+
+// Marks a just used lazy handle as most recently used
+static void lazy_touch(OpenfheCiphertext* ct) {
+    LazyCache& cache = lazy_cache();
+    std::lock_guard cache_lock(cache.mutex);
+    {
+        std::lock_guard lock(ct->mutex);
+        // Evicted or modified before we got here
+        if (!ct->ct || !ct->lazy) return;
+        if (ct->lazy->cached) {
+            cache.lru.splice(cache.lru.begin(), cache.lru, ct->lazy->lru);
+            return;
+        }
+        cache.lru.push_front(ct);
+        ct->lazy->lru = cache.lru.begin();
+        ct->lazy->cached = true;
+        cache.bytes += ct->lazy->resident_bytes;
+    }
+    lazy_trim_locked(cache, ct);
+}
+
+Ciphertext<DCRTPoly> OpenfheCiphertext::get() const {
+    if (!lazy) return ct;
+
+    Ciphertext<DCRTPoly> result;
+    {
+        std::lock_guard lock(mutex);
+        if (!ct) ct = lazy_decode(*lazy);
+        result = ct;
+    }
+    lazy_touch(const_cast<OpenfheCiphertext*>(this));
+    return result;
+}
+
+// Copy-on-write bookkeeping, see ciphertext_get_cow_stats
+static std::atomic<uint64_t> g_cow_shared_clones{0};
+static std::atomic<uint64_t> g_cow_copies{0};
+static std::atomic<uint64_t> g_cow_copied_bytes{0};
+
+// In-memory size of the polynomials
+static uint64_t ciphertext_payload_bytes(const Ciphertext<DCRTPoly>& ct) {
+    uint64_t bytes = 0;
+    for (const auto& element : ct->GetElements()) {
+        bytes += static_cast<uint64_t>(element.GetNumOfElements()) * element.GetRingDimension() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+Ciphertext<DCRTPoly>& OpenfheCiphertext::mut() {
+    while (lazy) {
+        {
+            std::lock_guard lock(mutex);
+            if (!ct) ct = lazy_decode(*lazy);
+        }
+
+        LazyCache& cache = lazy_cache();
+        std::lock_guard cache_lock(cache.mutex);
+        std::lock_guard lock(mutex);
+        // Evicted in between; decode again
+        if (!ct) continue;
+        // Modified polynomials cannot be recovered from the source any more
+        lazy_forget_locked(cache, this);
+        lazy.reset();
+    }
+    // Clones share the polynomials until one of them is written to
+    if (ct.use_count() > 1) {
+        ct = ct->Clone();
+        g_cow_copies.fetch_add(1, std::memory_order_relaxed);
+        g_cow_copied_bytes.fetch_add(ciphertext_payload_bytes(ct), std::memory_order_relaxed);
+    }
+    return ct;
+}
+
+void OpenfheCiphertext::set(Ciphertext<DCRTPoly> c) {
+    if (lazy) {
+        LazyCache& cache = lazy_cache();
+        std::lock_guard cache_lock(cache.mutex);
+        std::lock_guard lock(mutex);
+        lazy_forget_locked(cache, this);
+        lazy.reset();
+    }
+    ct = std::move(c);
+}
+
+OpenfheCiphertext::~OpenfheCiphertext() {
+    if (!lazy) return;
+    LazyCache& cache = lazy_cache();
+    std::lock_guard cache_lock(cache.mutex);
+    lazy_forget_locked(cache, this);
+}
+
+// A copy of the source of a lazy handle that is not decoded yet, else null
+static std::unique_ptr<OpenfheCiphertext::LazySource> lazy_clone_source(const OpenfheCiphertext* ct) {
+    if (!ct->lazy) return nullptr;
+    std::lock_guard lock(ct->mutex);
+    if (ct->ct) return nullptr;
+
+    auto source = std::make_unique<OpenfheCiphertext::LazySource>();
+    source->ctx = ct->lazy->ctx;
+    source->format = ct->lazy->format;
+    source->data = ct->lazy->data;
+    source->size = ct->lazy->size;
+    source->store = ct->lazy->store;
+    source->session = ct->lazy->session;
+    source->object_id = ct->lazy->object_id;
+    return source;
+}
+
+extern "C" OpenfheError ciphertext_lazy_from_span(
+    CryptoContextHandle ctx,
+    const uint8_t* data,
+    size_t size,
+    SerialFormat format,
+    CiphertextHandle* out_ct
+) {
+    if (!ctx || !data || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        auto source = std::make_unique<OpenfheCiphertext::LazySource>();
+        source->ctx = ctx->ctx;
+        source->format = format;
+        source->data = data;
+        source->size = size;
+        *out_ct = new OpenfheCiphertext(std::move(source));
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError ciphertext_lazy_from_store(
+    CryptoContextHandle ctx,
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    SerialFormat format,
+    CiphertextHandle* out_ct
+) {
+    if (!ctx || !store || !session_id || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        {
+            std::shared_lock lock(store->mutex);
+            if (store->index.find(ObjectKey{session_key(session_id), object_id}) == store->index.end()) {
+                set_error("Object " + std::to_string(object_id) + " not found");
+                return OPENFHE_ERROR_KEY_NOT_FOUND;
+            }
+        }
+
+        auto source = std::make_unique<OpenfheCiphertext::LazySource>();
+        source->ctx = ctx->ctx;
+        source->format = format;
+        source->store = store;
+        source->session = session_key(session_id);
+        source->object_id = object_id;
+        *out_ct = new OpenfheCiphertext(std::move(source));
+    TRY_CATCH_END
+}
+
+extern "C" bool ciphertext_is_lazy(CiphertextHandle ct) {
+    return ct && ct->lazy;
+}
+
+extern "C" bool ciphertext_is_materialized(CiphertextHandle ct) {
+    if (!ct) return false;
+    if (!ct->lazy) return true;
+    std::lock_guard lock(ct->mutex);
+    return ct->ct != nullptr;
+}
+
+extern "C" bool ciphertext_evict(CiphertextHandle ct) {
+    if (!ct || !ct->lazy) return false;
+
+    LazyCache& cache = lazy_cache();
+    std::lock_guard cache_lock(cache.mutex);
+    std::lock_guard lock(ct->mutex);
+    if (!ct->lazy->cached) return false;
+    lazy_evict_locked(cache, ct);
+    return true;
+}
+
+extern "C" void ciphertext_set_lazy_budget(size_t bytes) {
+    LazyCache& cache = lazy_cache();
+    std::lock_guard cache_lock(cache.mutex);
+    cache.budget = bytes;
+    lazy_trim_locked(cache, nullptr);
+}
+
+extern "C" size_t ciphertext_get_lazy_resident_bytes(void) {
+    LazyCache& cache = lazy_cache();
+    std::lock_guard cache_lock(cache.mutex);
+    return cache.bytes;
+}
+
+// ============================================================================
+// Context Snapshots Implementation
+// ============================================================================
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'G', 'Z', 'S', 'N', 'A', 'P', 0, 0};
+constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+constexpr uint64_t kFnvPrime = 0x100000001b3ull;
+
+// On-disk snapshot header (native byte order), followed by the OpenFHE
+// version string and the serialized context
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t openfhe_version_size;
+    uint64_t context_size;
+    uint64_t checksum;  // FNV-1a over everything after the header
+};
+static_assert(sizeof(SnapshotHeader) == 32, "snapshot header layout is part of the file format");
+
+uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+struct SnapshotWriter {
+    int fd;
+    std::string path;
+    uint64_t offset = sizeof(SnapshotHeader);
+    uint64_t checksum = kFnvOffset;
+};
+
+int snapshot_write(void* user_ctx, const uint8_t* data, size_t size) {
+    auto* writer = static_cast<SnapshotWriter*>(user_ctx);
+    try {
+        pwrite_all(writer->fd, data, size, writer->offset, writer->path);
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return 1;
+    }
+    writer->offset += size;
+    writer->checksum = fnv1a(writer->checksum, data, size);
+    return 0;
+}
+
+// NTT twiddle tables are computed on first use rather than serialized with
+// the context. Encoding one packed plaintext transforms a polynomial over
+// every tower of the modulus chain, so no request pays for them later.
+void prime_context(const CryptoContext<DCRTPoly>& cc) {
+    cc->MakePackedPlaintext(std::vector<int64_t>{0});
+}
+
+}  // namespace
+
+extern "C" OpenfheError crypto_context_snapshot_save(CryptoContextHandle ctx, const char* path) {
+    if (!ctx || !path) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        SnapshotWriter writer{-1, std::string(path) + ".tmp"};
+        writer.fd = open(writer.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (writer.fd < 0) throw_errno("open " + writer.path);
+
+        // Closes the file and removes it unless it was renamed into place
+        struct TempFile {
+            SnapshotWriter& writer;
+            bool committed = false;
+            ~TempFile() {
+                close(writer.fd);
+                if (!committed) unlink(writer.path.c_str());
+            }
+        } temp{writer};
+
+        const std::string version = GetOPENFHEVersion();
+        if (snapshot_write(&writer, reinterpret_cast<const uint8_t*>(version.data()), version.size()) != 0) {
+            return OPENFHE_ERROR_INTERNAL;
+        }
+
+        const uint64_t context_offset = writer.offset;
+        {
+            WriterStreamBuf buf(&snapshot_write, &writer);
+            std::ostream os(&buf);
+            Serial::Serialize(ctx->ctx, os, SerType::BINARY);
+            os.flush();
+            // snapshot_write has set the error message
+            if (buf.failed()) return OPENFHE_ERROR_INTERNAL;
+        }
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.format_version = OPENFHE_SNAPSHOT_VERSION;
+        header.openfhe_version_size = static_cast<uint32_t>(version.size());
+        header.context_size = writer.offset - context_offset;
+        header.checksum = writer.checksum;
+        pwrite_all(writer.fd, &header, sizeof(header), 0, writer.path);
+
+        if (fsync(writer.fd) != 0) throw_errno("sync " + writer.path);
+        if (rename(writer.path.c_str(), path) != 0) throw_errno("rename " + writer.path);
+        temp.committed = true;
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError crypto_context_snapshot_load(const char* path, CryptoContextHandle* out_ctx) {
+    if (!path || !out_ctx) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw_errno(std::string("open ") + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw_errno(std::string("stat ") + path);
+        }
+        const size_t size = static_cast<size_t>(st.st_size);
+        if (size < sizeof(SnapshotHeader)) {
+            close(fd);
+            set_error(std::string("Snapshot ") + path + " is truncated");
+            return OPENFHE_ERROR_SERIALIZATION;
+        }
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) throw_errno(std::string("mmap ") + path);
+
+        struct Mapping {
+            void* data;
+            size_t size;
+            ~Mapping() { munmap(data, size); }
+        } mapping{map, size};
+        const uint8_t* bytes = static_cast<const uint8_t*>(map);
+
+        SnapshotHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+        if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+            set_error(std::string(path) + " is not a context snapshot");
+            return OPENFHE_ERROR_SERIALIZATION;
+        }
+        if (header.format_version != OPENFHE_SNAPSHOT_VERSION) {
+            set_error("Snapshot format version " + std::to_string(header.format_version) +
+                      " is not supported, expected " + std::to_string(OPENFHE_SNAPSHOT_VERSION));
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        const size_t payload_size = size - sizeof(header);
+        if (header.openfhe_version_size > payload_size ||
+            header.context_size != payload_size - header.openfhe_version_size) {
+            set_error(std::string("Snapshot ") + path + " is truncated");
+            return OPENFHE_ERROR_SERIALIZATION;
+        }
+        const uint8_t* payload = bytes + sizeof(header);
+        if (fnv1a(kFnvOffset, payload, payload_size) != header.checksum) {
+            set_error(std::string("Snapshot ") + path + " is corrupt (checksum mismatch)");
+            return OPENFHE_ERROR_SERIALIZATION;
+        }
+
+        const std::string version(reinterpret_cast<const char*>(payload), header.openfhe_version_size);
+        if (version != GetOPENFHEVersion()) {
+            set_error("Snapshot was written by OpenFHE " + version + ", running " + GetOPENFHEVersion());
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        CryptoContext<DCRTPoly> cc;
+        try {
+            SpanStreamBuf buf(payload + header.openfhe_version_size, header.context_size);
+            std::istream ss(&buf);
+            Serial::Deserialize(cc, ss, SerType::BINARY);
+        } catch (const std::exception& e) {
+            set_error(std::string("Snapshot ") + path + ": " + e.what());
+            return OPENFHE_ERROR_SERIALIZATION;
+        }
+        if (!cc) {
+            set_error(std::string("Snapshot ") + path + " holds no context");
+            return OPENFHE_ERROR_SERIALIZATION;
+        }
+
+        prime_context(cc);
+        *out_ctx = new OpenfheCryptoContext(cc);
+    TRY_CATCH_END
+}
+
+// ============================================================================
+// Zero-Encryption Pools Implementation
+// ============================================================================
+
+struct OpenfheZeroPool {
+    CryptoContext<DCRTPoly> ctx;
+    PublicKey<DCRTPoly> pk;
+    Plaintext zero;
+    size_t capacity;
+    // The context's model, so re-randomizing does not rebuild it
+    NoiseModel noise;
+
+    OpenfheZeroPool(const OpenfheCryptoContext& c, PublicKey<DCRTPoly> key, size_t cap)
+        : ctx(c.ctx), pk(std::move(key)), zero(c.ctx->MakePackedPlaintext(std::vector<int64_t>{0})),
+          capacity(cap), noise(c.noise) {}
+
+    // Guarded by the refiller mutex
+    std::deque<Ciphertext<DCRTPoly>> ready;
+    uint64_t zero_bytes = 0;  // size of one encryption, known after the first
+    uint64_t served = 0;
+    uint64_t misses = 0;
+    bool failed = false;
+};
+
+namespace {
+
+constexpr size_t kDefaultZeroPoolBudget = 256ull << 20;
+
+// One idle-priority thread fills every pool in the process, so creating a
+// pool never starts a thread. Pools take turns, one encryption each, and
+// filling pauses while the pools together hold `budget` bytes.
+struct ZeroRefiller {
+    std::mutex mutex;  // also guards the queues and counters of every pool
+    std::condition_variable wake;
+    std::condition_variable done;  // an encryption finished
+    std::list<OpenfheZeroPool*> pools;
+    OpenfheZeroPool* filling = nullptr;
+    size_t bytes = 0;
+    size_t budget = kDefaultZeroPoolBudget;
+    bool started = false;
+};
+
+// Never destroyed: the refill thread runs until the process exits
+ZeroRefiller& zero_refiller() {
+    static ZeroRefiller* refiller = new ZeroRefiller();
+    return *refiller;
+}
+
+bool zero_pool_wants(const ZeroRefiller& r, const OpenfheZeroPool& pool) {
+    return !pool.failed && pool.ready.size() < pool.capacity && r.bytes + pool.zero_bytes <= r.budget;
+}
+
+}  // namespace
+
+static void zero_pool_refill() {
+    // Only use CPU time nobody else wants; best effort, the pools work at
+    // normal priority too
+    sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    ZeroRefiller& r = zero_refiller();
+    std::unique_lock lock(r.mutex);
+    while (true) {
+        auto next = r.pools.end();
+        r.wake.wait(lock, [&] {
+            next = std::find_if(r.pools.begin(), r.pools.end(),
+                                [&](const OpenfheZeroPool* pool) { return zero_pool_wants(r, *pool); });
+            return next != r.pools.end();
+        });
+        OpenfheZeroPool* pool = *next;
+        // Round robin: the pool goes to the back of the line
+        r.pools.splice(r.pools.end(), r.pools, next);
+        r.filling = pool;
+
+        lock.unlock();
+        Ciphertext<DCRTPoly> zero;
+        try {
+            zero = pool->ctx->Encrypt(pool->pk, pool->zero);
+        } catch (...) {
+        }
+        lock.lock();
+
+        // Removed from the list if it is being destroyed, which waits below
+        if (std::find(r.pools.begin(), r.pools.end(), pool) != r.pools.end()) {
+            if (zero) {
+                pool->zero_bytes = ciphertext_payload_bytes(zero);
+                pool->ready.push_back(std::move(zero));
+                r.bytes += pool->zero_bytes;
+            } else {
+                // Encryption does not fail intermittently. Stop refilling the
+                // pool and let consumers encrypt inline, where the error
+                // reaches the caller.
+                pool->failed = true;
+            }
+        }
+        r.filling = nullptr;
+        r.done.notify_all();
+    }
+}
+
+extern "C" OpenfheError zero_pool_create(
+    CryptoContextHandle ctx,
+    PublicKeyHandle pk,
+    size_t capacity,
+    ZeroPoolHandle* out_pool
+) {
+    if (!ctx || !pk || !out_pool) return OPENFHE_ERROR_NULL_POINTER;
+    if (capacity == 0) {
+        set_error("Zero pool capacity must be positive");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+
+    TRY_CATCH_BEGIN
+        auto pool = std::make_unique<OpenfheZeroPool>(*ctx, pk->key, capacity);
+        ZeroRefiller& r = zero_refiller();
+        {
+            std::lock_guard lock(r.mutex);
+            if (!r.started) {
+                std::thread(zero_pool_refill).detach();
+                r.started = true;
+            }
+            r.pools.push_back(pool.get());
+        }
+        r.wake.notify_one();
+        *out_pool = pool.release();
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError ciphertext_rerandomize(CiphertextHandle ct, ZeroPoolHandle pool) {
+    if (!ct || !pool) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        Ciphertext<DCRTPoly> current = ct->get();
+        if (!check_ciphertext_context(pool->ctx, current)) return OPENFHE_ERROR_INVALID_PARAM;
+        if (current->GetKeyTag() != pool->pk->GetKeyTag()) {
+            set_error("Ciphertext is not encrypted under the zero pool's public key");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        Ciphertext<DCRTPoly> zero;
+        ZeroRefiller& r = zero_refiller();
+        {
+            std::lock_guard lock(r.mutex);
+            if (!pool->ready.empty()) {
+                zero = std::move(pool->ready.front());
+                pool->ready.pop_front();
+                r.bytes -= pool->zero_bytes;
+                ++pool->served;
+            } else {
+                ++pool->misses;
+            }
+        }
+        r.wake.notify_one();
+        if (!zero) zero = pool->ctx->Encrypt(pool->pk, pool->zero);
+
+        // EvalAdd brings the fresh encryption down to the level of `current`
+        ct->set(pool->ctx->EvalAdd(current, zero));
+        if (!std::isnan(ct->noise_bits)) {
+            const NoiseModel& noise = pool->noise;
+            const Noise before{ct->noise_bits, current->GetElements()[0].GetNumOfElements(),
+                               std::max<uint32_t>(current->GetNoiseScaleDeg(), 1)};
+            noise.track(*ct, noise.add(before, noise.fresh(before.towers)));
+        }
+    TRY_CATCH_END
+}
+
+extern "C" void zero_pool_get_stats(ZeroPoolHandle pool, ZeroPoolStats* out_stats) {
+    if (!pool || !out_stats) return;
+
+    std::lock_guard lock(zero_refiller().mutex);
+    out_stats->capacity = pool->capacity;
+    out_stats->available = pool->ready.size();
+    out_stats->served = pool->served;
+    out_stats->misses = pool->misses;
+}
+
+extern "C" void zero_pool_reserve(ZeroPoolHandle pool, size_t capacity) {
+    if (!pool) return;
+
+    ZeroRefiller& r = zero_refiller();
+    {
+        std::lock_guard lock(r.mutex);
+        if (capacity <= pool->capacity) return;
+        pool->capacity = capacity;
+    }
+    r.wake.notify_one();
+}
+
+extern "C" void zero_pool_set_budget(size_t bytes) {
+    ZeroRefiller& r = zero_refiller();
+    {
+        std::lock_guard lock(r.mutex);
+        r.budget = bytes > 0 ? bytes : kDefaultZeroPoolBudget;
+    }
+    r.wake.notify_one();
+}
+
+extern "C" size_t zero_pool_get_pooled_bytes(void) {
+    ZeroRefiller& r = zero_refiller();
+    std::lock_guard lock(r.mutex);
+    return r.bytes;
+}
+
+extern "C" void zero_pool_destroy(ZeroPoolHandle pool) {
+    if (!pool) return;
+
+    ZeroRefiller& r = zero_refiller();
+    {
+        std::unique_lock lock(r.mutex);
+        r.pools.remove(pool);
+        r.bytes -= pool->ready.size() * pool->zero_bytes;
+        // The refill thread may be encrypting for it right now
+        r.done.wait(lock, [&] { return r.filling != pool; });
+    }
+    r.wake.notify_one();
+    delete pool;
+}
+
+// ============================================================================
+// DNA Kernels Implementation
+// ============================================================================
+
+// Slot layout of a DNA ciphertext, kept in its metadata map. Outside the
+// anonymous namespace so cereal can register it for serialization.
+class DnaLayoutMetadata : public Metadata {
+public:
+    DnaLayout layout{};
+
+    DnaLayoutMetadata() = default;
+    explicit DnaLayoutMetadata(const DnaLayout& l) : layout(l) {}
+
+    std::shared_ptr<Metadata> Clone() const override {
+        return std::make_shared<DnaLayoutMetadata>(layout);
+    }
+
+    bool operator==(const Metadata& other) const override {
+        auto o = dynamic_cast<const DnaLayoutMetadata*>(&other);
+        return o && o->layout.kind == layout.kind && o->layout.channel == layout.channel &&
+               o->layout.stride == layout.stride && o->layout.row_bases == layout.row_bases &&
+               o->layout.overlap == layout.overlap;
+    }
+
+    std::ostream& print(std::ostream& out) const override {
+        return out << "[ dna layout " << layout.kind << " channel " << layout.channel << " stride "
+                   << layout.stride << " row " << layout.row_bases << " overlap " << layout.overlap << " ]";
+    }
+
+    template <class Archive>
+    void save(Archive& ar, std::uint32_t const) const {
+        ar(cereal::base_class<Metadata>(this), cereal::make_nvp("kind", layout.kind),
+           cereal::make_nvp("channel", layout.channel), cereal::make_nvp("stride", layout.stride),
+           cereal::make_nvp("row", layout.row_bases), cereal::make_nvp("overlap", layout.overlap));
+    }
+
+    template <class Archive>
+    void load(Archive& ar, std::uint32_t const) {
+        ar(cereal::base_class<Metadata>(this), cereal::make_nvp("kind", layout.kind),
+           cereal::make_nvp("channel", layout.channel), cereal::make_nvp("stride", layout.stride),
+           cereal::make_nvp("row", layout.row_bases), cereal::make_nvp("overlap", layout.overlap));
+    }
+};
+
+CEREAL_REGISTER_TYPE(DnaLayoutMetadata);
+CEREAL_REGISTER_POLYMORPHIC_RELATION(Metadata, DnaLayoutMetadata);
+
+namespace {
+
+constexpr size_t kDnaChannels = 4;
+constexpr const char* kDnaLayoutKey = "dna_layout";
+
+// Layout of a one-hot chunk encoded with make_dna_plaintext
+DnaLayout default_dna_layout(const CryptoContext<DCRTPoly>& cc) {
+    DnaLayout layout{};
+    layout.kind = DNA_LAYOUT_ONE_HOT;
+    layout.stride = kDnaChannels;
+    layout.row_bases = cc->GetRingDimension() / 2 / kDnaChannels;
+    return layout;
+}
+
+// Recorded layout of `ct`, if any
+std::optional<DnaLayout> find_dna_layout(const Ciphertext<DCRTPoly>& ct) {
+    auto it = ct->FindMetadataByKey(kDnaLayoutKey);
+    if (!ct->MetadataFound(it)) return std::nullopt;
+    auto md = std::dynamic_pointer_cast<DnaLayoutMetadata>(ct->GetMetadata(it));
+    if (!md) return std::nullopt;
+    return md->layout;
+}
+
+DnaLayout dna_layout_of(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& ct) {
+    return find_dna_layout(ct).value_or(default_dna_layout(cc));
+}
+
+void set_dna_layout(Ciphertext<DCRTPoly>& ct, const DnaLayout& layout) {
+    ct->SetMetadataByKey(kDnaLayoutKey, std::make_shared<DnaLayoutMetadata>(layout));
+}
+
+// Kernels take one-hot input with no slots between bases
+bool is_one_hot(const Ciphertext<DCRTPoly>& ct) {
+    auto layout = find_dna_layout(ct);
+    return !layout || (layout->kind == DNA_LAYOUT_ONE_HOT && layout->stride == kDnaChannels);
+}
+
+// Checks one sequence handed to a kernel; sets `seq` to its ciphertext
+OpenfheError check_dna_input(const CryptoContext<DCRTPoly>& cc, CiphertextHandle handle,
+                             Ciphertext<DCRTPoly>& seq, std::string& error) {
+    if (!handle) {
+        error = "null handle";
+        return OPENFHE_ERROR_NULL_POINTER;
+    }
+    seq = handle->get();
+    if (!ciphertext_matches_context(cc, seq)) {
+        error = "crypto context parameters do not match";
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+    if (!is_one_hot(seq)) {
+        error = "not in the one-hot layout";
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+    return OPENFHE_OK;
+}
+
+// Channel of a base, -1 for N and -2 for anything else
+int dna_channel(char base) {
+    switch (base) {
+        case 'A': case 'a': return 0;
+        case 'C': case 'c': return 1;
+        case 'G': case 'g': return 2;
+        case 'T': case 't': return 3;
+        case 'N': case 'n': return -1;
+        default: return -2;
+    }
+}
+
+// Plaintext with 1 in channel `channel` of every base, at the given level
+Plaintext dna_channel_mask(const CryptoContext<DCRTPoly>& cc, size_t channel, uint32_t level) {
+    std::vector<int64_t> mask(cc->GetRingDimension(), 0);
+    for (size_t slot = channel; slot < mask.size(); slot += kDnaChannels) mask[slot] = 1;
+    return cc->MakePackedPlaintext(mask, 1, level);
+}
+
+// Mismatch profile of one sequence. `offsets[c]` lists the pattern positions
+// holding base `c`.
+Ciphertext<DCRTPoly> dna_hamming_profile(
+    const CryptoContext<DCRTPoly>& cc,
+    const Ciphertext<DCRTPoly>& seq,
+    const std::array<std::vector<uint32_t>, kDnaChannels>& offsets,
+    size_t pattern_len
+) {
+    // Every rotation below is of `seq`, so the expensive key-switching
+    // decomposition is done once and shared
+    auto precomp = cc->EvalFastRotationPrecompute(seq);
+    const uint32_t m = cc->GetCyclotomicOrder();
+    const uint32_t level = seq->GetLevel();
+
+    // Sum the shifted sequences that are compared against the same base, so
+    // only one plaintext product per base is needed
+    Ciphertext<DCRTPoly> matches;
+    for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+        if (offsets[channel].empty()) continue;
+        Ciphertext<DCRTPoly> shifted;
+        for (uint32_t k : offsets[channel]) {
+            auto rotated = k == 0 ? seq : cc->EvalFastRotation(seq, kDnaChannels * k, m, precomp);
+            // Not in place: `shifted` may still be the caller's ciphertext
+            shifted = shifted ? cc->EvalAdd(shifted, rotated) : rotated;
+        }
+        auto selected = cc->EvalMult(shifted, dna_channel_mask(cc, channel, level));
+        if (matches) {
+            cc->EvalAddInPlace(matches, selected);
+        } else {
+            matches = selected;
+        }
+    }
+
+    // Fold the four channels of each base into its first slot
+    cc->EvalAddInPlace(matches, cc->EvalRotate(matches, 1));
+    cc->EvalAddInPlace(matches, cc->EvalRotate(matches, 2));
+
+    std::vector<int64_t> length(cc->GetRingDimension(), static_cast<int64_t>(pattern_len));
+    return cc->EvalAdd(cc->EvalNegate(matches), cc->MakePackedPlaintext(length, 1, matches->GetLevel()));
+}
+
+// Rotation moving channel `channel` of base j + k to lane `lane` of base j,
+// as a non-negative index within a row
+uint32_t multi_rotation(uint32_t ring_dim, size_t k, size_t channel, size_t lane) {
+    const size_t row = ring_dim / 2;
+    return static_cast<uint32_t>((kDnaChannels * k + channel + row - lane) % row);
+}
+
+// Profiles of every pattern against one sequence; see dna_hamming_scan_multi.
+// `patterns` holds the channel of each pattern base.
+std::vector<Ciphertext<DCRTPoly>> dna_hamming_multi_profiles(
+    const CryptoContext<DCRTPoly>& cc,
+    const Ciphertext<DCRTPoly>& seq,
+    const std::vector<std::vector<uint8_t>>& patterns
+) {
+    const uint32_t ring_dim = cc->GetRingDimension();
+    const uint32_t m = cc->GetCyclotomicOrder();
+    const uint32_t level = seq->GetLevel();
+
+    // Channel c of the sequence alone. Rotated so that channel c of base
+    // j + k lands in lane l, it is zero everywhere except in lane l, which
+    // is what lets four patterns share a profile without further masking.
+    std::array<Ciphertext<DCRTPoly>, kDnaChannels> channels;
+    std::array<std::shared_ptr<std::vector<DCRTPoly>>, kDnaChannels> precomps;
+    std::map<std::pair<size_t, uint32_t>, Ciphertext<DCRTPoly>> rotated;
+    auto term = [&](size_t channel, uint32_t index) -> const Ciphertext<DCRTPoly>& {
+        if (!channels[channel]) {
+            channels[channel] = cc->EvalMult(seq, dna_channel_mask(cc, channel, level));
+            precomps[channel] = cc->EvalFastRotationPrecompute(channels[channel]);
+        }
+        auto& slot = rotated[{channel, index}];
+        if (!slot) {
+            slot = index == 0 ? channels[channel]
+                              : cc->EvalFastRotation(channels[channel], index, m, precomps[channel]);
+        }
+        return slot;
+    };
+
+    const size_t outputs = (patterns.size() + kDnaChannels - 1) / kDnaChannels;
+    std::vector<Ciphertext<DCRTPoly>> profiles;
+    profiles.reserve(outputs);
+    for (size_t g = 0; g < outputs; ++g) {
+        // Terms are shared, so the sum must not start out as one of them
+        Ciphertext<DCRTPoly> matches;
+        bool owned = false;
+        std::vector<int64_t> lengths(ring_dim, 0);
+
+        for (size_t lane = 0; lane < kDnaChannels; ++lane) {
+            const size_t p = g * kDnaChannels + lane;
+            if (p >= patterns.size()) break;
+            for (size_t k = 0; k < patterns[p].size(); ++k) {
+                const auto& t = term(patterns[p][k], multi_rotation(ring_dim, k, patterns[p][k], lane));
+                if (!matches) {
+                    matches = t;
+                } else if (!owned) {
+                    matches = cc->EvalAdd(matches, t);
+                    owned = true;
+                } else {
+                    cc->EvalAddInPlace(matches, t);
+                }
+            }
+            for (size_t slot = lane; slot < lengths.size(); slot += kDnaChannels) {
+                lengths[slot] = static_cast<int64_t>(patterns[p].size());
+            }
+        }
+        profiles.push_back(cc->EvalAdd(cc->EvalNegate(matches), cc->MakePackedPlaintext(lengths, 1, matches->GetLevel())));
+    }
+    return profiles;
+}
+
+// Rotations that bring channel c of base i + t to slot 4i, for t < k
+std::vector<int32_t> kmer_shift_rotations(uint32_t k) {
+    std::vector<int32_t> indices;
+    for (uint32_t index = 1; index < kDnaChannels * k; ++index) indices.push_back(static_cast<int32_t>(index));
+    return indices;
+}
+
+// Strides of the in-row reduction; they keep the four lanes apart
+std::vector<int32_t> kmer_reduce_rotations(uint32_t ring_dim) {
+    std::vector<int32_t> indices;
+    for (uint32_t stride = kDnaChannels; stride < ring_dim / 2; stride <<= 1) {
+        indices.push_back(static_cast<int32_t>(stride));
+    }
+    return indices;
+}
+
+// Plaintext with 1 in slot 4i for every base i where a k-mer fits into
+// the row and that is not among the first `skip[row]` of its row, at the
+// given level
+Plaintext kmer_position_mask(const CryptoContext<DCRTPoly>& cc, uint32_t k, const std::array<size_t, 2>& skip,
+                             uint32_t level) {
+    const size_t row_bases = cc->GetRingDimension() / 2 / kDnaChannels;
+    std::vector<int64_t> mask(cc->GetRingDimension(), 0);
+    for (size_t i = 0; i < 2 * row_bases; ++i) {
+        const size_t j = i % row_bases;
+        if (j >= skip[i / row_bases] && j + k <= row_bases) mask[i * kDnaChannels] = 1;
+    }
+    return cc->MakePackedPlaintext(mask, 1, level);
+}
+
+// K-mer starts at the front of each row of `seq` that were already counted:
+// the second row repeats `overlap` bases of the first, and a chunk that
+// follows another in a batch repeats as many of its predecessor. Only the
+// last k - 1 of those bases start new k-mers.
+std::array<size_t, 2> kmer_repeated_starts(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& seq,
+                                           uint32_t k, bool follows_chunk) {
+    const uint32_t overlap = dna_layout_of(cc, seq).overlap;
+    const size_t repeated = overlap > k - 1 ? overlap - (k - 1) : 0;
+    return {follows_chunk ? repeated : 0, repeated};
+}
+
+// Indicator of every k-mer w at each position of `seq`, in slot 4i of
+// element w, leaving out the first `skip[row]` positions of each row.
+// Products are built position by position, so all k-mers with a common
+// prefix share its product, and each of the 4k - 1 shifts of `seq` is
+// rotated once.
+std::vector<Ciphertext<DCRTPoly>> kmer_indicators(
+    const CryptoContext<DCRTPoly>& cc,
+    const Ciphertext<DCRTPoly>& seq,
+    uint32_t k,
+    const std::array<size_t, 2>& skip
+) {
+    auto precomp = cc->EvalFastRotationPrecompute(seq);
+    const uint32_t m = cc->GetCyclotomicOrder();
+    // Channel c of base i + t in slot 4i, for every channel
+    auto shifted = [&](uint32_t t) {
+        std::array<Ciphertext<DCRTPoly>, kDnaChannels> channels;
+        for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+            const uint32_t index = static_cast<uint32_t>(kDnaChannels * t + channel);
+            channels[channel] = index == 0 ? seq : cc->EvalFastRotation(seq, index, m, precomp);
+        }
+        return channels;
+    };
+
+    // The position mask goes on the last factor, which is multiplied in last,
+    // so it costs no extra level on the product chain
+    auto mask = kmer_position_mask(cc, k, skip, seq->GetLevel());
+    std::array<Ciphertext<DCRTPoly>, kDnaChannels> last = shifted(k - 1);
+    for (auto& channel : last) channel = cc->EvalMult(channel, mask);
+    if (k == 1) return {last.begin(), last.end()};
+
+    const auto first = shifted(0);
+    std::vector<Ciphertext<DCRTPoly>> prefixes(first.begin(), first.end());
+    for (uint32_t t = 1; t + 1 < k; ++t) {
+        const auto next = shifted(t);
+        std::vector<Ciphertext<DCRTPoly>> longer;
+        longer.reserve(prefixes.size() * kDnaChannels);
+        for (const auto& prefix : prefixes) {
+            for (const auto& channel : next) longer.push_back(cc->EvalMult(prefix, channel));
+        }
+        prefixes = std::move(longer);
+    }
+
+    std::vector<Ciphertext<DCRTPoly>> indicators;
+    indicators.reserve(prefixes.size() * kDnaChannels);
+    for (const auto& prefix : prefixes) {
+        for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+            indicators.push_back(cc->EvalMult(prefix, last[channel]));
+        }
+    }
+    return indicators;
+}
+
+// Noise of a dna_hamming_profile output
+Noise hamming_profile_noise(
+    const NoiseModel& noise,
+    Noise seq,
+    const std::array<std::vector<uint32_t>, kDnaChannels>& offsets
+) {
+    const Noise rotated = noise.key_switch(seq);
+    std::optional<Noise> matches;
+    for (const auto& positions : offsets) {
+        if (positions.empty()) continue;
+        const Noise selected = noise.mult_plaintext(noise.sum(rotated, static_cast<double>(positions.size())));
+        matches = matches ? noise.add(*matches, selected) : selected;
+    }
+    Noise folded = *matches;
+    for (int fold = 0; fold < 2; ++fold) folded = noise.add(folded, noise.key_switch(folded));
+    return noise.add_plaintext(folded);
+}
+
+// Noise of a dna_hamming_multi_profiles output summing `terms` rotations
+Noise hamming_multi_noise(const NoiseModel& noise, Noise seq, size_t terms) {
+    const Noise term = noise.key_switch(noise.mult_plaintext(seq));
+    return noise.add_plaintext(noise.sum(term, static_cast<double>(terms)));
+}
+
+// Noise of each kmer_indicators output
+Noise kmer_indicator_noise(const NoiseModel& noise, Noise seq, uint32_t k) {
+    const Noise shifted = noise.key_switch(seq);
+    const Noise last = noise.mult_plaintext(shifted);
+    if (k == 1) return last;
+    Noise prefix = shifted;
+    for (uint32_t t = 1; t + 1 < k; ++t) prefix = noise.key_switch(noise.mult(prefix, shifted));
+    return noise.key_switch(noise.mult(prefix, last));
+}
+
+}  // namespace
+
+extern "C" OpenfheError make_dna_plaintext(
+    CryptoContextHandle ctx,
+    const char* bases,
+    size_t length,
+    PlaintextHandle* out_pt
+) {
+    if (!ctx || (length > 0 && !bases) || !out_pt) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const size_t slots = ctx->ctx->GetRingDimension();
+        if (length > slots / kDnaChannels) {
+            set_error("Sequence of " + std::to_string(length) + " bases does not fit into " +
+                      std::to_string(slots) + " slots");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        std::vector<int64_t> values(length * kDnaChannels, 0);
+        for (size_t i = 0; i < length; ++i) {
+            int channel = dna_channel(bases[i]);
+            if (channel == -2) {
+                set_error("Invalid base at position " + std::to_string(i));
+                return OPENFHE_ERROR_INVALID_PARAM;
+            }
+            if (channel >= 0) values[i * kDnaChannels + static_cast<size_t>(channel)] = 1;
+        }
+        auto pt = ctx->ctx->MakePackedPlaintext(values);
+        *out_pt = new OpenfhePlaintext(pt);
+    TRY_CATCH_END
+}
+
+extern "C" size_t dna_hamming_scan_rotations(size_t pattern_len, int32_t* out_indices, size_t capacity) {
+    std::vector<int32_t> indices;
+    for (size_t k = 1; k < pattern_len; ++k) indices.push_back(static_cast<int32_t>(kDnaChannels * k));
+    // Channel fold
+    indices.push_back(1);
+    indices.push_back(2);
+
+    if (out_indices) {
+        std::copy_n(indices.begin(), std::min(capacity, indices.size()), out_indices);
+    }
+    return indices.size();
+}
+
+extern "C" OpenfheError dna_hamming_scan(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    const char* pattern,
+    size_t pattern_len,
+    CiphertextHandle* out_profiles
+) {
+    if (!ctx || !pattern || (count > 0 && (!seqs || !out_profiles))) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        const size_t row_bases = cc->GetRingDimension() / 2 / kDnaChannels;
+        if (pattern_len == 0 || pattern_len > row_bases) {
+            set_error("Pattern length must be between 1 and " + std::to_string(row_bases));
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        std::array<std::vector<uint32_t>, kDnaChannels> offsets;
+        for (size_t k = 0; k < pattern_len; ++k) {
+            int channel = dna_channel(pattern[k]);
+            if (channel < 0) {
+                set_error("Invalid pattern base at position " + std::to_string(k));
+                return OPENFHE_ERROR_INVALID_PARAM;
+            }
+            offsets[static_cast<size_t>(channel)].push_back(static_cast<uint32_t>(k));
+        }
+
+        std::vector<Ciphertext<DCRTPoly>> profiles(count);
+        std::vector<Noise> noises(count);
+        OpenfheError code = parallel_all_or_nothing(count, "Sequence", OPENFHE_ERROR_CRYPTO_FAILURE,
+            [&](size_t i, std::string& error) {
+                Ciphertext<DCRTPoly> seq;
+                OpenfheError checked = check_dna_input(cc, seqs[i], seq, error);
+                if (checked != OPENFHE_OK) return checked;
+                profiles[i] = dna_hamming_profile(cc, seq, offsets, pattern_len);
+                noises[i] = hamming_profile_noise(ctx->noise, ctx->noise.of(*seqs[i]), offsets);
+                return OPENFHE_OK;
+            });
+        if (code != OPENFHE_OK) return code;
+
+        for (size_t i = 0; i < count; ++i) {
+            out_profiles[i] = new OpenfheCiphertext(std::move(profiles[i]));
+            ctx->noise.track(*out_profiles[i], noises[i]);
+        }
+    TRY_CATCH_END
+}
+
+extern "C" size_t dna_hamming_multi_outputs(size_t num_patterns) {
+    return (num_patterns + kDnaChannels - 1) / kDnaChannels;
+}
+
+extern "C" size_t dna_hamming_multi_rotations(
+    CryptoContextHandle ctx,
+    size_t max_pattern_len,
+    int32_t* out_indices,
+    size_t capacity
+) {
+    if (!ctx) return 0;
+
+    const uint32_t ring_dim = ctx->ctx->GetRingDimension();
+    std::set<int32_t> indices;
+    for (size_t k = 0; k < max_pattern_len; ++k) {
+        for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+            for (size_t lane = 0; lane < kDnaChannels; ++lane) {
+                uint32_t index = multi_rotation(ring_dim, k, channel, lane);
+                if (index != 0) indices.insert(static_cast<int32_t>(index));
+            }
+        }
+    }
+
+    if (out_indices) {
+        std::copy_n(indices.begin(), std::min(capacity, indices.size()), out_indices);
+    }
+    return indices.size();
+}
+
+extern "C" OpenfheError dna_hamming_scan_multi(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    const char* const* patterns,
+    const size_t* pattern_lens,
+    size_t num_patterns,
+    CiphertextHandle* out_profiles
+) {
+    if (!ctx || (num_patterns > 0 && (!patterns || !pattern_lens)) ||
+        (count > 0 && (!seqs || !out_profiles))) {
+        return OPENFHE_ERROR_NULL_POINTER;
+    }
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        const size_t row_bases = cc->GetRingDimension() / 2 / kDnaChannels;
+        if (num_patterns == 0) {
+            set_error("No patterns given");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        std::vector<std::vector<uint8_t>> parsed(num_patterns);
+        for (size_t p = 0; p < num_patterns; ++p) {
+            if (!patterns[p]) return OPENFHE_ERROR_NULL_POINTER;
+            if (pattern_lens[p] == 0 || pattern_lens[p] > row_bases) {
+                set_error("Pattern " + std::to_string(p) + ": length must be between 1 and " +
+                          std::to_string(row_bases));
+                return OPENFHE_ERROR_INVALID_PARAM;
+            }
+            for (size_t k = 0; k < pattern_lens[p]; ++k) {
+                int channel = dna_channel(patterns[p][k]);
+                if (channel < 0) {
+                    set_error("Pattern " + std::to_string(p) + ": invalid base at position " + std::to_string(k));
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                parsed[p].push_back(static_cast<uint8_t>(channel));
+            }
+        }
+
+        const size_t outputs = dna_hamming_multi_outputs(num_patterns);
+        std::vector<size_t> terms(outputs, 0);
+        for (size_t p = 0; p < num_patterns; ++p) terms[p / kDnaChannels] += parsed[p].size();
+        std::vector<std::vector<Ciphertext<DCRTPoly>>> profiles(count);
+        OpenfheError code = parallel_all_or_nothing(count, "Sequence", OPENFHE_ERROR_CRYPTO_FAILURE,
+            [&](size_t i, std::string& error) {
+                Ciphertext<DCRTPoly> seq;
+                OpenfheError checked = check_dna_input(cc, seqs[i], seq, error);
+                if (checked != OPENFHE_OK) return checked;
+                profiles[i] = dna_hamming_multi_profiles(cc, seq, parsed);
+                return OPENFHE_OK;
+            });
+        if (code != OPENFHE_OK) return code;
+
+        for (size_t i = 0; i < count; ++i) {
+            const Noise seq = ctx->noise.of(*seqs[i]);
+            for (size_t g = 0; g < outputs; ++g) {
+                out_profiles[i * outputs + g] = new OpenfheCiphertext(std::move(profiles[i][g]));
+                ctx->noise.track(*out_profiles[i * outputs + g], hamming_multi_noise(ctx->noise, seq, terms[g]));
+            }
+        }
+    TRY_CATCH_END
+}
+
+extern "C" size_t dna_kmer_histogram_outputs(uint32_t k) {
+    if (k == 0 || k > OPENFHE_KMER_MAX_K) return 0;
+    return size_t{1} << (2 * (k - 1));
+}
+
+extern "C" size_t dna_kmer_rotations(CryptoContextHandle ctx, uint32_t k, int32_t* out_indices, size_t capacity) {
+    if (!ctx || k == 0 || k > OPENFHE_KMER_MAX_K) return 0;
+
+    std::vector<int32_t> indices = kmer_shift_rotations(k);
+    // Moving k-mers into lanes 1-3
+    for (int32_t lane = 1; lane < static_cast<int32_t>(kDnaChannels); ++lane) indices.push_back(-lane);
+    for (int32_t stride : kmer_reduce_rotations(ctx->ctx->GetRingDimension())) {
+        if (std::find(indices.begin(), indices.end(), stride) == indices.end()) indices.push_back(stride);
+    }
+
+    if (out_indices) {
+        std::copy_n(indices.begin(), std::min(capacity, indices.size()), out_indices);
+    }
+    return indices.size();
+}
+
+namespace {
+
+// Adds the k-mer indicators of every sequence into `totals`, one per k-mer;
+// null totals start out as the first sum. Every sequence after the first is
+// taken to follow the one before it in a batch. `total_noise` receives the
+// bound of the added indicators.
+OpenfheError kmer_accumulate(
+    const OpenfheCryptoContext& ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    uint32_t k,
+    std::vector<Ciphertext<DCRTPoly>>& totals,
+    Noise& total_noise
+) {
+    const CryptoContext<DCRTPoly>& cc = ctx.ctx;
+    const size_t kmers = totals.size();
+    std::mutex totals_mutex;
+
+    OpenfheError code = parallel_all_or_nothing(count, "Sequence", OPENFHE_ERROR_CRYPTO_FAILURE,
+        [&](size_t i, std::string& error) {
+            Ciphertext<DCRTPoly> seq;
+            OpenfheError checked = check_dna_input(cc, seqs[i], seq, error);
+            if (checked != OPENFHE_OK) return checked;
+            auto indicators = kmer_indicators(cc, seq, k, kmer_repeated_starts(cc, seq, k, i > 0));
+
+            std::lock_guard lock(totals_mutex);
+            for (size_t w = 0; w < kmers; ++w) {
+                if (totals[w]) {
+                    cc->EvalAddInPlace(totals[w], indicators[w]);
+                } else {
+                    totals[w] = std::move(indicators[w]);
+                }
+            }
+            return OPENFHE_OK;
+        });
+    if (code != OPENFHE_OK) return code;
+
+    const NoiseModel& noise = ctx.noise;
+    total_noise = kmer_indicator_noise(noise, noise.of(*seqs[0]), k);
+    for (size_t i = 1; i < count; ++i) {
+        total_noise = noise.add(total_noise, kmer_indicator_noise(noise, noise.of(*seqs[i]), k));
+    }
+    return OPENFHE_OK;
+}
+
+// Packs four k-mer totals per ciphertext, one per lane, and sums each lane
+// over the row. `total_noise` bounds every total. The reduction leaves a
+// lane's sum in every slot of that lane, so four totals per reduction is the
+// most that stay apart; packing more would need a masking product and one
+// level beyond the k the kernel is specified for.
+OpenfheError kmer_pack(
+    const OpenfheCryptoContext& ctx,
+    const std::vector<Ciphertext<DCRTPoly>>& totals,
+    Noise total_noise,
+    CiphertextHandle* out_counts
+) {
+    const CryptoContext<DCRTPoly>& cc = ctx.ctx;
+    const size_t outputs = totals.size() / kDnaChannels;
+    const std::vector<int32_t> strides = kmer_reduce_rotations(cc->GetRingDimension());
+    std::vector<Ciphertext<DCRTPoly>> packed(outputs);
+
+    OpenfheError code = parallel_all_or_nothing(outputs, "K-mer group", OPENFHE_ERROR_CRYPTO_FAILURE,
+        [&](size_t g, std::string&) {
+            Ciphertext<DCRTPoly> acc = totals[g * kDnaChannels];
+            for (size_t lane = 1; lane < kDnaChannels; ++lane) {
+                acc = cc->EvalAdd(acc, cc->EvalRotate(totals[g * kDnaChannels + lane], -static_cast<int32_t>(lane)));
+            }
+            for (int32_t stride : strides) cc->EvalAddInPlace(acc, cc->EvalRotate(acc, stride));
+            packed[g] = std::move(acc);
+            return OPENFHE_OK;
+        });
+    if (code != OPENFHE_OK) return code;
+
+    // Every output sums its totals the same way
+    const NoiseModel& noise = ctx.noise;
+    Noise reduced = total_noise;
+    for (size_t lane = 1; lane < kDnaChannels; ++lane) reduced = noise.add(reduced, noise.key_switch(total_noise));
+    for (size_t stride = 0; stride < strides.size(); ++stride) reduced = noise.add(reduced, noise.key_switch(reduced));
+
+    for (size_t g = 0; g < outputs; ++g) {
+        out_counts[g] = new OpenfheCiphertext(std::move(packed[g]));
+        noise.track(*out_counts[g], reduced);
+    }
+    return OPENFHE_OK;
+}
+
+bool check_kmer_args(uint32_t k, size_t count) {
+    if (dna_kmer_histogram_outputs(k) == 0) {
+        set_error("k must be between 1 and " + std::to_string(OPENFHE_KMER_MAX_K));
+        return false;
+    }
+    if (count == 0) {
+        set_error("No sequences given");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+extern "C" OpenfheError dna_kmer_histogram(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    uint32_t k,
+    CiphertextHandle* out_counts
+) {
+    if (!ctx || !out_counts || (count > 0 && !seqs)) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        if (!check_kmer_args(k, count)) return OPENFHE_ERROR_INVALID_PARAM;
+
+        // Per k-mer sums over all sequences; the reduction is linear, so it
+        // only has to run once on these
+        std::vector<Ciphertext<DCRTPoly>> totals(dna_kmer_partial_sums(k));
+        Noise total_noise{};
+        OpenfheError code = kmer_accumulate(*ctx, seqs, count, k, totals, total_noise);
+        if (code != OPENFHE_OK) return code;
+        return kmer_pack(*ctx, totals, total_noise, out_counts);
+    TRY_CATCH_END
+}
+
+extern "C" size_t dna_kmer_partial_sums(uint32_t k) {
+    return dna_kmer_histogram_outputs(k) * kDnaChannels;
+}
+
+extern "C" OpenfheError dna_kmer_accumulate(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    uint32_t k,
+    CiphertextHandle* partials
+) {
+    if (!ctx || !partials || (count > 0 && !seqs)) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        if (!check_kmer_args(k, count)) return OPENFHE_ERROR_INVALID_PARAM;
+        const size_t kmers = dna_kmer_partial_sums(k);
+        const bool first = !partials[0];
+        for (size_t w = 0; w < kmers; ++w) {
+            if (!partials[w] != first) {
+                set_error("Partial sums must be all set or all null");
+                return OPENFHE_ERROR_INVALID_PARAM;
+            }
+            if (!first && !check_ciphertext_context(cc, partials[w]->get())) return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        std::vector<Ciphertext<DCRTPoly>> totals(kmers);
+        Noise added{};
+        OpenfheError code = kmer_accumulate(*ctx, seqs, count, k, totals, added);
+        if (code != OPENFHE_OK) return code;
+
+        // Sums are computed out of place, so a failure leaves the partials as
+        // they were
+        if (!first) {
+            for (size_t w = 0; w < kmers; ++w) totals[w] = cc->EvalAdd(partials[w]->get(), totals[w]);
+        }
+        for (size_t w = 0; w < kmers; ++w) {
+            if (first) {
+                partials[w] = new OpenfheCiphertext(std::move(totals[w]));
+                ctx->noise.track(*partials[w], added);
+            } else {
+                const Noise predicted = ctx->noise.add(ctx->noise.of(*partials[w]), added);
+                partials[w]->set(std::move(totals[w]));
+                ctx->noise.track(*partials[w], predicted);
+            }
+        }
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError dna_kmer_finalize(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* partials,
+    uint32_t k,
+    CiphertextHandle* out_counts
+) {
+    if (!ctx || !partials || !out_counts) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        if (!check_kmer_args(k, 1)) return OPENFHE_ERROR_INVALID_PARAM;
+        const size_t kmers = dna_kmer_partial_sums(k);
+        std::vector<Ciphertext<DCRTPoly>> totals(kmers);
+        Noise total_noise{};
+        for (size_t w = 0; w < kmers; ++w) {
+            if (!partials[w]) return OPENFHE_ERROR_NULL_POINTER;
+            totals[w] = partials[w]->get();
+            if (!check_ciphertext_context(ctx->ctx, totals[w])) return OPENFHE_ERROR_INVALID_PARAM;
+            const Noise own = ctx->noise.of(*partials[w]);
+            if (w == 0 || own.bits > total_noise.bits) total_noise = own;
+        }
+        return kmer_pack(*ctx, totals, total_noise, out_counts);
+    TRY_CATCH_END
+}
+
+// ============================================================================
+// DNA Slot Layouts Implementation
+// ============================================================================
+
+namespace {
+
+// Fills in stride and row_bases of a fresh encoding; false if the kind is
+// unknown or the overlap leaves no room in a row
+bool complete_dna_layout(const CryptoContext<DCRTPoly>& cc, DnaLayout& layout) {
+    if (layout.kind > DNA_LAYOUT_BASE4) return false;
+    layout.stride = layout.kind == DNA_LAYOUT_ONE_HOT ? kDnaChannels : 1;
+    layout.row_bases = cc->GetRingDimension() / 2 / layout.stride;
+    return layout.overlap < layout.row_bases;
+}
+
+uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t m) {
+    return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b % m);
+}
+
+uint64_t pow_mod(uint64_t base, uint64_t exp, uint64_t m) {
+    uint64_t result = 1 % m;
+    for (base %= m; exp > 0; exp >>= 1) {
+        if (exp & 1) result = mul_mod(result, base, m);
+        base = mul_mod(base, base, m);
+    }
+    return result;
+}
+
+// Residue of `v` modulo `t` in the signed range packed encodings use
+int64_t centered_mod(int64_t v, uint64_t t) {
+    const int64_t st = static_cast<int64_t>(t);
+    int64_t r = v % st;
+    if (r < 0) r += st;
+    return r > st / 2 ? r - st : r;
+}
+
+// Coefficients (constant first) of the polynomial that is 1 at digit
+// `channel` and 0 at the other digits and at N (-1), modulo prime t
+std::array<int64_t, 5> base4_indicator(int64_t channel, uint64_t t) {
+    std::array<int64_t, 5> numerator{1, 0, 0, 0, 0};
+    int64_t denominator = 1;
+    size_t degree = 0;
+    for (int64_t digit = -1; digit < static_cast<int64_t>(kDnaChannels); ++digit) {
+        if (digit == channel) continue;
+        // numerator *= (x - digit)
+        for (size_t k = ++degree; k > 0; --k) numerator[k] = numerator[k - 1] - digit * numerator[k];
+        numerator[0] *= -digit;
+        denominator *= channel - digit;
+    }
+    const uint64_t inverse = pow_mod(static_cast<uint64_t>(centered_mod(denominator, t) + static_cast<int64_t>(t)) % t, t - 2, t);
+    std::array<int64_t, 5> coefficients{};
+    for (size_t k = 0; k < coefficients.size(); ++k) {
+        const uint64_t n = static_cast<uint64_t>(centered_mod(numerator[k], t) + static_cast<int64_t>(t)) % t;
+        coefficients[k] = centered_mod(static_cast<int64_t>(mul_mod(n, inverse, t)), t);
+    }
+    return coefficients;
+}
+
+Plaintext constant_plaintext(const CryptoContext<DCRTPoly>& cc, int64_t value, uint32_t level) {
+    std::vector<int64_t> values(cc->GetRingDimension(), value);
+    return cc->MakePackedPlaintext(values, 1, level);
+}
+
+std::vector<Ciphertext<DCRTPoly>> split_one_hot(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& x) {
+    std::vector<Ciphertext<DCRTPoly>> channels;
+    for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+        auto masked = cc->EvalMult(x, dna_channel_mask(cc, channel, x->GetLevel()));
+        // Move the channel onto the base's first slot
+        channels.push_back(channel == 0 ? masked : cc->EvalRotate(masked, static_cast<int32_t>(channel)));
+    }
+    return channels;
+}
+
+std::vector<Ciphertext<DCRTPoly>> split_base4(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& x) {
+    const uint64_t t = cc->GetCryptoParameters()->GetPlaintextModulus();
+    // Powers shared by all four indicator polynomials
+    auto x2 = cc->EvalSquare(x);
+    const std::array<Ciphertext<DCRTPoly>, 4> powers{x, x2, cc->EvalMult(x2, x), cc->EvalSquare(x2)};
+
+    std::vector<Ciphertext<DCRTPoly>> channels;
+    for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+        const auto coefficients = base4_indicator(static_cast<int64_t>(channel), t);
+        Ciphertext<DCRTPoly> acc;
+        for (size_t k = 1; k < coefficients.size(); ++k) {
+            if (coefficients[k] == 0) continue;
+            auto term = cc->EvalMult(powers[k - 1], coefficients[k]);
+            acc = acc ? cc->EvalAdd(acc, term) : term;
+        }
+        channels.push_back(cc->EvalAdd(acc, constant_plaintext(cc, coefficients[0], acc->GetLevel())));
+    }
+    return channels;
+}
+
+// Noise of each split_one_hot or split_base4 output
+std::array<Noise, kDnaChannels> split_noise(const NoiseModel& noise, uint64_t t, Noise x, uint32_t kind) {
+    std::array<Noise, kDnaChannels> channels;
+    if (kind == DNA_LAYOUT_ONE_HOT) {
+        channels.fill(noise.key_switch(noise.mult_plaintext(x)));
+        return channels;
+    }
+    const Noise x2 = noise.key_switch(noise.mult(x, x));
+    const std::array<Noise, 4> powers{x, x2, noise.key_switch(noise.mult(x2, x)), noise.key_switch(noise.mult(x2, x2))};
+    for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+        const auto coefficients = base4_indicator(static_cast<int64_t>(channel), t);
+        std::optional<Noise> acc;
+        for (size_t k = 1; k < coefficients.size(); ++k) {
+            if (coefficients[k] == 0) continue;
+            const Noise term = noise.mult_scalar(powers[k - 1], coefficients[k]);
+            acc = acc ? noise.add(*acc, term) : term;
+        }
+        channels[channel] = noise.add_plaintext(*acc);
+    }
+    return channels;
+}
+
+}  // namespace
+
+extern "C" size_t dna_layout_ciphertexts(uint32_t kind) {
+    return kind == DNA_LAYOUT_CHANNELS ? kDnaChannels : 1;
+}
+
+extern "C" size_t dna_layout_append_offset(size_t existing_bases, size_t window) {
+    if (window == 0 || existing_bases < window) return 0;
+    return existing_bases - (window - 1);
+}
+
+extern "C" OpenfheError dna_layout_plan(
+    CryptoContextHandle ctx,
+    DnaKernel kernel,
+    size_t genome_len,
+    size_t window,
+    DnaLayoutPlan* out_plan
+) {
+    if (!ctx || !out_plan) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        std::vector<uint32_t> accepted;
+        switch (kernel) {
+            case DNA_KERNEL_HAMMING:
+            case DNA_KERNEL_HAMMING_MULTI:
+            case DNA_KERNEL_KMER:
+                accepted = {DNA_LAYOUT_ONE_HOT};
+                break;
+            case DNA_KERNEL_COMPARE:
+                accepted = {DNA_LAYOUT_BASE4, DNA_LAYOUT_CHANNELS, DNA_LAYOUT_ONE_HOT};
+                break;
+            default:
+                set_error("Unknown kernel " + std::to_string(kernel));
+                return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        std::optional<DnaLayoutPlan> best;
+        for (uint32_t kind : accepted) {
+            DnaLayoutPlan plan{};
+            plan.layout.kind = kind;
+            plan.layout.overlap = window > 0 ? static_cast<uint32_t>(window - 1) : 0;
+            if (!complete_dna_layout(ctx->ctx, plan.layout)) continue;
+
+            plan.bases_per_chunk = 2 * static_cast<size_t>(plan.layout.row_bases - plan.layout.overlap);
+            const size_t remaining = genome_len > plan.layout.overlap ? genome_len - plan.layout.overlap : 1;
+            plan.chunks = (remaining + plan.bases_per_chunk - 1) / plan.bases_per_chunk;
+            plan.ciphertexts = plan.chunks * dna_layout_ciphertexts(kind);
+            if (!best || plan.ciphertexts < best->ciphertexts) best = plan;
+        }
+        if (!best) {
+            set_error("Windows of " + std::to_string(window) + " bases do not fit a row");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+        *out_plan = *best;
+    TRY_CATCH_END
+}
+
+namespace {
+
+// Slot values of one chunk in a completed layout, one vector per output
+// ciphertext. Returns the position of an invalid base, or SIZE_MAX.
+size_t dna_layout_values(
+    const CryptoContext<DCRTPoly>& cc,
+    const DnaLayout& chunk,
+    const char* bases,
+    size_t length,
+    std::vector<std::vector<int64_t>>& values
+) {
+    const size_t slots = cc->GetRingDimension();
+    const size_t outputs = dna_layout_ciphertexts(chunk.kind);
+    // Base-4 pads with N so unused slots do not read as A
+    values.assign(outputs, std::vector<int64_t>(slots, chunk.kind == DNA_LAYOUT_BASE4 ? -1 : 0));
+    for (size_t row = 0; row < 2; ++row) {
+        const size_t start = row * (chunk.row_bases - chunk.overlap);
+        for (size_t j = 0; j < chunk.row_bases && start + j < length; ++j) {
+            const int channel = dna_channel(bases[start + j]);
+            if (channel == -2) return start + j;
+            const size_t slot = row * (slots / 2) + j * chunk.stride;
+            switch (chunk.kind) {
+                case DNA_LAYOUT_ONE_HOT:
+                    if (channel >= 0) values[0][slot + static_cast<size_t>(channel)] = 1;
+                    break;
+                case DNA_LAYOUT_CHANNELS:
+                    if (channel >= 0) values[static_cast<size_t>(channel)][slot] = 1;
+                    break;
+                case DNA_LAYOUT_BASE4:
+                    values[0][slot] = channel;
+                    break;
+            }
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Encrypts the slot values of one chunk, tagging each ciphertext with its channel
+void dna_layout_encrypt_values(
+    const CryptoContext<DCRTPoly>& cc,
+    const PublicKey<DCRTPoly>& pk,
+    DnaLayout chunk,
+    const std::vector<std::vector<int64_t>>& values,
+    Ciphertext<DCRTPoly>* out
+) {
+    for (size_t i = 0; i < values.size(); ++i) {
+        out[i] = cc->Encrypt(pk, cc->MakePackedPlaintext(values[i]));
+        chunk.channel = static_cast<uint32_t>(i);
+        set_dna_layout(out[i], chunk);
+    }
+}
+
+}  // namespace
+
+extern "C" OpenfheError dna_layout_encrypt(
+    CryptoContextHandle ctx,
+    PublicKeyHandle pk,
+    const DnaLayout* layout,
+    const char* bases,
+    size_t length,
+    CiphertextHandle* out_cts
+) {
+    if (!ctx || !pk || !layout || (length > 0 && !bases) || !out_cts) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        DnaLayout chunk = *layout;
+        chunk.channel = 0;
+        if (!complete_dna_layout(cc, chunk)) {
+            set_error("Invalid layout kind or overlap");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+        const size_t capacity = 2 * static_cast<size_t>(chunk.row_bases) - chunk.overlap;
+        if (length > capacity) {
+            set_error("Chunk of " + std::to_string(length) + " bases does not fit into " +
+                      std::to_string(capacity));
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        std::vector<std::vector<int64_t>> values;
+        const size_t bad = dna_layout_values(cc, chunk, bases, length, values);
+        if (bad != SIZE_MAX) {
+            set_error("Invalid base at position " + std::to_string(bad));
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        std::vector<Ciphertext<DCRTPoly>> cts(values.size());
+        dna_layout_encrypt_values(cc, pk->key, chunk, values, cts.data());
+        for (size_t i = 0; i < cts.size(); ++i) {
+            out_cts[i] = new OpenfheCiphertext(std::move(cts[i]));
+            out_cts[i]->noise_bits = ctx->noise.fresh(0).bits;
+        }
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError dna_layout_encrypt_batch(
+    CryptoContextHandle ctx,
+    PublicKeyHandle pk,
+    const DnaLayout* layout,
+    const char* bases,
+    size_t length,
+    size_t chunks,
+    CiphertextHandle* out_cts
+) {
+    if (!ctx || !pk || !layout || (length > 0 && !bases) || (chunks > 0 && !out_cts)) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        DnaLayout chunk = *layout;
+        chunk.channel = 0;
+        if (!complete_dna_layout(cc, chunk)) {
+            set_error("Invalid layout kind or overlap");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+        const size_t stride = 2 * static_cast<size_t>(chunk.row_bases - chunk.overlap);
+        const size_t capacity = 2 * static_cast<size_t>(chunk.row_bases) - chunk.overlap;
+        if (chunks > 0 && (chunks - 1) * stride >= length) {
+            set_error(std::to_string(chunks) + " chunks need more than " + std::to_string(length) + " bases");
+            return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        const size_t outputs = dna_layout_ciphertexts(chunk.kind);
+        std::vector<Ciphertext<DCRTPoly>> cts(chunks * outputs);
+        OpenfheError code = parallel_all_or_nothing(chunks, "Chunk", OPENFHE_ERROR_CRYPTO_FAILURE,
+            [&](size_t i, std::string& error) {
+                const size_t start = i * stride;
+                const size_t size = std::min(capacity, length - start);
+                std::vector<std::vector<int64_t>> values;
+                const size_t bad = dna_layout_values(cc, chunk, bases + start, size, values);
+                if (bad != SIZE_MAX) {
+                    error = "invalid base at position " + std::to_string(start + bad);
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                dna_layout_encrypt_values(cc, pk->key, chunk, values, &cts[i * outputs]);
+                return OPENFHE_OK;
+            });
+        if (code != OPENFHE_OK) return code;
+
+        for (size_t i = 0; i < cts.size(); ++i) {
+            out_cts[i] = new OpenfheCiphertext(std::move(cts[i]));
+            out_cts[i]->noise_bits = ctx->noise.fresh(0).bits;
+        }
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError ciphertext_set_key_tag(CiphertextHandle ct, const char* key_tag) {
+    if (!ct || !key_tag) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        ct->mut()->SetKeyTag(key_tag);
+    TRY_CATCH_END
+}
+
+extern "C" bool ciphertext_get_dna_layout(CiphertextHandle ct, DnaLayout* out_layout) {
+    if (!ct || !out_layout) return false;
+    try {
+        auto layout = find_dna_layout(ct->get());
+        if (!layout) return false;
+        *out_layout = *layout;
+        return true;
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return false;
+    }
+}
+
+extern "C" OpenfheError ciphertext_set_dna_layout(CiphertextHandle ct, const DnaLayout* layout) {
+    if (!ct || !layout) return OPENFHE_ERROR_NULL_POINTER;
+    if (layout->kind > DNA_LAYOUT_BASE4 || layout->channel >= kDnaChannels || layout->stride == 0 ||
+        layout->overlap >= layout->row_bases) {
+        set_error("Invalid DNA layout");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+
+    TRY_CATCH_BEGIN
+        set_dna_layout(ct->mut(), *layout);
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError dna_layout_split(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    CiphertextHandle* out_channels
+) {
+    if (!ctx || !ct || !out_channels) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        Ciphertext<DCRTPoly> x = ct->get();
+        DnaLayout layout = dna_layout_of(cc, x);
+
+        const uint32_t kind = layout.kind;
+        std::vector<Ciphertext<DCRTPoly>> channels;
+        switch (layout.kind) {
+            case DNA_LAYOUT_ONE_HOT: channels = split_one_hot(cc, x); break;
+            case DNA_LAYOUT_BASE4: channels = split_base4(cc, x); break;
+            default:
+                set_error("Only one-hot and base-4 ciphertexts can be split");
+                return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        layout.kind = DNA_LAYOUT_CHANNELS;
+        for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+            layout.channel = static_cast<uint32_t>(channel);
+            set_dna_layout(channels[channel], layout);
+        }
+        const auto noises = split_noise(ctx->noise, cc->GetCryptoParameters()->GetPlaintextModulus(),
+                                        ctx->noise.of(*ct), kind);
+        for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+            out_channels[channel] = new OpenfheCiphertext(std::move(channels[channel]));
+            ctx->noise.track(*out_channels[channel], noises[channel]);
+        }
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError dna_layout_merge(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* channels,
+    uint32_t kind,
+    CiphertextHandle* out_ct
+) {
+    if (!ctx || !channels || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        std::array<Ciphertext<DCRTPoly>, kDnaChannels> inputs;
+        std::optional<DnaLayout> layout;
+        for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+            if (!channels[channel]) return OPENFHE_ERROR_NULL_POINTER;
+            inputs[channel] = channels[channel]->get();
+            auto own = find_dna_layout(inputs[channel]);
+            if (!own || own->kind != DNA_LAYOUT_CHANNELS || own->channel != channel ||
+                (layout && (own->stride != layout->stride || own->row_bases != layout->row_bases ||
+                            own->overlap != layout->overlap))) {
+                set_error("Channel " + std::to_string(channel) + " is not part of a channel layout");
+                return OPENFHE_ERROR_INVALID_PARAM;
+            }
+            layout = own;
+        }
+
+        const NoiseModel& noise = ctx->noise;
+        Ciphertext<DCRTPoly> merged;
+        std::optional<Noise> merged_noise;
+        switch (kind) {
+            case DNA_LAYOUT_ONE_HOT:
+                if (layout->stride != kDnaChannels) {
+                    set_error("Dense channels cannot be merged into one-hot");
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                merged = inputs[0];
+                merged_noise = noise.of(*channels[0]);
+                for (size_t channel = 1; channel < kDnaChannels; ++channel) {
+                    merged = cc->EvalAdd(merged, cc->EvalRotate(inputs[channel], -static_cast<int32_t>(channel)));
+                    merged_noise = noise.add(*merged_noise, noise.key_switch(noise.of(*channels[channel])));
+                }
+                break;
+            case DNA_LAYOUT_BASE4:
+                // Channel c contributes c + 1; a base with no channel (N) is -1
+                for (size_t channel = 0; channel < kDnaChannels; ++channel) {
+                    auto term = cc->EvalMult(inputs[channel], static_cast<int64_t>(channel + 1));
+                    merged = merged ? cc->EvalAdd(merged, term) : term;
+                    const Noise term_noise = noise.mult_scalar(noise.of(*channels[channel]), static_cast<int64_t>(channel + 1));
+                    merged_noise = merged_noise ? noise.add(*merged_noise, term_noise) : term_noise;
+                }
+                merged = cc->EvalAdd(merged, constant_plaintext(cc, -1, merged->GetLevel()));
+                merged_noise = noise.add_plaintext(*merged_noise);
+                break;
+            default:
+                set_error("Channels merge into one-hot or base-4 only");
+                return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        layout->kind = kind;
+        layout->channel = 0;
+        set_dna_layout(merged, *layout);
+        *out_ct = new OpenfheCiphertext(std::move(merged));
+        noise.track(**out_ct, *merged_noise);
+    TRY_CATCH_END
+}
+
+// ============================================================================
+// Equality Tests Implementation
+// ============================================================================
+
+namespace {
+
+// Factor in the product tree for x^(t-1)
+template <typename Value>
+struct PowerNode {
+    uint32_t depth;
+    // Ciphertext components minus one: 1 once relinearized
+    uint32_t degree;
+    Value value;
+};
+
+// Multiplies the nodes into one, always combining the two shallowest so the
+// product is no deeper than it has to be. A factor is only relinearized when
+// the degree of the product would exceed `max_degree`, the higher-degree
+// factor first. `multiply(a, b)` returns the unrelinearized product of two
+// values; `relinearize(value, degree)` brings one back to degree 1.
+template <typename Value, typename Multiply, typename Relinearize>
+PowerNode<Value> power_product(
+    std::vector<PowerNode<Value>> nodes,
+    uint32_t max_degree,
+    Multiply multiply,
+    Relinearize relinearize
+) {
+    auto deeper = [](const PowerNode<Value>& a, const PowerNode<Value>& b) { return a.depth > b.depth; };
+    auto pop = [&] {
+        std::pop_heap(nodes.begin(), nodes.end(), deeper);
+        PowerNode<Value> node = std::move(nodes.back());
+        nodes.pop_back();
+        return node;
+    };
+    auto relin = [&](PowerNode<Value>& node) {
+        if (node.degree < 2) return;
+        relinearize(node.value, node.degree);
+        node.degree = 1;
+    };
+
+    std::make_heap(nodes.begin(), nodes.end(), deeper);
+    while (nodes.size() > 1) {
+        PowerNode<Value> a = pop();
+        PowerNode<Value> b = pop();
+        if (a.degree < b.degree) std::swap(a, b);
+        if (a.degree + b.degree > max_degree) relin(a);
+        if (a.degree + b.degree > max_degree) relin(b);
+        nodes.push_back({std::max(a.depth, b.depth) + 1, a.degree + b.degree, multiply(a.value, b.value)});
+        std::push_heap(nodes.begin(), nodes.end(), deeper);
+    }
+    PowerNode<Value> root = pop();
+    relin(root);
+    return root;
+}
+
+// Evaluates x^exponent: squares x up to the highest bit of the exponent and
+// multiplies the squares of its set bits. `square(value)` returns a
+// relinearized square.
+template <typename Value, typename Square, typename Multiply, typename Relinearize>
+PowerNode<Value> eval_power(
+    uint64_t exponent,
+    Value x,
+    uint32_t max_degree,
+    Square square,
+    Multiply multiply,
+    Relinearize relinearize
+) {
+    std::vector<PowerNode<Value>> factors;
+    for (uint32_t bit = 0; (exponent >> bit) != 0; ++bit) {
+        if (bit > 0) x = square(x);
+        if ((exponent >> bit) & 1) factors.push_back({bit, 1, x});
+    }
+    return power_product(std::move(factors), std::max<uint32_t>(max_degree, 2), multiply, relinearize);
+}
+
+EqualityTestCost is_zero_cost(uint64_t plaintext_modulus, uint32_t max_degree) {
+    EqualityTestCost cost{};
+    // Values are irrelevant here; only the operations are counted
+    cost.depth = eval_power(
+        plaintext_modulus - 1, char{0}, max_degree,
+        [&](char value) {
+            ++cost.multiplications;
+            ++cost.key_switches;
+            return value;
+        },
+        [&](char value, char) {
+            ++cost.multiplications;
+            return value;
+        },
+        [&](char&, uint32_t degree) { cost.key_switches += degree - 1; }
+    ).depth;
+    return cost;
+}
+
+uint32_t max_relin_degree(const CryptoContext<DCRTPoly>& cc) {
+    auto params = std::dynamic_pointer_cast<CryptoParametersRNS>(cc->GetCryptoParameters());
+    return params ? params->GetMaxRelinSkDeg() : 2;
+}
+
+// Multiplicative levels `ct` has left before its modulus is used up
+uint32_t levels_left(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& ct) {
+    auto params = std::dynamic_pointer_cast<CryptoParametersRNS>(cc->GetCryptoParameters());
+    // FLEXIBLEAUTOEXT keeps one extra modulus that no level consumes, and an
+    // unrescaled product still holds the modulus of its pending level
+    const uint32_t reserved = (params && params->GetScalingTechnique() == FLEXIBLEAUTOEXT ? 1 : 0) + ct->GetNoiseScaleDeg();
+    const uint32_t towers = ct->GetElements()[0].GetNumOfElements();
+    return towers > reserved ? towers - reserved : 0;
+}
+
+// 1 - x^(t-1), after checking that `x` has the levels for it
+OpenfheError eval_is_zero_checked(
+    const OpenfheCryptoContext& ctx,
+    const Ciphertext<DCRTPoly>& x,
+    Noise x_noise,
+    CiphertextHandle* out_ct
+) {
+    const CryptoContext<DCRTPoly>& cc = ctx.ctx;
+    const uint64_t t = cc->GetCryptoParameters()->GetPlaintextModulus();
+    const uint32_t max_degree = max_relin_degree(cc);
+    const EqualityTestCost cost = is_zero_cost(t, max_degree);
+    const uint32_t levels = levels_left(cc, x);
+    if (levels < cost.depth) {
+        set_error("Equality test needs depth " + std::to_string(cost.depth) +
+                  " for plaintext modulus " + std::to_string(t) + ", the ciphertext has " +
+                  std::to_string(levels) + " levels left");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+
+    Ciphertext<DCRTPoly> power = eval_power(
+        t - 1, x, max_degree,
+        [&](const Ciphertext<DCRTPoly>& value) { return cc->EvalSquare(value); },
+        [&](const Ciphertext<DCRTPoly>& a, const Ciphertext<DCRTPoly>& b) { return cc->EvalMultNoRelin(a, b); },
+        [&](Ciphertext<DCRTPoly>& value, uint32_t) { value = cc->Relinearize(value); }
+    ).value;
+
+    // The same power tree, evaluated on noise bounds
+    const NoiseModel& noise = ctx.noise;
+    const Noise power_noise = eval_power(
+        t - 1, x_noise, max_degree,
+        [&](Noise value) { return noise.key_switch(noise.mult(value, value)); },
+        [&](Noise a, Noise b) { return noise.mult(a, b); },
+        [&](Noise& value, uint32_t degree) {
+            for (uint32_t d = 1; d < degree; ++d) value = noise.key_switch(value);
+        }
+    ).value;
+
+    std::vector<int64_t> ones(cc->GetRingDimension(), 1);
+    *out_ct = new OpenfheCiphertext(
+        cc->EvalAdd(cc->EvalNegate(power), cc->MakePackedPlaintext(ones, 1, power->GetLevel())));
+    noise.track(**out_ct, noise.add_plaintext(power_noise));
+    return OPENFHE_OK;
+}
+
+}  // namespace
+
+extern "C" OpenfheError eval_is_zero_cost(
+    uint64_t plaintext_modulus,
+    uint32_t max_relin_sk_deg,
+    EqualityTestCost* out_cost
+) {
+    if (!out_cost) return OPENFHE_ERROR_NULL_POINTER;
+    if (plaintext_modulus < 2) {
+        set_error("Plaintext modulus must be a prime");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+    *out_cost = is_zero_cost(plaintext_modulus, max_relin_sk_deg);
+    return OPENFHE_OK;
+}
+
+extern "C" OpenfheError eval_is_zero(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    CiphertextHandle* out_ct
+) {
+    if (!ctx || !ct || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        return eval_is_zero_checked(*ctx, ct->get(), ctx->noise.of(*ct), out_ct);
+    TRY_CATCH_END
+}
+
+extern "C" OpenfheError eval_equal(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct1,
+    CiphertextHandle ct2,
+    CiphertextHandle* out_ct
+) {
+    if (!ctx || !ct1 || !ct2 || !out_ct) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        return eval_is_zero_checked(*ctx, ctx->ctx->EvalSub(ct1->get(), ct2->get()),
+                                    ctx->noise.add(ctx->noise.of(*ct1), ctx->noise.of(*ct2)), out_ct);
+    TRY_CATCH_END
+}
+
+// ============================================================================
+// Cost Model Implementation
+// ============================================================================
+
+namespace {
+
+bool op_key_switches(FheOp op) {
+    return op == FHE_OP_MULT || op == FHE_OP_ROTATE || op == FHE_OP_ROTATE_PRECOMPUTE || op == FHE_OP_FAST_ROTATE;
+}
+
+// What the cost of `op` is proportional to
+double op_units(FheOp op, uint32_t ring_dim, uint32_t towers) {
+    const double units = static_cast<double>(ring_dim) * towers;
+    return op_key_switches(op) ? units * towers : units;
+}
+
+uint64_t thread_cpu_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// CPU time of one call of `fn`, averaged over `iterations` calls after a
+// warm-up call
+template <typename Fn>
+double cpu_ns_per_call(uint32_t iterations, Fn fn) {
+    fn();
+    const uint64_t start = thread_cpu_ns();
+    for (uint32_t i = 0; i < iterations; ++i) fn();
+    return static_cast<double>(thread_cpu_ns() - start) / iterations;
+}
+
+// Towers of a fresh ciphertext
+uint32_t fresh_towers(const CryptoContext<DCRTPoly>& cc) {
+    return static_cast<uint32_t>(cc->GetElementParams()->GetParams().size());
+}
+
+// Towers left after `depth` rescalings
+uint32_t towers_after(uint32_t towers, uint32_t depth) {
+    return towers > depth ? towers - depth : 1;
+}
+
+// Sums the predicted time of a kernel's operations
+struct CostTally {
+    const FheCostModel* model;
+    uint32_t ring_dim;
+    double ns = 0;
+
+    void add(FheOp op, double count, uint32_t towers) {
+        ns += count * fhe_cost_op_ns(model, op, ring_dim, towers);
+    }
+};
+
+}  // namespace
+
+extern "C" OpenfheError fhe_cost_model_calibrate(
+    CryptoContextHandle ctx,
+    uint32_t iterations,
+    FheCostModel* out_model
+) {
+    if (!ctx || !out_model) return OPENFHE_ERROR_NULL_POINTER;
+    if (iterations == 0) {
+        set_error("Calibration needs at least one iteration");
+        return OPENFHE_ERROR_INVALID_PARAM;
+    }
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        auto kp = cc->KeyGen();
+        if (!kp.good()) {
+            set_error("Key generation failed");
+            return OPENFHE_ERROR_CRYPTO_FAILURE;
+        }
+        // The throwaway keys must not outlive the calibration
+        struct KeyCleanup {
+            std::string tag;
+            ~KeyCleanup() {
+                CryptoContextImpl<DCRTPoly>::ClearEvalMultKeys(tag);
+                CryptoContextImpl<DCRTPoly>::ClearEvalAutomorphismKeys(tag);
+            }
+        } cleanup{kp.secretKey->GetKeyTag()};
+        cc->EvalMultKeyGen(kp.secretKey);
+        cc->EvalRotateKeyGen(kp.secretKey, {1});
+
+        const uint32_t ring_dim = cc->GetRingDimension();
+        std::vector<int64_t> values(ring_dim);
+        for (size_t i = 0; i < values.size(); ++i) values[i] = static_cast<int64_t>(i % kDnaChannels);
+        auto pt = cc->MakePackedPlaintext(values);
+        auto a = cc->Encrypt(kp.publicKey, pt);
+        auto b = cc->Encrypt(kp.publicKey, pt);
+        const uint32_t towers = a->GetElements()[0].GetNumOfElements();
+        const uint32_t m = cc->GetCyclotomicOrder();
+
+        std::stringstream blob;
+        Serial::Serialize(a, blob, SerType::BINARY);
+        const std::string bytes = blob.str();
+
+        FheCostModel model{};
+        model.ring_dim = ring_dim;
+        model.towers = towers;
+        std::array<double, FHE_OP_COUNT> ns{};
+        std::exception_ptr failure;
+
+        // One thread, like an iteration of the kernels' parallel loops: the
+        // operations' own loops run serially inside it, so the thread's CPU
+        // time is the whole cost
+        #pragma omp parallel num_threads(1)
+        {
+            try {
+                auto precomp = cc->EvalFastRotationPrecompute(a);
+                double precompute_bytes = 0;
+                for (const auto& poly : *precomp) {
+                    precompute_bytes += static_cast<double>(poly.GetNumOfElements()) * poly.GetRingDimension() * sizeof(uint64_t);
+                }
+                model.precompute_ciphertexts = precompute_bytes / static_cast<double>(fhe_ciphertext_bytes(ring_dim, towers));
+
+                ns[FHE_OP_ADD] = cpu_ns_per_call(iterations, [&] { cc->EvalAdd(a, b); });
+                ns[FHE_OP_MULT_PLAIN] = cpu_ns_per_call(iterations, [&] { cc->EvalMult(a, pt); });
+                ns[FHE_OP_MULT] = cpu_ns_per_call(iterations, [&] { cc->EvalMult(a, b); });
+                ns[FHE_OP_ROTATE] = cpu_ns_per_call(iterations, [&] { cc->EvalRotate(a, 1); });
+                ns[FHE_OP_ROTATE_PRECOMPUTE] = cpu_ns_per_call(iterations, [&] { cc->EvalFastRotationPrecompute(a); });
+                ns[FHE_OP_FAST_ROTATE] = cpu_ns_per_call(iterations, [&] { cc->EvalFastRotation(a, 1, m, precomp); });
+                ns[FHE_OP_ENCRYPT] = cpu_ns_per_call(iterations, [&] { cc->Encrypt(kp.publicKey, pt); });
+                ns[FHE_OP_DESERIALIZE] = cpu_ns_per_call(iterations, [&] {
+                    std::istringstream in(bytes);
+                    Ciphertext<DCRTPoly> ct;
+                    Serial::Deserialize(ct, in, SerType::BINARY);
+                });
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        }
+        if (failure) std::rethrow_exception(failure);
+
+        for (size_t op = 0; op < FHE_OP_COUNT; ++op) {
+            model.ns_per_unit[op] = ns[op] / op_units(static_cast<FheOp>(op), ring_dim, towers);
+        }
+        *out_model = model;
+    TRY_CATCH_END
+}
+
+extern "C" double fhe_cost_op_ns(const FheCostModel* model, FheOp op, uint32_t ring_dim, uint32_t towers) {
+    if (!model || static_cast<unsigned>(op) >= FHE_OP_COUNT) return 0;
+    return model->ns_per_unit[op] * op_units(op, ring_dim, towers);
+}
+
+extern "C" uint64_t fhe_ciphertext_bytes(uint32_t ring_dim, uint32_t towers) {
+    return 2ull * ring_dim * towers * sizeof(uint64_t);
+}
+
+extern "C" OpenfheError dna_kernel_cost(
+    CryptoContextHandle ctx,
+    const FheCostModel* model,
+    DnaKernel kernel,
+    size_t chunks,
+    size_t window,
+    size_t patterns,
+    FheCostEstimate* out_estimate
+) {
+    if (!ctx || !model || !out_estimate) return OPENFHE_ERROR_NULL_POINTER;
+
+    TRY_CATCH_BEGIN
+        const CryptoContext<DCRTPoly>& cc = ctx->ctx;
+        const uint32_t ring_dim = cc->GetRingDimension();
+        const uint32_t towers = fresh_towers(cc);
+        const double ct_bytes = static_cast<double>(fhe_ciphertext_bytes(ring_dim, towers));
+        const double precompute_bytes = model->precompute_ciphertexts * ct_bytes;
+        const double n = static_cast<double>(chunks);
+        // Chunks run in parallel, one working set per thread
+        const double threads = static_cast<double>(
+            std::min<size_t>(static_cast<size_t>(std::max(omp_get_max_threads(), 1)), std::max<size_t>(chunks, 1)));
+
+        CostTally tally{model, ring_dim};
+        double chunk_bytes = 0;   // inputs and outputs of one chunk
+        double shared_bytes = 0;  // accumulators over all chunks
+        double thread_bytes = 0;  // working set while a chunk is processed
+
+        switch (kernel) {
+            case DNA_KERNEL_HAMMING: {
+                if (window == 0) {
+                    set_error("Pattern length must be at least 1");
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                const double p = static_cast<double>(window);
+                tally.add(FHE_OP_ROTATE_PRECOMPUTE, n, towers);
+                tally.add(FHE_OP_FAST_ROTATE, n * (p - 1), towers);
+                tally.add(FHE_OP_MULT_PLAIN, n * std::min(p, 4.0), towers);
+                tally.add(FHE_OP_ROTATE, n * 2, towers);
+                tally.add(FHE_OP_ADD, n * (p + 3), towers);
+                chunk_bytes = 2 * ct_bytes;
+                thread_bytes = 4 * ct_bytes + precompute_bytes;
+                break;
+            }
+            case DNA_KERNEL_HAMMING_MULTI: {
+                if (window == 0 || patterns == 0) {
+                    set_error("Need at least one pattern of at least one base");
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                const double p = static_cast<double>(window);
+                // Rotated channel terms are shared once the panel covers every
+                // (channel, lane) pair
+                const double rotations = std::min(static_cast<double>(patterns) * p, 16 * p);
+                const double outputs = static_cast<double>(dna_hamming_multi_outputs(patterns));
+                tally.add(FHE_OP_MULT_PLAIN, n * kDnaChannels, towers);
+                tally.add(FHE_OP_ROTATE_PRECOMPUTE, n * kDnaChannels, towers_after(towers, 1));
+                tally.add(FHE_OP_FAST_ROTATE, n * rotations, towers_after(towers, 1));
+                tally.add(FHE_OP_ADD, n * (static_cast<double>(patterns) * p + outputs), towers_after(towers, 1));
+                chunk_bytes = (1 + outputs) * ct_bytes;
+                thread_bytes = (kDnaChannels + rotations) * ct_bytes + kDnaChannels * precompute_bytes;
+                break;
+            }
+            case DNA_KERNEL_KMER: {
+                const uint32_t k = static_cast<uint32_t>(std::min<size_t>(window, OPENFHE_KMER_MAX_K + 1));
+                const size_t outputs = dna_kmer_histogram_outputs(k);
+                if (outputs == 0) {
+                    set_error("k must be between 1 and " + std::to_string(OPENFHE_KMER_MAX_K));
+                    return OPENFHE_ERROR_INVALID_PARAM;
+                }
+                const double kmers = static_cast<double>(outputs * kDnaChannels);
+                // Each of the k shifts of the sequence is rotated into its
+                // four channels once, the unshifted first channel for free
+                const double rotations = static_cast<double>(kDnaChannels * k - 1);
+                for (uint32_t t = 1; t + 1 < k; ++t) {
+                    tally.add(FHE_OP_MULT, n * std::pow(4.0, t + 1), towers_after(towers, t));
+                }
+                if (k > 1) tally.add(FHE_OP_MULT, n * kmers, towers_after(towers, k - 1));
+                tally.add(FHE_OP_ROTATE_PRECOMPUTE, n, towers);
+                tally.add(FHE_OP_FAST_ROTATE, n * rotations, towers);
+                tally.add(FHE_OP_MULT_PLAIN, n * kDnaChannels, towers);
+                tally.add(FHE_OP_ADD, n * kmers, towers_after(towers, k));
+
+                // Lane packing and row reduction run once per output
+                const double reduce = static_cast<double>(kDnaChannels - 1 + kmer_reduce_rotations(ring_dim).size());
+                tally.add(FHE_OP_ROTATE, static_cast<double>(outputs) * reduce, towers_after(towers, k));
+                tally.add(FHE_OP_ADD, static_cast<double>(outputs) * reduce, towers_after(towers, k));
+                chunk_bytes = ct_bytes;
+                shared_bytes = kmers * ct_bytes;
+                // Indicators, the longest prefixes, the masked last shift and
+                // the shift being multiplied in
+                thread_bytes = (kmers + kmers / kDnaChannels + 2 * kDnaChannels) * ct_bytes + precompute_bytes;
+                break;
+            }
+            case DNA_KERNEL_COMPARE: {
+                const uint64_t t = cc->GetCryptoParameters()->GetPlaintextModulus();
+                const EqualityTestCost cost = is_zero_cost(t, max_relin_degree(cc));
+                // Levels drop along the power tree; price it at the middle one
+                tally.add(FHE_OP_MULT, n * cost.multiplications, towers_after(towers, cost.depth / 2));
+                tally.add(FHE_OP_ADD, n * 3, towers);
+                chunk_bytes = 3 * ct_bytes;
+                thread_bytes = (cost.depth + 2) * ct_bytes;
+                break;
+            }
+            default:
+                set_error("Unknown kernel " + std::to_string(static_cast<int>(kernel)));
+                return OPENFHE_ERROR_INVALID_PARAM;
+        }
+
+        out_estimate->cpu_ns = static_cast<uint64_t>(tally.ns);
+        out_estimate->peak_bytes = static_cast<uint64_t>(n * chunk_bytes + shared_bytes + threads * thread_bytes);
+    TRY_CATCH_END
+}
+
+// ============================================================================
+// Ciphertext Management Implementation
+// ============================================================================
+
+extern "C" CiphertextHandle ciphertext_clone(CiphertextHandle ct) {
+    if (!ct) return nullptr;
+    try {
+        if (auto source = lazy_clone_source(ct)) return new OpenfheCiphertext(std::move(source));
+        // Shares the polynomials; the first in-place write copies them
+        auto shared = new OpenfheCiphertext(ct->get());
+        shared->noise_bits = ct->noise_bits;
+        g_cow_shared_clones.fetch_add(1, std::memory_order_relaxed);
+        return shared;
+    } catch (const std::exception& e) {
+        set_error(e.what());
+        return nullptr;
+    }
+}
+
+extern "C" void ciphertext_destroy(CiphertextHandle ct) {
+    delete ct;
+}
+
+extern "C" bool ciphertext_is_shared(CiphertextHandle ct) {
+    if (!ct) return false;
+    std::lock_guard lock(ct->mutex);
+    return ct->ct && ct->ct.use_count() > 1;
+}
+
+extern "C" void ciphertext_get_cow_stats(CiphertextCowStats* out_stats) {
+    if (!out_stats) return;
+    out_stats->shared_clones = g_cow_shared_clones.load(std::memory_order_relaxed);
+    out_stats->copies = g_cow_copies.load(std::memory_order_relaxed);
+    out_stats->copied_bytes = g_cow_copied_bytes.load(std::memory_order_relaxed);
 }
@@ -20,12 +20,18 @@ typedef enum {
     OPENFHE_ERROR_CRYPTO_FAILURE = -3,
     OPENFHE_ERROR_SERIALIZATION = -4,
     OPENFHE_ERROR_KEY_NOT_FOUND = -5,
+    OPENFHE_ERROR_ABORTED = -6,
     OPENFHE_ERROR_INTERNAL = -99
 } OpenfheError;
 
 // Get last error message (thread-local)
 const char* openfhe_get_last_error(void);
 
+// CPU level this library was compiled for ("x86-64-v3", "x86-64-v4", ...),
+// or "default" for a build without -Dcpu-variants. With variants the dynamic
+// loader picks the best one the CPU supports from glibc-hwcaps/.
+const char* openfhe_c_build_variant(void);
+
 // ============================================================================
 // Opaque Pointer Types
 // ============================================================================
@@ -36,6 +42,9 @@ typedef struct OpenfhePublicKey* PublicKeyHandle;
 typedef struct OpenfhePrivateKey* PrivateKeyHandle;
 typedef struct OpenfheCiphertext* CiphertextHandle;
 typedef struct OpenfhePlaintext* PlaintextHandle;
+typedef struct OpenfheCiphertextStream* CiphertextStreamHandle;
+typedef struct OpenfheSegmentStore* SegmentStoreHandle;
+typedef struct OpenfheZeroPool* ZeroPoolHandle;
 
 // ============================================================================
 // BGV Context Creation Parameters
@@ -319,6 +328,58 @@ OpenfheError mod_reduce_inplace(
 
 uint32_t ciphertext_get_level(CiphertextHandle ct);
 
+// Replace the key tag under which evaluation keys are looked up
+OpenfheError ciphertext_set_key_tag(CiphertextHandle ct, const char* key_tag);
+
+// ============================================================================
+// Noise Estimation
+// ============================================================================
+
+// Noise of a ciphertext: a bound on the coefficients of m + t*e, the value
+// decryption recovers modulo the ciphertext modulus Q. Decryption is correct
+// while the budget is positive.
+typedef struct {
+    double noise_bits;    // log2 of the noise bound
+    double modulus_bits;  // log2 of Q
+    double budget_bits;   // modulus_bits - 1 - noise_bits
+    uint32_t towers;      // RNS moduli in Q
+    // 1 if the bound was tracked through the operations that produced the
+    // ciphertext; 0 if its history is unknown (deserialized, bootstrapped)
+    // and it is taken to be a fresh encryption
+    int32_t tracked;
+} NoiseEstimate;
+
+// Analytic estimate, tracked per handle through encryption, the eval_*
+// operations and the DNA kernels. It is not serialized.
+OpenfheError ciphertext_noise_estimate(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    NoiseEstimate* out_estimate
+);
+
+// RNS moduli `ct` could drop from the top of its modulus, without
+// rescaling, while keeping an estimated budget of `min_budget_bits`.
+// Always 0 for handles whose noise is not tracked (see NoiseEstimate).
+OpenfheError ciphertext_noise_droppable_towers(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    double min_budget_bits,
+    uint32_t* out_towers
+);
+
+// True if this build can measure noise with the secret key (compiled with
+// OPENFHE_C_EXACT_NOISE, `zig build -Dexact-noise=true`)
+bool openfhe_c_has_exact_noise(void);
+
+// Exact noise of `ct` under `sk`: the largest coefficient of m + t*e.
+// OPENFHE_ERROR_INVALID_PARAM in builds without OPENFHE_C_EXACT_NOISE.
+OpenfheError ciphertext_noise_measure(
+    CryptoContextHandle ctx,
+    PrivateKeyHandle sk,
+    CiphertextHandle ct,
+    NoiseEstimate* out_measurement
+);
+
 // ============================================================================
 // Bootstrapping (BGV)
 // ============================================================================
@@ -354,6 +415,9 @@ typedef enum {
     SERIAL_JSON = 1
 } SerialFormat;
 
+// Deserializers read `data` in place without copying it; the buffer only has
+// to stay valid for the duration of the call.
+
 // Context serialization
 OpenfheError crypto_context_serialize(
     CryptoContextHandle ctx,
@@ -384,6 +448,11 @@ OpenfheError public_key_deserialize(
     PublicKeyHandle* out_pk
 );
 
+// OPENFHE_ERROR_INVALID_PARAM unless `pk` was generated under the parameters
+// of `ctx`. Deserializing accepts keys of any parameter set, so keys from
+// clients must pass this before they are used with `ctx`.
+OpenfheError public_key_check_context(CryptoContextHandle ctx, PublicKeyHandle pk);
+
 // Private key serialization
 OpenfheError private_key_serialize(
     PrivateKeyHandle sk,
@@ -447,13 +516,723 @@ OpenfheError eval_automorphism_keys_deserialize(
 // Free serialized data
 void serialized_data_free(uint8_t* data);
 
+// ============================================================================
+// Evaluation Key Management
+// ============================================================================
+
+// Evaluation keys live in the context under the tag of the key pair they were
+// generated from, which is also the tag of its public key. Writes at most
+// `capacity` bytes of the tag (not terminated) and its full length to `out_len`.
+OpenfheError public_key_get_tag(
+    PublicKeyHandle pk,
+    char* out,
+    size_t capacity,
+    size_t* out_len
+);
+
+// Same as eval_mult_keys_deserialize / eval_automorphism_keys_deserialize, but
+// the blob is rejected with OPENFHE_ERROR_INVALID_PARAM unless every key in it
+// carries `key_tag` and belongs to `ctx`. Nothing is registered on failure.
+// The keys are registered under `register_tag` instead of their own tag, so
+// two owners of the same key pair never share or clear each other's keys;
+// evaluate on ciphertexts retagged with ciphertext_set_key_tag.
+OpenfheError eval_mult_keys_deserialize_tagged(
+    CryptoContextHandle ctx,
+    const uint8_t* data,
+    size_t size,
+    SerialFormat format,
+    const char* key_tag,
+    const char* register_tag
+);
+
+OpenfheError eval_automorphism_keys_deserialize_tagged(
+    CryptoContextHandle ctx,
+    const uint8_t* data,
+    size_t size,
+    SerialFormat format,
+    const char* key_tag,
+    const char* register_tag
+);
+
+// Remove the multiplication and automorphism keys registered under `key_tag`
+OpenfheError eval_keys_clear(CryptoContextHandle ctx, const char* key_tag);
+
+// Receives serialized bytes in order, in blocks of at most 64 KiB.
+// Return 0 to continue, non-zero to abort with OPENFHE_ERROR_ABORTED.
+typedef int (*OpenfheWriteFn)(void* user_ctx, const uint8_t* data, size_t size);
+
+// Serialize a ciphertext straight into `write_fn` without materializing the
+// whole encoding in memory
+OpenfheError ciphertext_serialize_to(
+    CiphertextHandle ct,
+    SerialFormat format,
+    OpenfheWriteFn write_fn,
+    void* user_ctx
+);
+
+// ============================================================================
+// Streaming Ciphertext Decoding
+// ============================================================================
+
+// Stream format: a sequence of frames, each a uint32 little-endian length
+// followed by that many bytes of one serialized ciphertext. Chunks may split
+// frames anywhere; at most one frame is buffered at a time.
+
+// Called once per decoded ciphertext. `frame` is only valid during the call.
+// The callee takes ownership of `ct` whatever it returns. Return 0 to keep
+// going, non-zero to abort the stream with OPENFHE_ERROR_ABORTED.
+typedef int (*CiphertextSinkFn)(
+    void* user_ctx,
+    const uint8_t* frame,
+    size_t frame_size,
+    CiphertextHandle ct
+);
+
+// Frames longer than `max_frame_size` are rejected with OPENFHE_ERROR_INVALID_PARAM
+OpenfheError ciphertext_stream_create(
+    CryptoContextHandle ctx,
+    SerialFormat format,
+    size_t max_frame_size,
+    CiphertextStreamHandle* out_stream
+);
+
+// Decode as many frames as `data` completes and hand each to `sink`.
+// After an error the stream is unusable and every further call fails.
+OpenfheError ciphertext_stream_feed(
+    CiphertextStreamHandle stream,
+    const uint8_t* data,
+    size_t size,
+    CiphertextSinkFn sink,
+    void* user_ctx
+);
+
+// Fails with OPENFHE_ERROR_SERIALIZATION if the input ended mid-frame
+OpenfheError ciphertext_stream_finish(CiphertextStreamHandle stream);
+
+// Number of ciphertexts decoded so far
+uint64_t ciphertext_stream_get_count(CiphertextStreamHandle stream);
+
+void ciphertext_stream_destroy(CiphertextStreamHandle stream);
+
+// ============================================================================
+// Batch Ciphertext Decoding
+// ============================================================================
+
+// One serialized object in caller memory
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+} OpenfheSpan;
+
+// Pass as `level` to accept ciphertexts at any level
+#define OPENFHE_ANY_LEVEL UINT32_MAX
+
+// Deserialize `count` independent ciphertexts concurrently on the OpenMP
+// thread pool. Every ciphertext must belong to `ctx` and sit at `level`.
+// All or nothing: on failure no handle is returned and the error message
+// names the first bad span (OPENFHE_ERROR_SERIALIZATION for undecodable
+// data, OPENFHE_ERROR_INVALID_PARAM for a context or level mismatch).
+OpenfheError ciphertext_deserialize_batch(
+    CryptoContextHandle ctx,
+    const OpenfheSpan* spans,
+    size_t count,
+    SerialFormat format,
+    uint32_t level,
+    CiphertextHandle* out_cts
+);
+
+// ============================================================================
+// Segment Store
+// ============================================================================
+
+// Append-only on-disk store for serialized objects, keyed by a 16-byte
+// session id and a 64-bit object id. Records are appended to segment files
+// that are memory-mapped for reading; the index is rebuilt from the segments
+// on open. Deletions append tombstones and are reclaimed by compaction.
+
+typedef struct {
+    uint64_t live_objects;
+    uint64_t live_bytes;    // record headers + payloads still reachable
+    uint64_t dead_bytes;    // overwritten, deleted and tombstone records
+    uint32_t segments;
+} SegmentStoreStats;
+
+// Open or create the store in `dir`. New segments are started once the active
+// one reaches `segment_size` bytes (0 selects 256 MiB).
+OpenfheError segment_store_open(
+    const char* dir,
+    uint64_t segment_size,
+    SegmentStoreHandle* out_store
+);
+
+// Store `data` under (session_id, object_id), replacing any previous object
+OpenfheError segment_store_put(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    const uint8_t* data,
+    size_t size
+);
+
+// Zero-copy view of a stored object inside the segment mapping. The view
+// stays valid until segment_store_compact or segment_store_close.
+// Returns OPENFHE_ERROR_KEY_NOT_FOUND for unknown objects.
+OpenfheError segment_store_get(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    const uint8_t** out_data,
+    size_t* out_size
+);
+
+// Deserialize a stored ciphertext straight from the mapping
+OpenfheError segment_store_load_ciphertext(
+    SegmentStoreHandle store,
+    CryptoContextHandle ctx,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    SerialFormat format,
+    CiphertextHandle* out_ct
+);
+
+// Object ids of the session in ascending order. Writes at most `max_ids`
+// ids and reports the total number in `out_count`.
+OpenfheError segment_store_list(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t* out_ids,
+    size_t max_ids,
+    size_t* out_count
+);
+
+OpenfheError segment_store_delete(
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id
+);
+
+OpenfheError segment_store_delete_session(
+    SegmentStoreHandle store,
+    const uint8_t* session_id
+);
+
+// Rewrite the live records of every segment holding dead bytes and remove
+// the old segment files. Invalidates all views returned by segment_store_get.
+OpenfheError segment_store_compact(SegmentStoreHandle store);
+
+// Compact only the oldest segment holding dead bytes, so the work can be
+// spread over short steps. Invalidates the views into that segment;
+// `out_more` reports whether other segments still hold dead bytes.
+OpenfheError segment_store_compact_step(SegmentStoreHandle store, bool* out_more);
+
+// Flush appended records to disk
+OpenfheError segment_store_sync(SegmentStoreHandle store);
+
+void segment_store_get_stats(SegmentStoreHandle store, SegmentStoreStats* out_stats);
+
+void segment_store_close(SegmentStoreHandle store);
+
+// ============================================================================
+// Lazy Ciphertexts
+// ============================================================================
+
+// A lazy handle keeps only the location of a serialized ciphertext and decodes
+// the polynomials the first time an operation reads it. It works with every
+// function taking a CiphertextHandle; decoding errors are reported by the
+// operation that triggered them. Once modified in place it becomes an ordinary
+// handle. Until then its polynomials may be dropped again (see
+// ciphertext_evict and ciphertext_set_lazy_budget) and are decoded anew when
+// next read.
+
+// Lazy handle over borrowed bytes, which must stay valid and unchanged for
+// the lifetime of the handle and its clones
+OpenfheError ciphertext_lazy_from_span(
+    CryptoContextHandle ctx,
+    const uint8_t* data,
+    size_t size,
+    SerialFormat format,
+    CiphertextHandle* out_ct
+);
+
+// Lazy handle over an object in a segment store, which must outlive the
+// handle. Returns OPENFHE_ERROR_KEY_NOT_FOUND for unknown objects.
+OpenfheError ciphertext_lazy_from_store(
+    CryptoContextHandle ctx,
+    SegmentStoreHandle store,
+    const uint8_t* session_id,
+    uint64_t object_id,
+    SerialFormat format,
+    CiphertextHandle* out_ct
+);
+
+bool ciphertext_is_lazy(CiphertextHandle ct);
+
+// False only for lazy handles whose polynomials are not in memory
+bool ciphertext_is_materialized(CiphertextHandle ct);
+
+// Drop the polynomials of an unmodified lazy handle. Returns false if there
+// was nothing to drop.
+bool ciphertext_evict(CiphertextHandle ct);
+
+// Upper bound, in serialized bytes, for all materialized lazy handles. The
+// least recently used ones are evicted beyond it; 0 (the default) disables it.
+void ciphertext_set_lazy_budget(size_t bytes);
+
+size_t ciphertext_get_lazy_resident_bytes(void);
+
+// ============================================================================
+// Context Snapshots
+// ============================================================================
+
+// A snapshot is a versioned file holding a serialized context (including any
+// bootstrap precomputations from eval_bootstrap_setup) together with the
+// OpenFHE version that wrote it and a checksum of the payload.
+#define OPENFHE_SNAPSHOT_VERSION 1
+
+// Write the snapshot to a temporary file next to `path`, sync it and rename
+// it into place, so readers never observe a partial snapshot
+OpenfheError crypto_context_snapshot_save(CryptoContextHandle ctx, const char* path);
+
+// Restore a context from a snapshot, deserializing from a read-only mapping
+// of the file. Fails with OPENFHE_ERROR_INVALID_PARAM if the file was written
+// by another snapshot format or OpenFHE version, and with
+// OPENFHE_ERROR_SERIALIZATION if it is truncated or corrupt.
+OpenfheError crypto_context_snapshot_load(const char* path, CryptoContextHandle* out_ctx);
+
+// ============================================================================
+// Zero-Encryption Pools
+// ============================================================================
+
+// Re-randomizing a result before it leaves the server hides everything about
+// how it was computed: adding a fresh encryption of zero under the owner's
+// public key leaves the plaintext unchanged but replaces its randomness. A
+// pool keeps such encryptions ready, filled by a background thread that runs
+// with idle scheduling priority, so consumers only pay for an addition.
+
+typedef struct {
+    size_t capacity;
+    size_t available;
+    uint64_t served;    // re-randomizations using a pooled encryption
+    uint64_t misses;    // re-randomizations that had to encrypt inline
+} ZeroPoolStats;
+
+// Create a pool of up to `capacity` encryptions of zero under `pk`. One
+// idle-priority thread shared by all pools in the process fills them in turn.
+// The pool keeps its own references to the context and the key.
+OpenfheError zero_pool_create(
+    CryptoContextHandle ctx,
+    PublicKeyHandle pk,
+    size_t capacity,
+    ZeroPoolHandle* out_pool
+);
+
+// Add a fresh encryption of zero to `ct` in place. Uses a pooled encryption
+// when one is ready and encrypts inline otherwise. Fails with
+// OPENFHE_ERROR_INVALID_PARAM if `ct` is not encrypted under the pool's key.
+OpenfheError ciphertext_rerandomize(CiphertextHandle ct, ZeroPoolHandle pool);
+
+void zero_pool_get_stats(ZeroPoolHandle pool, ZeroPoolStats* out_stats);
+
+// Raise the pool's capacity to at least `capacity`, e.g. to the number of
+// results a session downloads at once; the refill thread tops it up
+void zero_pool_reserve(ZeroPoolHandle pool, size_t capacity);
+
+// Bytes all pools of the process may hold together; refilling pauses at the
+// limit. 0 selects the default of 256 MiB.
+void zero_pool_set_budget(size_t bytes);
+
+// Bytes currently held by all pools of the process
+size_t zero_pool_get_pooled_bytes(void);
+
+// Waits for at most one encryption in progress for the pool
+void zero_pool_destroy(ZeroPoolHandle pool);
+
+// ============================================================================
+// DNA Kernels
+// ============================================================================
+
+// Sequences are one-hot packed: base i of a chunk occupies slots 4i..4i+3
+// (channels A, C, G, T), holding 1 in the channel of its base and 0 in the
+// others. Rotations are cyclic within each half of the slot vector, so a
+// ciphertext holds two rows of ring_dim / 8 bases each. The kernels reject
+// ciphertexts tagged with any other layout (see DNA Slot Layouts).
+
+// Encode `length` bases (A, C, G, T in either case; N for an unknown base,
+// which matches nothing) starting at slot 0
+OpenfheError make_dna_plaintext(
+    CryptoContextHandle ctx,
+    const char* bases,
+    size_t length,
+    PlaintextHandle* out_pt
+);
+
+// Rotation indices whose keys dna_hamming_scan needs for a pattern of
+// `pattern_len` bases. Writes at most `capacity` of them to `out_indices`
+// and returns the total count.
+size_t dna_hamming_scan_rotations(size_t pattern_len, int32_t* out_indices, size_t capacity);
+
+// For each one-hot packed sequence ciphertext, compute the number of
+// mismatches between `pattern` (A, C, G, T) and the window starting at every
+// base. The profile comes back packed: slot 4j holds the distance for the
+// window at base j; the other slots hold partial sums. Positions past the end
+// of the encoded bases count as mismatches. Windows that wrap around the end
+// of a row (j > row_bases - pattern_len in either row) are not meaningful,
+// so chunks should overlap by pattern_len - 1 bases.
+//
+// The pattern's rotations of each sequence share one hoisted decomposition.
+// Sequences are processed concurrently on the OpenMP thread pool; on failure
+// no profile is returned.
+OpenfheError dna_hamming_scan(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    const char* pattern,
+    size_t pattern_len,
+    CiphertextHandle* out_profiles
+);
+
+// Search a panel of patterns in one pass. Each sequence is split into its
+// four channels once (four plaintext products); every pattern position is
+// then a hoisted rotation of one channel, shared by all patterns that need
+// it, so each further pattern only costs additions. Needs more rotation keys
+// than dna_hamming_scan (up to 16 per pattern position).
+
+// Number of profile ciphertexts per sequence for `num_patterns` patterns
+size_t dna_hamming_multi_outputs(size_t num_patterns);
+
+// Rotation indices dna_hamming_scan_multi needs for patterns of up to
+// `max_pattern_len` bases. Writes at most `capacity` of them to
+// `out_indices` and returns the total count.
+size_t dna_hamming_multi_rotations(
+    CryptoContextHandle ctx,
+    size_t max_pattern_len,
+    int32_t* out_indices,
+    size_t capacity
+);
+
+// Like dna_hamming_scan for every pattern at once. `out_profiles` receives
+// dna_hamming_multi_outputs(num_patterns) ciphertexts per sequence, sequence
+// by sequence: profile g holds the distance of pattern 4g + l for the window
+// at base j in slot 4j + l. Slots of lanes without a pattern are zero.
+OpenfheError dna_hamming_scan_multi(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    const char* const* patterns,
+    const size_t* pattern_lens,
+    size_t num_patterns,
+    CiphertextHandle* out_profiles
+);
+
+#define OPENFHE_KMER_MAX_K 3
+
+// Number of ciphertexts dna_kmer_histogram returns for `k`: each holds the
+// counts of four consecutive k-mers, 0 if `k` is out of range
+size_t dna_kmer_histogram_outputs(uint32_t k);
+
+// Rotation indices whose keys dna_kmer_histogram needs. Writes at most
+// `capacity` of them to `out_indices` and returns the total count.
+size_t dna_kmer_rotations(CryptoContextHandle ctx, uint32_t k, int32_t* out_indices, size_t capacity);
+
+// Count all 4^k k-mers (1 <= k <= OPENFHE_KMER_MAX_K) over `count` one-hot
+// packed sequence ciphertexts. K-mers are numbered with A=0, C=1, G=2, T=3
+// as base-4 digits, first base most significant. Output g (of
+// dna_kmer_histogram_outputs(k)) holds the count of k-mer 4g + l in slot l
+// for the first row and slot ring_dim / 2 + l for the second; the total is
+// their sum. K-mers with an N, or running past the end of a row, are not
+// counted, so chunks should overlap by k - 1 bases. A layout overlap beyond
+// that repeats k-mers: they are skipped at the start of the second row, and
+// at the start of every sequence after the first, which is taken to follow
+// its predecessor as in dna_layout_encrypt_batch. Needs multiplicative
+// depth k.
+//
+// Products of shifted one-hot vectors are shared by all k-mers with a common
+// prefix, and the slot reduction runs once for the whole batch.
+OpenfheError dna_kmer_histogram(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    uint32_t k,
+    CiphertextHandle* out_counts
+);
+
+// Number of partial sums dna_kmer_accumulate keeps for `k`: one per k-mer,
+// 0 if `k` is out of range
+size_t dna_kmer_partial_sums(uint32_t k);
+
+// dna_kmer_histogram split in two, for genomes that grow chunk by chunk.
+// `partials` (dna_kmer_partial_sums(k) handles) are either all null, to
+// start counting, or all from an earlier call; the k-mers of `seqs` are
+// added to them. The first of `seqs` continues the counted bases from
+// dna_layout_append_offset(n, k), so none of its k-mers are skipped; the
+// others follow it as in dna_kmer_histogram. All or nothing: on failure the
+// partials are unchanged. The partials are ordinary ciphertexts and can be
+// stored between uploads.
+OpenfheError dna_kmer_accumulate(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* seqs,
+    size_t count,
+    uint32_t k,
+    CiphertextHandle* partials
+);
+
+// Pack and reduce the partial sums into the dna_kmer_histogram outputs.
+// Leaves `partials` untouched, so counting can go on afterwards.
+OpenfheError dna_kmer_finalize(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* partials,
+    uint32_t k,
+    CiphertextHandle* out_counts
+);
+
+// ============================================================================
+// DNA Slot Layouts
+// ============================================================================
+
+// How bases map onto slots. A chunk fills both rows of a ciphertext; the
+// second row starts `overlap` bases before the end of the first, so windows
+// of up to overlap + 1 bases never straddle the row boundary, and consecutive
+// chunks overlap the same way. The layout is recorded in the ciphertext
+// metadata and survives serialization; ciphertexts without one (e.g. from
+// make_dna_plaintext) are taken to be one-hot.
+typedef enum {
+    // Base i in slots 4i..4i+3 of one ciphertext, 1 in the channel of its
+    // base (A, C, G, T). What the DNA kernels work on.
+    DNA_LAYOUT_ONE_HOT = 0,
+    // Four ciphertexts, one per channel, holding 1 where the base is that
+    // channel. Encrypted directly they are dense (one slot per base); split
+    // from one-hot they keep its stride of 4.
+    DNA_LAYOUT_CHANNELS = 1,
+    // Base i in slot i as a digit: A=0, C=1, G=2, T=3, N=-1. Four times
+    // denser than one-hot.
+    DNA_LAYOUT_BASE4 = 2
+} DnaLayoutKind;
+
+typedef struct {
+    uint32_t kind;       // DnaLayoutKind
+    uint32_t channel;    // DNA_LAYOUT_CHANNELS: channel of this ciphertext
+    uint32_t stride;     // slots per base
+    uint32_t row_bases;  // bases per row (ring_dim / 2 / stride)
+    uint32_t overlap;    // bases the second row repeats from the first
+} DnaLayout;
+
+typedef enum {
+    DNA_KERNEL_HAMMING = 0,
+    DNA_KERNEL_HAMMING_MULTI = 1,
+    DNA_KERNEL_KMER = 2,
+    // Slot-wise comparison of aligned genomes with eval_equal
+    DNA_KERNEL_COMPARE = 3
+} DnaKernel;
+
+typedef struct {
+    DnaLayout layout;        // channel is 0; each chunk needs all channels
+    size_t bases_per_chunk;  // new bases each chunk covers
+    size_t chunks;
+    size_t ciphertexts;      // over all chunks
+} DnaLayoutPlan;
+
+// Ciphertexts per chunk of a layout kind: 4 for DNA_LAYOUT_CHANNELS, else 1
+size_t dna_layout_ciphertexts(uint32_t kind);
+
+// Base at which to start encrypting bases appended to a genome of
+// `existing_bases` for a kernel looking at windows of `window` bases (k for
+// k-mers, the pattern length for searches): `window - 1` bases before its
+// end, so the new chunks hold exactly the windows that end in new bases.
+// Independent of the layout overlap, which may be larger than `window - 1`.
+size_t dna_layout_append_offset(size_t existing_bases, size_t window);
+
+// Pick the layout `kernel` accepts that needs the fewest ciphertexts for a
+// genome of `genome_len` bases, searched with windows of `window` bases.
+// Chunk i starts at base i * bases_per_chunk.
+OpenfheError dna_layout_plan(
+    CryptoContextHandle ctx,
+    DnaKernel kernel,
+    size_t genome_len,
+    size_t window,
+    DnaLayoutPlan* out_plan
+);
+
+// Encrypt one chunk of at most 2 * row_bases - overlap bases (A, C, G, T or
+// N in either case) into dna_layout_ciphertexts(layout->kind) ciphertexts
+// tagged with the layout. Stride and row_bases are derived from the context.
+OpenfheError dna_layout_encrypt(
+    CryptoContextHandle ctx,
+    PublicKeyHandle pk,
+    const DnaLayout* layout,
+    const char* bases,
+    size_t length,
+    CiphertextHandle* out_cts
+);
+
+// Encrypt `chunks` consecutive chunks of a genome concurrently on the OpenMP
+// thread pool. Chunk i starts at base i * 2 * (row_bases - overlap), the
+// bases_per_chunk of dna_layout_plan, and takes
+// dna_layout_ciphertexts(layout->kind) slots of out_cts, in chunk order. All
+// or nothing: on failure no handle is returned and the error names the first
+// bad chunk.
+OpenfheError dna_layout_encrypt_batch(
+    CryptoContextHandle ctx,
+    PublicKeyHandle pk,
+    const DnaLayout* layout,
+    const char* bases,
+    size_t length,
+    size_t chunks,
+    CiphertextHandle* out_cts
+);
+
+// Layout recorded on `ct`; false if there is none
+bool ciphertext_get_dna_layout(CiphertextHandle ct, DnaLayout* out_layout);
+OpenfheError ciphertext_set_dna_layout(CiphertextHandle ct, const DnaLayout* layout);
+
+// Split a one-hot or base-4 ciphertext into four channel ciphertexts. From
+// one-hot: a mask and a rotation per channel (rotation keys 1..3). From
+// base-4: the channel indicators are degree-4 polynomials in the digit,
+// evaluated from shared powers (three products, depth 2, mult keys).
+OpenfheError dna_layout_split(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    CiphertextHandle* out_channels
+);
+
+// Merge four channel ciphertexts into one of `kind`: base-4 (a weighted sum)
+// or one-hot (rotations -1..-3; only for channels split from one-hot)
+OpenfheError dna_layout_merge(
+    CryptoContextHandle ctx,
+    const CiphertextHandle* channels,
+    uint32_t kind,
+    CiphertextHandle* out_ct
+);
+
+// ============================================================================
+// Equality Tests
+// ============================================================================
+
+// For a prime plaintext modulus t, x^(t-1) is 1 in every nonzero slot and 0
+// in every zero slot (Fermat), so 1 - x^(t-1) tests slots for zero. The power
+// is a balanced product over the repeated squares of x, which reaches the
+// minimum depth ceil(log2(t - 1)). Products in the tree stay
+// unrelinearized while their degree fits max_relin_sk_deg, which moves key
+// switching down to lower levels, where it is cheaper.
+
+typedef struct {
+    uint32_t depth;            // multiplicative levels consumed
+    uint32_t multiplications;  // ciphertext products, squarings included
+    uint32_t key_switches;     // one per relinearized degree
+} EqualityTestCost;
+
+// Cost of eval_is_zero in a context with the given plaintext modulus and
+// max_relin_sk_deg
+OpenfheError eval_is_zero_cost(
+    uint64_t plaintext_modulus,
+    uint32_t max_relin_sk_deg,
+    EqualityTestCost* out_cost
+);
+
+// 1 in every slot of `ct` holding 0, and 0 elsewhere. Fails with
+// OPENFHE_ERROR_INVALID_PARAM if `ct` has fewer levels left than the test
+// needs. Requires the eval mult keys.
+OpenfheError eval_is_zero(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct,
+    CiphertextHandle* out_ct
+);
+
+// 1 in every slot where `ct1` and `ct2` agree, and 0 elsewhere
+OpenfheError eval_equal(
+    CryptoContextHandle ctx,
+    CiphertextHandle ct1,
+    CiphertextHandle ct2,
+    CiphertextHandle* out_ct
+);
+
+// ============================================================================
+// Cost Model
+// ============================================================================
+
+// Predicts the CPU time and peak memory of FHE work before it runs. An
+// operation costs a calibrated number of nanoseconds per ring_dim * towers,
+// or per ring_dim * towers^2 for the ones that key-switch, so a model
+// measured on one context also prices lower levels and other ring sizes.
+typedef enum {
+    FHE_OP_ADD = 0,                // ciphertext + ciphertext
+    FHE_OP_MULT_PLAIN = 1,         // ciphertext * plaintext
+    FHE_OP_MULT = 2,               // ciphertext * ciphertext, relinearized
+    FHE_OP_ROTATE = 3,             // rotation with its own decomposition
+    FHE_OP_ROTATE_PRECOMPUTE = 4,  // decomposition shared by fast rotations
+    FHE_OP_FAST_ROTATE = 5,        // rotation from a shared decomposition
+    FHE_OP_ENCRYPT = 6,            // public-key encryption
+    FHE_OP_DESERIALIZE = 7,        // one binary ciphertext
+    FHE_OP_COUNT = 8
+} FheOp;
+
+typedef struct {
+    double ns_per_unit[FHE_OP_COUNT];
+    // Size of a rotation precomputation, in ciphertexts
+    double precompute_ciphertexts;
+    // Shape of the ciphertexts the model was measured on
+    uint32_t ring_dim;
+    uint32_t towers;
+} FheCostModel;
+
+typedef struct {
+    uint64_t cpu_ns;      // summed over all threads
+    uint64_t peak_bytes;  // inputs, outputs and the working sets of all threads
+} FheCostEstimate;
+
+// Measure every operation `iterations` times on fresh ciphertexts of `ctx`,
+// on one thread and in thread CPU time, so concurrent load does not skew the
+// result. Uses a throwaway key pair whose evaluation keys are removed again,
+// so it must not run while other threads evaluate.
+OpenfheError fhe_cost_model_calibrate(
+    CryptoContextHandle ctx,
+    uint32_t iterations,
+    FheCostModel* out_model
+);
+
+// Predicted CPU nanoseconds of one `op` on ciphertexts of the given shape
+double fhe_cost_op_ns(const FheCostModel* model, FheOp op, uint32_t ring_dim, uint32_t towers);
+
+// In-memory size of a ciphertext of the given shape
+uint64_t fhe_ciphertext_bytes(uint32_t ring_dim, uint32_t towers);
+
+// Predicted cost of running `kernel` over `chunks` fresh ciphertexts of
+// `ctx` (pairs of them for DNA_KERNEL_COMPARE). `window` is the pattern
+// length (the longest one for DNA_KERNEL_HAMMING_MULTI) or k; `patterns` is
+// the panel size for DNA_KERNEL_HAMMING_MULTI and ignored otherwise.
+OpenfheError dna_kernel_cost(
+    CryptoContextHandle ctx,
+    const FheCostModel* model,
+    DnaKernel kernel,
+    size_t chunks,
+    size_t window,
+    size_t patterns,
+    FheCostEstimate* out_estimate
+);
+
 // ============================================================================
 // Ciphertext Management
 // ============================================================================
 
+// Clones are copy-on-write: they share the polynomials with the original
+// until either one is modified in place (eval_*_inplace, mod_reduce_inplace,
+// ciphertext_set_dna_layout, ...), which copies them for the modified handle
+// only. Cloning a lazy handle that was not decoded yet shares its source.
+// Returns NULL on failure.
 CiphertextHandle ciphertext_clone(CiphertextHandle ct);
 void ciphertext_destroy(CiphertextHandle ct);
 
+// True while the handle's polynomials are shared with another handle
+bool ciphertext_is_shared(CiphertextHandle ct);
+
+typedef struct {
+    uint64_t shared_clones;  // clones made by sharing instead of copying
+    uint64_t copies;         // copies made on the first write to a shared handle
+    uint64_t copied_bytes;   // polynomial bytes those copies allocated
+} CiphertextCowStats;
+
+// Process-wide counters since startup
+void ciphertext_get_cow_stats(CiphertextCowStats* out_stats);
+
 #ifdef __cplusplus
 }
 #endif
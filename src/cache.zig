@@ -0,0 +1,465 @@
+//! Memoized analysis results.
+//!
+//! Users re-run the same analysis on the same upload (reloading the page,
+//! sharing a link). A result is keyed by its session, kernel, kernel
+//! parameters and the ids and versions of its input objects, and kept in a
+//! segment store of its own, so a repeated run costs one store read instead
+//! of the kernel.
+//!
+//! Entries live under object ids derived from a digest of the key; the
+//! record starts with the full digest, which lookups check.
+//! Changing an input changes its version and with it the key, so stale
+//! entries are never found again and age out of the LRU order. The index is
+//! in memory only: after a restart each session's entries are picked up from
+//! the store the first time the session uses the cache.
+//!
+//! Evicting an entry only writes a tombstone; once the records the cache has
+//! dropped add up to its budget, it compacts its store one segment at a time.
+//! The cache thus holds at most its budget in live records and as much again
+//! in garbage, and compacting it never moves the uploads.
+
+const std = @import("std");
+const uuid = @import("uuid");
+const openfhe = @import("openfhe");
+
+pub const SessionId = [36]u8;
+
+pub const default_budget_mb = 1024;
+
+const Digest = [std.crypto.hash.sha2.Sha256.digest_length]u8;
+
+/// One input ciphertext of an analysis
+pub const Input = struct {
+    objectId: u64,
+    /// Anything that changes when the object is rewritten, e.g. the
+    /// `stored_at` of its metadata row
+    version: i64,
+};
+
+pub const Key = struct {
+    sessionId: SessionId,
+    kernel: []const u8,
+    /// Kernel parameters, serialized by the caller (pattern, k, ...)
+    params: []const u8,
+    inputs: []const Input,
+
+    fn digest(self: Key) Digest {
+        var hasher = std.crypto.hash.sha2.Sha256.init(.{});
+        hasher.update(&self.sessionId);
+        for ([_][]const u8{ self.kernel, self.params }) |field| {
+            hasher.update(std.mem.asBytes(&std.mem.nativeToLittle(u64, field.len)));
+            hasher.update(field);
+        }
+        for (self.inputs) |input| {
+            hasher.update(std.mem.asBytes(&std.mem.nativeToLittle(u64, input.objectId)));
+            hasher.update(std.mem.asBytes(&std.mem.nativeToLittle(i64, input.version)));
+        }
+        var out: Digest = undefined;
+        hasher.final(&out);
+        return out;
+    }
+};
+
+pub const Stats = struct {
+    hits: u64,
+    misses: u64,
+    evictions: u64,
+    entries: usize,
+    bytes: u64,
+
+    /// Share of lookups answered from the cache, 0 before the first one
+    pub fn hitRate(self: Stats) f64 {
+        const lookups = self.hits + self.misses;
+        if (lookups == 0) return 0;
+        return @as(f64, @floatFromInt(self.hits)) / @as(f64, @floatFromInt(lookups));
+    }
+};
+
+pub const ResultCache = struct {
+    allocator: std.mem.Allocator,
+    /// Holds nothing but cached results
+    store: openfhe.SegmentStore,
+    /// Held shared while reading a view of `store`, exclusively to compact it
+    storeLock: std.Thread.RwLock = .{},
+    /// Upper bound for the stored entries, record payloads included
+    budgetBytes: u64,
+
+    mutex: std.Thread.Mutex = .{},
+    entries: std.AutoHashMapUnmanaged(EntryKey, *Entry) = .empty,
+    /// Least recently used first
+    lru: std.DoublyLinkedList = .{},
+    /// Sessions whose entries from before a restart are in `entries`
+    adopted: std.AutoHashMapUnmanaged(SessionId, void) = .empty,
+    bytes: u64 = 0,
+    /// Bytes of records dropped since the last compaction
+    deadBytes: u64 = 0,
+    hits: u64 = 0,
+    misses: u64 = 0,
+    evictions: u64 = 0,
+
+    const EntryKey = struct {
+        sessionId: SessionId,
+        objectId: u64,
+    };
+
+    const Entry = struct {
+        node: std.DoublyLinkedList.Node = .{},
+        key: EntryKey,
+        bytes: u64,
+    };
+
+    pub fn init(allocator: std.mem.Allocator, store: openfhe.SegmentStore, budgetBytes: u64) ResultCache {
+        return .{
+            .allocator = allocator,
+            .store = store,
+            .budgetBytes = budgetBytes,
+        };
+    }
+
+    pub fn deinit(self: *ResultCache) void {
+        var it = self.entries.valueIterator();
+        while (it.next()) |entry| self.allocator.destroy(entry.*);
+        self.entries.deinit(self.allocator);
+        self.adopted.deinit(self.allocator);
+    }
+
+    /// The cached result for `key`, or null if the analysis has to run.
+    /// The caller owns the returned ciphertext.
+    pub fn get(self: *ResultCache, fhe: openfhe.CryptoContext, key: Key) !?openfhe.Ciphertext {
+        const digest = key.digest();
+        const entryKey = EntryKey{ .sessionId = key.sessionId, .objectId = objectIdOf(&digest) };
+        const session = storeKey(&key.sessionId) orelse return error.InvalidSession;
+
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            try self.adopt(key.sessionId, &session);
+            const entry = self.entries.get(entryKey) orelse {
+                self.misses += 1;
+                return null;
+            };
+            self.lru.remove(&entry.node);
+            self.lru.append(&entry.node);
+        }
+
+        const ct: ?openfhe.Ciphertext = blk: {
+            self.storeLock.lockShared();
+            defer self.storeLock.unlockShared();
+
+            const record = self.store.get(&session, entryKey.objectId) catch |err| switch (err) {
+                // Gone with the session
+                error.KeyNotFound => break :blk null,
+                else => return err,
+            };
+            if (record.len < digest.len or !std.mem.eql(u8, record[0..digest.len], &digest)) break :blk null;
+            break :blk try openfhe.Ciphertext.deserialize(fhe, record[digest.len..], .binary);
+        };
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (ct == null) {
+            // A digest prefix collision, or the record went away meanwhile
+            self.misses += 1;
+            return null;
+        }
+        self.hits += 1;
+        return ct;
+    }
+
+    /// Stores the result of the analysis `key` describes. `ct` stays owned
+    /// by the caller. Results larger than the whole budget are not kept.
+    pub fn put(self: *ResultCache, key: Key, ct: openfhe.Ciphertext) !void {
+        const digest = key.digest();
+        const entryKey = EntryKey{ .sessionId = key.sessionId, .objectId = objectIdOf(&digest) };
+        const session = storeKey(&key.sessionId) orelse return error.InvalidSession;
+
+        var record = std.Io.Writer.Allocating.init(self.allocator);
+        defer record.deinit();
+        record.writer.writeAll(&digest) catch return error.OutOfMemory;
+        try ct.serializeTo(.binary, &record.writer);
+        const bytes = record.written().len;
+        if (bytes > self.budgetBytes) return;
+
+        if (try self.insert(entryKey, &session, record.written())) try self.compact();
+    }
+
+    /// Compaction moves records, so no view may be in use while it runs.
+    /// Going one segment at a time, lookups wait for one segment copy at most.
+    fn compact(self: *ResultCache) !void {
+        while (true) {
+            self.storeLock.lock();
+            defer self.storeLock.unlock();
+            if (!try self.store.compactStep()) break;
+        }
+    }
+
+    /// Stores and indexes a record and evicts entries beyond the budget.
+    /// True if the store should be compacted.
+    fn insert(self: *ResultCache, entryKey: EntryKey, session: *const openfhe.SegmentStore.SessionId, record: []const u8) !bool {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        try self.adopt(entryKey.sessionId, session);
+
+        try self.entries.ensureUnusedCapacity(self.allocator, 1);
+        try self.store.put(session, entryKey.objectId, record);
+
+        const slot = self.entries.getOrPutAssumeCapacity(entryKey);
+        if (slot.found_existing) {
+            self.bytes -= slot.value_ptr.*.bytes;
+            self.deadBytes += slot.value_ptr.*.bytes;
+            slot.value_ptr.*.bytes = record.len;
+            self.lru.remove(&slot.value_ptr.*.node);
+        } else {
+            const entry = self.allocator.create(Entry) catch |err| {
+                self.entries.removeByPtr(slot.key_ptr);
+                self.store.delete(session, entryKey.objectId) catch {};
+                return err;
+            };
+            entry.* = .{ .key = entryKey, .bytes = record.len };
+            slot.value_ptr.* = entry;
+        }
+        self.lru.append(&slot.value_ptr.*.node);
+        self.bytes += record.len;
+
+        while (self.bytes > self.budgetBytes) {
+            const node = self.lru.popFirst() orelse break;
+            self.drop(@fieldParentPtr("node", node), true);
+            self.evictions += 1;
+        }
+
+        if (self.deadBytes < self.budgetBytes) return false;
+        self.deadBytes = 0;
+        return true;
+    }
+
+    /// Forgets a deleted session and deletes its records
+    pub fn forget(self: *ResultCache, sessionId: SessionId) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        if (storeKey(&sessionId)) |session| {
+            self.store.deleteSession(&session) catch |err| {
+                std.log.warn("could not delete cached results: {} {s}", .{ err, openfhe.getLastError() });
+            };
+        }
+        _ = self.adopted.remove(sessionId);
+        var node = self.lru.first;
+        while (node) |current| {
+            node = current.next;
+            const entry: *Entry = @fieldParentPtr("node", current);
+            if (!std.mem.eql(u8, &entry.key.sessionId, &sessionId)) continue;
+            self.lru.remove(current);
+            self.drop(entry, false);
+        }
+    }
+
+    pub fn stats(self: *ResultCache) Stats {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return .{
+            .hits = self.hits,
+            .misses = self.misses,
+            .evictions = self.evictions,
+            .entries = self.entries.count(),
+            .bytes = self.bytes,
+        };
+    }
+
+    /// Removes an entry already unlinked from `lru`. Called with `mutex` held.
+    fn drop(self: *ResultCache, entry: *Entry, deleteRecord: bool) void {
+        if (deleteRecord) {
+            if (storeKey(&entry.key.sessionId)) |session| {
+                if (self.store.delete(&session, entry.key.objectId)) {
+                    self.deadBytes += entry.bytes;
+                } else |err| {
+                    std.log.warn("could not delete cached result: {} {s}", .{ err, openfhe.getLastError() });
+                }
+            }
+        }
+        self.bytes -= entry.bytes;
+        _ = self.entries.remove(entry.key);
+        self.allocator.destroy(entry);
+    }
+
+    /// Indexes the session's entries written before a restart, as the least
+    /// recently used ones. Called with `mutex` held.
+    fn adopt(self: *ResultCache, sessionId: SessionId, session: *const openfhe.SegmentStore.SessionId) !void {
+        if (self.adopted.contains(sessionId)) return;
+
+        const ids = try self.store.list(session, self.allocator);
+        defer self.allocator.free(ids);
+
+        try self.adopted.ensureUnusedCapacity(self.allocator, 1);
+        try self.entries.ensureUnusedCapacity(self.allocator, @intCast(ids.len));
+        for (ids) |objectId| {
+            const entryKey = EntryKey{ .sessionId = sessionId, .objectId = objectId };
+            if (self.entries.contains(entryKey)) continue;
+            const bytes = blk: {
+                self.storeLock.lockShared();
+                defer self.storeLock.unlockShared();
+                break :blk (self.store.get(session, objectId) catch continue).len;
+            };
+            const entry = try self.allocator.create(Entry);
+            entry.* = .{ .key = entryKey, .bytes = bytes };
+            self.entries.putAssumeCapacity(entryKey, entry);
+            self.lru.prepend(&entry.node);
+            self.bytes += bytes;
+        }
+        self.adopted.putAssumeCapacity(sessionId, {});
+    }
+};
+
+fn objectIdOf(digest: *const Digest) u64 {
+    return std.mem.readInt(u64, digest[0..8], .little);
+}
+
+fn storeKey(sessionId: *const SessionId) ?openfhe.SegmentStore.SessionId {
+    const id = uuid.urn.deserialize(sessionId) catch return null;
+    return std.mem.toBytes(id);
+}
+
+const TestFixture = struct {
+    tmp: std.testing.TmpDir,
+    dir: [:0]u8,
+    store: openfhe.SegmentStore,
+    ctx: openfhe.CryptoContext,
+    kp: openfhe.KeyPair,
+    ct: openfhe.Ciphertext,
+
+    const session: SessionId = "0f8fad5b-d9cb-469f-a165-70867728950e".*;
+
+    fn init(self: *TestFixture) !void {
+        const allocator = std.testing.allocator;
+        self.* = .{ .tmp = std.testing.tmpDir(.{}), .dir = undefined, .store = undefined, .ctx = undefined, .kp = undefined, .ct = undefined };
+        const path = try self.tmp.dir.realpathAlloc(allocator, ".");
+        defer allocator.free(path);
+        self.dir = try allocator.dupeZ(u8, path);
+        self.store = try openfhe.SegmentStore.open(self.dir, 0);
+
+        self.ctx = try openfhe.CryptoContext.createBgv(.{});
+        try self.ctx.enablePke();
+        self.kp = try self.ctx.keyGen();
+        var pk = self.kp.getPublicKey();
+        defer pk.deinit();
+        var pt = try self.ctx.makePackedPlaintext(&.{ 4, 2 });
+        defer pt.deinit();
+        self.ct = try self.ctx.encrypt(pk, pt);
+    }
+
+    fn deinit(self: *TestFixture) void {
+        self.ct.deinit();
+        self.kp.deinit();
+        self.ctx.deinit();
+        self.store.close();
+        std.testing.allocator.free(self.dir);
+        self.tmp.cleanup();
+    }
+
+    /// Bytes one cached copy of `ct` takes
+    fn recordBytes(self: *TestFixture) !u64 {
+        const frame = try self.ct.serialize(.binary, std.testing.allocator);
+        defer std.testing.allocator.free(frame);
+        return @sizeOf(Digest) + frame.len;
+    }
+
+    const v1 = [_]Input{.{ .objectId = 7, .version = 1 }};
+    const v2 = [_]Input{.{ .objectId = 7, .version = 2 }};
+
+    fn key(params: []const u8, inputs: []const Input) Key {
+        return .{ .sessionId = session, .kernel = "kmer", .params = params, .inputs = inputs };
+    }
+
+    fn expectHit(self: *TestFixture, cache: *ResultCache, k: Key) !void {
+        var found = (try cache.get(self.ctx, k)) orelse return error.TestExpectedHit;
+        found.deinit();
+    }
+};
+
+test "result cache hits, and misses once an input changes" {
+    var f: TestFixture = undefined;
+    try f.init();
+    defer f.deinit();
+    var cache = ResultCache.init(std.testing.allocator, f.store, 1 << 30);
+    defer cache.deinit();
+
+    try std.testing.expectEqual(@as(?openfhe.Ciphertext, null), try cache.get(f.ctx, TestFixture.key("k=3", &TestFixture.v1)));
+    try cache.put(TestFixture.key("k=3", &TestFixture.v1), f.ct);
+    try f.expectHit(&cache, TestFixture.key("k=3", &TestFixture.v1));
+
+    // Rewriting the input gives it a new version; other parameters are
+    // another analysis
+    try std.testing.expectEqual(@as(?openfhe.Ciphertext, null), try cache.get(f.ctx, TestFixture.key("k=3", &TestFixture.v2)));
+    try std.testing.expectEqual(@as(?openfhe.Ciphertext, null), try cache.get(f.ctx, TestFixture.key("k=2", &TestFixture.v1)));
+
+    const stats = cache.stats();
+    try std.testing.expectEqual(@as(u64, 1), stats.hits);
+    try std.testing.expectEqual(@as(u64, 3), stats.misses);
+    try std.testing.expectEqual(@as(usize, 1), stats.entries);
+    try std.testing.expectEqual(try f.recordBytes(), stats.bytes);
+    try std.testing.expectApproxEqAbs(0.25, stats.hitRate(), 1e-9);
+
+    cache.forget(TestFixture.session);
+    try std.testing.expectEqual(@as(usize, 0), cache.stats().entries);
+    try std.testing.expectEqual(@as(u64, 0), f.store.stats().live_objects);
+}
+
+test "result cache evicts the least recently used entry" {
+    var f: TestFixture = undefined;
+    try f.init();
+    defer f.deinit();
+    const record = try f.recordBytes();
+    var cache = ResultCache.init(std.testing.allocator, f.store, 2 * record + record / 2);
+    defer cache.deinit();
+
+    try cache.put(TestFixture.key("a", &TestFixture.v1), f.ct);
+    try cache.put(TestFixture.key("b", &TestFixture.v1), f.ct);
+    try f.expectHit(&cache, TestFixture.key("a", &TestFixture.v1));
+    try cache.put(TestFixture.key("c", &TestFixture.v1), f.ct);
+
+    const stats = cache.stats();
+    try std.testing.expectEqual(@as(u64, 1), stats.evictions);
+    try std.testing.expectEqual(@as(usize, 2), stats.entries);
+    try std.testing.expectEqual(2 * record, stats.bytes);
+    try std.testing.expectEqual(@as(?openfhe.Ciphertext, null), try cache.get(f.ctx, TestFixture.key("b", &TestFixture.v1)));
+    try f.expectHit(&cache, TestFixture.key("a", &TestFixture.v1));
+    try f.expectHit(&cache, TestFixture.key("c", &TestFixture.v1));
+}
+
+test "result cache compacts the store once evictions add up to its budget" {
+    var f: TestFixture = undefined;
+    try f.init();
+    defer f.deinit();
+    const record = try f.recordBytes();
+    var cache = ResultCache.init(std.testing.allocator, f.store, 2 * record);
+    defer cache.deinit();
+
+    var params: [8]u8 = undefined;
+    for (0..16) |i| {
+        try cache.put(TestFixture.key(try std.fmt.bufPrint(&params, "{d}", .{i}), &TestFixture.v1), f.ct);
+        // Never more garbage than the budget, headers and tombstones aside
+        try std.testing.expect(f.store.stats().dead_bytes < 2 * 2 * record);
+    }
+    try std.testing.expectEqual(@as(u64, 14), cache.stats().evictions);
+}
+
+test "result cache picks up its entries after a restart" {
+    var f: TestFixture = undefined;
+    try f.init();
+    defer f.deinit();
+
+    {
+        var cache = ResultCache.init(std.testing.allocator, f.store, 1 << 30);
+        defer cache.deinit();
+        try cache.put(TestFixture.key("k=3", &TestFixture.v1), f.ct);
+        try f.store.sync();
+    }
+    f.store.close();
+    f.store = try openfhe.SegmentStore.open(f.dir, 0);
+
+    var cache = ResultCache.init(std.testing.allocator, f.store, 1 << 30);
+    defer cache.deinit();
+    try f.expectHit(&cache, TestFixture.key("k=3", &TestFixture.v1));
+    const stats = cache.stats();
+    try std.testing.expectEqual(@as(usize, 1), stats.entries);
+    try std.testing.expectEqual(try f.recordBytes(), stats.bytes);
+}
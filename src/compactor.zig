@@ -0,0 +1,69 @@
+//! Background compaction of the segment store.
+//!
+//! Compaction moves records, so it needs the store lock exclusively and
+//! would stall every download and analysis while it rewrites the store.
+//! The compactor instead works one segment at a time and releases the lock
+//! between segments, so requests only ever wait for a single segment copy.
+//! Requests that free space just nudge it; it starts once most of the store
+//! is garbage and then runs until no segment holds dead bytes.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+
+/// Backstop for nudges that were missed, e.g. space freed before startup
+const check_interval_ns = 60 * std.time.ns_per_s;
+
+pub const Compactor = struct {
+    store: openfhe.SegmentStore,
+    /// Held shared by readers of views into `store`
+    lock: *std.Thread.RwLock,
+
+    thread: ?std.Thread = null,
+    wake: std.Thread.ResetEvent = .{},
+    stopping: std.atomic.Value(bool) = .init(false),
+
+    pub fn init(store: openfhe.SegmentStore, lock: *std.Thread.RwLock) Compactor {
+        return .{ .store = store, .lock = lock };
+    }
+
+    pub fn deinit(self: *Compactor) void {
+        if (self.thread) |thread| {
+            self.stopping.store(true, .release);
+            self.wake.set();
+            thread.join();
+            self.thread = null;
+        }
+    }
+
+    pub fn start(self: *Compactor) !void {
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+    }
+
+    /// Called after deletions; compaction starts if enough is garbage
+    pub fn request(self: *Compactor) void {
+        self.wake.set();
+    }
+
+    fn run(self: *Compactor) void {
+        while (!self.stopping.load(.acquire)) {
+            self.wake.timedWait(check_interval_ns) catch {};
+            self.wake.reset();
+
+            const stats = self.store.stats();
+            if (stats.dead_bytes <= stats.live_bytes) continue;
+            while (!self.stopping.load(.acquire)) {
+                const more = self.step() catch {
+                    std.log.err("Compaction failed: {s}", .{openfhe.getLastError()});
+                    break;
+                };
+                if (!more) break;
+            }
+        }
+    }
+
+    fn step(self: *Compactor) !bool {
+        self.lock.lock();
+        defer self.lock.unlock();
+        return self.store.compactStep();
+    }
+};
@@ -0,0 +1,179 @@
+//! Streaming ingest of encrypted genome uploads.
+//!
+//! An upload body is a sequence of length-prefixed serialized ciphertexts
+//! (u32 little-endian length, then the ciphertext). The body is read in
+//! fixed-size chunks and decoded incrementally, and every ciphertext goes to
+//! storage as soon as its last byte arrives, so memory use stays bounded by
+//! one frame no matter how large the genome is.
+
+const std = @import("std");
+const pg = @import("pg");
+const httpz = @import("httpz");
+const openfhe = @import("openfhe");
+
+/// Bodies up to this size are buffered by httpz as before; larger ones are
+/// left on the socket and have to be consumed through `BodyReader`.
+pub const lazy_read_size = 10485760;
+
+/// Upper bound for a whole upload stream
+pub const max_upload_size = 16 * 1024 * 1024 * 1024;
+
+/// Upper bound for a single serialized ciphertext inside an upload
+pub const max_frame_size = 64 * 1024 * 1024;
+
+/// Size of the chunks the body is read in
+pub const chunk_size = 64 * 1024;
+
+const read_timeout_ms = 10_000;
+
+/// Reads a request body chunk by chunk, whether or not httpz buffered it
+pub const BodyReader = union(enum) {
+    buffered: ?[]const u8,
+    lazy: httpz.Request.Reader,
+
+    pub fn init(req: *httpz.Request) !BodyReader {
+        if (req.body()) |body| return .{ .buffered = body };
+        return .{ .lazy = try req.reader(read_timeout_ms) };
+    }
+
+    /// Returns the next chunk of the body, or null once it is exhausted
+    pub fn next(self: *BodyReader, buf: []u8) !?[]const u8 {
+        switch (self.*) {
+            .buffered => |*body| {
+                const chunk = body.* orelse return null;
+                body.* = null;
+                return chunk;
+            },
+            .lazy => |*reader| {
+                const n = try reader.read(buf);
+                return if (n == 0) null else buf[0..n];
+            },
+        }
+    }
+};
+
+/// Metadata rows written by one INSERT. A genome upload is thousands of
+/// frames, and a round trip per frame would dominate the ingest.
+pub const insert_batch = 256;
+
+/// Stores each decoded ciphertext of an upload under ascending object ids:
+/// the serialized frame goes to the segment store right away, its metadata
+/// to Postgres in batches of `insert_batch` rows. Call `flush` once the
+/// stream ends. An upload can take minutes, so a pooled connection is only
+/// held while a batch is written, not for the whole stream.
+///
+/// Ids come from the session's `next_object_id` counter, a batch at a time,
+/// so uploads running side by side never share an id. The ids of one upload
+/// are contiguous unless another upload to the session reserves in between.
+pub const StoreSink = struct {
+    db: *pg.Pool,
+    store: openfhe.SegmentStore,
+    sessionId: []const u8,
+    storeKey: openfhe.SegmentStore.SessionId,
+    /// Id of the first stored frame, once one is
+    firstObjectId: ?u64 = null,
+    /// Next id of the reserved range, which ends at `reservedEnd`
+    nextObjectId: u64 = 0,
+    reservedEnd: u64 = 0,
+    /// Frames whose metadata rows are written
+    stored: u64 = 0,
+    err: ?anyerror = null,
+    /// Sizes of the frames after the stored ones, still without a row
+    pendingSizes: [insert_batch]i64 = undefined,
+    pending: usize = 0,
+
+    pub fn init(db: *pg.Pool, store: openfhe.SegmentStore, sessionId: []const u8, storeKey: openfhe.SegmentStore.SessionId) StoreSink {
+        return .{
+            .db = db,
+            .store = store,
+            .sessionId = sessionId,
+            .storeKey = storeKey,
+        };
+    }
+
+    pub fn onCiphertext(self: *StoreSink, frame: []const u8, ct: openfhe.Ciphertext) !void {
+        var owned = ct;
+        defer owned.deinit();
+
+        errdefer |err| self.err = err;
+        if (self.nextObjectId == self.reservedEnd) try self.reserve();
+        const objectId = self.nextObjectId;
+        self.store.put(&self.storeKey, objectId, frame) catch |err| {
+            // Nothing else uses the reserved ids, so the batch can go
+            self.dropPending();
+            return err;
+        };
+        if (self.firstObjectId == null) self.firstObjectId = objectId;
+        self.pendingSizes[self.pending] = @intCast(frame.len);
+        self.pending += 1;
+        self.nextObjectId += 1;
+        if (self.pending == insert_batch) try self.flush();
+    }
+
+    /// Writes the metadata rows of all pending frames in one statement
+    pub fn flush(self: *StoreSink) !void {
+        if (self.pending == 0) return;
+        const sizes = self.pendingSizes[0..self.pending];
+        const firstObjectId = self.nextObjectId - sizes.len;
+
+        // Without their metadata rows the objects would be unreachable
+        errdefer self.dropPending();
+        errdefer |err| self.err = err;
+        var conn = try self.db.acquire();
+        defer conn.release();
+
+        _ = conn.exec(
+            \\INSERT INTO ciphertexts (session_id, object_id, size_bytes, stored_at)
+            \\SELECT $1::uuid, $2 + n - 1, size_bytes, $4::timestamp FROM unnest($3::bigint[]) WITH ORDINALITY AS frames (size_bytes, n);
+        ,
+            .{ self.sessionId, @as(i64, @intCast(firstObjectId)), sizes, std.time.microTimestamp() },
+        ) catch |err| {
+            if (conn.err) |pge| std.log.err("PG {s}\n", .{pge.message});
+            return err;
+        };
+        self.stored += sizes.len;
+        self.pending = 0;
+    }
+
+    /// Takes the next `insert_batch` ids off the session's counter. The row
+    /// lock of the UPDATE orders concurrent uploads.
+    fn reserve(self: *StoreSink) !void {
+        var conn = try self.db.acquire();
+        defer conn.release();
+
+        var row = (conn.row(
+            "UPDATE keys SET next_object_id = next_object_id + $2 WHERE session_id = $1 RETURNING next_object_id - $2;",
+            .{ self.sessionId, @as(i64, insert_batch) },
+        ) catch |err| {
+            if (conn.err) |pge| std.log.err("PG {s}\n", .{pge.message});
+            return err;
+        }) orelse return error.UnknownSession;
+        defer row.deinit() catch {};
+
+        self.nextObjectId = @intCast(row.get(i64, 0));
+        self.reservedEnd = self.nextObjectId + insert_batch;
+    }
+
+    /// Deletes the stored frames that have no metadata row yet. Their ids
+    /// were reserved by this sink, so no other upload's objects are touched.
+    fn dropPending(self: *StoreSink) void {
+        const firstObjectId = self.nextObjectId - self.pending;
+        for (0..self.pending) |i| self.store.delete(&self.storeKey, firstObjectId + i) catch {};
+        self.pending = 0;
+    }
+};
+
+/// Decodes the whole request body into `sink`, one chunk at a time
+pub fn ingest(fhe: openfhe.CryptoContext, req: *httpz.Request, sink: anytype) !u64 {
+    var stream = try openfhe.CiphertextStream.init(fhe, .binary, max_frame_size);
+    defer stream.deinit();
+
+    var body = try BodyReader.init(req);
+    var buf: [chunk_size]u8 = undefined;
+    while (try body.next(&buf)) |chunk| {
+        try stream.feed(chunk, sink);
+    }
+    try stream.finish();
+
+    return stream.count();
+}
@@ -0,0 +1,302 @@
+//! Content-addressed store for serialized evaluation keys.
+//!
+//! Eval mult and rotation (automorphism) keys are by far the largest objects
+//! a session owns. Each uploaded blob is written once as `<dir>/<sha256 hex>`,
+//! so uploading the same keys again only costs the hash, and Postgres maps
+//! (session, kind) to a digest. Any instance sharing the directory and the
+//! database can therefore serve the session after a restart.
+//!
+//! Keys are registered in the crypto context on the first job of a session,
+//! deserialized straight from a read-only mapping of the blob, and dropped by
+//! the sweeper once the session has been idle for `idle_timeout_ms`. They are
+//! registered under the session id rather than the tag the client's key pair
+//! chose, so no other session can load or clear them; jobs retag their input
+//! ciphertexts with `sessionTag` to evaluate with them.
+
+const std = @import("std");
+const pg = @import("pg");
+const openfhe = @import("openfhe");
+
+const ingest = @import("ingest.zig");
+
+pub const SessionId = [36]u8;
+pub const Digest = [std.crypto.hash.sha2.Sha256.digest_length * 2]u8;
+
+pub const Kind = enum {
+    mult,
+    automorphism,
+
+    pub fn parse(name: []const u8) ?Kind {
+        return std.meta.stringToEnum(Kind, name);
+    }
+};
+
+pub const default_idle_timeout_ms = 10 * std.time.ms_per_min;
+const sweep_interval_ns = 30 * std.time.ns_per_s;
+
+pub const KeyStore = struct {
+    allocator: std.mem.Allocator,
+    dir: std.fs.Dir,
+    fhe: openfhe.CryptoContext,
+    idle_timeout_ms: i64,
+
+    mutex: std.Thread.Mutex = .{},
+    loaded: std.AutoHashMapUnmanaged(SessionId, Loaded) = .empty,
+
+    /// OpenFHE keeps evaluation keys in process-wide maps that are not safe
+    /// to modify while other threads evaluate. Jobs hold this shared between
+    /// `acquire` and `release`; loading and dropping keys take it exclusively.
+    keysLock: std.Thread.RwLock = .{},
+
+    sweeper: ?std.Thread = null,
+    stopSweeper: std.Thread.ResetEvent = .{},
+
+    const Loaded = struct {
+        /// Tag of the session's key pair, which results have to carry
+        keyTag: [:0]u8,
+        users: u32,
+        lastUsedMs: i64,
+    };
+
+    pub const Saved = struct {
+        digest: Digest,
+        /// False if an identical blob was already stored
+        created: bool,
+    };
+
+    pub fn init(allocator: std.mem.Allocator, fhe: openfhe.CryptoContext, path: []const u8, idle_timeout_ms: i64) !KeyStore {
+        try std.fs.cwd().makePath(path);
+        return .{
+            .allocator = allocator,
+            .dir = try std.fs.cwd().openDir(path, .{}),
+            .fhe = fhe,
+            .idle_timeout_ms = idle_timeout_ms,
+        };
+    }
+
+    pub fn deinit(self: *KeyStore) void {
+        if (self.sweeper) |thread| {
+            self.stopSweeper.set();
+            thread.join();
+        }
+        var it = self.loaded.iterator();
+        while (it.next()) |entry| {
+            self.fhe.clearEvalKeys(&sessionTag(entry.key_ptr.*)) catch {};
+            self.allocator.free(entry.value_ptr.keyTag);
+        }
+        self.loaded.deinit(self.allocator);
+        self.dir.close();
+    }
+
+    /// Streams an uploaded blob to disk while hashing it and files it under
+    /// its digest. Memory use is one read chunk regardless of the key size.
+    pub fn save(self: *KeyStore, body: *ingest.BodyReader) !Saved {
+        var tmpNameBuf: [32]u8 = undefined;
+        const tmpName = try std.fmt.bufPrint(&tmpNameBuf, "tmp-{x}", .{std.crypto.random.int(u64)});
+        // Fails harmlessly once the file has been renamed
+        defer self.dir.deleteFile(tmpName) catch {};
+
+        var hasher = std.crypto.hash.sha2.Sha256.init(.{});
+        {
+            var file = try self.dir.createFile(tmpName, .{ .exclusive = true });
+            defer file.close();
+
+            var total: usize = 0;
+            var buf: [ingest.chunk_size]u8 = undefined;
+            while (try body.next(&buf)) |chunk| {
+                hasher.update(chunk);
+                try file.writeAll(chunk);
+                total += chunk.len;
+            }
+            if (total == 0) return error.EmptyKeyBlob;
+            try file.sync();
+        }
+
+        const digest = std.fmt.bytesToHex(hasher.finalResult(), .lower);
+        const exists = if (self.dir.access(&digest, .{})) |_| true else |err| switch (err) {
+            error.FileNotFound => false,
+            else => return err,
+        };
+        if (!exists) try self.dir.rename(tmpName, &digest);
+        return .{ .digest = digest, .created = !exists };
+    }
+
+    /// Removes a blob that failed validation or is no longer referenced
+    pub fn remove(self: *KeyStore, digest: *const Digest) void {
+        self.dir.deleteFile(digest) catch |err| {
+            std.log.warn("could not remove key blob {s}: {}", .{ digest, err });
+        };
+    }
+
+    /// Validates a freshly uploaded blob by loading it for the session. Fails
+    /// with `error.InvalidParam` if it holds keys of another key pair or
+    /// another context. Keys of a loaded session are replaced in place.
+    pub fn install(self: *KeyStore, conn: *pg.Conn, sessionId: SessionId, kind: Kind, digest: *const Digest) !void {
+        const keyTag = try sessionKeyTag(self.allocator, conn, &sessionId);
+        defer self.allocator.free(keyTag);
+
+        self.keysLock.lock();
+        defer self.keysLock.unlock();
+        try self.loadBlob(digest, kind, keyTag, sessionId);
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.loaded.getPtr(sessionId)) |entry| {
+            entry.lastUsedMs = std.time.milliTimestamp();
+        } else {
+            // Only tracked sessions may have keys in the context; the first
+            // job loads the complete set
+            self.fhe.clearEvalKeys(&sessionTag(sessionId)) catch {};
+        }
+    }
+
+    /// Makes sure the session's evaluation keys are registered in the context
+    /// under `sessionTag(sessionId)`, loading them on first use. Returns the
+    /// tag of the session's key pair, valid until `release`, which results
+    /// must carry again before they leave the job. Must be paired with
+    /// `release`, and a thread must not acquire a second session before
+    /// releasing the first.
+    pub fn acquire(self: *KeyStore, conn: *pg.Conn, sessionId: SessionId) ![:0]const u8 {
+        if (self.touch(sessionId)) |keyTag| {
+            self.keysLock.lockShared();
+            return keyTag;
+        }
+
+        const tag = try sessionKeyTag(self.allocator, conn, &sessionId);
+        var tagOwned = true;
+        defer if (tagOwned) self.allocator.free(tag);
+
+        var blobs = try conn.query("SELECT kind, digest FROM eval_keys WHERE session_id = $1;", .{@as([]const u8, &sessionId)});
+        defer blobs.deinit();
+
+        const keyTag = blk: {
+            self.keysLock.lock();
+            defer self.keysLock.unlock();
+
+            // Another request may have loaded the session in the meantime
+            if (self.touch(sessionId)) |loadedTag| break :blk loadedTag;
+            while (try blobs.next()) |row| {
+                const kind = Kind.parse(row.get([]u8, 0)) orelse return error.UnknownKeyKind;
+                const digest = row.get([]u8, 1);
+                if (digest.len != @sizeOf(Digest)) return error.InvalidDigest;
+                try self.loadBlob(digest[0..@sizeOf(Digest)], kind, tag, sessionId);
+            }
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            try self.loaded.put(self.allocator, sessionId, .{
+                .keyTag = tag,
+                .users = 1,
+                .lastUsedMs = std.time.milliTimestamp(),
+            });
+            tagOwned = false;
+            break :blk tag;
+        };
+        self.keysLock.lockShared();
+        return keyTag;
+    }
+
+    pub fn release(self: *KeyStore, sessionId: SessionId) void {
+        self.keysLock.unlockShared();
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.loaded.getPtr(sessionId)) |entry| {
+            entry.users -= 1;
+            entry.lastUsedMs = std.time.milliTimestamp();
+        }
+    }
+
+    /// Drops the session's keys from the context, e.g. when it is deleted
+    pub fn forget(self: *KeyStore, sessionId: SessionId) void {
+        self.keysLock.lock();
+        defer self.keysLock.unlock();
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = self.loaded.fetchRemove(sessionId) orelse return;
+        self.fhe.clearEvalKeys(&sessionTag(sessionId)) catch {};
+        self.allocator.free(entry.value.keyTag);
+    }
+
+    /// Drops the keys of every session idle for longer than the timeout.
+    /// Skips the round instead of waiting if jobs are running.
+    pub fn sweep(self: *KeyStore) void {
+        if (!self.keysLock.tryLock()) return;
+        defer self.keysLock.unlock();
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const cutoff = std.time.milliTimestamp() - self.idle_timeout_ms;
+        var it = self.loaded.iterator();
+        while (it.next()) |entry| {
+            if (entry.value_ptr.users > 0 or entry.value_ptr.lastUsedMs > cutoff) continue;
+            self.fhe.clearEvalKeys(&sessionTag(entry.key_ptr.*)) catch {};
+            self.allocator.free(entry.value_ptr.keyTag);
+            // Removing the current entry keeps the iterator valid
+            self.loaded.removeByPtr(entry.key_ptr);
+        }
+    }
+
+    pub fn startSweeper(self: *KeyStore) !void {
+        self.sweeper = try std.Thread.spawn(.{}, runSweeper, .{self});
+    }
+
+    fn runSweeper(self: *KeyStore) void {
+        while (true) {
+            self.stopSweeper.timedWait(sweep_interval_ns) catch {
+                self.sweep();
+                continue;
+            };
+            return;
+        }
+    }
+
+    /// Marks a loaded session as used and returns its key pair's tag; null
+    /// if its keys are not loaded
+    fn touch(self: *KeyStore, sessionId: SessionId) ?[:0]const u8 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = self.loaded.getPtr(sessionId) orelse return null;
+        entry.users += 1;
+        entry.lastUsedMs = std.time.milliTimestamp();
+        return entry.keyTag;
+    }
+
+    /// Deserializes a blob into the context from a read-only mapping, so the
+    /// file is never copied onto the heap. The keys must carry `keyTag` and
+    /// are registered under the session. Caller holds `keysLock` exclusively.
+    fn loadBlob(self: *KeyStore, digest: *const Digest, kind: Kind, keyTag: [:0]const u8, sessionId: SessionId) !void {
+        var file = try self.dir.openFile(digest, .{});
+        defer file.close();
+
+        const size = (try file.stat()).size;
+        if (size == 0) return error.EmptyKeyBlob;
+        const data = try std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+        defer std.posix.munmap(data);
+
+        const registerTag = sessionTag(sessionId);
+        switch (kind) {
+            .mult => try self.fhe.deserializeEvalMultKeysTagged(data, .binary, keyTag, &registerTag),
+            .automorphism => try self.fhe.deserializeEvalAutomorphismKeysTagged(data, .binary, keyTag, &registerTag),
+        }
+    }
+};
+
+/// Tag the session's evaluation keys are registered under
+pub fn sessionTag(sessionId: SessionId) [@sizeOf(SessionId):0]u8 {
+    var tag = [_:0]u8{0} ** @sizeOf(SessionId);
+    @memcpy(&tag, &sessionId);
+    return tag;
+}
+
+/// Tag of the session's key pair, derived from its registered public key
+fn sessionKeyTag(allocator: std.mem.Allocator, conn: *pg.Conn, sessionId: []const u8) ![:0]u8 {
+    var row = (try conn.row("SELECT public_key FROM keys WHERE session_id = $1;", .{sessionId})) orelse return error.UnknownSession;
+    defer row.deinit() catch {};
+
+    var pk = try openfhe.PublicKey.deserialize(row.get([]u8, 0), .binary);
+    defer pk.deinit();
+    return pk.getTag(allocator);
+}
@@ -6,18 +6,6 @@ const server = @import("server.zig");
 const openfhe = @import("openfhe");
 
 pub fn main() !void {
-    // Test OpenFHE BGV wrapper
-    std.log.info("Initializing OpenFHE BGV context...", .{});
-    var ctx = openfhe.CryptoContext.createBgv(.{
-        .multiplicative_depth = 2,
-        .plaintext_modulus = 65537,
-    }) catch |err| {
-        std.log.err("Failed to create BGV context: {s}", .{openfhe.getLastError()});
-        return err;
-    };
-    defer ctx.deinit();
-    std.log.info("OpenFHE BGV context created. Ring dimension: {}", .{ctx.getRingDim()});
-
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     const allocator = gpa.allocator();
 
@@ -33,18 +21,92 @@ pub fn main() !void {
         },
     };
 
+    var ctx = try initContext(allocator, config.storeDir, config.fhe);
+    defer ctx.deinit();
+    std.log.info("OpenFHE BGV context ready. Ring dimension: {}", .{ctx.getRingDim()});
+
+    // Worker processes split the budget, so the total stays the same
+    openfhe.ZeroPool.setBudget(config.zeroPoolMb * 1024 * 1024 / @max(config.workers, 1));
+    if (config.workerFds) |fds| return server.serveWorker(allocator, ctx, fds, config.zeroPoolSize);
+
+    // Measured on this machine, so admission control matches its speed
+    const costModel = ctx.calibrateCostModel(server.cost_calibration_iterations) catch |err| {
+        std.log.err("Failed to calibrate the cost model: {s}", .{openfhe.getLastError()});
+        return err;
+    };
+    std.log.info("Cost model: add {d:.0} us, mult {d:.0} us, rotation {d:.0} us, decode {d:.0} us", .{
+        costModel.freshOpNs(.add) / std.time.ns_per_us,
+        costModel.freshOpNs(.mult) / std.time.ns_per_us,
+        costModel.freshOpNs(.rotate) / std.time.ns_per_us,
+        costModel.freshOpNs(.deserialize) / std.time.ns_per_us,
+    });
+
     var db = try pg.Pool.init(allocator, .{
         .connect = .{ .port = config.dbPort, .host = config.dbHost },
         .auth = .{ .username = config.dbUser, .database = config.dbDatabase, .password = config.dbPassword },
     });
     defer db.deinit();
 
+    var store = openfhe.SegmentStore.open(config.storeDir, 0) catch |err| {
+        std.log.err("Failed to open segment store in {s}: {s}", .{ config.storeDir, openfhe.getLastError() });
+        return err;
+    };
+    defer store.close();
+    const storeStats = store.stats();
+    std.log.info("Segment store: {} objects in {} segments", .{ storeStats.live_objects, storeStats.segments });
+
+    // Compacting the result cache never has to move the uploads
+    const resultsDir = try std.fs.path.joinZ(allocator, &.{ config.storeDir, "results" });
+    defer allocator.free(resultsDir);
+    var resultStore = openfhe.SegmentStore.open(resultsDir, 0) catch |err| {
+        std.log.err("Failed to open segment store in {s}: {s}", .{ resultsDir, openfhe.getLastError() });
+        return err;
+    };
+    defer resultStore.close();
+
+    const keysDir = try std.fs.path.join(allocator, &.{ config.storeDir, "keys" });
+    defer allocator.free(keysDir);
+
     var app = server.App{
         .db = db,
         .config = config,
+        .fhe = ctx,
+        .results = server.ResultStore.init(allocator),
+        .store = store,
+        .keys = try server.KeyStore.init(allocator, ctx, keysDir, server.default_key_idle_timeout_ms),
+        .zeros = server.ZeroPools.init(allocator, ctx, config.zeroPoolSize, server.default_zero_pool_idle_timeout_ms),
+        .scheduler = server.Scheduler.init(allocator, costModel, .{
+            .slots = if (config.maxJobs > 0) config.maxJobs else @intCast(std.Thread.getCpuCount() catch 1),
+            .memoryBudget = if (config.memoryBudgetMb > 0)
+                config.memoryBudgetMb * 1024 * 1024
+            else
+                (std.process.totalSystemMemory() catch 8 * 1024 * 1024 * 1024) / 2,
+            .maxWaitNs = config.maxQueueWaitMs * std.time.ns_per_ms,
+        }),
+        .cache = undefined,
+        .compactor = undefined,
     };
+    app.cache = server.ResultCache.init(allocator, resultStore, config.resultCacheMb * 1024 * 1024);
+    defer app.cache.deinit();
+    app.compactor = server.Compactor.init(store, &app.storeLock);
+    defer app.compactor.deinit();
+    defer app.results.deinit();
+    defer app.scheduler.deinit();
+    defer app.keys.deinit();
+    defer app.zeros.deinit();
+    try app.keys.startSweeper();
+    try app.zeros.startSweeper();
+    try app.compactor.start();
     try app.initDb();
 
+    var workerPool: ?server.WorkerPool = null;
+    if (config.workers > 0) {
+        workerPool = try server.WorkerPool.init(allocator, config.workers);
+        app.workers = &workerPool.?;
+        std.log.info("FHE work runs in {} worker processes", .{config.workers});
+    }
+    defer if (workerPool) |*pool| pool.deinit();
+
     var appServer = try server.initServer(allocator, &app);
     defer {
         appServer.stop();
@@ -55,6 +117,41 @@ pub fn main() !void {
     try appServer.listen();
 }
 
+/// Restores the BGV context from its snapshot in the store directory, or
+/// builds it and writes the snapshot so the next boot can skip the setup.
+/// The file name carries a hash of the parameters, so changing them never
+/// picks up a stale snapshot.
+fn initContext(allocator: std.mem.Allocator, storeDir: []const u8, params: openfhe.BgvParams) !openfhe.CryptoContext {
+    var hasher = std.hash.Wyhash.init(0);
+    std.hash.autoHash(&hasher, params);
+    var nameBuf: [64]u8 = undefined;
+    const name = try std.fmt.bufPrint(&nameBuf, "context-{x:0>16}.snap", .{hasher.final()});
+    const path = try std.fs.path.joinZ(allocator, &.{ storeDir, name });
+    defer allocator.free(path);
+
+    if (std.fs.cwd().access(path, .{})) |_| {
+        if (openfhe.CryptoContext.loadSnapshot(path)) |ctx| {
+            std.log.info("Restored BGV context from {s}", .{path});
+            return ctx;
+        } else |_| {
+            std.log.warn("Ignoring context snapshot {s}: {s}", .{ path, openfhe.getLastError() });
+        }
+    } else |_| {}
+
+    std.log.info("Initializing OpenFHE BGV context...", .{});
+    var ctx = openfhe.CryptoContext.createBgv(params) catch |err| {
+        std.log.err("Failed to create BGV context: {s}", .{openfhe.getLastError()});
+        return err;
+    };
+    errdefer ctx.deinit();
+
+    try std.fs.cwd().makePath(storeDir);
+    ctx.saveSnapshot(path) catch {
+        std.log.warn("Could not write context snapshot {s}: {s}", .{ path, openfhe.getLastError() });
+    };
+    return ctx;
+}
+
 pub const ParseArgsResult = union(enum) {
     ok: server.AppConfig,
     err: []const u8, // allocated, caller must free on error
@@ -68,6 +165,16 @@ pub fn parseArgs(alloc: std.mem.Allocator, args: *std.process.ArgIterator) Parse
     var dbUser: ?[]const u8 = null;
     var dbPassword: ?[]const u8 = null;
     var dbDatabase: ?[]const u8 = null;
+    var storeDir: ?[:0]const u8 = null;
+    var fhe: openfhe.BgvParams = .{};
+    var maxJobs: u32 = 0;
+    var memoryBudgetMb: u64 = 0;
+    var maxQueueWaitMs: u64 = server.default_max_queue_wait_ms;
+    var workers: u32 = 0;
+    var resultCacheMb: u64 = server.default_result_cache_mb;
+    var zeroPoolSize: u32 = server.default_zero_pool_capacity;
+    var zeroPoolMb: u64 = server.default_zero_pool_mb;
+    var workerFds: ?server.WorkerFds = null;
 
     const exec = args.next() orelse "app";
     while (args.next()) |flag| {
@@ -91,6 +198,70 @@ pub fn parseArgs(alloc: std.mem.Allocator, args: *std.process.ArgIterator) Parse
             dbPassword = args.next() orelse return expectedArgValueError(alloc, flag, "db password");
         } else if (std.mem.eql(u8, flag, "--db-database")) {
             dbDatabase = args.next() orelse return expectedArgValueError(alloc, flag, "db database");
+        } else if (std.mem.eql(u8, flag, "--store-dir")) {
+            storeDir = args.next() orelse return expectedArgValueError(alloc, flag, "store directory");
+        } else if (std.mem.eql(u8, flag, "--fhe-depth")) {
+            const depthArg = args.next() orelse return expectedArgValueError(alloc, flag, "multiplicative depth");
+            fhe.multiplicative_depth = std.fmt.parseInt(u32, depthArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "multiplicative depth must be a number") catch "multiplicative depth must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--fhe-plaintext-modulus")) {
+            const modulusArg = args.next() orelse return expectedArgValueError(alloc, flag, "plaintext modulus");
+            fhe.plaintext_modulus = std.fmt.parseInt(u64, modulusArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "plaintext modulus must be a number") catch "plaintext modulus must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--fhe-ring-dim")) {
+            const ringDimArg = args.next() orelse return expectedArgValueError(alloc, flag, "ring dimension");
+            fhe.ring_dim = std.fmt.parseInt(u32, ringDimArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "ring dimension must be a number") catch "ring dimension must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--fhe-security")) {
+            const securityArg = args.next() orelse return expectedArgValueError(alloc, flag, "security level");
+            fhe.security_level = std.fmt.parseInt(u32, securityArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "security level must be a number") catch "security level must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--max-jobs")) {
+            const maxJobsArg = args.next() orelse return expectedArgValueError(alloc, flag, "job count");
+            maxJobs = std.fmt.parseInt(u32, maxJobsArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "job count must be a number") catch "job count must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--memory-budget-mb")) {
+            const budgetArg = args.next() orelse return expectedArgValueError(alloc, flag, "memory budget");
+            memoryBudgetMb = std.fmt.parseInt(u64, budgetArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "memory budget must be a number") catch "memory budget must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--max-queue-wait-ms")) {
+            const waitArg = args.next() orelse return expectedArgValueError(alloc, flag, "queue wait");
+            maxQueueWaitMs = std.fmt.parseInt(u64, waitArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "queue wait must be a number") catch "queue wait must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--workers")) {
+            const workersArg = args.next() orelse return expectedArgValueError(alloc, flag, "worker count");
+            workers = std.fmt.parseInt(u32, workersArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "worker count must be a number") catch "worker count must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--result-cache-mb")) {
+            const cacheArg = args.next() orelse return expectedArgValueError(alloc, flag, "result cache size");
+            resultCacheMb = std.fmt.parseInt(u64, cacheArg, 10) catch {
+                return .{ .err = alloc.dupe(u8, "result cache size must be a number") catch "result cache size must be a number" };
+            };
+        } else if (std.mem.eql(u8, flag, "--zero-pool-size")) {
+            const poolArg = args.next() orelse return expectedArgValueError(alloc, flag, "zero pool size");
+            zeroPoolSize = std.fmt.parseInt(u32, poolArg, 10) catch 0;
+            if (zeroPoolSize == 0) {
+                return .{ .err = alloc.dupe(u8, "zero pool size must be a positive number") catch "zero pool size must be a positive number" };
+            }
+        } else if (std.mem.eql(u8, flag, "--zero-pool-mb")) {
+            const budgetArg = args.next() orelse return expectedArgValueError(alloc, flag, "zero pool memory");
+            zeroPoolMb = std.fmt.parseInt(u64, budgetArg, 10) catch 0;
+            if (zeroPoolMb == 0) {
+                return .{ .err = alloc.dupe(u8, "zero pool memory must be a positive number") catch "zero pool memory must be a positive number" };
+            }
+        } else if (std.mem.eql(u8, flag, "--worker-fds")) {
+            const fdsArg = args.next() orelse return expectedArgValueError(alloc, flag, "worker descriptors");
+            workerFds = server.WorkerFds.parse(fdsArg) orelse {
+                return .{ .err = alloc.dupe(u8, "worker descriptors must be <socket>,<region>") catch "worker descriptors must be <socket>,<region>" };
+            };
         }
     }
 
@@ -101,6 +272,7 @@ pub fn parseArgs(alloc: std.mem.Allocator, args: *std.process.ArgIterator) Parse
     if (dbUser == null) return missedArgError(alloc, exec, "--db-user");
     if (dbPassword == null) return missedArgError(alloc, exec, "--db-password");
     if (dbDatabase == null) return missedArgError(alloc, exec, "--db-database");
+    if (storeDir == null) return missedArgError(alloc, exec, "--store-dir");
 
     return .{ .ok = .{
         .appHost = appHost.?,
@@ -110,6 +282,16 @@ pub fn parseArgs(alloc: std.mem.Allocator, args: *std.process.ArgIterator) Parse
         .dbUser = dbUser.?,
         .dbPassword = dbPassword.?,
         .dbDatabase = dbDatabase.?,
+        .storeDir = storeDir.?,
+        .fhe = fhe,
+        .maxJobs = maxJobs,
+        .memoryBudgetMb = memoryBudgetMb,
+        .maxQueueWaitMs = maxQueueWaitMs,
+        .workers = workers,
+        .resultCacheMb = resultCacheMb,
+        .zeroPoolSize = zeroPoolSize,
+        .zeroPoolMb = zeroPoolMb,
+        .workerFds = workerFds,
     } };
 }
 
@@ -123,13 +305,31 @@ fn missedArgError(alloc: std.mem.Allocator, exec: []const u8, argFlag: []const u
         \\{s} missing
         \\usage: {s} [options]
         \\Options:
-        \\  --app-host       Host to serve application
-        \\  --app-port       Port to serve application
-        \\  --db-host        Database host
-        \\  --db-port        Database port
-        \\  --db-user        Database user
-        \\  --db-password    Database password
-        \\  --db-database    Database name
+        \\  --app-host               Host to serve application
+        \\  --app-port               Port to serve application
+        \\  --db-host                Database host
+        \\  --db-port                Database port
+        \\  --db-user                Database user
+        \\  --db-password            Database password
+        \\  --db-database            Database name
+        \\  --store-dir              Directory for ciphertext segments and evaluation keys
+        \\  --fhe-depth              BGV multiplicative depth (default 2)
+        \\  --fhe-plaintext-modulus  BGV plaintext modulus (default 65537)
+        \\  --fhe-ring-dim           BGV ring dimension (default: smallest secure)
+        \\  --fhe-security           Security level in bits: 128, 192 or 256 (default 128)
+        \\  --max-jobs               FHE requests running at once (default: one per core)
+        \\  --memory-budget-mb       Memory for running FHE requests (default: half the RAM)
+        \\  --max-queue-wait-ms      Longest predicted queue wait before 429 (default 30000)
+        \\  --workers                FHE worker processes (default 0: work in the API process)
+        \\  --zero-pool-size         Encryptions of zero kept ready per session (default 16)
+        \\  --zero-pool-mb           Memory for encryptions of zero of all sessions (default 256)
+        \\  --result-cache-mb        Store space for memoized analysis results (default 1024)
     , .{ argFlag, exec }) catch "error: missing required argument";
     return .{ .err = msg };
 }
+
+test {
+    _ = @import("cache.zig");
+    _ = @import("scheduler.zig");
+    _ = @import("workers.zig");
+}
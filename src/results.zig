@@ -0,0 +1,127 @@
+//! Encrypted analysis results waiting to be downloaded.
+//!
+//! Jobs publish result ciphertexts per session. The download route streams
+//! copies of them to the client, see `stream`, and they stay until the client
+//! acknowledges them, so a download that breaks off loses nothing.
+
+const std = @import("std");
+const httpz = @import("httpz");
+const openfhe = @import("openfhe");
+
+pub const SessionId = [36]u8;
+
+pub const ResultStore = struct {
+    allocator: std.mem.Allocator,
+    mutex: std.Thread.Mutex = .{},
+    sessions: std.AutoHashMapUnmanaged(SessionId, std.ArrayList(openfhe.Ciphertext)) = .empty,
+
+    pub fn init(allocator: std.mem.Allocator) ResultStore {
+        return .{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *ResultStore) void {
+        var it = self.sessions.valueIterator();
+        while (it.next()) |list| {
+            for (list.items) |*ct| ct.deinit();
+            list.deinit(self.allocator);
+        }
+        self.sessions.deinit(self.allocator);
+    }
+
+    /// Publish a result for the session; the store takes ownership of `ct`
+    pub fn put(self: *ResultStore, sessionId: SessionId, ct: openfhe.Ciphertext) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = try self.sessions.getOrPut(self.allocator, sessionId);
+        if (!entry.found_existing) entry.value_ptr.* = .empty;
+        try entry.value_ptr.append(self.allocator, ct);
+    }
+
+    /// Number of results waiting for the session
+    pub fn pending(self: *ResultStore, sessionId: SessionId) usize {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const list = self.sessions.get(sessionId) orelse return 0;
+        return list.items.len;
+    }
+
+    /// Copies of the session's pending results, oldest first, which stay
+    /// pending. Copies are copy-on-write, so this is cheap; the caller owns
+    /// them and must release them with `release`.
+    pub fn snapshot(self: *ResultStore, sessionId: SessionId) !?std.ArrayList(openfhe.Ciphertext) {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const list = self.sessions.get(sessionId) orelse return null;
+        var copies = try std.ArrayList(openfhe.Ciphertext).initCapacity(self.allocator, list.items.len);
+        for (list.items) |ct| copies.appendAssumeCapacity(ct.clone());
+        return copies;
+    }
+
+    /// Drops the session's `count` oldest results once the client has them.
+    /// Returns how many were dropped, fewer if fewer were pending.
+    pub fn acknowledge(self: *ResultStore, sessionId: SessionId, count: usize) usize {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const list = self.sessions.getPtr(sessionId) orelse return 0;
+        const dropped = @min(count, list.items.len);
+        for (list.items[0..dropped]) |*ct| ct.deinit();
+        list.replaceRangeAssumeCapacity(0, dropped, &.{});
+        if (list.items.len == 0) {
+            list.deinit(self.allocator);
+            _ = self.sessions.remove(sessionId);
+        }
+        return dropped;
+    }
+
+    /// Remove and return all pending results of the session. The caller owns
+    /// the ciphertexts and must release them with `release`.
+    pub fn take(self: *ResultStore, sessionId: SessionId) ?std.ArrayList(openfhe.Ciphertext) {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = self.sessions.fetchRemove(sessionId) orelse return null;
+        return entry.value;
+    }
+
+    pub fn release(self: *ResultStore, results: *std.ArrayList(openfhe.Ciphertext)) void {
+        for (results.items) |*ct| ct.deinit();
+        results.deinit(self.allocator);
+    }
+};
+
+/// Writes serialized bytes to a chunked response as length-prefixed blocks
+const BlockWriter = struct {
+    res: *httpz.Response,
+
+    pub fn writeAll(self: BlockWriter, bytes: []const u8) !void {
+        var prefix: [4]u8 = undefined;
+        std.mem.writeInt(u32, &prefix, @intCast(bytes.len), .little);
+        try self.res.chunk(&prefix);
+        if (bytes.len > 0) try self.res.chunk(bytes);
+    }
+};
+
+/// Streams ciphertexts with chunked transfer encoding, serializing each one
+/// directly into the response. Every ciphertext is sent as a sequence of
+/// blocks (u32 little-endian length, then the bytes) closed by a zero-length
+/// block, so neither side needs to know its size up front.
+pub fn stream(res: *httpz.Response, cts: []const openfhe.Ciphertext) !void {
+    res.content_type = .BINARY;
+    const writer = BlockWriter{ .res = res };
+    for (cts) |ct| {
+        try ct.serializeTo(.binary, writer);
+        try writer.writeAll(&.{});
+    }
+}
+
+/// Streams one already serialized ciphertext in the same blocks as `stream`
+pub fn streamSerialized(res: *httpz.Response, bytes: []const u8) !void {
+    res.content_type = .BINARY;
+    const writer = BlockWriter{ .res = res };
+    try writer.writeAll(bytes);
+    try writer.writeAll(&.{});
+}
@@ -0,0 +1,327 @@
+//! Admission control and shortest-job-first scheduling of FHE work.
+//!
+//! Requests that do FHE work ask for a slot with their predicted cost (CPU
+//! time and peak memory from the calibrated cost model) before they start.
+//! They run at once if a slot and the memory are free. Otherwise they queue,
+//! and freed slots go to the waiting job with the earliest predicted finish
+//! (arrival plus CPU time), so short jobs overtake long ones but a long job
+//! is not passed forever. Jobs above `Config.longJobNs` may hold all slots
+//! but one, so cheap requests such as `/register` never wait behind a few
+//! huge ones. A request whose predicted wait exceeds `Config.maxWaitNs` is
+//! turned away with 429 and a Retry-After, one that can never fit the memory
+//! budget with 413.
+
+const std = @import("std");
+const openfhe = @import("openfhe");
+
+pub const default_max_wait_ms = 30 * std.time.ms_per_s;
+pub const default_long_job_ms = 500;
+/// Iterations per operation when calibrating the cost model at startup
+pub const calibration_iterations = 3;
+
+pub const Cost = struct {
+    cpuNs: u64,
+    peakBytes: u64,
+};
+
+pub const Ticket = struct {
+    cost: Cost,
+    long: bool,
+};
+
+pub const Admission = union(enum) {
+    admitted: Ticket,
+    /// Seconds the client should wait before retrying
+    busy: u64,
+    too_large,
+};
+
+pub const Config = struct {
+    /// Jobs running at once
+    slots: u32,
+    /// Bytes the running jobs may hold together
+    memoryBudget: u64,
+    maxWaitNs: u64 = default_max_wait_ms * std.time.ns_per_ms,
+    longJobNs: u64 = default_long_job_ms * std.time.ns_per_ms,
+};
+
+pub const Scheduler = struct {
+    allocator: std.mem.Allocator,
+    model: openfhe.CostModel,
+    config: Config,
+    /// Cores the predicted CPU time is spread over
+    cores: u64,
+
+    mutex: std.Thread.Mutex = .{},
+    running: u32 = 0,
+    runningLong: u32 = 0,
+    runningBytes: u64 = 0,
+    runningNs: u64 = 0,
+    waiting: std.ArrayList(*Waiter) = .empty,
+
+    const Waiter = struct {
+        cost: Cost,
+        long: bool,
+        /// Predicted finish if it ran alone: arrival plus CPU time
+        key: i128,
+        granted: std.Thread.ResetEvent = .{},
+    };
+
+    pub fn init(allocator: std.mem.Allocator, model: openfhe.CostModel, config: Config) Scheduler {
+        std.debug.assert(config.slots > 0);
+        return .{
+            .allocator = allocator,
+            .model = model,
+            .config = config,
+            .cores = std.Thread.getCpuCount() catch 1,
+        };
+    }
+
+    pub fn deinit(self: *Scheduler) void {
+        self.waiting.deinit(self.allocator);
+    }
+
+    /// Runs the job now, queues it until a slot frees up, or turns it away.
+    /// An admitted job must be passed to `release` when it is done.
+    pub fn acquire(self: *Scheduler, cost: Cost) Admission {
+        const long = cost.cpuNs >= self.config.longJobNs;
+        var waiter = Waiter{ .cost = cost, .long = long, .key = std.time.nanoTimestamp() + cost.cpuNs };
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            if (cost.peakBytes > self.config.memoryBudget) return .too_large;
+            if (self.waiting.items.len == 0 and self.fits(cost, long)) {
+                self.start(cost, long);
+                return .{ .admitted = .{ .cost = cost, .long = long } };
+            }
+
+            const waitNs = self.predictedWaitNs(waiter.key);
+            if (waitNs > self.config.maxWaitNs) return .{ .busy = retryAfter(waitNs) };
+            self.waiting.append(self.allocator, &waiter) catch return .{ .busy = retryAfter(waitNs) };
+            // It may fit where the jobs ahead of it do not
+            self.dispatch();
+        }
+        waiter.granted.wait();
+        return .{ .admitted = .{ .cost = cost, .long = long } };
+    }
+
+    pub fn release(self: *Scheduler, ticket: Ticket) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        self.running -= 1;
+        if (ticket.long) self.runningLong -= 1;
+        self.runningBytes -= ticket.cost.peakBytes;
+        self.runningNs -= ticket.cost.cpuNs;
+        self.dispatch();
+    }
+
+    /// Decoding `bytes` of serialized ciphertexts, each held in memory while
+    /// it is decoded
+    pub fn deserializeCost(self: *const Scheduler, bytes: u64) Cost {
+        const ctBytes = self.model.ciphertextBytes();
+        const count = @max(1, std.math.divCeil(u64, bytes, ctBytes) catch 1);
+        return .{
+            .cpuNs = count * self.opNs(.deserialize),
+            .peakBytes = 2 * ctBytes,
+        };
+    }
+
+    /// Decoding a streamed body whose length is not known up front. It may be
+    /// as large as any upload, so it always counts as a long job and can
+    /// never take the slot kept for short ones.
+    pub fn streamCost(self: *const Scheduler) Cost {
+        const ctBytes = self.model.ciphertextBytes();
+        return .{
+            .cpuNs = @max(self.config.longJobNs, self.opNs(.deserialize)),
+            .peakBytes = 2 * ctBytes,
+        };
+    }
+
+    /// Re-randomizing and serializing `count` results already in memory
+    pub fn downloadCost(self: *const Scheduler, count: usize) Cost {
+        return .{
+            .cpuNs = count * (self.opNs(.add) + self.opNs(.deserialize)),
+            .peakBytes = self.model.ciphertextBytes(),
+        };
+    }
+
+    pub const Stats = struct {
+        running: u32,
+        waiting: usize,
+        runningBytes: u64,
+    };
+
+    pub fn stats(self: *Scheduler) Stats {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return .{ .running = self.running, .waiting = self.waiting.items.len, .runningBytes = self.runningBytes };
+    }
+
+    fn opNs(self: *const Scheduler, op: openfhe.FheOp) u64 {
+        return @intFromFloat(@ceil(self.model.freshOpNs(op)));
+    }
+
+    fn fits(self: *const Scheduler, cost: Cost, long: bool) bool {
+        if (self.running >= self.config.slots) return false;
+        // Long jobs leave a slot for short ones
+        if (long and self.runningLong + 1 >= self.config.slots and self.config.slots > 1) return false;
+        // A job bigger than what is left of the budget runs once it is alone
+        return self.running == 0 or self.runningBytes + cost.peakBytes <= self.config.memoryBudget;
+    }
+
+    fn start(self: *Scheduler, cost: Cost, long: bool) void {
+        self.running += 1;
+        if (long) self.runningLong += 1;
+        self.runningBytes += cost.peakBytes;
+        self.runningNs += cost.cpuNs;
+    }
+
+    /// Starts waiting jobs in order of predicted finish while they fit
+    fn dispatch(self: *Scheduler) void {
+        while (true) {
+            var best: ?usize = null;
+            for (self.waiting.items, 0..) |waiter, i| {
+                if (!self.fits(waiter.cost, waiter.long)) continue;
+                if (best == null or waiter.key < self.waiting.items[best.?].key) best = i;
+            }
+            const waiter = self.waiting.swapRemove(best orelse return);
+            self.start(waiter.cost, waiter.long);
+            waiter.granted.set();
+        }
+    }
+
+    /// Wall time until a job with `key` would start: the running work and
+    /// every waiting job due before it, spread over the cores
+    fn predictedWaitNs(self: *const Scheduler, key: i128) u64 {
+        var aheadNs = self.runningNs;
+        for (self.waiting.items) |waiter| {
+            if (waiter.key <= key) aheadNs += waiter.cost.cpuNs;
+        }
+        return aheadNs / self.cores;
+    }
+
+    fn retryAfter(waitNs: u64) u64 {
+        return @max(1, std.math.divCeil(u64, waitNs, std.time.ns_per_s) catch 1);
+    }
+};
+
+fn testScheduler(config: Config) Scheduler {
+    var scheduler = Scheduler.init(std.testing.allocator, .{ .raw = std.mem.zeroes(@FieldType(openfhe.CostModel, "raw")) }, config);
+    // Predicted waits in CPU time, whatever the machine
+    scheduler.cores = 1;
+    return scheduler;
+}
+
+fn waitForQueue(scheduler: *Scheduler, waiting: usize) void {
+    while (scheduler.stats().waiting != waiting) std.Thread.sleep(std.time.ns_per_ms);
+}
+
+const ms = std.time.ns_per_ms;
+
+test "scheduler admits while slots and memory are free" {
+    var scheduler = testScheduler(.{ .slots = 2, .memoryBudget = 100, .maxWaitNs = 0 });
+    defer scheduler.deinit();
+
+    const a = scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 60 }).admitted;
+    // Over what is left of the budget, and no time to wait for it
+    try std.testing.expect(scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 60 }) == .busy);
+    const b = scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 40 }).admitted;
+    try std.testing.expectEqual(@as(u64, 100), scheduler.stats().runningBytes);
+    // Both slots are taken
+    try std.testing.expect(scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 0 }) == .busy);
+
+    scheduler.release(a);
+    scheduler.release(b);
+    try std.testing.expectEqual(Scheduler.Stats{ .running = 0, .waiting = 0, .runningBytes = 0 }, scheduler.stats());
+
+    // A job bigger than the budget can never run
+    try std.testing.expect(scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 101 }) == .too_large);
+}
+
+test "scheduler turns jobs away when the predicted wait is too long" {
+    var scheduler = testScheduler(.{ .slots = 1, .memoryBudget = 100, .maxWaitNs = 1000 * ms });
+    defer scheduler.deinit();
+
+    const running = scheduler.acquire(.{ .cpuNs = 2500 * ms, .peakBytes = 10 }).admitted;
+    defer scheduler.release(running);
+
+    // 2.5 s of work ahead, rounded up
+    try std.testing.expectEqual(Admission{ .busy = 3 }, scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 10 }));
+    try std.testing.expectEqual(@as(usize, 0), scheduler.stats().waiting);
+}
+
+const Grants = struct {
+    mutex: std.Thread.Mutex = .{},
+    order: [4]u64 = undefined,
+    len: usize = 0,
+
+    fn run(self: *Grants, scheduler: *Scheduler, cost: Cost) void {
+        const ticket = scheduler.acquire(cost).admitted;
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.order[self.len] = cost.cpuNs;
+            self.len += 1;
+        }
+        scheduler.release(ticket);
+    }
+};
+
+test "scheduler grants queued jobs shortest predicted finish first" {
+    var scheduler = testScheduler(.{ .slots = 1, .memoryBudget = 100, .maxWaitNs = std.time.ns_per_hour });
+    defer scheduler.deinit();
+
+    const running = scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 10 }).admitted;
+
+    var grants = Grants{};
+    const long = try std.Thread.spawn(.{}, Grants.run, .{ &grants, &scheduler, Cost{ .cpuNs = 60 * std.time.ns_per_s, .peakBytes = 10 } });
+    waitForQueue(&scheduler, 1);
+    // Arrives later but is due first
+    const short = try std.Thread.spawn(.{}, Grants.run, .{ &grants, &scheduler, Cost{ .cpuNs = 2 * ms, .peakBytes = 10 } });
+    waitForQueue(&scheduler, 2);
+
+    scheduler.release(running);
+    long.join();
+    short.join();
+    try std.testing.expectEqualSlices(u64, &.{ 2 * ms, 60 * std.time.ns_per_s }, grants.order[0..grants.len]);
+}
+
+test "scheduler keeps a slot free for short jobs" {
+    var scheduler = testScheduler(.{ .slots = 2, .memoryBudget = 100, .maxWaitNs = std.time.ns_per_hour, .longJobNs = 500 * ms });
+    defer scheduler.deinit();
+
+    const first = scheduler.acquire(.{ .cpuNs = std.time.ns_per_s, .peakBytes = 10 }).admitted;
+    try std.testing.expect(first.long);
+
+    // A second long job would take the last slot, so it waits
+    var grants = Grants{};
+    const second = try std.Thread.spawn(.{}, Grants.run, .{ &grants, &scheduler, Cost{ .cpuNs = 2 * std.time.ns_per_s, .peakBytes = 10 } });
+    waitForQueue(&scheduler, 1);
+
+    // A short one still gets in ahead of it
+    const short = scheduler.acquire(.{ .cpuNs = ms, .peakBytes = 10 }).admitted;
+    try std.testing.expect(!short.long);
+    try std.testing.expectEqual(@as(u32, 2), scheduler.stats().running);
+    try std.testing.expectEqual(@as(usize, 1), scheduler.stats().waiting);
+    scheduler.release(short);
+    try std.testing.expectEqual(@as(usize, 1), scheduler.stats().waiting);
+
+    // The long job starts once the other long one is done
+    scheduler.release(first);
+    second.join();
+    try std.testing.expectEqual(@as(usize, 1), grants.len);
+    try std.testing.expectEqual(Scheduler.Stats{ .running = 0, .waiting = 0, .runningBytes = 0 }, scheduler.stats());
+}
+
+test "scheduler charges streams of unknown length as long jobs" {
+    var scheduler = testScheduler(.{ .slots = 2, .memoryBudget = 100, .maxWaitNs = 0, .longJobNs = 500 * ms });
+    defer scheduler.deinit();
+
+    const stream = scheduler.acquire(scheduler.streamCost()).admitted;
+    try std.testing.expect(stream.long);
+    // A second one would take the slot kept for short jobs
+    try std.testing.expect(scheduler.acquire(scheduler.streamCost()) == .busy);
+    scheduler.release(stream);
+}
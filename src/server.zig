@@ -2,6 +2,34 @@ const std = @import("std");
 const pg = @import("pg");
 const httpz = @import("httpz");
 const uuid = @import("uuid");
+const openfhe = @import("openfhe");
+
+const cache = @import("cache.zig");
+const compactor = @import("compactor.zig");
+const ingest = @import("ingest.zig");
+const keys = @import("keys.zig");
+const results = @import("results.zig");
+const scheduler = @import("scheduler.zig");
+const zeros = @import("zeros.zig");
+const workers = @import("workers.zig");
+const worker = @import("worker.zig");
+
+pub const ResultCache = cache.ResultCache;
+pub const default_result_cache_mb = cache.default_budget_mb;
+pub const Compactor = compactor.Compactor;
+pub const KeyStore = keys.KeyStore;
+pub const default_key_idle_timeout_ms = keys.default_idle_timeout_ms;
+pub const ResultStore = results.ResultStore;
+pub const Scheduler = scheduler.Scheduler;
+pub const cost_calibration_iterations = scheduler.calibration_iterations;
+pub const default_max_queue_wait_ms = scheduler.default_max_wait_ms;
+pub const ZeroPools = zeros.ZeroPools;
+pub const default_zero_pool_capacity = zeros.default_capacity;
+pub const default_zero_pool_idle_timeout_ms = zeros.default_idle_timeout_ms;
+pub const default_zero_pool_mb = zeros.default_budget_mb;
+pub const WorkerPool = workers.WorkerPool;
+pub const WorkerFds = workers.Fds;
+pub const serveWorker = worker.serve;
 
 pub const AppConfig = struct {
     appHost: []const u8,
@@ -11,11 +39,50 @@ pub const AppConfig = struct {
     dbUser: []const u8,
     dbPassword: []const u8,
     dbDatabase: []const u8,
+    storeDir: [:0]const u8,
+    /// Parameters of the server's BGV context; clients fetch them from
+    /// `/api/v0.1.0/params` to build a matching one
+    fhe: openfhe.BgvParams = .{},
+    /// FHE requests running at once; 0 for one per core
+    maxJobs: u32 = 0,
+    /// Memory the running FHE requests may hold together; 0 for half the RAM
+    memoryBudgetMb: u64 = 0,
+    /// Requests predicted to wait longer for a slot are turned away with 429
+    maxQueueWaitMs: u64 = default_max_queue_wait_ms,
+    /// FHE worker processes; 0 keeps all FHE work in the API process
+    workers: u32 = 0,
+    /// Store space for memoized analysis results
+    resultCacheMb: u64 = cache.default_budget_mb,
+    /// Encryptions of zero a new session's pool keeps ready
+    zeroPoolSize: u32 = zeros.default_capacity,
+    /// Memory all zero pools hold together, split between worker processes
+    zeroPoolMb: u64 = zeros.default_budget_mb,
+    /// Set when this process is one of those workers
+    workerFds: ?workers.Fds = null,
 };
 
 pub const App = struct {
     db: *pg.Pool,
     config: AppConfig,
+    fhe: openfhe.CryptoContext,
+    results: results.ResultStore,
+    /// Ciphertext payloads; Postgres only keeps their metadata
+    store: openfhe.SegmentStore,
+    /// Held shared while views returned by `store.get` are in use and
+    /// exclusively by each compaction step, which moves records
+    storeLock: std.Thread.RwLock = .{},
+    /// Reclaims deleted sessions' space in the background
+    compactor: compactor.Compactor,
+    /// Results of earlier analyses, kept in `store`
+    cache: cache.ResultCache,
+    /// Evaluation keys, loaded into `fhe` per session on demand
+    keys: keys.KeyStore,
+    /// Encryptions of zero that re-randomize results before download
+    zeros: zeros.ZeroPools,
+    /// Admits FHE work by its predicted cost, shortest first
+    scheduler: scheduler.Scheduler,
+    /// Worker processes holding the zero pools instead of `zeros`, if any
+    workers: ?*workers.WorkerPool = null,
 
     pub fn initDb(self: *App) !void {
         var conn = try self.db.acquire();
@@ -25,7 +92,37 @@ pub const App = struct {
             \\CREATE TABLE IF NOT EXISTS keys (
             \\    session_id UUID,
             \\    public_key bytea,
-            \\    issued_at timestamp
+            \\    issued_at timestamp,
+            \\    key_tag TEXT,
+            \\    next_object_id BIGINT DEFAULT 0
+            \\);
+        ,
+            .{},
+        );
+
+        _ = try conn.exec(
+            \\CREATE TABLE IF NOT EXISTS ciphertexts (
+            \\    session_id UUID,
+            \\    object_id BIGINT,
+            \\    size_bytes BIGINT,
+            \\    stored_at timestamp,
+            \\    PRIMARY KEY (session_id, object_id)
+            \\);
+        ,
+            .{},
+        );
+
+        try self.migrateBytea(conn);
+        try self.migrateKeyTags(conn);
+        try migrateObjectCounters(conn);
+
+        _ = try conn.exec(
+            \\CREATE TABLE IF NOT EXISTS eval_keys (
+            \\    session_id UUID,
+            \\    kind TEXT,
+            \\    digest CHAR(64),
+            \\    stored_at timestamp,
+            \\    PRIMARY KEY (session_id, kind)
             \\);
         ,
             .{},
@@ -34,6 +131,78 @@ pub const App = struct {
         try conn.commit();
     }
 
+    /// Moves ciphertexts stored by older versions in the `data` bytea column
+    /// into the segment store and drops the column.
+    fn migrateBytea(self: *App, conn: *pg.Conn) !void {
+        var column = (try conn.row(
+            "SELECT 1 FROM information_schema.columns WHERE table_name = 'ciphertexts' AND column_name = 'data';",
+            .{},
+        )) orelse return;
+        column.deinit() catch {};
+
+        var result = try conn.query("SELECT session_id::text, object_id, data FROM ciphertexts WHERE data IS NOT NULL;", .{});
+        defer result.deinit();
+
+        var migrated: u64 = 0;
+        while (try result.next()) |row| {
+            const key = storeKey(row.get([]u8, 0)) orelse continue;
+            try self.store.put(&key, @intCast(row.get(i64, 1)), row.get([]u8, 2));
+            migrated += 1;
+        }
+        try self.store.sync();
+
+        _ = try conn.exec("ALTER TABLE ciphertexts ADD COLUMN IF NOT EXISTS size_bytes BIGINT;", .{});
+        _ = try conn.exec("UPDATE ciphertexts SET size_bytes = octet_length(data) WHERE size_bytes IS NULL;", .{});
+        _ = try conn.exec("ALTER TABLE ciphertexts DROP COLUMN IF EXISTS data;", .{});
+        std.log.info("Moved {} ciphertexts from Postgres into the segment store", .{migrated});
+    }
+
+    /// Records the key pair tag of sessions registered by older versions and
+    /// makes it unique, so a public key can only be registered once. Where
+    /// older versions let several sessions register the same key, only the
+    /// first keeps the tag.
+    fn migrateKeyTags(_: *App, conn: *pg.Conn) !void {
+        _ = try conn.exec("ALTER TABLE keys ADD COLUMN IF NOT EXISTS key_tag TEXT;", .{});
+
+        var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+        defer arena.deinit();
+        const Tagged = struct { sessionId: []const u8, tag: []const u8 };
+        var tagged: std.ArrayList(Tagged) = .empty;
+        {
+            var result = try conn.query("SELECT session_id::text, public_key FROM keys WHERE key_tag IS NULL ORDER BY issued_at;", .{});
+            defer result.deinit();
+            while (try result.next()) |row| {
+                var pk = openfhe.PublicKey.deserialize(row.get([]u8, 1), .binary) catch continue;
+                defer pk.deinit();
+                try tagged.append(arena.allocator(), .{
+                    .sessionId = try arena.allocator().dupe(u8, row.get([]u8, 0)),
+                    .tag = try pk.getTag(arena.allocator()),
+                });
+            }
+        }
+
+        for (tagged.items) |entry| {
+            _ = try conn.exec(
+                \\UPDATE keys SET key_tag = $2 WHERE session_id = $1::uuid
+                \\AND NOT EXISTS (SELECT 1 FROM keys WHERE key_tag = $2);
+            , .{ entry.sessionId, entry.tag });
+        }
+        _ = try conn.exec("CREATE UNIQUE INDEX IF NOT EXISTS keys_key_tag ON keys (key_tag);", .{});
+        if (tagged.items.len > 0) std.log.info("Recorded the key tags of {} sessions", .{tagged.items.len});
+    }
+
+    /// Starts the object id counter of sessions registered by older versions
+    /// after their highest stored id
+    fn migrateObjectCounters(conn: *pg.Conn) !void {
+        _ = try conn.exec("ALTER TABLE keys ADD COLUMN IF NOT EXISTS next_object_id BIGINT;", .{});
+        _ = try conn.exec(
+            \\UPDATE keys SET next_object_id = COALESCE(
+            \\    (SELECT MAX(object_id) + 1 FROM ciphertexts WHERE ciphertexts.session_id = keys.session_id), 0)
+            \\WHERE next_object_id IS NULL;
+        , .{});
+        _ = try conn.exec("ALTER TABLE keys ALTER COLUMN next_object_id SET DEFAULT 0;", .{});
+    }
+
     pub fn uncaughtError(_: *App, req: *httpz.Request, res: *httpz.Response, err: anyerror) void {
         std.log.info("500 {} {s} {}", .{ req.method, req.url.path, err });
         res.status = 500;
@@ -45,65 +214,604 @@ pub fn initServer(alloc: std.mem.Allocator, app: *App) !httpz.Server(*App) {
     var server = try httpz.Server(*App).init(alloc, .{
         .address = app.config.appHost,
         .port = app.config.appPort,
-        .request = .{ .max_body_size = 10485760 },
+        .request = .{
+            .max_body_size = ingest.max_upload_size,
+            .lazy_read_size = ingest.lazy_read_size,
+        },
     }, app);
 
     var router = try server.router(.{});
     router.get("/health", health, .{});
+    router.get("/api/v0.1.0/params", fheParams, .{});
     router.post("/api/v0.1.0/register", register, .{});
+    router.post("/api/v0.1.0/sessions/:session/ciphertexts", uploadCiphertexts, .{});
+    router.post("/api/v0.1.0/sessions/:session/analyses/kmer", kmerAnalysis, .{});
+    router.get("/api/v0.1.0/sessions/:session/results", downloadResults, .{});
+    router.delete("/api/v0.1.0/sessions/:session/results", acknowledgeResults, .{});
+    router.put("/api/v0.1.0/sessions/:session/eval-keys/:kind", uploadEvalKeys, .{});
+    router.delete("/api/v0.1.0/sessions/:session", deleteSession, .{});
 
     return server;
 }
 
-/// Health check endpoint
-fn health(_: *App, _: *httpz.Request, res: *httpz.Response) !void {
+/// Health check endpoint, with the scheduler's load and the result cache
+fn health(app: *App, _: *httpz.Request, res: *httpz.Response) !void {
+    const load = app.scheduler.stats();
+    const cached = app.cache.stats();
+    res.status = 200;
+    try res.json(.{
+        .status = "healthy",
+        .runningJobs = load.running,
+        .queuedJobs = load.waiting,
+        .resultCache = .{
+            .hits = cached.hits,
+            .misses = cached.misses,
+            .hitRate = cached.hitRate(),
+            .entries = cached.entries,
+            .bytes = cached.bytes,
+        },
+    }, .{});
+}
+
+/// BGV parameters clients must use for their keys and ciphertexts
+fn fheParams(app: *App, _: *httpz.Request, res: *httpz.Response) !void {
     res.status = 200;
-    try res.json(.{ .status = "healthy" }, .{});
+    try res.json(.{
+        .multiplicativeDepth = app.config.fhe.multiplicative_depth,
+        .plaintextModulus = app.fhe.getPlaintextModulus(),
+        .ringDim = app.fhe.getRingDim(),
+        .securityLevel = app.config.fhe.security_level,
+    }, .{});
 }
 
 const RegisterRequest = struct {
-    publicKey: []u8,
+    publicKey: []const u8,
+    /// `publicKey` deserialized, owned by the caller
+    key: openfhe.PublicKey,
+
+    /// Accepts either `application/octet-stream` with the serialized public key
+    /// as the raw body, or the legacy JSON `{"publicKey": "<base64>"}` form.
+    /// Keys made for other parameters than `fhe` are rejected.
+    pub fn validateRequest(alloc: std.mem.Allocator, req: *httpz.Request, fhe: openfhe.CryptoContext) anyerror!RegisterRequest {
+        const publicKey = if (isOctetStream(req))
+            req.body() orelse return error.ValidationError
+        else
+            try decodeJson(alloc, req);
+
+        // The binary body is handed to the deserializer in place, no copy is made.
+        var key = openfhe.PublicKey.deserialize(publicKey, .binary) catch return error.ValidationError;
+        errdefer key.deinit();
+        key.checkContext(fhe) catch return error.ValidationError;
 
-    pub fn validateRequest(alloc: std.mem.Allocator, req: *httpz.Request) anyerror!RegisterRequest {
+        return .{ .publicKey = publicKey, .key = key };
+    }
+
+    fn decodeJson(alloc: std.mem.Allocator, req: *httpz.Request) anyerror![]const u8 {
         const request_raw = try req.json(struct { publicKey: []u8 }) orelse return error.ValidationError;
         const decodedSize = try std.base64.standard.Decoder.calcSizeForSlice(request_raw.publicKey);
-        const request = RegisterRequest{ .publicKey = try alloc.alloc(u8, decodedSize) };
-        try std.base64.standard.Decoder.decode(request.publicKey, request_raw.publicKey);
-        return request;
+        const publicKey = try alloc.alloc(u8, decodedSize);
+        try std.base64.standard.Decoder.decode(publicKey, request_raw.publicKey);
+        return publicKey;
     }
 };
 
+/// Waits until the scheduler runs the request's FHE work. Null if the
+/// request was turned away; the response is set then.
+fn admit(app: *App, req: *httpz.Request, res: *httpz.Response, cost: scheduler.Cost) !?scheduler.Ticket {
+    switch (app.scheduler.acquire(cost)) {
+        .admitted => |ticket| return ticket,
+        .busy => |seconds| {
+            std.log.info("429 {} {s} retry after {}s", .{ req.method, req.url.path, seconds });
+            res.status = 429;
+            res.header("Retry-After", try std.fmt.allocPrint(res.arena, "{d}", .{seconds}));
+            res.body = "Too Many Requests";
+        },
+        .too_large => {
+            std.log.info("413 {} {s} needs {} bytes", .{ req.method, req.url.path, cost.peakBytes });
+            res.status = 413;
+            res.body = "Content Too Large";
+        },
+    }
+    return null;
+}
+
+/// Size of the request body, buffered or still on the socket; null if the
+/// client did not say, e.g. for a chunked upload
+fn bodyLength(req: *httpz.Request) ?u64 {
+    if (req.body()) |body| return body.len;
+    const header = req.header("content-length") orelse return null;
+    return std.fmt.parseInt(u64, header, 10) catch null;
+}
+
+/// Cost of decoding the request body. One of unknown length may be as large
+/// as any upload, so it is charged as a long job.
+fn bodyCost(app: *App, req: *httpz.Request) scheduler.Cost {
+    const length = bodyLength(req) orelse return app.scheduler.streamCost();
+    return app.scheduler.deserializeCost(length);
+}
+
+/// httpz accepts bodies up to `ingest.max_upload_size` for the upload routes,
+/// which stream them, but buffers only up to `ingest.lazy_read_size`. Other
+/// routes refuse whatever it left on the socket; true if the request was.
+fn rejectStreamedBody(req: *httpz.Request, res: *httpz.Response) bool {
+    if (req.body() != null) return false;
+    const length = std.fmt.parseInt(u64, req.header("content-length") orelse "0", 10) catch 0;
+    if (length == 0 and req.header("transfer-encoding") == null) return false;
+
+    std.log.info("413 {} {s} body not buffered", .{ req.method, req.url.path });
+    res.status = 413;
+    res.body = "Content Too Large";
+    return true;
+}
+
+/// Binary upload routes take the serialized OpenFHE object as the raw request body
+fn isOctetStream(req: *httpz.Request) bool {
+    const contentType = req.header("content-type") orelse return false;
+    return std.ascii.startsWithIgnoreCase(contentType, "application/octet-stream");
+}
+
 /// Accept public keys from the user and assign user a session ID for later communication
 fn register(app: *App, req: *httpz.Request, res: *httpz.Response) !void {
-    const request = RegisterRequest.validateRequest(res.arena, req) catch |err| {
-        std.log.info("422 {} {s} {}", .{ req.method, req.url.path, err });
+    if (rejectStreamedBody(req, res)) return;
+    const ticket = (try admit(app, req, res, app.scheduler.deserializeCost(bodyLength(req) orelse 0))) orelse return;
+    defer app.scheduler.release(ticket);
+
+    var request = RegisterRequest.validateRequest(res.arena, req, app.fhe) catch |err| {
+        std.log.info("422 {} {s} {} {s}", .{ req.method, req.url.path, err, openfhe.getLastError() });
         res.status = 422;
         res.body = "Unprocessable Content";
         return;
     };
+    defer request.key.deinit();
 
     const sessionId = uuid.v4.new();
     const issuedAt = std.time.microTimestamp();
     const publicKey = request.publicKey;
+    const keyTag = try request.key.getTag(res.arena);
 
     // try app.savePublicKey(request.public_key);
     var conn = try app.db.acquire();
     defer conn.release();
 
+    // A key pair belongs to one session; registering it again, e.g. someone
+    // else's public key, must not give access to that session's keys
+    var inserted = (conn.row(
+        \\INSERT INTO keys (session_id, public_key, issued_at, key_tag) VALUES ($1, $2, $3, $4)
+        \\ON CONFLICT (key_tag) DO NOTHING RETURNING 1;
+    , .{ uuid.urn.serialize(sessionId), publicKey, issuedAt, @as([]const u8, keyTag) }) catch |err| {
+        logPgError(conn, err);
+        return err;
+    }) orelse {
+        std.log.info("409 {} {s} public key already registered", .{ req.method, req.url.path });
+        res.status = 409;
+        res.body = "Conflict";
+        return;
+    };
+    try inserted.deinit();
+
+    res.status = 200;
+    try res.json(.{ .sessionId = uuid.urn.serialize(sessionId) }, .{});
+}
+
+/// Append a stream of encrypted genome chunks to the session. The body is a
+/// sequence of u32 little-endian length prefixed serialized ciphertexts and
+/// may be far larger than the buffered body limit; see `ingest.zig`.
+fn uploadCiphertexts(app: *App, req: *httpz.Request, res: *httpz.Response) !void {
+    const sessionId = parseSessionId(req) orelse {
+        std.log.info("422 {} {s} bad session id", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+
+    const ticket = (try admit(app, req, res, bodyCost(app, req))) orelse return;
+    defer app.scheduler.release(ticket);
+
+    {
+        var conn = try app.db.acquire();
+        defer conn.release();
+        if (!try sessionExists(conn, &sessionId)) {
+            res.status = 404;
+            res.body = "Not Found";
+            return;
+        }
+    }
+
+    // The sink takes a connection per batch; the stream may run for minutes
+    var sink = ingest.StoreSink.init(app.db, app.store, &sessionId, storeKey(&sessionId).?);
+    const count = ingest.ingest(app.fhe, req, &sink) catch |err| {
+        // Frames before the bad one are kept
+        if (sink.err == null) sink.flush() catch {};
+        if (sink.err) |storeErr| return storeErr;
+        std.log.info("422 {} {s} {} after {} ciphertexts: {s}", .{ req.method, req.url.path, err, sink.stored, openfhe.getLastError() });
+        res.status = 422;
+        try res.json(.{ .stored = sink.stored, .@"error" = "Invalid ciphertext stream" }, .{});
+        return;
+    };
+    try sink.flush();
+    // Acknowledge the upload only once it is on disk
+    try app.store.sync();
+
+    res.status = 200;
+    try res.json(.{ .stored = count, .firstObjectId = sink.firstObjectId }, .{});
+}
+
+/// Count the k-mers (`?k=` 1 to 3) over all ciphertexts of the session, which
+/// must be one-hot packed. The histogram is published as results for the
+/// download route; the session's mult and rotation keys must be uploaded.
+/// A histogram of the same uploads is served from the result cache.
+fn kmerAnalysis(app: *App, req: *httpz.Request, res: *httpz.Response) !void {
+    const sessionId = parseSessionId(req) orelse {
+        std.log.info("422 {} {s} bad session id", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+    const query = try req.query();
+    const k = std.fmt.parseInt(u32, query.get("k") orelse "", 10) catch 0;
+    if (openfhe.dnaKmerHistogramOutputs(k) == 0) {
+        std.log.info("422 {} {s} bad k", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    }
+
+    const found: ?[]cache.Input = blk: {
+        var conn = try app.db.acquire();
+        defer conn.release();
+        if (!try sessionExists(conn, &sessionId)) break :blk null;
+        break :blk try sessionObjects(conn, res.arena, &sessionId);
+    };
+    const objects = found orelse {
+        res.status = 404;
+        res.body = "Not Found";
+        return;
+    };
+    if (objects.len == 0) {
+        std.log.info("422 {} {s} no ciphertexts", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    }
+
+    const cacheKeys = try kmerCacheKeys(res.arena, sessionId, k, objects);
+    if (try cachedResults(app, res.arena, cacheKeys)) |counts| {
+        for (counts, 0..) |ct, i| {
+            errdefer for (counts[i..]) |*lost| lost.deinit();
+            try app.results.put(sessionId, ct);
+        }
+        res.status = 200;
+        try res.json(.{ .results = counts.len }, .{});
+        return;
+    }
+
+    const estimate = try app.fhe.dnaKernelCost(app.scheduler.model, .kmer, objects.len, k, 0);
+    const ticket = (try admit(app, req, res, .{ .cpuNs = estimate.cpu_ns, .peakBytes = estimate.peak_bytes })) orelse return;
+    defer app.scheduler.release(ticket);
+
+    const inputs = try loadCiphertexts(app, res.arena, &sessionId, objects);
+    defer for (inputs) |*ct| ct.deinit();
+
+    const keyTag = blk: {
+        var conn = try app.db.acquire();
+        defer conn.release();
+        break :blk try app.keys.acquire(conn, sessionId);
+    };
+    defer app.keys.release(sessionId);
+    // Evaluate with the keys registered under this session only
+    const sessionTag = keys.sessionTag(sessionId);
+    for (inputs) |ct| try ct.setKeyTag(&sessionTag);
+
+    const counts = app.fhe.dnaKmerHistogram(inputs, k, res.arena) catch |err| switch (err) {
+        // Not one-hot packed, or keys missing
+        error.InvalidParam, error.CryptoFailure => {
+            std.log.info("422 {} {s} {}: {s}", .{ req.method, req.url.path, err, openfhe.getLastError() });
+            res.status = 422;
+            res.body = "Unprocessable Content";
+            return;
+        },
+        else => return err,
+    };
+    for (counts, 0..) |ct, i| {
+        // Back under the key pair's tag, as the client and zero pools expect
+        errdefer for (counts[i..]) |*lost| lost.deinit();
+        try ct.setKeyTag(keyTag);
+        app.cache.put(cacheKeys[i], ct) catch |err| {
+            std.log.warn("could not cache result: {} {s}", .{ err, openfhe.getLastError() });
+        };
+        try app.results.put(sessionId, ct);
+    }
+
+    res.status = 200;
+    try res.json(.{ .results = counts.len }, .{});
+}
+
+/// Stream copies of the session's pending results, oldest first. They stay on
+/// the server until acknowledged with DELETE, so a broken download can be
+/// repeated; `X-Result-Count` tells how many were sent. Each result is
+/// re-randomized first, so it reveals nothing beyond its plaintext.
+fn downloadResults(app: *App, req: *httpz.Request, res: *httpz.Response) !void {
+    const sessionId = parseSessionId(req) orelse {
+        std.log.info("422 {} {s} bad session id", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+
+    const ticket = (try admit(app, req, res, app.scheduler.downloadCost(app.results.pending(sessionId)))) orelse return;
+    defer app.scheduler.release(ticket);
+
+    var pending = (try app.results.snapshot(sessionId)) orelse {
+        res.status = 404;
+        res.body = "Not Found";
+        return;
+    };
+    defer app.results.release(&pending);
+    res.header("X-Result-Count", try std.fmt.allocPrint(res.arena, "{d}", .{pending.items.len}));
+
+    if (app.workers) |pool| {
+        var conn = try app.db.acquire();
+        defer conn.release();
+
+        var streamed: usize = 0;
+        res.status = 200;
+        pool.download(conn, sessionId, pending.items, res, &streamed) catch |err| {
+            if (streamed > 0) return err;
+
+            std.log.warn("503 {} {s} {}", .{ req.method, req.url.path, err });
+            res.status = 503;
+            res.header("Retry-After", "1");
+            res.body = "Service Unavailable";
+        };
+        return;
+    }
+
+    {
+        var conn = try app.db.acquire();
+        defer conn.release();
+        // Re-randomizing copies the shared polynomials, the pending results
+        // are left as they are
+        try app.zeros.rerandomize(conn, sessionId, pending.items);
+    }
+
+    res.status = 200;
+    try results.stream(res, pending.items);
+}
+
+/// Drop the `?count=` oldest pending results of the session, once the client
+/// has downloaded them
+fn acknowledgeResults(app: *App, req: *httpz.Request, res: *httpz.Response) !void {
+    const sessionId = parseSessionId(req) orelse {
+        std.log.info("422 {} {s} bad session id", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+    const query = try req.query();
+    const count = std.fmt.parseInt(usize, query.get("count") orelse "", 10) catch {
+        std.log.info("422 {} {s} bad count", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+
+    res.status = 200;
+    try res.json(.{ .acknowledged = app.results.acknowledge(sessionId, count) }, .{});
+}
+
+/// Store the session's serialized evaluation keys (`:kind` is `mult` or
+/// `automorphism`). Blobs are content-addressed, so re-uploading keys the
+/// server already has only costs the transfer.
+fn uploadEvalKeys(app: *App, req: *httpz.Request, res: *httpz.Response) !void {
+    const sessionId = parseSessionId(req) orelse {
+        std.log.info("422 {} {s} bad session id", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+    const kind = keys.Kind.parse(req.param("kind") orelse "") orelse {
+        res.status = 404;
+        res.body = "Not Found";
+        return;
+    };
+
+    const ticket = (try admit(app, req, res, bodyCost(app, req))) orelse return;
+    defer app.scheduler.release(ticket);
+
+    {
+        var conn = try app.db.acquire();
+        defer conn.release();
+        if (!try sessionExists(conn, &sessionId)) {
+            res.status = 404;
+            res.body = "Not Found";
+            return;
+        }
+    }
+
+    // No connection is held while the blob streams in
+    var body = try ingest.BodyReader.init(req);
+    const saved = try app.keys.save(&body);
+
+    var conn = try app.db.acquire();
+    defer conn.release();
+    app.keys.install(conn, sessionId, kind, &saved.digest) catch |err| {
+        if (saved.created) app.keys.remove(&saved.digest);
+        std.log.info("422 {} {s} {}: {s}", .{ req.method, req.url.path, err, openfhe.getLastError() });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+
     _ = conn.exec(
-        "INSERT INTO keys (session_id, public_key, issued_at) VALUES ($1, $2, $3);",
-        .{ uuid.urn.serialize(sessionId), publicKey, issuedAt },
+        \\INSERT INTO eval_keys (session_id, kind, digest, stored_at) VALUES ($1, $2, $3, $4)
+        \\ON CONFLICT (session_id, kind) DO UPDATE SET digest = EXCLUDED.digest, stored_at = EXCLUDED.stored_at;
+    ,
+        .{ @as([]const u8, &sessionId), @tagName(kind), @as([]const u8, &saved.digest), std.time.microTimestamp() },
     ) catch |err| {
-        if (err == error.PG) {
-            if (conn.err) |pge| {
-                std.log.err("PG {s}\n", .{pge.message});
-            }
-        }
+        logPgError(conn, err);
         return err;
     };
 
     res.status = 200;
-    try res.json(.{ .sessionId = uuid.urn.serialize(sessionId) }, .{});
+    try res.json(.{ .digest = @as([]const u8, &saved.digest), .created = saved.created }, .{});
+}
+
+/// Forget a session: its key, its stored ciphertexts and any pending results.
+/// Space is reclaimed by the background compactor once most of the store is
+/// garbage.
+fn deleteSession(app: *App, req: *httpz.Request, res: *httpz.Response) !void {
+    const sessionId = parseSessionId(req) orelse {
+        std.log.info("422 {} {s} bad session id", .{ req.method, req.url.path });
+        res.status = 422;
+        res.body = "Unprocessable Content";
+        return;
+    };
+
+    var conn = try app.db.acquire();
+    defer conn.release();
+
+    if (!try sessionExists(conn, &sessionId)) {
+        res.status = 404;
+        res.body = "Not Found";
+        return;
+    }
+
+    const key = storeKey(&sessionId).?;
+    try app.store.deleteSession(&key);
+    app.cache.forget(sessionId);
+    app.keys.forget(sessionId);
+    app.zeros.forget(sessionId);
+    if (app.workers) |pool| pool.forget(sessionId);
+    if (app.results.take(sessionId)) |pending| {
+        var owned = pending;
+        app.results.release(&owned);
+    }
+
+    _ = conn.exec("DELETE FROM ciphertexts WHERE session_id = $1;", .{@as([]const u8, &sessionId)}) catch |err| {
+        logPgError(conn, err);
+        return err;
+    };
+    _ = conn.exec("DELETE FROM keys WHERE session_id = $1;", .{@as([]const u8, &sessionId)}) catch |err| {
+        logPgError(conn, err);
+        return err;
+    };
+    try deleteEvalKeys(app, conn, &sessionId);
+    app.compactor.request();
+
+    res.status = 204;
+}
+
+/// Drops the session's evaluation key rows and every blob no other session uses
+fn deleteEvalKeys(app: *App, conn: *pg.Conn, sessionId: []const u8) !void {
+    var orphans = conn.query(
+        \\WITH removed AS (DELETE FROM eval_keys WHERE session_id = $1 RETURNING digest)
+        \\SELECT DISTINCT digest FROM removed
+        \\WHERE NOT EXISTS (SELECT 1 FROM eval_keys k WHERE k.digest = removed.digest AND k.session_id <> $1);
+    , .{sessionId}) catch |err| {
+        logPgError(conn, err);
+        return err;
+    };
+    defer orphans.deinit();
+
+    while (try orphans.next()) |row| {
+        const digest = row.get([]u8, 0);
+        if (digest.len == @sizeOf(keys.Digest)) app.keys.remove(digest[0..@sizeOf(keys.Digest)]);
+    }
+}
+
+/// Segment store key of a session: the 16 bytes of its UUID
+fn storeKey(sessionId: []const u8) ?openfhe.SegmentStore.SessionId {
+    const id = uuid.urn.deserialize(sessionId) catch return null;
+    return std.mem.toBytes(id);
+}
+
+/// Canonical form of the `:session` path parameter, or null if it is not a UUID
+fn parseSessionId(req: *httpz.Request) ?[36]u8 {
+    const raw = req.param("session") orelse return null;
+    const id = uuid.urn.deserialize(raw) catch return null;
+    return uuid.urn.serialize(id);
+}
+
+/// The session's uploaded ciphertexts in ascending id order, versioned by
+/// their `stored_at` in microseconds
+fn sessionObjects(conn: *pg.Conn, alloc: std.mem.Allocator, sessionId: []const u8) ![]cache.Input {
+    var rows = try conn.query(
+        \\SELECT object_id, COALESCE((EXTRACT(EPOCH FROM stored_at) * 1000000)::bigint, 0)
+        \\FROM ciphertexts WHERE session_id = $1 ORDER BY object_id;
+    , .{sessionId});
+    defer rows.deinit();
+
+    var objects: std.ArrayList(cache.Input) = .empty;
+    while (try rows.next()) |row| {
+        try objects.append(alloc, .{ .objectId = @intCast(row.get(i64, 0)), .version = row.get(i64, 1) });
+    }
+    return objects.items;
+}
+
+/// Reads the ciphertexts from the store; the caller owns them
+fn loadCiphertexts(app: *App, alloc: std.mem.Allocator, sessionId: []const u8, objects: []const cache.Input) ![]openfhe.Ciphertext {
+    const key = storeKey(sessionId).?;
+    const cts = try alloc.alloc(openfhe.Ciphertext, objects.len);
+    var loaded: usize = 0;
+    errdefer for (cts[0..loaded]) |*ct| ct.deinit();
+
+    app.storeLock.lockShared();
+    defer app.storeLock.unlockShared();
+    for (objects) |object| {
+        cts[loaded] = try app.store.loadCiphertext(app.fhe, &key, object.objectId, .binary);
+        loaded += 1;
+    }
+    return cts;
+}
+
+/// One result cache key per ciphertext of the k-mer histogram
+fn kmerCacheKeys(alloc: std.mem.Allocator, sessionId: cache.SessionId, k: u32, objects: []const cache.Input) ![]cache.Key {
+    const out = try alloc.alloc(cache.Key, openfhe.dnaKmerHistogramOutputs(k));
+    for (out, 0..) |*key, i| {
+        key.* = .{
+            .sessionId = sessionId,
+            .kernel = "kmer",
+            .params = try std.fmt.allocPrint(alloc, "k={d},output={d}", .{ k, i }),
+            .inputs = objects,
+        };
+    }
+    return out;
+}
+
+/// The cached results for all of `cacheKeys`, or null if any of them has to
+/// be computed. Lookups that fail count as misses. The caller owns the
+/// returned ciphertexts.
+fn cachedResults(app: *App, alloc: std.mem.Allocator, cacheKeys: []const cache.Key) !?[]openfhe.Ciphertext {
+    const cts = try alloc.alloc(openfhe.Ciphertext, cacheKeys.len);
+    var found: usize = 0;
+    errdefer for (cts[0..found]) |*ct| ct.deinit();
+
+    for (cacheKeys) |key| {
+        const ct = app.cache.get(app.fhe, key) catch |err| blk: {
+            std.log.warn("could not read cached result: {} {s}", .{ err, openfhe.getLastError() });
+            break :blk null;
+        };
+        cts[found] = ct orelse {
+            for (cts[0..found]) |*hit| hit.deinit();
+            return null;
+        };
+        found += 1;
+    }
+    return cts;
+}
+
+fn sessionExists(conn: *pg.Conn, sessionId: []const u8) !bool {
+    var row = (try conn.row("SELECT 1 FROM keys WHERE session_id = $1;", .{sessionId})) orelse return false;
+    row.deinit() catch {};
+    return true;
+}
+
+fn logPgError(conn: *pg.Conn, err: anyerror) void {
+    if (err == error.PG) {
+        if (conn.err) |pge| {
+            std.log.err("PG {s}\n", .{pge.message});
+        }
+    }
 }
 
 // fn analyze(app: *App, _: *httpz.Request, res: *httpz.Response) !void {
@@ -0,0 +1,98 @@
+//! Worker mode: the loop an FHE worker process runs, see `workers.zig`.
+//!
+//! The worker owns the zero pools of the sessions pinned to it and answers
+//! one request at a time. It exits when the API process closes its socket.
+
+const std = @import("std");
+const posix = std.posix;
+const openfhe = @import("openfhe");
+
+const workers = @import("workers.zig");
+const zeros = @import("zeros.zig");
+
+pub fn serve(allocator: std.mem.Allocator, fhe: openfhe.CryptoContext, fds: workers.Fds, zeroPoolSize: usize) !void {
+    const size = try (std.fs.File{ .handle = fds.region }).getEndPos();
+    const region = try posix.mmap(null, size, posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED }, fds.region, 0);
+    defer posix.munmap(region);
+
+    var pools = zeros.ZeroPools.init(allocator, fhe, zeroPoolSize, zeros.default_idle_timeout_ms);
+    defer pools.deinit();
+    try pools.startSweeper();
+
+    while (true) {
+        var req: workers.Request = undefined;
+        const n = try posix.read(fds.socket, std.mem.asBytes(&req));
+        if (n == 0) return;
+        if (n != @sizeOf(workers.Request)) return error.BadRequest;
+
+        const resp = handle(allocator, fhe, &pools, region, req);
+        _ = try posix.send(fds.socket, std.mem.asBytes(&resp), posix.MSG.NOSIGNAL);
+    }
+}
+
+fn handle(
+    allocator: std.mem.Allocator,
+    fhe: openfhe.CryptoContext,
+    pools: *zeros.ZeroPools,
+    region: []u8,
+    req: workers.Request,
+) workers.Response {
+    const op = std.meta.intToEnum(workers.Op, req.op) catch return status(.invalid);
+    var frames = workers.FrameReader{ .data = region[0..@min(req.len, region.len)] };
+    switch (op) {
+        .prepare => {
+            const publicKey = frames.next() orelse return status(.invalid);
+            var pk = openfhe.PublicKey.deserialize(publicKey, .binary) catch return status(.invalid);
+            defer pk.deinit();
+            pools.prepare(req.session, pk) catch |err| {
+                std.log.info("rejected public key: {} {s}", .{ err, openfhe.getLastError() });
+                return status(.invalid);
+            };
+            return status(.ok);
+        },
+        .rerandomize => return rerandomize(allocator, fhe, pools, region, req) catch |err| switch (err) {
+            error.UnknownSession => status(.unknown_session),
+            error.BadRequest => status(.invalid),
+            else => {
+                std.log.err("re-randomization failed: {} {s}", .{ err, openfhe.getLastError() });
+                return status(.failed);
+            },
+        },
+        .forget => {
+            pools.forget(req.session);
+            return status(.ok);
+        },
+    }
+}
+
+/// Decodes the ciphertext frames, re-randomizes them and writes them back
+/// over the inputs
+fn rerandomize(
+    allocator: std.mem.Allocator,
+    fhe: openfhe.CryptoContext,
+    pools: *zeros.ZeroPools,
+    region: []u8,
+    req: workers.Request,
+) !workers.Response {
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+    const alloc = arena.allocator();
+
+    var frames = workers.FrameReader{ .data = region[0..@min(req.len, region.len)] };
+    const blobs = try alloc.alloc([]const u8, req.count);
+    for (blobs) |*blob| blob.* = frames.next() orelse return error.BadRequest;
+
+    const cts = try alloc.alloc(openfhe.Ciphertext, req.count);
+    openfhe.Ciphertext.deserializeBatch(fhe, blobs, .binary, null, cts, alloc) catch return error.BadRequest;
+    defer for (cts) |*ct| ct.deinit();
+
+    try pools.rerandomize(null, req.session, cts);
+
+    var out = workers.FrameWriter{ .region = region };
+    for (cts) |ct| try out.putCiphertext(ct);
+    return .{ .status = @intFromEnum(workers.Status.ok), .count = out.count, .len = out.len };
+}
+
+fn status(s: workers.Status) workers.Response {
+    return .{ .status = @intFromEnum(s), .count = 0, .len = 0 };
+}
@@ -0,0 +1,479 @@
+//! FHE worker processes.
+//!
+//! With `--workers N` the server starts N copies of itself in worker mode and
+//! hands them its per-session FHE state and work: the zero pools that
+//! re-randomize results, and the re-randomization itself. An OpenFHE crash
+//! or memory blow-up then takes down one worker, which is restarted, instead
+//! of the API, and every worker has its own allocator and OpenMP runtime.
+//!
+//! Each worker is reached over a Unix socket pair carrying fixed-size
+//! `Request`/`Response` packets. Ciphertexts do not travel over the socket:
+//! they are written into a memory region shared with the worker (a memfd
+//! mapped by both processes) as length-prefixed frames, which the worker
+//! decodes in place and overwrites with its results. Sessions are pinned to
+//! a worker by a hash of their id, so their pools stay warm.
+
+const std = @import("std");
+const posix = std.posix;
+const linux = std.os.linux;
+const pg = @import("pg");
+const httpz = @import("httpz");
+const openfhe = @import("openfhe");
+
+const results = @import("results.zig");
+
+pub const SessionId = [36]u8;
+
+/// Size of the region shared with each worker; larger downloads go in batches
+pub const region_size = 256 * 1024 * 1024;
+/// Bytes of ciphertexts per download batch. Each batch is copied out of the
+/// region before it is streamed, so a slow client does not hold the worker.
+pub const batch_size = 16 * 1024 * 1024;
+/// A worker that takes longer to answer one request is taken to be hung
+pub const answer_timeout_ms = 30 * std.time.ms_per_s;
+
+pub const Op = enum(u32) {
+    /// Region holds the session's serialized public key: create its pool
+    prepare,
+    /// Region holds `count` ciphertext frames: re-randomize them in place
+    rerandomize,
+    /// Drop the session's pool
+    forget,
+};
+
+pub const Status = enum(u32) {
+    ok,
+    /// The worker has no pool for the session; send its key first
+    unknown_session,
+    invalid,
+    failed,
+};
+
+/// Descriptors a worker inherits, passed as `--worker-fds <socket>,<region>`
+pub const Fds = struct {
+    socket: posix.fd_t,
+    region: posix.fd_t,
+
+    pub fn parse(arg: []const u8) ?Fds {
+        var it = std.mem.splitScalar(u8, arg, ',');
+        const socket = std.fmt.parseInt(posix.fd_t, it.next() orelse return null, 10) catch return null;
+        const region = std.fmt.parseInt(posix.fd_t, it.next() orelse return null, 10) catch return null;
+        if (it.next() != null) return null;
+        return .{ .socket = socket, .region = region };
+    }
+};
+
+pub const Request = extern struct {
+    op: u32,
+    count: u32,
+    /// Bytes of the region in use
+    len: u64,
+    session: SessionId,
+};
+
+pub const Response = extern struct {
+    status: u32,
+    count: u32,
+    len: u64,
+};
+
+/// Writes length-prefixed frames (u32 little-endian length, then the bytes)
+/// into a region, the framing of ciphertext uploads
+pub const FrameWriter = struct {
+    region: []u8,
+    len: usize = 0,
+    count: u32 = 0,
+    overflow: bool = false,
+
+    pub fn putBytes(self: *FrameWriter, bytes: []const u8) !void {
+        const start = try self.begin();
+        self.writeAll(bytes) catch |err| {
+            self.len = start;
+            return err;
+        };
+        self.end(start);
+    }
+
+    pub fn putCiphertext(self: *FrameWriter, ct: openfhe.Ciphertext) !void {
+        const start = try self.begin();
+        ct.serializeTo(.binary, self) catch |err| {
+            self.len = start;
+            if (self.overflow) return error.RegionFull;
+            return err;
+        };
+        self.end(start);
+    }
+
+    /// Appends to the open frame; used by `Ciphertext.serializeTo`
+    pub fn writeAll(self: *FrameWriter, bytes: []const u8) !void {
+        if (bytes.len > self.region.len - self.len) {
+            self.overflow = true;
+            return error.RegionFull;
+        }
+        @memcpy(self.region[self.len..][0..bytes.len], bytes);
+        self.len += bytes.len;
+    }
+
+    fn begin(self: *FrameWriter) !usize {
+        self.overflow = false;
+        const start = self.len;
+        try self.writeAll(&.{ 0, 0, 0, 0 });
+        return start;
+    }
+
+    fn end(self: *FrameWriter, start: usize) void {
+        std.mem.writeInt(u32, self.region[start..][0..4], @intCast(self.len - start - 4), .little);
+        self.count += 1;
+    }
+};
+
+pub const FrameReader = struct {
+    data: []const u8,
+
+    /// Next frame, or null at the end or at a truncated frame
+    pub fn next(self: *FrameReader) ?[]const u8 {
+        if (self.data.len < 4) return null;
+        const len = std.mem.readInt(u32, self.data[0..4], .little);
+        if (self.data.len - 4 < len) return null;
+        const frame = self.data[4..][0..len];
+        self.data = self.data[4 + len ..];
+        return frame;
+    }
+};
+
+pub const WorkerPool = struct {
+    allocator: std.mem.Allocator,
+    workers: []Worker,
+    exePath: []u8,
+    /// This process's arguments, which every worker is started with
+    args: [][:0]u8,
+    env: std.process.EnvMap,
+    /// Descriptors a worker inherits are inheritable only while it is being
+    /// spawned; serializing spawns keeps them out of its siblings
+    spawnMutex: std.Thread.Mutex = .{},
+
+    const Worker = struct {
+        index: usize,
+        /// Held for a whole exchange, including filling and reading the
+        /// region, but not while results go out to a client
+        mutex: std.Thread.Mutex = .{},
+        child: ?std.process.Child = null,
+        socket: posix.fd_t = -1,
+        memfd: posix.fd_t,
+        region: []align(std.heap.page_size_min) u8,
+    };
+
+    /// Starts `count` workers. OpenMP threads are split evenly between them.
+    pub fn init(allocator: std.mem.Allocator, count: u32) !WorkerPool {
+        var pool = WorkerPool{
+            .allocator = allocator,
+            .workers = try allocator.alloc(Worker, count),
+            .exePath = undefined,
+            .args = undefined,
+            .env = undefined,
+        };
+        errdefer allocator.free(pool.workers);
+        pool.exePath = try std.fs.selfExePathAlloc(allocator);
+        errdefer allocator.free(pool.exePath);
+        pool.args = try std.process.argsAlloc(allocator);
+        errdefer std.process.argsFree(allocator, pool.args);
+        pool.env = try std.process.getEnvMap(allocator);
+        errdefer pool.env.deinit();
+
+        const cores = std.Thread.getCpuCount() catch 1;
+        var threadsBuf: [16]u8 = undefined;
+        try pool.env.put("OMP_NUM_THREADS", try std.fmt.bufPrint(&threadsBuf, "{d}", .{@max(1, cores / count)}));
+
+        var started: usize = 0;
+        errdefer for (pool.workers[0..started]) |*w| pool.close(w);
+        for (pool.workers, 0..) |*w, i| {
+            const memfd = try posix.memfd_create("genz-worker", linux.MFD.CLOEXEC);
+            errdefer posix.close(memfd);
+            try posix.ftruncate(memfd, region_size);
+            const region = try posix.mmap(null, region_size, posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED }, memfd, 0);
+            w.* = .{ .index = i, .memfd = memfd, .region = region };
+            errdefer posix.munmap(region);
+            try pool.spawn(w);
+            started += 1;
+        }
+        return pool;
+    }
+
+    pub fn deinit(self: *WorkerPool) void {
+        for (self.workers) |*w| self.close(w);
+        self.allocator.free(self.workers);
+        self.allocator.free(self.exePath);
+        std.process.argsFree(self.allocator, self.args);
+        self.env.deinit();
+    }
+
+    pub fn forget(self: *WorkerPool, sessionId: SessionId) void {
+        const w = self.workerFor(sessionId);
+        w.mutex.lock();
+        defer w.mutex.unlock();
+        _ = self.exchange(w, .{ .op = @intFromEnum(Op.forget), .count = 0, .len = 0, .session = sessionId }) catch {};
+    }
+
+    /// Re-randomizes `cts` on the session's worker and streams the results
+    /// to `res`, a batch at a time. Each batch is copied out of the shared
+    /// region and the worker is released before it is sent.
+    /// `streamed` counts the ciphertexts sent, also when an error is returned.
+    pub fn download(
+        self: *WorkerPool,
+        conn: *pg.Conn,
+        sessionId: SessionId,
+        cts: []const openfhe.Ciphertext,
+        res: *httpz.Response,
+        streamed: *usize,
+    ) !void {
+        while (streamed.* < cts.len) {
+            const batch = try self.rerandomizeBatch(conn, sessionId, cts[streamed.*..]);
+            defer self.allocator.free(batch);
+
+            var reader = FrameReader{ .data = batch };
+            while (reader.next()) |frame| {
+                try results.streamSerialized(res, frame);
+                streamed.* += 1;
+            }
+            std.debug.assert(reader.data.len == 0);
+        }
+    }
+
+    /// Re-randomizes as many of `cts` as fit into one batch on the session's
+    /// worker and returns a copy of the result frames; caller owns it
+    fn rerandomizeBatch(self: *WorkerPool, conn: *pg.Conn, sessionId: SessionId, cts: []const openfhe.Ciphertext) ![]u8 {
+        const w = self.workerFor(sessionId);
+        w.mutex.lock();
+        defer w.mutex.unlock();
+
+        var frames = try fillBatch(w.region[0..batch_size], cts);
+        // A ciphertext larger than a batch goes alone, in the whole region
+        if (frames.count == 0) frames = try fillBatch(w.region, cts[0..1]);
+        if (frames.count == 0) return error.CiphertextTooLarge;
+
+        var keySent = false;
+        while (true) {
+            const resp = try self.exchange(w, .{
+                .op = @intFromEnum(Op.rerandomize),
+                .count = frames.count,
+                .len = frames.len,
+                .session = sessionId,
+            });
+            switch (try statusOf(resp)) {
+                .ok => {
+                    if (resp.count != frames.count or resp.len > w.region.len) return error.WorkerRejected;
+                    var reader = FrameReader{ .data = w.region[0..resp.len] };
+                    var count: u32 = 0;
+                    while (reader.next()) |_| count += 1;
+                    if (count != frames.count or reader.data.len != 0) return error.WorkerRejected;
+                    return self.allocator.dupe(u8, w.region[0..resp.len]);
+                },
+                // First download of the session: the worker needs the key.
+                // Sending it overwrites the region, so the batch is written again.
+                .unknown_session => {
+                    if (keySent) return error.UnknownSession;
+                    var row = (try conn.row("SELECT public_key FROM keys WHERE session_id = $1;", .{@as([]const u8, &sessionId)})) orelse return error.UnknownSession;
+                    defer row.deinit() catch {};
+                    try self.sendKey(w, sessionId, row.get([]u8, 0));
+                    keySent = true;
+                    frames = try fillBatch(frames.region, cts[0..frames.count]);
+                },
+                else => return error.WorkerRejected,
+            }
+        }
+    }
+
+    fn workerFor(self: *WorkerPool, sessionId: SessionId) *Worker {
+        return &self.workers[std.hash.Wyhash.hash(0, &sessionId) % self.workers.len];
+    }
+
+    fn sendKey(self: *WorkerPool, w: *Worker, sessionId: SessionId, publicKey: []const u8) !void {
+        var frames = FrameWriter{ .region = w.region };
+        try frames.putBytes(publicKey);
+        const resp = try self.exchange(w, .{
+            .op = @intFromEnum(Op.prepare),
+            .count = 1,
+            .len = frames.len,
+            .session = sessionId,
+        });
+        if (try statusOf(resp) != .ok) return error.InvalidPublicKey;
+    }
+
+    /// One request and its response. A worker that does not answer is
+    /// restarted and the request fails with `error.WorkerFailed`.
+    fn exchange(self: *WorkerPool, w: *Worker, req: Request) !Response {
+        if (w.child == null) try self.spawn(w);
+
+        var resp: Response = undefined;
+        const answered = blk: {
+            // No SIGPIPE if the worker is gone: the send just fails
+            _ = posix.send(w.socket, std.mem.asBytes(&req), posix.MSG.NOSIGNAL) catch break :blk false;
+            // A worker that hangs without dying never closes the socket
+            var pending = [_]posix.pollfd{.{ .fd = w.socket, .events = posix.POLL.IN, .revents = 0 }};
+            if ((posix.poll(&pending, answer_timeout_ms) catch break :blk false) == 0) break :blk false;
+            const n = posix.read(w.socket, std.mem.asBytes(&resp)) catch break :blk false;
+            break :blk n == @sizeOf(Response);
+        };
+        if (!answered) {
+            std.log.err("FHE worker {} stopped answering, restarting it", .{w.index});
+            self.stop(w);
+            self.spawn(w) catch |err| std.log.err("could not restart FHE worker {}: {}", .{ w.index, err });
+            return error.WorkerFailed;
+        }
+        return resp;
+    }
+
+    fn spawn(self: *WorkerPool, w: *Worker) !void {
+        var fds: [2]i32 = undefined;
+        switch (posix.errno(linux.socketpair(linux.AF.UNIX, linux.SOCK.SEQPACKET | linux.SOCK.CLOEXEC, 0, &fds))) {
+            .SUCCESS => {},
+            else => |err| return posix.unexpectedErrno(err),
+        }
+        errdefer posix.close(fds[0]);
+        defer posix.close(fds[1]);
+
+        self.spawnMutex.lock();
+        defer self.spawnMutex.unlock();
+
+        try setInheritable(fds[1], true);
+        try setInheritable(w.memfd, true);
+        defer setInheritable(w.memfd, false) catch {};
+
+        var fdsBuf: [32]u8 = undefined;
+        const argv = try self.allocator.alloc([]const u8, self.args.len + 2);
+        defer self.allocator.free(argv);
+        argv[0] = self.exePath;
+        for (self.args[1..], argv[1..self.args.len]) |arg, *slot| slot.* = arg;
+        argv[self.args.len] = "--worker-fds";
+        argv[self.args.len + 1] = try std.fmt.bufPrint(&fdsBuf, "{d},{d}", .{ fds[1], w.memfd });
+
+        var child = std.process.Child.init(argv, self.allocator);
+        child.env_map = &self.env;
+        child.stdin_behavior = .Ignore;
+        try child.spawn();
+
+        w.child = child;
+        w.socket = fds[0];
+        std.log.info("FHE worker {} started (pid {})", .{ w.index, child.id });
+    }
+
+    fn close(self: *WorkerPool, w: *Worker) void {
+        self.stop(w);
+        posix.munmap(w.region);
+        posix.close(w.memfd);
+    }
+
+    /// Kills the worker's process; its region stays mapped for the next one
+    fn stop(_: *WorkerPool, w: *Worker) void {
+        if (w.child) |*child| {
+            _ = child.kill() catch {};
+            w.child = null;
+        }
+        if (w.socket >= 0) {
+            posix.close(w.socket);
+            w.socket = -1;
+        }
+    }
+};
+
+/// Writes frames of `cts` into `region` until one does not fit
+fn fillBatch(region: []u8, cts: []const openfhe.Ciphertext) !FrameWriter {
+    var frames = FrameWriter{ .region = region };
+    for (cts) |ct| {
+        frames.putCiphertext(ct) catch |err| switch (err) {
+            error.RegionFull => break,
+            else => return err,
+        };
+    }
+    return frames;
+}
+
+fn statusOf(resp: Response) !Status {
+    return std.meta.intToEnum(Status, resp.status) catch error.WorkerRejected;
+}
+
+fn setInheritable(fd: posix.fd_t, inheritable: bool) !void {
+    const flags = try posix.fcntl(fd, posix.F.GETFD, 0);
+    const cloexec: usize = posix.FD_CLOEXEC;
+    _ = try posix.fcntl(fd, posix.F.SETFD, if (inheritable) flags & ~cloexec else flags | cloexec);
+}
+
+test "frames round-trip through a region" {
+    var region: [32]u8 = undefined;
+    var writer = FrameWriter{ .region = &region };
+    try writer.putBytes("key");
+    try writer.putBytes("");
+    try writer.putBytes("ciphertext");
+    try std.testing.expectEqual(@as(u32, 3), writer.count);
+    try std.testing.expectEqual(@as(usize, 3 * 4 + 3 + 10), writer.len);
+
+    // A frame that does not fit leaves the earlier ones intact
+    try std.testing.expectError(error.RegionFull, writer.putBytes("too long to fit"));
+    try std.testing.expect(writer.overflow);
+    try std.testing.expectEqual(@as(u32, 3), writer.count);
+
+    var reader = FrameReader{ .data = region[0..writer.len] };
+    try std.testing.expectEqualStrings("key", reader.next().?);
+    try std.testing.expectEqualStrings("", reader.next().?);
+    try std.testing.expectEqualStrings("ciphertext", reader.next().?);
+    try std.testing.expectEqual(@as(?[]const u8, null), reader.next());
+
+    // Truncated frames are not returned
+    var truncated = FrameReader{ .data = region[0 .. writer.len - 1] };
+    _ = truncated.next().?;
+    _ = truncated.next().?;
+    try std.testing.expectEqual(@as(?[]const u8, null), truncated.next());
+    var header = FrameReader{ .data = region[0..2] };
+    try std.testing.expectEqual(@as(?[]const u8, null), header.next());
+}
+
+test "worker descriptors parse from the command line" {
+    try std.testing.expectEqual(Fds{ .socket = 3, .region = 7 }, Fds.parse("3,7").?);
+    try std.testing.expectEqual(@as(?Fds, null), Fds.parse("3"));
+    try std.testing.expectEqual(@as(?Fds, null), Fds.parse("3,7,9"));
+    try std.testing.expectEqual(@as(?Fds, null), Fds.parse("3,x"));
+    try std.testing.expectEqual(@as(?Fds, null), Fds.parse(""));
+}
+
+test "downloads larger than a region go in batches" {
+    const allocator = std.testing.allocator;
+
+    var ctx = try openfhe.CryptoContext.createBgv(.{});
+    defer ctx.deinit();
+    try ctx.enablePke();
+    var kp = try ctx.keyGen();
+    defer kp.deinit();
+    var pk = kp.getPublicKey();
+    defer pk.deinit();
+
+    var pt = try ctx.makePackedPlaintext(&.{ 1, 2, 3 });
+    defer pt.deinit();
+    var cts: [5]openfhe.Ciphertext = undefined;
+    for (&cts) |*ct| ct.* = try ctx.encrypt(pk, pt);
+    defer for (&cts) |*ct| ct.deinit();
+
+    const frame = try cts[0].serialize(.binary, allocator);
+    defer allocator.free(frame);
+
+    // Room for two and a half frames
+    const region = try allocator.alloc(u8, 5 * (4 + frame.len) / 2);
+    defer allocator.free(region);
+
+    var sent: usize = 0;
+    var batches: usize = 0;
+    while (sent < cts.len) : (batches += 1) {
+        const frames = try fillBatch(region, cts[sent..]);
+        try std.testing.expect(frames.count > 0);
+        var reader = FrameReader{ .data = region[0..frames.len] };
+        while (reader.next()) |bytes| : (sent += 1) {
+            var ct = try openfhe.Ciphertext.deserialize(ctx, bytes, .binary);
+            ct.deinit();
+        }
+    }
+    try std.testing.expectEqual(@as(usize, 3), batches);
+
+    // A ciphertext that fits nowhere yields an empty batch
+    const tiny = try fillBatch(region[0..16], &cts);
+    try std.testing.expectEqual(@as(u32, 0), tiny.count);
+    try std.testing.expectEqual(@as(usize, 0), tiny.len);
+}
@@ -0,0 +1,201 @@
+//! Pools of encryptions of zero for re-randomizing results.
+//!
+//! Every result is re-randomized before it is downloaded, so it reveals
+//! nothing about the computation beyond its plaintext. Each session gets a
+//! pool of fresh encryptions of zero under its public key, so a download only
+//! pays for one addition per result instead of a public-key encryption. One
+//! idle-priority thread refills all pools in turn, and together they hold at
+//! most the budget set with `openfhe.ZeroPool.setBudget`.
+//!
+//! Pools are created on a session's first download, so sessions that never
+//! download cost nothing, and dropped once the session has been idle for
+//! `idle_timeout_ms`.
+//! A pool starts at `capacity` encryptions and grows to the largest download
+//! its session has made, up to `max_capacity`, so repeated downloads of the
+//! same size are served from the pool in full.
+
+const std = @import("std");
+const pg = @import("pg");
+const openfhe = @import("openfhe");
+
+pub const SessionId = [36]u8;
+
+/// Outputs of a k = 3 histogram, the largest single kernel result
+pub const default_capacity = 16;
+/// Bound on the growth of one session's pool
+pub const max_capacity = 256;
+/// Memory all pools hold together
+pub const default_budget_mb = 256;
+pub const default_idle_timeout_ms = 10 * std.time.ms_per_min;
+const sweep_interval_ns = 30 * std.time.ns_per_s;
+
+pub const ZeroPools = struct {
+    allocator: std.mem.Allocator,
+    fhe: openfhe.CryptoContext,
+    /// Encryptions initially kept ready per session; one result needs one
+    capacity: usize,
+    idle_timeout_ms: i64,
+
+    mutex: std.Thread.Mutex = .{},
+    pools: std.AutoHashMapUnmanaged(SessionId, Entry) = .empty,
+
+    sweeper: ?std.Thread = null,
+    stopSweeper: std.Thread.ResetEvent = .{},
+
+    const Entry = struct {
+        pool: openfhe.ZeroPool,
+        users: u32,
+        lastUsedMs: i64,
+    };
+
+    pub fn init(allocator: std.mem.Allocator, fhe: openfhe.CryptoContext, capacity: usize, idle_timeout_ms: i64) ZeroPools {
+        return .{
+            .allocator = allocator,
+            .fhe = fhe,
+            .capacity = capacity,
+            .idle_timeout_ms = idle_timeout_ms,
+        };
+    }
+
+    pub fn deinit(self: *ZeroPools) void {
+        if (self.sweeper) |thread| {
+            self.stopSweeper.set();
+            thread.join();
+        }
+        var it = self.pools.valueIterator();
+        while (it.next()) |entry| entry.pool.deinit();
+        self.pools.deinit(self.allocator);
+    }
+
+    /// Creates the session's pool from a public key sent along with its first
+    /// download, for processes that cannot look the key up themselves
+    pub fn prepare(self: *ZeroPools, sessionId: SessionId, pk: openfhe.PublicKey) !void {
+        _ = try self.install(sessionId, try openfhe.ZeroPool.init(self.fhe, pk, self.capacity));
+        self.release(sessionId);
+    }
+
+    /// Re-randomizes each ciphertext in place under the session's public key.
+    /// Without a `conn` to look the key up, a session that has no pool yet
+    /// fails with `error.UnknownSession`.
+    pub fn rerandomize(self: *ZeroPools, conn: ?*pg.Conn, sessionId: SessionId, cts: []const openfhe.Ciphertext) !void {
+        const pool = try self.acquire(conn, sessionId);
+        defer self.release(sessionId);
+        // Sessions tend to download batches of the same size
+        pool.reserve(@min(cts.len, max_capacity));
+        for (cts) |ct| try ct.rerandomize(pool);
+    }
+
+    /// Drops the session's pool, e.g. when it is deleted. A pool still in use
+    /// is left to the sweeper.
+    pub fn forget(self: *ZeroPools, sessionId: SessionId) void {
+        const pool = blk: {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            const entry = self.pools.getPtr(sessionId) orelse return;
+            if (entry.users > 0) {
+                entry.lastUsedMs = 0;
+                return;
+            }
+            break :blk self.pools.fetchRemove(sessionId).?.value.pool;
+        };
+        var owned = pool;
+        owned.deinit();
+    }
+
+    /// Drops the pools of every session idle for longer than the timeout
+    pub fn sweep(self: *ZeroPools) void {
+        var idle: std.ArrayList(openfhe.ZeroPool) = .empty;
+        defer idle.deinit(self.allocator);
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            const cutoff = std.time.milliTimestamp() - self.idle_timeout_ms;
+            var it = self.pools.iterator();
+            while (it.next()) |entry| {
+                if (entry.value_ptr.users > 0 or entry.value_ptr.lastUsedMs > cutoff) continue;
+                // Keep the pool if there is no room to defer its destruction
+                idle.append(self.allocator, entry.value_ptr.pool) catch break;
+                // Removing the current entry keeps the iterator valid
+                self.pools.removeByPtr(entry.key_ptr);
+            }
+        }
+        // Joining a refill thread may wait for an encryption, so do it unlocked
+        for (idle.items) |*pool| pool.deinit();
+    }
+
+    pub fn startSweeper(self: *ZeroPools) !void {
+        self.sweeper = try std.Thread.spawn(.{}, runSweeper, .{self});
+    }
+
+    fn runSweeper(self: *ZeroPools) void {
+        while (true) {
+            self.stopSweeper.timedWait(sweep_interval_ns) catch {
+                self.sweep();
+                continue;
+            };
+            return;
+        }
+    }
+
+    /// Pool of the session, created from its registered public key if needed.
+    /// Must be paired with `release`.
+    fn acquire(self: *ZeroPools, conn: ?*pg.Conn, sessionId: SessionId) !openfhe.ZeroPool {
+        if (self.touch(sessionId)) |pool| return pool;
+
+        var row = (try (conn orelse return error.UnknownSession).row("SELECT public_key FROM keys WHERE session_id = $1;", .{@as([]const u8, &sessionId)})) orelse return error.UnknownSession;
+        defer row.deinit() catch {};
+        return self.install(sessionId, try self.create(row.get([]u8, 0)));
+    }
+
+    fn release(self: *ZeroPools, sessionId: SessionId) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.pools.getPtr(sessionId)) |entry| {
+            entry.users -= 1;
+            if (entry.lastUsedMs != 0) entry.lastUsedMs = std.time.milliTimestamp();
+        }
+    }
+
+    fn create(self: *ZeroPools, publicKey: []const u8) !openfhe.ZeroPool {
+        var pk = try openfhe.PublicKey.deserialize(publicKey, .binary);
+        defer pk.deinit();
+        return openfhe.ZeroPool.init(self.fhe, pk, self.capacity);
+    }
+
+    /// Registers a freshly created pool as in use. If another request created
+    /// one for the session in the meantime, that one wins.
+    fn install(self: *ZeroPools, sessionId: SessionId, created: openfhe.ZeroPool) !openfhe.ZeroPool {
+        var pool = created;
+        var spare: ?openfhe.ZeroPool = null;
+        defer if (spare) |*p| p.deinit();
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = self.pools.getOrPut(self.allocator, sessionId) catch |err| {
+            spare = pool;
+            return err;
+        };
+        if (entry.found_existing) {
+            spare = pool;
+            entry.value_ptr.users += 1;
+            entry.value_ptr.lastUsedMs = std.time.milliTimestamp();
+            return entry.value_ptr.pool;
+        }
+        entry.value_ptr.* = .{ .pool = pool, .users = 1, .lastUsedMs = std.time.milliTimestamp() };
+        return pool;
+    }
+
+    /// Marks the session's pool as used; null if it has none
+    fn touch(self: *ZeroPools, sessionId: SessionId) ?openfhe.ZeroPool {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = self.pools.getPtr(sessionId) orelse return null;
+        entry.users += 1;
+        entry.lastUsedMs = std.time.milliTimestamp();
+        return entry.pool;
+    }
+};
@@ -1,4 +1,4 @@
-import { initOpenFHE, generateBGVContext, serializePublicKey, registerPublicKey } from './openfhe-utils.js';
+import { initOpenFHE, fetchParams, generateBGVContext, serializePublicKey, registerPublicKey } from './openfhe-utils.js';
 
 const generateBtn = document.getElementById('generateBtn');
 const loadingDiv = document.getElementById('loading');
@@ -40,16 +40,19 @@ async function handleGenerateKey() {
             console.log('OpenFHE WASM module loaded');
         }
 
+        setLoading(true, 'Fetching server parameters...');
+        const params = await fetchParams();
+
         setLoading(true, 'Generating BGV key pair...');
-        const { cc, keyPair } = generateBGVContext(openfhe);
+        const { cc, keyPair } = generateBGVContext(openfhe, params);
         console.log('BGV context created, keys generated');
 
         setLoading(true, 'Serializing public key...');
-        const publicKeyBase64 = serializePublicKey(openfhe, keyPair.publicKey);
-        console.log(`Public key serialized (${publicKeyBase64.length} bytes base64)`);
+        const publicKey = serializePublicKey(openfhe, keyPair.publicKey);
+        console.log(`Public key serialized (${publicKey.byteLength} bytes)`);
 
         setLoading(true, 'Registering with server...');
-        const result = await registerPublicKey(publicKeyBase64);
+        const result = await registerPublicKey(publicKey);
         console.log('Registration successful:', result);
 
         setLoading(false);
@@ -1,33 +1,31 @@
-Uint8Array.prototype.toBase64 = function() {
-    let binary = '';
-    const len = this.byteLength;
-    for (let i = 0; i < len; i++) {
-        binary += String.fromCharCode(this[i]);
-    }
-    return btoa(binary);
-};
-
-Uint8Array.fromBase64 = function(base64) {
-    const binaryString = atob(base64);
-    const len = binaryString.length;
-    const bytes = new Uint8Array(len);
-    for (let i = 0; i < len; i++) {
-        bytes[i] = binaryString.charCodeAt(i);
-    }
-    return bytes;
-};
-
 export async function initOpenFHE() {
     const factory = await import('/static/js/openfhe/openfhe_pke_es6.js');
     const openfhe = await factory.default();
     return openfhe;
 }
 
-export function generateBGVContext(openfhe) {
+// Parameters of the server's BGV context; keys and ciphertexts are only
+// usable with a context built from the same values
+export async function fetchParams() {
+    const response = await fetch('/api/v0.1.0/params');
+    if (!response.ok) {
+        throw new Error(`Fetching parameters failed (${response.status})`);
+    }
+    return await response.json();
+}
+
+export function generateBGVContext(openfhe, serverParams) {
+    const securityLevels = {
+        128: openfhe.SecurityLevel.HEStd_128_classic,
+        192: openfhe.SecurityLevel.HEStd_192_classic,
+        256: openfhe.SecurityLevel.HEStd_256_classic,
+    };
+
     const params = new openfhe.CCParamsCryptoContextBGVRNS();
-    params.SetMultiplicativeDepth(2);
-    params.SetPlaintextModulus(65537);
-    params.SetSecurityLevel(openfhe.SecurityLevel.HEStd_128_classic);
+    params.SetMultiplicativeDepth(serverParams.multiplicativeDepth);
+    params.SetPlaintextModulus(serverParams.plaintextModulus);
+    params.SetRingDim(serverParams.ringDim);
+    params.SetSecurityLevel(securityLevels[serverParams.securityLevel] ?? securityLevels[128]);
 
     const cc = new openfhe.GenCryptoContextBGV(params);
     cc.Enable(openfhe.PKESchemeFeature.PKE);
@@ -39,20 +37,19 @@ export function generateBGVContext(openfhe) {
 }
 
 export function serializePublicKey(openfhe, publicKey) {
-    const serialized = openfhe.SerializePublicKeyToBuffer(
+    return openfhe.SerializePublicKeyToBuffer(
         publicKey,
         openfhe.SerType.BINARY
     );
-    return serialized.toBase64();
 }
 
-export async function registerPublicKey(publicKeyBase64) {
+export async function registerPublicKey(publicKey) {
     const response = await fetch('/api/v0.1.0/register', {
         method: 'POST',
         headers: {
-            'Content-Type': 'application/json'
+            'Content-Type': 'application/octet-stream'
         },
-        body: JSON.stringify({ publicKey: publicKeyBase64 })
+        body: publicKey
     });
 
     if (!response.ok) {
@@ -62,3 +59,90 @@ export async function registerPublicKey(publicKeyBase64) {
 
     return await response.json();
 }
+
+// Upload serialized ciphertexts (Uint8Array each) as one length-prefixed
+// stream. The Blob keeps the parts separate, so nothing is concatenated in
+// memory and the server decodes them as they arrive.
+export async function uploadCiphertexts(sessionId, serializedCiphertexts) {
+    const parts = [];
+    for (const ct of serializedCiphertexts) {
+        const prefix = new Uint8Array(4);
+        new DataView(prefix.buffer).setUint32(0, ct.byteLength, true);
+        parts.push(prefix, ct);
+    }
+
+    const response = await fetch(`/api/v0.1.0/sessions/${sessionId}/ciphertexts`, {
+        method: 'POST',
+        headers: {
+            'Content-Type': 'application/octet-stream'
+        },
+        body: new Blob(parts)
+    });
+
+    if (!response.ok) {
+        const text = await response.text();
+        throw new Error(`Upload failed (${response.status}): ${text}`);
+    }
+
+    return await response.json();
+}
+
+// Upload serialized evaluation keys; `kind` is 'mult' or 'automorphism'.
+// The server keeps one copy per distinct blob, so repeating an upload is cheap.
+export async function uploadEvalKeys(sessionId, kind, serializedKeys) {
+    const response = await fetch(`/api/v0.1.0/sessions/${sessionId}/eval-keys/${kind}`, {
+        method: 'PUT',
+        headers: {
+            'Content-Type': 'application/octet-stream'
+        },
+        body: serializedKeys
+    });
+
+    if (!response.ok) {
+        const text = await response.text();
+        throw new Error(`Evaluation key upload failed (${response.status}): ${text}`);
+    }
+
+    return await response.json();
+}
+
+// Download pending results as serialized ciphertexts (Uint8Array each). Each
+// ciphertext arrives as length-prefixed blocks closed by an empty block.
+export async function downloadResults(sessionId) {
+    const response = await fetch(`/api/v0.1.0/sessions/${sessionId}/results`);
+
+    if (!response.ok) {
+        const text = await response.text();
+        throw new Error(`Download failed (${response.status}): ${text}`);
+    }
+
+    const body = new Uint8Array(await response.arrayBuffer());
+    const view = new DataView(body.buffer, body.byteOffset, body.byteLength);
+    const ciphertexts = [];
+    let blocks = [];
+    let offset = 0;
+    while (offset + 4 <= body.byteLength) {
+        const length = view.getUint32(offset, true);
+        offset += 4;
+        if (length === 0) {
+            ciphertexts.push(concatBlocks(blocks));
+            blocks = [];
+            continue;
+        }
+        blocks.push(body.subarray(offset, offset + length));
+        offset += length;
+    }
+
+    return ciphertexts;
+}
+
+function concatBlocks(blocks) {
+    const size = blocks.reduce((sum, block) => sum + block.byteLength, 0);
+    const out = new Uint8Array(size);
+    let offset = 0;
+    for (const block of blocks) {
+        out.set(block, offset);
+        offset += block.byteLength;
+    }
+    return out;
+}